@@ -4,285 +4,4238 @@
 #include <vector>
 #include <fstream>
 #include <cstring>
+#include <cstdio>
 #include <map>
+#include <set>
 #include <sstream>
+#include <algorithm>
 #include <conio.h> 
 
 // 平台相关的头文件
 #ifdef _WIN32
     #include <windows.h>
     #include <tchar.h>
+    #include <io.h>
+    #include <setjmp.h>
 #else
     #include <dirent.h>
     #include <unistd.h>
     #include <limits.h>
     #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <signal.h>
+    #include <setjmp.h>
 #endif
 
 #include <windows.h>
 #include <functional>
 
-class BrainfuckCompiler {
+// JIT只支持x86-64，其他平台jit()退回解释执行
+#if defined(__x86_64__) || defined(_M_X64)
+    #define BFX_JIT_X64 1
+#endif
+
+// GCC/Clang支持computed goto时解释器用直接线索化分派，否则（或定义BFX_NO_THREADED_DISPATCH时）用switch
+#if defined(__GNUC__) && !defined(BFX_NO_THREADED_DISPATCH)
+    #define BFX_THREADED_DISPATCH 1
+#endif
+
+// JIT机器码所在的内存：先可读写，写完改为只读可执行
+class ExecutableMemory {
 private:
-    std::vector<uint8_t> memory;
-    size_t data_pointer;
-    std::string code;
-    size_t instruction_pointer;
-    
-    // 浼樺寲锛氶璁＄畻璺宠浆浣嶇疆
-    std::vector<size_t> jump_forward;
-    std::vector<size_t> jump_backward;
+    void* address;
+    size_t length;
 
 public:
-    static const size_t MEMORY_SIZE = 30000;
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+    ExecutableMemory() : address(nullptr), length(0) {}
 
-    BrainfuckCompiler() : memory(MEMORY_SIZE, 0), data_pointer(0), instruction_pointer(0) {
-        jump_forward.resize(MEMORY_SIZE);
-        jump_backward.resize(MEMORY_SIZE);
+    ~ExecutableMemory() {
+        release();
     }
 
-    // 棰勮绠楀惊鐜烦杞綅缃?
-    void precomputeJumps() {
-        std::stack<size_t> loop_stack;
+    // 把机器码复制到新分配的可执行内存中
+    bool load(const std::vector<unsigned char>& bytes) {
+        release();
+        if (bytes.empty()) {
+            return false;
+        }
+#ifdef _WIN32
+        void* block = VirtualAlloc(nullptr, bytes.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (block == nullptr) {
+            return false;
+        }
+        memcpy(block, &bytes[0], bytes.size());
+        DWORD old_protect;
+        if (!VirtualProtect(block, bytes.size(), PAGE_EXECUTE_READ, &old_protect)) {
+            VirtualFree(block, 0, MEM_RELEASE);
+            return false;
+        }
+        FlushInstructionCache(GetCurrentProcess(), block, bytes.size());
+#else
+        void* block = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) {
+            return false;
+        }
+        memcpy(block, &bytes[0], bytes.size());
+        if (mprotect(block, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+            munmap(block, bytes.size());
+            return false;
+        }
+#endif
+        address = block;
+        length = bytes.size();
+        return true;
+    }
 
-        for (size_t i = 0; i < code.length(); i++) {
-            char c = code[i];
+    // 释放可执行内存
+    void release() {
+        if (address == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        VirtualFree(address, 0, MEM_RELEASE);
+#else
+        munmap(address, length);
+#endif
+        address = nullptr;
+        length = 0;
+    }
 
-            if (c == '[') {
-                loop_stack.push(i);
-            } else if (c == ']') {
-                if (loop_stack.empty()) {
-                    throw std::runtime_error("Unmatched ']' at position " + std::to_string(i));
+    // 获取机器码入口地址，未载入时返回nullptr
+    void* entry() const {
+        return address;
+    }
+};
+
+// '.'的输出缓冲区：缓冲区满、读取输入前、执行结束或行缓冲模式遇到换行时才整块写出
+class OutputSink {
+private:
+    static const size_t BUFFER_SIZE = 65536;
+    std::vector<char> buffer;
+    size_t used;
+    FILE* target;  // nullptr时丢弃输出
+    bool line_buffered;
+
+public:
+    explicit OutputSink(FILE* file = stdout) : buffer(BUFFER_SIZE), used(0), target(file), line_buffered(false) {
+    }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink() {
+        flush();
+    }
+
+    void setLineBuffered(bool enabled) {
+        line_buffered = enabled;
+    }
+
+    bool isLineBuffered() const {
+        return line_buffered;
+    }
+
+    // 更换输出目标，返回原来的目标；nullptr丢弃之后的输出（倒退调试时重新执行已输出过的部分）
+    FILE* redirect(FILE* file) {
+        FILE* previous = target;
+        target = file;
+        return previous;
+    }
+
+    void put(char c) {
+        buffer[used++] = c;
+        if (used == BUFFER_SIZE || (line_buffered && c == '\n')) {
+            flush();
+        }
+    }
+
+    void write(const char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            put(data[i]);
+        }
+    }
+
+    // std::cout与stdio同步，和其他std::cout输出的先后顺序不会错乱
+    void flush() {
+        if (target == nullptr) {
+            used = 0;
+            return;
+        }
+        if (used > 0) {
+            fwrite(buffer.data(), 1, used, target);
+            used = 0;
+        }
+        fflush(target);
+    }
+};
+
+// ','的输入来源：按块读入缓冲区（终端上每次一行，管道/文件每次一整块，或直接使用内存数据）
+class InputSource {
+public:
+    // 读到输入末尾后','对单元的处理
+    enum EofMode {
+        EOF_UNCHANGED,   // 保持原值
+        EOF_ZERO,        // 写入0
+        EOF_MINUS_ONE    // 写入-1（255）
+    };
+
+private:
+    static const size_t BUFFER_SIZE = 65536;
+    std::string data;
+    size_t position;
+    FILE* file;          // nullptr表示只读data中的内存数据
+    bool owns_file;
+    bool interactive;
+    bool finished;
+    EofMode eof_mode;
+    bool skip_newlines;
+    bool recording;      // 保留读过的数据，见setRecording()
+
+    static bool isTerminal(FILE* f) {
+#ifdef _WIN32
+        return _isatty(_fileno(f)) != 0;
+#else
+        return isatty(fileno(f)) != 0;
+#endif
+    }
+
+    void reset() {
+        if (owns_file && file != nullptr) {
+            fclose(file);
+        }
+        file = nullptr;
+        owns_file = false;
+        interactive = false;
+        finished = false;
+        data.clear();
+        position = 0;
+    }
+
+    // 读入下一块，没有数据时返回false
+    bool refill() {
+        if (file == nullptr || finished) {
+            return false;
+        }
+        const size_t start = recording ? data.size() : 0;  // 记录时接在读过的数据之后
+        data.resize(start + BUFFER_SIZE);
+        size_t length = 0;
+        if (interactive) {
+            // 终端上只读一行，不等待后续输入
+            int c;
+            while (length < BUFFER_SIZE && (c = getc(file)) != EOF) {
+                data[start + length++] = static_cast<char>(c);
+                if (c == '\n') break;
+            }
+        } else {
+            length = fread(&data[start], 1, BUFFER_SIZE, file);
+        }
+        data.resize(start + length);
+        position = start;
+        if (length == 0) {
+            finished = true;
+            if (interactive) clearerr(file); // 终端上的EOF不影响之后的菜单输入
+            return false;
+        }
+        return true;
+    }
+
+public:
+    InputSource() : position(0), file(nullptr), owns_file(false), interactive(false),
+                    finished(false), eof_mode(EOF_ZERO), skip_newlines(false), recording(false) {
+        useStdin();
+    }
+
+    InputSource(const InputSource&) = delete;
+    InputSource& operator=(const InputSource&) = delete;
+
+    ~InputSource() {
+        reset();
+    }
+
+    void useStdin() {
+        reset();
+        file = stdin;
+        interactive = isTerminal(stdin);
+    }
+
+    // 打开失败时返回false，之后视为空输入
+    bool openFile(const std::string& path) {
+        reset();
+        file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        owns_file = true;
+        return true;
+    }
+
+    void setData(const std::string& input) {
+        reset();
+        data = input;
+    }
+
+    void setEofMode(EofMode mode) {
+        eof_mode = mode;
+    }
+
+    EofMode getEofMode() const {
+        return eof_mode;
+    }
+
+    void setSkipNewlines(bool enabled) {
+        skip_newlines = enabled;
+    }
+
+    // 下一次get()需要读入新数据（可能等待输入），此时应先刷新输出、显示提示
+    bool needsRefill() const {
+        return position >= data.size() && file != nullptr && !finished;
+    }
+
+    bool isInteractive() const {
+        return interactive;
+    }
+
+    // 记录期间从文件读入的数据都保留下来（缓冲区只增不减），可以用rewind()回到之前的位置；get()没有额外开销
+    void setRecording(bool enabled) {
+        recording = enabled;
+    }
+
+    size_t getCursor() const {
+        return position;
+    }
+
+    // 回到getCursor()返回的位置，先重复读过的数据再继续读新输入；EOF之后不再读文件，重复执行同样读到EOF
+    void rewind(size_t cursor) {
+        position = std::min(cursor, data.size());
+    }
+
+    // 返回下一个字节，输入结束时返回-1
+    int get() {
+        for (;;) {
+            if (position >= data.size() && !refill()) {
+                return -1;
+            }
+            unsigned char c = static_cast<unsigned char>(data[position++]);
+            if (!(skip_newlines && c == '\n')) {
+                return c;
+            }
+        }
+    }
+
+    template <typename Cell>
+    void readCell(Cell& cell) {
+        int c = get();
+        if (c >= 0) {
+            cell = static_cast<Cell>(c);
+        } else if (eof_mode == EOF_ZERO) {
+            cell = 0;
+        } else if (eof_mode == EOF_MINUS_ONE) {
+            cell = static_cast<Cell>(-1);
+        }
+    }
+};
+
+// 扫描循环的SIMD加速：x86-64上总有SSE2；GCC/Clang另编一份AVX2版本，运行时检测CPU后选用
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define BFX_SCAN_SSE2 1
+    #if defined(__GNUC__)
+        #include <immintrin.h>
+        #define BFX_SCAN_AVX2 1
+    #endif
+#endif
+
+// 按固定步长查找值为0的单元：步长1/2/4整块比较（2/4用掩码筛掉不相关的位置），其他步长逐个检查
+class CellScanner {
+public:
+    // 从position开始按stride查找，越过边界时回绕；找不到时与原始循环一样不会返回
+    static size_t findZeroWrapped(const uint8_t* cells, size_t size, size_t position, int stride) {
+        const long long n = static_cast<long long>(size);
+        long long start = static_cast<long long>(position);
+        for (;;) {
+            long long found = findZero(cells, n, start, stride);
+            if (found >= 0) {
+                return static_cast<size_t>(found);
+            }
+            // 本段没有0，从回绕后的位置继续
+            long long last = (stride > 0) ? start + ((n - 1 - start) / stride) * stride : start % -stride;
+            start = ((last + stride) % n + n) % n;
+        }
+    }
+
+    // 不回绕的查找，到达边界仍未找到时返回-1
+    static long long findZero(const uint8_t* cells, long long size, long long position, int stride) {
+        if (stride == 1 || stride == 2 || stride == 4) {
+            return findForward(cells, position, size, stride);
+        }
+        if (stride == -1 || stride == -2 || stride == -4) {
+            return findBackward(cells, position, -stride);
+        }
+        for (long long i = position; i >= 0 && i < size; i += stride) {
+            if (cells[i] == 0) return i;
+        }
+        return -1;
+    }
+
+private:
+    // 块内需要检查的位：向前从最低位起，向后从最高位起
+    static uint32_t forwardMask(int stride) {
+        return (stride == 1) ? 0xFFFFFFFFu : (stride == 2) ? 0x55555555u : 0x11111111u;
+    }
+
+    static uint32_t backwardMask(int stride) {
+        return (stride == 1) ? 0xFFFFFFFFu : (stride == 2) ? 0xAAAAAAAAu : 0x88888888u;
+    }
+
+    static int lowestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int n = 0;
+        while (!(bits & 1u)) { bits >>= 1; n++; }
+        return n;
+#endif
+    }
+
+    static int highestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return 31 - __builtin_clz(bits);
+#else
+        int n = 31;
+        while (!(bits & 0x80000000u)) { bits <<= 1; n--; }
+        return n;
+#endif
+    }
+
+#ifdef BFX_SCAN_AVX2
+    static bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    // 每次检查32个单元，i推进到第一个未检查的位置
+    __attribute__((target("avx2")))
+    static long long forwardAvx2(const uint8_t* cells, long long& i, long long limit, uint32_t mask) {
+        const __m256i zero = _mm256_setzero_si256();
+        for (; i + 32 <= limit; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+            uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero))) & mask;
+            if (hits) return i + lowestBit(hits);
+        }
+        return -1;
+    }
+
+    __attribute__((target("avx2")))
+    static long long backwardAvx2(const uint8_t* cells, long long& i, uint32_t mask) {
+        const __m256i zero = _mm256_setzero_si256();
+        for (; i - 31 >= 0; i -= 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i - 31));
+            uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero))) & mask;
+            if (hits) return i - 31 + highestBit(hits);
+        }
+        return -1;
+    }
+#endif
+
+    // [position, limit)内按步长1/2/4向前查找；块长是步长的倍数，块内要检查的位置固定
+    static long long findForward(const uint8_t* cells, long long position, long long limit, int stride) {
+        long long i = position;
+#ifdef BFX_SCAN_AVX2
+        if (hasAvx2()) {
+            long long found = forwardAvx2(cells, i, limit, forwardMask(stride));
+            if (found >= 0) return found;
+        }
+#endif
+#ifdef BFX_SCAN_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const uint32_t mask = forwardMask(stride) & 0xFFFFu;
+        for (; i + 16 <= limit; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+            uint32_t hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero))) & mask;
+            if (hits) return i + lowestBit(hits);
+        }
+#endif
+        for (; i < limit; i += stride) {
+            if (cells[i] == 0) return i;
+        }
+        return -1;
+    }
+
+    // 从position开始按步长1/2/4向后查找，直到位置0
+    static long long findBackward(const uint8_t* cells, long long position, int stride) {
+        long long i = position;
+#ifdef BFX_SCAN_AVX2
+        if (hasAvx2()) {
+            long long found = backwardAvx2(cells, i, backwardMask(stride));
+            if (found >= 0) return found;
+        }
+#endif
+#ifdef BFX_SCAN_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const uint32_t mask = backwardMask(stride) & 0xFFFFu;
+        for (; i - 15 >= 0; i -= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i - 15));
+            uint32_t hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero))) & mask;
+            if (hits) return i - 15 + highestBit(hits);
+        }
+#endif
+        for (; i >= 0; i -= stride) {
+            if (cells[i] == 0) return i;
+        }
+        return -1;
+    }
+};
+
+// 内存磁带：预留一整块虚拟地址，只有磁带当前长度可读写，其余（含两端保护区）不可访问
+//   [左保护区][磁带][未使用部分，最多到上限][右保护区]
+// 指针移动不检查边界，访问到不可访问的页时由SIGSEGV（Windows上为向量化异常）处理：
+// 落在磁带右侧且允许扩展就扩展后继续执行，否则跳回执行入口报告越界。长度按页取整，第0个单元紧挨左保护区；
+// 报错模式下最后一个单元之后到页末仍可读写，由执行时的显式检查报告越界（见BrainfuckCompiler::Policy::at()）
+class Tape {
+public:
+#ifdef _WIN32
+    typedef jmp_buf JumpBuffer;
+#else
+    typedef sigjmp_buf JumpBuffer;
+#endif
+    class Session;
+
+    static const size_t DEFAULT_LIMIT = 64 << 20;
+    static const size_t MIN_GUARD = 1 << 20;
+
+private:
+    uint8_t* base;
+    size_t reserved_bytes;
+    size_t guard_bytes;
+    size_t limit_bytes;
+    size_t committed_bytes;
+    size_t initial_bytes;
+    bool growable;
+    JumpBuffer jump;
+
+    static size_t pageSize() {
+        static size_t size = 0;
+        if (size == 0) {
+#ifdef _WIN32
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            size = info.dwPageSize;
+#else
+            size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        }
+        return size;
+    }
+
+    static size_t roundUp(size_t bytes) {
+        size_t page = pageSize();
+        return (bytes + page - 1) / page * page;
+    }
+
+    // 正在执行的磁带，供信号处理函数使用
+    static Tape*& activeTape() {
+        static Tape* tape = nullptr;
+        return tape;
+    }
+
+    void allocate(size_t guard) {
+        guard_bytes = roundUp(guard < MIN_GUARD ? MIN_GUARD : guard);
+        reserved_bytes = guard_bytes * 2 + limit_bytes;
+#ifdef _WIN32
+        base = static_cast<uint8_t*>(VirtualAlloc(nullptr, reserved_bytes, MEM_RESERVE, PAGE_NOACCESS));
+#else
+        void* region = mmap(nullptr, reserved_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        base = (region == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(region);
+#endif
+        if (base == nullptr) {
+            throw std::bad_alloc();
+        }
+        committed_bytes = 0;
+        if (!commitTo(initial_bytes)) {
+            release();
+            throw std::bad_alloc();
+        }
+    }
+
+    void release() {
+        if (base != nullptr) {
+#ifdef _WIN32
+            VirtualFree(base, 0, MEM_RELEASE);
+#else
+            munmap(base, reserved_bytes);
+#endif
+            base = nullptr;
+        }
+        committed_bytes = 0;
+    }
+
+    // 把磁带扩展到至少bytes字节（不超过上限），新单元为0
+    bool commitTo(size_t bytes) {
+        bytes = std::min(roundUp(bytes), limit_bytes);
+        if (bytes <= committed_bytes) {
+            return true;
+        }
+        uint8_t* start = cells() + committed_bytes;
+        size_t length = bytes - committed_bytes;
+#ifdef _WIN32
+        if (VirtualAlloc(start, length, MEM_COMMIT, PAGE_READWRITE) == nullptr) return false;
+#else
+        if (mprotect(start, length, PROT_READ | PROT_WRITE) != 0) return false;
+#endif
+        committed_bytes = bytes;
+        return true;
+    }
+
+    bool owns(const uint8_t* address) const {
+        return base != nullptr && address >= base && address < base + reserved_bytes;
+    }
+
+    // 返回true表示已扩展磁带，可以重新执行出错的指令
+    bool handleFault(const uint8_t* address) {
+        const uint8_t* begin = cells();
+        if (!growable || address < begin + committed_bytes || address >= begin + limit_bytes) {
+            return false;
+        }
+        size_t needed = static_cast<size_t>(address - begin) + 1;
+        return commitTo(std::max(needed, std::min(committed_bytes * 2, limit_bytes)));
+    }
+
+#ifdef _WIN32
+    static LONG WINAPI onException(EXCEPTION_POINTERS* info) {
+        Tape* tape = activeTape();
+        if (tape != nullptr && info->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION) {
+            const uint8_t* address = reinterpret_cast<const uint8_t*>(info->ExceptionRecord->ExceptionInformation[1]);
+            if (tape->owns(address)) {
+                if (tape->handleFault(address)) return EXCEPTION_CONTINUE_EXECUTION;
+                longjmp(tape->jump, 1);
+            }
+        }
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+#else
+    static void onSignal(int signal, siginfo_t* info, void*) {
+        Tape* tape = activeTape();
+        const uint8_t* address = static_cast<const uint8_t*>(info->si_addr);
+        if (tape != nullptr && tape->owns(address)) {
+            if (tape->handleFault(address)) return;
+            siglongjmp(tape->jump, 1);
+        }
+        // 不是磁带引起的：恢复默认处理，返回后再次出错时照常终止
+        ::signal(signal, SIG_DFL);
+    }
+#endif
+
+public:
+    explicit Tape(size_t initial_size = 30000, bool can_grow = true, size_t limit = DEFAULT_LIMIT)
+        : base(nullptr), reserved_bytes(0), guard_bytes(0), committed_bytes(0), growable(can_grow) {
+        initial_bytes = roundUp(std::max<size_t>(initial_size, 1));
+        limit_bytes = std::max(roundUp(limit), initial_bytes);
+        allocate(MIN_GUARD);
+    }
+
+    Tape(const Tape&) = delete;
+    Tape& operator=(const Tape&) = delete;
+
+    ~Tape() {
+        release();
+    }
+
+    uint8_t* cells() const {
+        return base + guard_bytes;
+    }
+
+    size_t size() const {
+        return committed_bytes;
+    }
+
+    void setGrowable(bool enabled) {
+        growable = enabled;
+    }
+
+    JumpBuffer& jumpBuffer() {
+        return jump;
+    }
+
+    // 恢复为bytes字节（按页取整）并清零；扩展出的部分归还系统，超过上限时重新预留（cells()会改变）
+    void reset(size_t bytes) {
+        size_t length = roundUp(std::max<size_t>(bytes, 1));
+        if (length > limit_bytes) {
+            release();
+            initial_bytes = limit_bytes = length;
+            allocate(guard_bytes);
+            return;
+        }
+        if (committed_bytes > length) {
+            uint8_t* start = cells() + length;
+            size_t extra = committed_bytes - length;
+#ifdef _WIN32
+            VirtualFree(start, extra, MEM_DECOMMIT);
+#else
+            mprotect(start, extra, PROT_NONE);
+            madvise(start, extra, MADV_DONTNEED);
+#endif
+            committed_bytes = length;
+        }
+        memset(cells(), 0, committed_bytes);
+        commitTo(length);
+        initial_bytes = length;
+    }
+
+    // 保证保护区不小于reach（一条指令能跨越的最大距离），必要时重新预留，cells()会改变
+    void ensureGuard(size_t reach) {
+        if (roundUp(reach) <= guard_bytes) {
+            return;
+        }
+        std::vector<uint8_t> saved(cells(), cells() + committed_bytes);
+        release();
+        allocate(reach);
+        commitTo(saved.size());
+        memcpy(cells(), saved.data(), saved.size());
+    }
+
+    // 扫描循环；扫到磁带末端时访问下一个位置，由保护页扩展磁带（新单元为0）或报告越界。
+    // 只读取前end个单元：end小于size()时其后到页末的单元不属于磁带，扫到那里时访问左侧保护区报告越界
+    ptrdiff_t scan(ptrdiff_t position, int stride, size_t end) {
+        ptrdiff_t length = static_cast<ptrdiff_t>(end);
+        ptrdiff_t next = -1;
+        if (position < length || position >= static_cast<ptrdiff_t>(size())) {
+            long long found = CellScanner::findZero(cells(), static_cast<long long>(end), position, stride);
+            if (found >= 0) {
+                return static_cast<ptrdiff_t>(found);
+            }
+            next = (stride > 0) ? position + ((length - 1 - position) / stride + 1) * stride
+                                : position % -stride + stride;
+            if (next >= length && next < static_cast<ptrdiff_t>(size())) next = -1;
+        }
+        volatile uint8_t* cell = cells() + next;
+        (void)*cell;
+        return next;
+    }
+
+    // 执行期间安装越界处理函数，析构时恢复
+    class Session {
+    private:
+        Tape* previous_tape;
+#ifdef _WIN32
+        void* handler;
+#else
+        struct sigaction previous_segv;
+        struct sigaction previous_bus;
+#endif
+
+    public:
+        explicit Session(Tape& tape) : previous_tape(activeTape()) {
+            activeTape() = &tape;
+#ifdef _WIN32
+            handler = AddVectoredExceptionHandler(1, &Tape::onException);
+#else
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_sigaction = &Tape::onSignal;
+            action.sa_flags = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGSEGV, &action, &previous_segv);
+            sigaction(SIGBUS, &action, &previous_bus); // macOS上访问保护页是SIGBUS
+#endif
+        }
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        ~Session() {
+#ifdef _WIN32
+            RemoveVectoredExceptionHandler(handler);
+#else
+            sigaction(SIGSEGV, &previous_segv, nullptr);
+            sigaction(SIGBUS, &previous_bus, nullptr);
+#endif
+            activeTape() = previous_tape;
+        }
+    };
+};
+
+// 设置越界时跳回的位置：直接返回0，越界跳回时返回非0
+#ifdef _WIN32
+    #define BFX_TAPE_SETJMP(buffer) setjmp(buffer)
+#else
+    #define BFX_TAPE_SETJMP(buffer) sigsetjmp(buffer, 1)
+#endif
+
+class BrainfuckCompiler {
+public:
+    // 指针越过磁带边界时的处理方式
+    enum PointerMode {
+        POINTER_WRAP,   // 回绕，磁带长度固定为设置的单元数
+        POINTER_ERROR,  // 访问磁带之外（或结束时指针在磁带之外）即越界
+        POINTER_GROW    // 向右越界时扩展磁带，向左越界报错
+    };
+
+    // 断点条件：cell处的值与value比较，成立时才停下
+    enum BreakCondition {
+        BREAK_ALWAYS,
+        BREAK_EQUAL,
+        BREAK_NOT_EQUAL,
+        BREAK_LESS,
+        BREAK_GREATER
+    };
+
+    // 停在position（过滤后代码中的位置）所属的IR指令执行之前
+    struct Breakpoint {
+        size_t position = 0;
+        BreakCondition condition = BREAK_ALWAYS;
+        ptrdiff_t cell = -1;  // -1为这条指令访问的单元（DP加偏移）
+        uint32_t value = 0;
+    };
+
+    // 观察点：cell改变、变为value或被'.'输出时停下
+    enum WatchKind {
+        WATCH_CHANGE,
+        WATCH_EQUAL,
+        WATCH_OUTPUT
+    };
+
+    struct Watchpoint {
+        size_t cell = 0;
+        WatchKind kind = WATCH_CHANGE;
+        uint32_t value = 0;  // 只用于WATCH_EQUAL
+    };
+
+    // debugContinue()停下的原因
+    enum DebugStop {
+        DEBUG_BREAKPOINT,  // 停在断点处，断点所在的指令还没有执行
+        DEBUG_WATCHPOINT,  // WATCH_OUTPUT停在'.'之前，其余停在改变单元的指令之后
+        DEBUG_FINISHED,
+        DEBUG_ERROR,       // 指针越界
+        DEBUG_HISTORY_START  // reverseContinue()途中没有可停的位置，回到了历史记录的起点
+    };
+
+    // 一个循环的执行统计（见setCounting()），代价以IR指令的执行次数计；
+    // lowerNestedLoops()改写过的循环只执行一轮，其余各轮由闭式计算完成
+    struct LoopProfile {
+        size_t start = 0;          // '['在code中的位置
+        size_t end = 0;            // ']'在code中的位置
+        size_t depth = 0;          // 嵌套深度，最外层为0
+        long long entries = 0;     // 进入循环体的次数，到达'['时单元为0的不计
+        long long iterations = 0;  // 循环体执行的总轮数
+        long long self_cost = 0;   // 直接属于这个循环的指令（含'['和']'，不含内层循环）的执行次数之和
+        long long total_cost = 0;  // 含内层循环
+    };
+
+private:
+    Tape tape;
+    uint8_t* memory;            // tape.cells()，单元宽度大于8位时按对应类型访问
+    ptrdiff_t data_pointer;     // 越界时可能短暂为负，由磁带的保护页检测
+    size_t tape_cells;          // 初始单元数，回绕模式下即磁带长度
+    int cell_bits;              // 单元宽度：8、16或32
+    PointerMode pointer_mode;
+    std::string code;
+    size_t instruction_pointer;
+    
+    // IR操作码：连续的+/-和</>在加载时各折叠为一条带次数的指令，
+    // 常见循环再由optimizeLoops()改写为CLEAR/MUL/SCAN（整除取余、比较写法前加闭式计算），
+    // 只剩加减、清零、乘法的外层循环由lowerNestedLoops()改写，最后由addressByOffset()把指针移动折算为单元偏移；
+    // 下面的"当前单元"都是指针加offset处的单元
+    enum OpCode {
+        OP_ADD,        // 当前单元加arg（可为负）
+        OP_MOVE,       // 指针移动arg（可为负，越界按PointerMode处理）
+        OP_OUTPUT,
+        OP_INPUT,
+        OP_LOOP_START, // arg为到匹配]的相对偏移
+        OP_LOOP_END,   // arg为到匹配[的相对偏移（负数）
+        OP_CLEAR,      // [-] / [+]
+        OP_MUL,        // [->+>++<<]的一个目标：当前单元 += 单元[from] * arg
+        OP_SCAN,       // [>] / [<<]：按步长arg移动到第一个0单元
+        OP_PRODUCT,    // 嵌套循环剩余各轮的累加：当前单元 += 单元[from] * 单元[by] * arg
+        OP_DIVMOD,     // 整除取余循环的闭式计算，from为除数单元，后面紧跟原循环（见lowerIdiom()）
+        OP_COMPARE     // 比较循环的闭式计算，from为另一个单元，arg为扫描步长，后面紧跟原循环
+    };
+    static const int OP_KINDS = OP_COMPARE + 1;
+
+    static const char* opName(int op) {
+        static const char* const names[OP_KINDS] = {
+            "add", "move", "output", "input", "loop", "end", "clear", "multiply", "scan", "product", "divmod", "compare"
+        };
+        return names[op];
+    }
+
+    struct Instruction {
+        OpCode op;
+        int arg;        // 折叠后的次数 / 乘数 / 扫描步长 / 循环跳转的相对偏移
+        int offset;     // 访问的单元相对指针的偏移（OP_MUL为目标，循环为检查的单元）
+        int from;       // OP_MUL/OP_PRODUCT读取的计数单元、OP_DIVMOD/OP_COMPARE的第二个单元相对指针的偏移
+        int by;         // OP_PRODUCT读取的另一个单元相对指针的偏移
+        size_t source;  // 对应code中的第一个字符位置
+    };
+
+    // 折叠后的IR，instruction_pointer指向这里
+    std::vector<Instruction> program;
+
+    // 紧凑编码中一条指令的操作数，offset/from/by限制在16位之内
+    struct PackedOperands {
+        int arg;
+        int16_t offset;
+        int16_t from;
+        int16_t by;
+    };
+
+    // 紧凑编码（见packProgram()）：操作码和操作数放在平行数组里，每条指令13字节（Instruction为32字节），
+    // 常见程序的整个热循环都能放进L1。操作数不再拆成各自的数组：解释器里跨回调可用的寄存器只有6个，多一个基址就多一次栈上读取
+    struct PackedProgram {
+        std::vector<uint8_t> codes;            // 处理代码编号：OpCode，之后依次为超级指令，最后一项为结束
+        std::vector<PackedOperands> operands;
+    };
+    PackedProgram packed;  // 为空时（偏移超出16位）退回switch分派
+
+    // 执行时的指令，16字节：packed的编号换算成处理代码的标签地址，分派只读一次（查编号表要读两次，基准程序上慢约三分之一）；
+    // by只有OP_PRODUCT用，直接从packed读
+    struct ThreadedInstruction {
+        const void* handler;
+        int arg;
+        int16_t offset;
+        int16_t from;
+    };
+
+    // interpretThreaded()换算出的指令，多次执行之间复用。换算要用标签地址，只能在interpretThreaded()里做：
+    // packProgram()、markBreakpoints()之后，或换了处理代码表（策略P）、停止标记时重新换算。
+    // 越界时从interpretThreaded()直接跳回，它的栈帧里不能有需要析构的局部变量
+    std::vector<ThreadedInstruction> threaded;
+    const void* const* threaded_handlers = nullptr;  // 为空时需要重新换算
+    const char* threaded_stops = nullptr;
+
+    // '.'的输出缓冲区和','的输入来源
+    OutputSink output;
+    InputSource input;
+
+    // 加载时预先执行的结果（见evaluatePrefix()），每次执行都从这里开始
+    long long prefix_budget = 0;         // 预先执行的IR指令数上限，0为不预先执行
+    std::string prefix_output;           // 预先执行期间的输出
+    bool prefix_pending = false;         // prefix_output是否还要在执行开始时写出
+    std::vector<uint32_t> prefix_cells;  // 结束时的磁带内容，到最后一个非0单元为止
+    ptrdiff_t prefix_pointer = 0;
+    size_t prefix_instruction = 0;       // 实际执行的起点
+
+    // 一段代码执行期间指针到达和访问的单元范围，相对这段代码开始时的指针（见analyzePointerRange()）
+    struct PointerRange {
+        bool bounded = true;  // 含扫描、比较或净移动不为0的循环时为false，此时low/high无意义
+        int low = 0;
+        int high = 0;
+    };
+    std::vector<PointerRange> loop_ranges;  // 下标为'['的指令位置，相对进入循环时的指针
+    PointerRange program_range;             // 整个程序，相对第0个单元
+
+    // 调试（见debugContinue()），断点在加载新代码后保留
+    std::vector<Breakpoint> breakpoints;
+    std::vector<char> break_flags;  // 各IR指令上是否有断点，比program多一项（结束）
+    ptrdiff_t stopped_at = -1;      // 上次停下的指令，从这里继续时先执行它
+    int hit_breakpoint = -1;
+    std::vector<Watchpoint> watchpoints;  // 不为空时debugContinue()改用engine.watch
+    std::vector<uint32_t> watch_values;   // 各观察点的单元上次检查时的值
+    int hit_watchpoint = -1;
+
+    // 倒退调试（见setHistory()）：每隔history_interval条指令保存一个检查点，倒退时从检查点重新执行
+    struct Checkpoint {
+        long long executed = 0;
+        size_t instruction_pointer = 0;
+        ptrdiff_t data_pointer = 0;
+        size_t input_cursor = 0;
+        std::vector<uint8_t> cells;  // 磁带到最后一个非0字节为止
+    };
+    static const size_t HISTORY_CHECKPOINTS = 64;     // 超过时丢弃一半检查点并把间隔加倍
+    static const size_t HISTORY_BYTES = 64 << 20;     // 检查点中磁带内容的总大小上限，超过时同样丢弃一半
+    static const long long HISTORY_INTERVAL = 4096;
+    bool history = false;
+    std::vector<Checkpoint> checkpoints;  // 按executed递增，第一个为开始记录时的状态
+    size_t history_bytes = 0;
+    long long history_interval = HISTORY_INTERVAL;
+    long long executed = 0;               // 开始记录以来执行的IR指令数
+    long long replay_target = 0;          // replayWith()执行到executed等于它为止
+    bool replay_scan = false;             // replayWith()是否查找会停下的位置
+    long long replay_before = 0;          // 只查找executed小于它的位置
+    long long replay_stop = -1;           // 找到的最后一个会停下的位置
+    int replay_watch = -1;                // replay_stop处命中的改变类观察点，停在指令之前时为-1
+
+    // 指令序列统计（见setProfiling()），多次执行累加
+    bool profiling = false;
+    std::vector<long long> pair_counts = std::vector<long long>(OP_KINDS * OP_KINDS);               // a * OP_KINDS + b
+    std::vector<long long> triple_counts = std::vector<long long>(OP_KINDS * OP_KINDS * OP_KINDS);  // (a * OP_KINDS + b) * OP_KINDS + c
+
+    // 逐条指令的执行统计（见setCounting()），loadCode()和restart()时清零
+    bool counting = false;
+    std::vector<long long> execution_counts;  // 下标与program相同
+    std::vector<long long> loop_entries;      // 各OP_LOOP_START进入循环体的次数，其余指令处为0
+
+    // 输出一个字符，保持原有的"Output(only-one-character) >> "格式
+    void writeOutput(uint8_t value) {
+        static const char prefix[] = "Output(only-one-character) >> ";
+        output.write(prefix, sizeof(prefix) - 1);
+        output.put(static_cast<char>(value));
+        output.put('\n');
+    }
+
+    // 需要等待输入时先刷新输出，终端上再显示提示
+    void promptInput() {
+        if (input.needsRefill()) {
+            output.flush();
+            if (input.isInteractive()) {
+                std::cout << "Input >> ";
+            }
+        }
+    }
+
+    // 由code生成IR，合并连续的+/-和</>
+    void buildProgram() {
+        program.clear();
+        size_t i = 0;
+        while (i < code.length()) {
+            char c = code[i];
+            Instruction ins;
+            ins.source = i;
+            ins.arg = 0;
+            ins.offset = 0;
+            ins.from = 0;
+            ins.by = 0;
+
+            if (c == '+' || c == '-' || c == '>' || c == '<') {
+                bool is_add = (c == '+' || c == '-');
+                int delta = 0;
+                while (i < code.length()) {
+                    char d = code[i];
+                    if (is_add && d == '+') delta++;
+                    else if (is_add && d == '-') delta--;
+                    else if (!is_add && d == '>') delta++;
+                    else if (!is_add && d == '<') delta--;
+                    else break;
+                    i++;
+                }
+
+                // 加减只保留模2^cell_bits的余数
+                if (is_add && cell_bits < 32) delta %= (1 << cell_bits);
+                if (delta != 0) {
+                    ins.op = is_add ? OP_ADD : OP_MOVE;
+                    ins.arg = delta;
+                    program.push_back(ins);
+                }
+                continue;
+            }
+
+            switch (c) {
+                case '.': ins.op = OP_OUTPUT; break;
+                case ',': ins.op = OP_INPUT; break;
+                case '[': ins.op = OP_LOOP_START; break;
+                case ']': ins.op = OP_LOOP_END; break;
+            }
+            program.push_back(ins);
+            i++;
+        }
+    }
+
+public:
+    static const size_t MEMORY_SIZE = 30000;
+    static const long long DEFAULT_PREFIX_BUDGET = 1 << 24; // setPrefixBudget()的常用值
+    static const int DEFAULT_TIER_THRESHOLD = 1000;         // tiered()中循环编译为机器码的默认回跳次数
+
+    // tape_size：磁带初始长度（可以扩展时按页取整）；growable：超出时是否自动扩展，否则视为越界
+    explicit BrainfuckCompiler(size_t tape_size = MEMORY_SIZE, bool growable = true)
+        : tape(tape_size, growable), memory(tape.cells()), data_pointer(0),
+          tape_cells(std::max<size_t>(tape_size, 1)), cell_bits(8), pointer_mode(growable ? POINTER_GROW : POINTER_ERROR),
+          instruction_pointer(0) {
+        selectEngine();
+    }
+
+    void setTapeGrowable(bool enabled) {
+        setPointerMode(enabled ? POINTER_GROW : POINTER_ERROR);
+    }
+
+    void setPointerMode(PointerMode mode) {
+        pointer_mode = mode;
+        tape.setGrowable(mode == POINTER_GROW);
+        selectEngine();
+    }
+
+    PointerMode getPointerMode() const {
+        return pointer_mode;
+    }
+
+    // 单元宽度只能是8、16、32；IR与宽度有关，已加载的代码会重新生成
+    bool setCellBits(int bits) {
+        if (bits != 8 && bits != 16 && bits != 32) {
+            return false;
+        }
+        cell_bits = bits;
+        if (!code.empty()) {
+            loadCode(code);
+        }
+        selectEngine();
+        return true;
+    }
+
+    int getCellBits() const {
+        return cell_bits;
+    }
+
+    // 加载时预先执行到第一次读取输入为止（最多steps条IR指令，0为关闭），这段的输出和磁带作为每次执行的起点，
+    // compileToC()/compileToCpp()也从这里开始；不读输入的程序只剩一次写出。已加载的代码会重新加载
+    void setPrefixBudget(long long steps) {
+        prefix_budget = std::max(steps, 0LL);
+        if (!code.empty()) {
+            loadCode(code);
+        }
+    }
+
+    long long getPrefixBudget() const {
+        return prefix_budget;
+    }
+
+    // tiered()中循环回跳多少次后编译为机器码，越小越早编译；不影响interpret()和jit()
+    void setTierThreshold(int back_edges) {
+        tier_threshold = std::max(back_edges, 1);
+    }
+
+    int getTierThreshold() const {
+        return tier_threshold;
+    }
+
+    // interpret()是否统计顺序执行的相邻两条、三条IR指令的操作码组合（改用switch分派，不融合超级指令）；
+    // 结果在多次执行、不同程序之间累加，跑完一组程序后由writeProfile()输出最常见的序列，用来挑选超级指令
+    void setProfiling(bool enabled) {
+        profiling = enabled;
+    }
+
+    bool getProfiling() const {
+        return profiling;
+    }
+
+    void resetProfile() {
+        std::fill(pair_counts.begin(), pair_counts.end(), 0);
+        std::fill(triple_counts.begin(), triple_counts.end(), 0);
+    }
+
+    // 每种长度输出出现最多的top个序列，每行的格式与packProgram()中的超级指令表相同，注释为名称、次数和占同长度序列的比例
+    void writeProfile(std::ostream& out, int top) const {
+        static const char* const constants[OP_KINDS] = {
+            "OP_ADD", "OP_MOVE", "OP_OUTPUT", "OP_INPUT", "OP_LOOP_START", "OP_LOOP_END",
+            "OP_CLEAR", "OP_MUL", "OP_SCAN", "OP_PRODUCT", "OP_DIVMOD", "OP_COMPARE"
+        };
+        for (int length = 2; length <= 3; length++) {
+            const std::vector<long long>& counts = (length == 2) ? pair_counts : triple_counts;
+            long long total = 0;
+            std::vector<std::pair<long long, int>> ranked;
+            for (size_t i = 0; i < counts.size(); i++) {
+                total += counts[i];
+                if (counts[i] > 0) {
+                    ranked.emplace_back(-counts[i], static_cast<int>(i));
+                }
+            }
+            std::sort(ranked.begin(), ranked.end());
+            out << "// " << length << "-instruction sequences, " << total << " in total\n";
+            for (int k = 0; k < top && k < static_cast<int>(ranked.size()); k++) {
+                const int index = ranked[k].second;
+                const int ops[3] = { (length == 2) ? index / OP_KINDS : index / (OP_KINDS * OP_KINDS),
+                                     (length == 2) ? index % OP_KINDS : index / OP_KINDS % OP_KINDS,
+                                     (length == 2) ? -1 : index % OP_KINDS };
+                std::string name = "op";
+                for (int j = 0; j < length; j++) {
+                    name += std::string("_") + opName(ops[j]);
+                }
+                const long long count = -ranked[k].first;
+                const long long permille = count * 1000 / total;
+                out << "{" << constants[ops[0]] << ", " << constants[ops[1]] << ", " << (ops[2] < 0 ? "-1" : constants[ops[2]])
+                    << "}, // " << name << ": " << count << " (" << permille / 10 << "." << permille % 10 << "%)\n";
+            }
+        }
+    }
+
+    // interpret()是否统计每条IR指令的执行次数和每个循环的进入次数（改用switch分派，不融合超级指令）；
+    // 统计在loadCode()和restart()时清零，执行后由getLoopProfile()和getSourceCosts()取得。
+    // 预先执行的部分（见setPrefixBudget()）不计入；setProfiling()同时开启时只统计指令序列
+    void setCounting(bool enabled) {
+        counting = enabled;
+    }
+
+    bool getCounting() const {
+        return counting;
+    }
+
+    // 每个循环的执行统计，按自身代价从大到小；已改写为清零、乘法、扫描等闭式计算的循环不在其中
+    std::vector<LoopProfile> getLoopProfile() const {
+        std::vector<LoopProfile> loops;
+        std::vector<size_t> open;  // 包含当前指令的各层循环在loops中的下标，最内层在最后
+        for (size_t i = 0; i < program.size(); i++) {
+            const Instruction& instruction = program[i];
+            if (instruction.op == OP_LOOP_START) {
+                LoopProfile loop;
+                loop.start = instruction.source;
+                loop.end = program[i + instruction.arg].source;
+                loop.depth = open.size();
+                loop.entries = loop_entries[i];
+                loop.iterations = execution_counts[i + instruction.arg];  // 每轮都以']'结束
+                open.push_back(loops.size());
+                loops.push_back(loop);
+            }
+            if (!open.empty()) {
+                loops[open.back()].self_cost += execution_counts[i];
+                for (size_t index : open) {
+                    loops[index].total_cost += execution_counts[i];
+                }
+            }
+            if (instruction.op == OP_LOOP_END) {
+                open.pop_back();
+            }
+        }
+        std::stable_sort(loops.begin(), loops.end(),
+                         [](const LoopProfile& a, const LoopProfile& b) { return a.self_cost > b.self_cost; });
+        return loops;
+    }
+
+    // code中每个位置的执行代价：从这个位置开始的IR指令的执行次数之和（折叠的"+++"计在第一个字符上），按行标注用
+    std::vector<long long> getSourceCosts() const {
+        std::vector<long long> costs(code.length());
+        for (size_t i = 0; i < program.size(); i++) {
+            if (program[i].source < code.length()) {  // 末尾补上的指针移动（见addressByOffset()）不对应任何字符
+                costs[program[i].source] += execution_counts[i];
+            }
+        }
+        return costs;
+    }
+
+    void setEofMode(InputSource::EofMode mode) {
+        input.setEofMode(mode);
+        selectEngine();
+    }
+
+    // 设置的单元数，不按页取整；扩展模式下为初始长度，访问更右侧的单元时磁带随之扩展
+    size_t getTapeSize() const {
+        return tape_cells;
+    }
+
+    // 输出是否每行刷新一次（默认只在缓冲区满、读取输入前和执行结束时刷新）
+    void setOutputLineBuffered(bool enabled) {
+        output.setLineBuffered(enabled);
+    }
+
+    // ','的输入来源，可改为文件或内存数据并设置EOF行为（默认标准输入，EOF写0）
+    InputSource& getInput() {
+        return input;
+    }
+
+    // 棰勮绠楀惊鐜烦杞綅缃?
+    void precomputeJumps() {
+        std::stack<size_t> loop_stack;
+
+        for (size_t i = 0; i < program.size(); i++) {
+            OpCode op = program[i].op;
+
+            if (op == OP_LOOP_START) {
+                loop_stack.push(i);
+            } else if (op == OP_LOOP_END) {
+                if (loop_stack.empty()) {
+                    throw std::runtime_error("Unmatched ']' at position " + std::to_string(program[i].source));
+                }
+
+                size_t start = loop_stack.top();
+                loop_stack.pop();
+
+                // 相对偏移直接存在指令里，大小随程序而定
+                program[start].arg = static_cast<int>(i - start);
+                program[i].arg = -static_cast<int>(i - start);
+            }
+        }
+
+        if (!loop_stack.empty()) {
+            while (loop_stack.size() > 1) loop_stack.pop();  // 报告最外层没有闭合的'['
+            throw std::runtime_error("Unmatched '[' at position " + std::to_string(program[loop_stack.top()].source));
+        }
+    }
+
+    // 识别清零、乘法、扫描循环并改写为专用指令，整除取余、比较循环前加上闭式计算，需在precomputeJumps()之后调用
+    void optimizeLoops() {
+        std::vector<Instruction> optimized;
+        optimized.reserve(program.size());
+
+        for (size_t i = 0; i < program.size(); i++) {
+            if (program[i].op == OP_LOOP_START) {
+                if (lowerLoop(i, i + program[i].arg, optimized)) {
+                    i += program[i].arg;
+                    continue;
+                }
+                lowerIdiom(i, i + program[i].arg, optimized);
+            }
+            optimized.push_back(program[i]);
+        }
+
+        program.swap(optimized);
+        precomputeJumps();
+    }
+
+    // 整除取余、比较这两种用"[>+>>]"、"[>]"让指针停在不同位置来分支的写法：在原循环前追加闭式计算的指令，原循环保留。
+    // 闭式计算后循环条件单元为0，原循环直接跳过；原循环要读的临时单元不为0等前提不成立时闭式计算什么也不做，仍逐轮执行。
+    // 单元相对循环条件单元：
+    //   [->-[>+>>]>[+[-<+>]>+>>]<<<<<]      0被除数，1除数倒计数，2余数，3商，4、5临时 -> OP_DIVMOD
+    //   [->+>-[>+>>]>[+[-<+>]>+>>]<<<<<<]   同上整体右移一格，被除数同时累加到1 -> OP_DIVMOD
+    //   [->-[>]<<]等（"[-"移动d"-["移动s"]"移回"]"）两个单元同时减1到其中一个为0，停下的位置表示哪个先到0 -> OP_COMPARE
+    void lowerIdiom(size_t start, size_t end, std::vector<Instruction>& out) {
+        // 除数倒计数单元之后的部分，循环指令只比较操作码
+        static const int divmod_body[][2] = {
+            {OP_ADD, -1}, {OP_LOOP_START, 0}, {OP_MOVE, 1}, {OP_ADD, 1}, {OP_MOVE, 2}, {OP_LOOP_END, 0},
+            {OP_MOVE, 1}, {OP_LOOP_START, 0}, {OP_ADD, 1}, {OP_LOOP_START, 0}, {OP_ADD, -1}, {OP_MOVE, -1},
+            {OP_ADD, 1}, {OP_MOVE, 1}, {OP_LOOP_END, 0}, {OP_MOVE, 1}, {OP_ADD, 1}, {OP_MOVE, 2},
+            {OP_LOOP_END, 0}
+        };
+        const size_t body_length = sizeof(divmod_body) / sizeof(divmod_body[0]);
+        auto is_op = [this](size_t i, OpCode op, int arg) {
+            return i < program.size() && program[i].op == op && program[i].arg == arg;
+        };
+
+        Instruction ins;
+        ins.source = program[start].source;
+        ins.arg = 0;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+        if (!is_op(start + 1, OP_ADD, -1)) return;
+
+        // 整除取余：被除数减1，右移一格（另一种写法给这格加1再右移），divmod_body，移回被除数
+        const int copy = (is_op(start + 2, OP_MOVE, 1) && is_op(start + 3, OP_ADD, 1)) ? 1 : 0;
+        const size_t body = start + 3 + copy * 2;
+        if (end - body == body_length + 1 && is_op(start + 2, OP_MOVE, 1) && (copy == 0 || is_op(start + 4, OP_MOVE, 1)) &&
+            is_op(end - 1, OP_MOVE, -5 - copy)) {
+            for (size_t i = 0; i < body_length; i++) {
+                const Instruction& actual = program[body + i];
+                if (actual.op != divmod_body[i][0] ||
+                    (actual.op != OP_LOOP_START && actual.op != OP_LOOP_END && actual.arg != divmod_body[i][1])) {
+                    return;
+                }
+            }
+            ins.op = OP_DIVMOD;
+            ins.from = 1 + copy;
+            out.push_back(ins);
+            return;
+        }
+
+        // 比较：减1，移动d，减1，[移动s]，移动m（d + s + m = 0）；扫描停下的d + s和另一种出口-s不能与两个单元重合
+        if (end - start == 8 && program[start + 2].op == OP_MOVE && is_op(start + 3, OP_ADD, -1) &&
+            program[start + 4].op == OP_LOOP_START && program[start + 5].op == OP_MOVE &&
+            program[start + 6].op == OP_LOOP_END && program[end - 1].op == OP_MOVE) {
+            const int distance = program[start + 2].arg;
+            const int stride = program[start + 5].arg;
+            if (distance + stride + program[end - 1].arg == 0 && -stride != distance) {
+                ins.op = OP_COMPARE;
+                ins.from = distance;
+                ins.arg = stride;
+                out.push_back(ins);
+            }
+        }
+    }
+
+    // 单元值的仿射表示：constant + Σ terms[k] * 偏移k处单元在循环体执行前的值，按单元宽度取模，不存系数为0的项
+    struct Affine {
+        uint32_t constant = 0;
+        std::map<int, uint32_t> terms;
+
+        bool operator==(const Affine& other) const {
+            return constant == other.constant && terms == other.terms;
+        }
+    };
+    using AffineState = std::map<int, Affine>; // 循环体改过的单元（相对循环条件单元） -> 执行后的值
+
+    // 只含加减、移动、清零和乘法的循环（多为内层已改写的嵌套循环，如乘积[>[->+>+<<]>[-<+>]<<-]）
+    // 改写为执行一轮加闭式计算，需在optimizeLoops()之后调用
+    void lowerNestedLoops() {
+        std::vector<Instruction> lowered;
+        lowered.reserve(program.size());
+        for (size_t i = 0; i < program.size(); i++) {
+            if (program[i].op == OP_LOOP_START && lowerAffineLoop(i, i + program[i].arg, lowered)) {
+                i += program[i].arg;
+                continue;
+            }
+            lowered.push_back(program[i]);
+        }
+        program.swap(lowered);
+        precomputeJumps();
+    }
+
+    // 把循环体看作仿射变换F。要求循环条件单元每轮加减1且与其他单元无关，其余改过的单元在第一轮之后
+    // 要么不再变化（F(F(x))中不变），要么每轮加上只由不再变化的单元和常数决定的量。
+    // 满足时循环体保留为第一轮，后面追加剩余轮数（第一轮后的条件单元，每轮加1时取相反数）乘以各项增量的
+    // OP_PRODUCT/OP_MUL，再清零条件单元，循环只执行一次；运算都按单元宽度取模，与逐轮回绕一致
+    bool lowerAffineLoop(size_t start, size_t end, std::vector<Instruction>& out) {
+        const uint32_t mask = cellMask();
+        auto normalize = [mask](Affine& value) -> Affine& {
+            value.constant &= mask;
+            for (auto it = value.terms.begin(); it != value.terms.end();) {
+                it->second &= mask;
+                if (it->second == 0) it = value.terms.erase(it);
+                else ++it;
+            }
+            return value;
+        };
+        // 循环体没改过的单元取初值
+        auto cell_value = [](const AffineState& state, int cell) {
+            auto it = state.find(cell);
+            if (it != state.end()) return it->second;
+            Affine value;
+            value.terms[cell] = 1;
+            return value;
+        };
+        auto add_scaled = [](Affine& target, const Affine& value, uint32_t factor) {
+            target.constant += value.constant * factor;
+            for (const auto& term : value.terms) target.terms[term.first] += term.second * factor;
+        };
+
+        AffineState state;
+        int position = 0;
+        for (size_t i = start + 1; i < end; i++) {
+            const Instruction& body = program[i];
+            if (body.op == OP_MOVE) {
+                position += body.arg;
+                continue;
+            }
+            Affine value = cell_value(state, position + body.offset);
+            if (body.op == OP_ADD) {
+                value.constant += static_cast<uint32_t>(body.arg);
+            } else if (body.op == OP_CLEAR) {
+                value = Affine();
+            } else if (body.op == OP_MUL) {
+                add_scaled(value, cell_value(state, position + body.from), static_cast<uint32_t>(body.arg));
+            } else {
+                return false;
+            }
+            state[position + body.offset] = normalize(value);
+        }
+
+        auto counter = state.find(0);
+        if (position != 0 || counter == state.end() || counter->second.terms.size() != 1 ||
+            counter->second.terms.begin()->first != 0 || counter->second.terms.begin()->second != 1 ||
+            (counter->second.constant != 1 && counter->second.constant != mask)) {
+            return false;
+        }
+        const uint32_t sign = (counter->second.constant == mask) ? 1 : mask; // 剩余轮数 = sign * 条件单元
+
+        // 每轮增量E(y) = F(y) - y；E(F(x))恒为0的单元第一轮后不再变化
+        std::set<int> fixed;
+        std::map<int, Affine> deltas;
+        for (const auto& entry : state) {
+            if (entry.first == 0) continue;
+            Affine delta = entry.second;
+            delta.terms[entry.first] -= 1;
+            normalize(delta);
+            Affine after;
+            after.constant = delta.constant;
+            for (const auto& term : delta.terms) add_scaled(after, cell_value(state, term.first), term.second);
+            if (normalize(after) == Affine()) {
+                fixed.insert(entry.first);
+            } else {
+                deltas[entry.first] = delta;
+            }
+        }
+
+        // 其余单元的增量只能含常数和不再变化的单元（没改过的单元也不变）
+        auto to_arg = [mask](uint32_t value) {
+            value &= mask;
+            return static_cast<int>(value > (mask >> 1) ? (value | ~mask) : value);
+        };
+        std::vector<Instruction> products, tail;
+        Instruction ins;
+        ins.source = program[end].source;
+        ins.from = 0;
+        ins.by = 0;
+        for (const auto& entry : deltas) {
+            ins.offset = entry.first;
+            for (const auto& term : entry.second.terms) {
+                if (term.first == 0 || (state.count(term.first) != 0 && fixed.count(term.first) == 0)) return false;
+                ins.op = OP_PRODUCT;
+                ins.by = term.first;
+                ins.arg = to_arg(term.second * sign);
+                products.push_back(ins);
+            }
+            if (entry.second.constant != 0) {
+                ins.op = OP_MUL;
+                ins.by = 0;
+                ins.arg = to_arg(entry.second.constant * sign);
+                tail.push_back(ins);
+            }
+        }
+        ins.op = OP_CLEAR;
+        ins.offset = 0;
+        ins.arg = 0;
+        ins.by = 0;
+        tail.push_back(ins);
+
+        // OP_PRODUCT在前，OP_MUL和清零相邻，与lowerLoop()的乘法循环形式相同
+        out.insert(out.end(), program.begin() + start, program.begin() + end);
+        out.insert(out.end(), products.begin(), products.end());
+        out.insert(out.end(), tail.begin(), tail.end());
+        out.push_back(program[end]);
+        return true;
+    }
+
+    // 把直线代码中的指针移动折算为之后各指令的offset，需在optimizeLoops()和lowerNestedLoops()之后调用；
+    // 只在扫描和比较（OP_COMPARE会移动指针）前、净移动不为0的循环边界和程序结尾留下OP_MOVE。
+    // 净移动为0且不含扫描和这类内层循环的循环整体按偏移寻址，进出都不移动指针
+    void addressByOffset() {
+        // 第一遍：标出可以整体按偏移寻址的循环
+        std::vector<bool> flat_loop(program.size(), false);
+        std::vector<size_t> loop_starts;
+        std::vector<int> net_moves;   // 各层循环体的净移动
+        std::vector<bool> flat;       // 各层循环体能否按偏移寻址
+        for (size_t i = 0; i < program.size(); i++) {
+            const Instruction& ins = program[i];
+            if (ins.op == OP_LOOP_START) {
+                loop_starts.push_back(i);
+                net_moves.push_back(0);
+                flat.push_back(true);
+            } else if (ins.op == OP_LOOP_END) {
+                bool is_flat = flat.back() && net_moves.back() == 0;
+                flat_loop[loop_starts.back()] = flat_loop[i] = is_flat;
+                loop_starts.pop_back();
+                net_moves.pop_back();
+                flat.pop_back();
+                if (!is_flat && !flat.empty()) flat.back() = false;
+            } else if (ins.op == OP_MOVE && !net_moves.empty()) {
+                net_moves.back() += ins.arg;
+            } else if ((ins.op == OP_SCAN || ins.op == OP_COMPARE) && !flat.empty()) {
+                flat.back() = false;
+            }
+        }
+
+        // 第二遍：累计移动，只在必须移动指针的位置生成OP_MOVE
+        std::vector<Instruction> addressed;
+        addressed.reserve(program.size());
+        int pending = 0; // 块起点到逻辑指针的偏移
+        for (size_t i = 0; i < program.size(); i++) {
+            Instruction ins = program[i];
+            switch (ins.op) {
+                case OP_MOVE:
+                    pending += ins.arg;
+                    continue;
+                case OP_LOOP_START:
+                case OP_LOOP_END:
+                    if (!flat_loop[i]) flushMove(addressed, pending, ins.source);
+                    ins.offset = pending;
+                    break;
+                case OP_SCAN:
+                case OP_COMPARE:
+                    flushMove(addressed, pending, ins.source);
+                    break;
+                case OP_PRODUCT:
+                    ins.by += pending;
+                    ins.from += pending;
+                    ins.offset += pending;
+                    break;
+                case OP_MUL:
+                case OP_DIVMOD:
+                    ins.from += pending;
+                    ins.offset += pending;
+                    break;
+                default:
+                    ins.offset += pending;
+                    break;
+            }
+            addressed.push_back(ins);
+        }
+        flushMove(addressed, pending, code.length());
+
+        program.swap(addressed);
+        precomputeJumps();
+    }
+
+    // 追加一条执行累计移动的OP_MOVE并清零pending
+    static void flushMove(std::vector<Instruction>& out, int& pending, size_t source) {
+        if (pending == 0) return;
+        Instruction ins;
+        ins.op = OP_MOVE;
+        ins.arg = pending;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+        ins.source = source;
+        out.push_back(ins);
+        pending = 0;
+    }
+
+    // 指针范围分析（addressByOffset()之后），沿循环嵌套做抽象解释：直线代码中指针位置确定，访问的单元即指针加偏移；
+    // 净移动为0、内层都有界的循环，执行多少轮都不超出一轮的范围，在外层就是一段确定的范围；扫描、比较和净移动不为0的循环使所在各层无界。
+    // 回绕模式下整个程序都在磁带内时不做回绕运算（见needsWrap()），否则分层执行和生成的C代码在有界循环入口检查一次
+    void analyzePointerRange() {
+        loop_ranges.assign(program.size(), PointerRange());
+        std::vector<PointerRange> ranges(1);  // 各层已分析部分的范围，第0层为整个程序
+        std::vector<size_t> loop_starts;      // 尚未结束的各层循环的开始位置
+        std::vector<int> entry_shifts;        // 进入各层循环时指针在外一层中的位置
+        int shift = 0;                        // 指针相对最内层起点的位置
+        for (size_t i = 0; i < program.size(); i++) {
+            const Instruction& ins = program[i];
+            switch (ins.op) {
+                case OP_MOVE:
+                    shift += ins.arg;
+                    includeRange(ranges.back(), shift, shift);
+                    break;
+                case OP_LOOP_START:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    if (ins.arg != 0) {  // 未配对的括号被忽略
+                        loop_starts.push_back(i);
+                        entry_shifts.push_back(shift);
+                        ranges.emplace_back();
+                        shift = 0;
+                        includeRange(ranges.back(), ins.offset, ins.offset);
+                    }
+                    break;
+                case OP_LOOP_END:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    if (ins.arg != 0) {
+                        PointerRange loop = ranges.back();
+                        loop.bounded = loop.bounded && shift == 0;
+                        loop_ranges[loop_starts.back()] = loop;
+                        ranges.pop_back();
+                        loop_starts.pop_back();
+                        shift = entry_shifts.back();
+                        entry_shifts.pop_back();
+                        if (loop.bounded) {
+                            includeRange(ranges.back(), shift + loop.low, shift + loop.high);
+                        } else {
+                            ranges.back().bounded = false;
+                        }
+                    }
+                    break;
+                case OP_SCAN:
+                case OP_COMPARE:
+                    ranges.back().bounded = false;
+                    break;
+                case OP_MUL:
+                    includeRange(ranges.back(), shift + std::min(ins.offset, ins.from), shift + std::max(ins.offset, ins.from));
+                    break;
+                case OP_PRODUCT:
+                    includeRange(ranges.back(), shift + std::min({ins.offset, ins.from, ins.by}), shift + std::max({ins.offset, ins.from, ins.by}));
+                    break;
+                case OP_DIVMOD:  // 访问的单元见divmodCells()
+                    includeRange(ranges.back(), shift + std::min(ins.offset, ins.from), shift + std::max(ins.offset + 1, ins.from + 4));
+                    break;
+                default:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    break;
+            }
+        }
+        program_range = ranges.front();
+    }
+
+    static void includeRange(PointerRange& range, int low, int high) {
+        range.low = std::min(range.low, low);
+        range.high = std::max(range.high, high);
+    }
+
+    // 是否需要回绕运算：回绕模式下指针范围分析不能证明整个程序都在磁带内。为false时结果与不回绕相同，
+    // 解释器选用不检查边界的实例，JIT和生成的代码也不回绕
+    bool needsWrap() const {
+        if (pointer_mode != POINTER_WRAP) return false;
+        return !program_range.bounded || program_range.low < 0 || program_range.high >= static_cast<ptrdiff_t>(getTapeSize());
+    }
+
+    // 指针为pointer时进入start处的循环，整个循环是否都在磁带内（无界时为false）
+    bool loopInside(size_t start, ptrdiff_t pointer) const {
+        const PointerRange& range = loop_ranges[start];
+        return range.bounded && pointer + range.low >= 0 && pointer + range.high < static_cast<ptrdiff_t>(tape_cells);
+    }
+
+    // 加载时从头执行到第一条OP_INPUT、程序结束或prefix_budget条指令为止，这段与输入无关；
+    // 需在resetTape()之后调用，结束时磁带和指针停在那里
+    void evaluatePrefix() {
+        prefix_output.clear();
+        prefix_cells.clear();
+        prefix_pointer = 0;
+        prefix_instruction = 0;
+        if (prefix_budget > 0) {
+            switch (cell_bits) {
+                case 16: evaluatePrefixWith<uint16_t>(); break;
+                case 32: evaluatePrefixWith<uint32_t>(); break;
+                default: evaluatePrefixWith<uint8_t>(); break;
+            }
+        }
+        data_pointer = prefix_pointer;
+        instruction_pointer = prefix_instruction;
+        prefix_pending = !prefix_output.empty();
+    }
+
+    // 访问或移动到[0, tape_cells)之外前停下，交给实际执行按指针模式处理，所以结果与指针模式无关；
+    // 一组OP_MUL连同清零计数单元的OP_CLEAR整体执行，不会停在中间（generateSource()按组生成）
+    template <typename Cell>
+    void evaluatePrefixWith() {
+        using P = Policy<Cell, POINTER_ERROR, InputSource::EOF_UNCHANGED>; // 只访问磁带之内，不用处理指针模式
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        auto inside = [size](ptrdiff_t index) { return index >= 0 && index < size; };
+        long long steps = 0;
+        ptrdiff_t pointer = 0;
+        size_t ip = 0;
+        bool stopped = false;
+        while (!stopped && ip < program.size() && steps < prefix_budget) {
+            const Instruction& ins = program[ip];
+            const ptrdiff_t cell = pointer + ins.offset;
+            if (ins.op == OP_INPUT || !inside(cell)) {
+                break;
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    cells[cell] += ins.arg;
+                    break;
+                case OP_MOVE:
+                    stopped = !inside(pointer + ins.arg);
+                    if (!stopped) pointer += ins.arg;
+                    break;
+                case OP_OUTPUT:
+                    prefix_output += static_cast<char>(cells[cell]);
+                    break;
+                case OP_LOOP_START:
+                    if (cells[cell] == 0) ip += ins.arg;
+                    break;
+                case OP_LOOP_END:
+                    if (cells[cell] != 0) ip += ins.arg;
+                    break;
+                case OP_CLEAR:
+                    cells[cell] = 0;
+                    break;
+                case OP_MUL: {
+                    const size_t last = mulGroupEnd(ip);
+                    for (size_t i = ip; i <= last && !stopped; i++) {
+                        stopped = !inside(pointer + program[i].offset) || !inside(pointer + program[i].from);
+                    }
+                    if (stopped) break;
+                    const Cell counter = cells[pointer + ins.from];
+                    for (size_t i = ip; i <= last; i++) {
+                        if (program[i].op == OP_CLEAR) {
+                            cells[pointer + program[i].offset] = 0;
+                        } else if (counter != 0) {
+                            cells[pointer + program[i].offset] += counter * program[i].arg;
+                        }
+                    }
+                    steps += last - ip;
+                    ip = last;
+                    break;
+                }
+                case OP_PRODUCT:
+                    stopped = !inside(pointer + ins.from) || !inside(pointer + ins.by);
+                    if (!stopped) productCells<P>(cells, pointer, ins);
+                    break;
+                case OP_DIVMOD:
+                    for (int i = std::min(ins.offset, ins.from); i <= ins.from + 4 && !stopped; i++) {
+                        stopped = !inside(pointer + i);
+                    }
+                    if (!stopped) divmodCells<P>(cells, pointer, ins.offset, ins.from);
+                    break;
+                case OP_COMPARE:
+                    stopped = !inside(pointer + ins.from) || !inside(pointer + ins.from + ins.arg) || !inside(pointer - ins.arg);
+                    if (!stopped) pointer = compareCells<P>(cells, pointer, ins.from, ins.arg);
+                    break;
+                case OP_SCAN:
+                    // 停在扫描中途也没关系，从当前位置继续扫描结果相同
+                    while (cells[pointer] != 0 && !stopped) {
+                        stopped = !inside(pointer + ins.arg);
+                        if (!stopped) {
+                            pointer += ins.arg;
+                            steps++;
+                        }
+                    }
+                    break;
+                default:
+                    break;
+            }
+            if (!stopped) {
+                ip++;
+                steps++;
+            }
+        }
+
+        prefix_pointer = pointer;
+        prefix_instruction = ip;
+        size_t used = tape_cells;
+        while (used > 0 && cells[used - 1] == 0) used--;
+        prefix_cells.assign(cells, cells + used);
+    }
+
+    // 从start处的OP_MUL起读同一计数单元的一组乘法的最后一条位置，其后清零计数单元的OP_CLEAR也算在内
+    size_t mulGroupEnd(size_t start) const {
+        const int from = program[start].from;
+        size_t last = start;
+        while (last + 1 < program.size() && program[last + 1].op == OP_MUL && program[last + 1].from == from) last++;
+        if (last + 1 < program.size() && program[last + 1].op == OP_CLEAR && program[last + 1].offset == from) last++;
+        return last;
+    }
+
+    void writePrefixOutput() {
+        if (!prefix_pending) return;
+        for (char c : prefix_output) {
+            writeOutput(static_cast<uint8_t>(c));
+        }
+        prefix_pending = false;
+    }
+
+    // 娓呯悊鍜岄獙璇佷唬鐮?
+    void loadCode(const std::string& brainfuck_code) {
+        code.clear();
+
+        // 鍙繚鐣欐湁鏁堢殑Brainfuck鎸囦护
+        for (char c : brainfuck_code) {
+            if (c == '>' || c == '<' || c == '+' || c == '-' ||
+                c == '.' || c == ',' || c == '[' || c == ']') {
+                code += c;
+            }
+        }
+
+        buildProgram();
+        precomputeJumps();
+        optimizeLoops();
+        lowerNestedLoops();
+        addressByOffset();
+        analyzePointerRange();
+        resetTape();
+        evaluatePrefix();
+        packProgram();
+        stopped_at = -1;
+        markBreakpoints();
+        resetHistory();
+        resetCounts();
+        selectEngine();
+    }
+
+    // 回到加载后的状态：磁带为预先执行的结果，指针在执行起点，预先执行的输出等待写出
+    void restart() {
+        resetTape();
+        for (size_t i = 0; i < prefix_cells.size(); i++) {
+            setCellAt(i, prefix_cells[i]);
+        }
+        data_pointer = prefix_pointer;
+        instruction_pointer = prefix_instruction;
+        prefix_pending = !prefix_output.empty();
+        stopped_at = -1;
+        resetHistory();
+        resetCounts();
+    }
+
+    // 浠庢枃浠跺姞杞戒唬鐮?
+    void loadCodeFromFile(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        loadCode(buffer.str());
+    }
+
+    // 瑙ｉ噴鎵ц
+    // 指针越界（小于0或超出不可扩展的磁带）时返回false
+    // 执行前按单元宽度、指针模式和EOF行为选出对应的实例（见selectEngine()）
+    bool interpret() {
+        restart();
+        selectEngine();
+
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            return false;
+        }
+        writePrefixOutput();
+        (this->*(profiling ? engine.profile : counting ? engine.count : engine.run))();
+        output.flush();
+        return pointerInRange();
+    }
+
+    // JIT执行：把IR编译为x86-64机器码后直接调用；不支持（含宽单元、需要回绕）时退回interpret()
+    bool jit() {
+        restart();
+        if (!compileNative()) {
+            return interpret();
+        }
+
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            jit_code.release();
+            output.flush();
+            return false;
+        }
+        writePrefixOutput();
+        JitFunction function = reinterpret_cast<JitFunction>(jit_code.entry());
+        uint8_t* pointer = function(this, memory, memory + data_pointer);
+        data_pointer = pointer - memory;
+        instruction_pointer = program.size();
+        jit_code.release();
+        output.flush();
+        return pointerInRange();
+    }
+
+    // 分层执行：先解释执行并统计每个']'的回跳次数，达到阈值（见setTierThreshold()）的循环才编译为机器码，
+    // 此后进入这个循环直接执行机器码。短程序保留解释执行的启动速度，长程序不为冷代码付出编译开销；不支持JIT时同interpret()
+    bool tiered() {
+        if (!nativeCells()) {
+            return interpret();
+        }
+        restart();
+        back_edges.assign(program.size(), 0);
+        tier_entries.assign(program.size(), -1);
+        hot_loops.clear();
+
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            tier_code.release();
+            output.flush();
+            return false;
+        }
+        writePrefixOutput();
+        if (needsWrap()) {
+            interpretTieredWith<POINTER_WRAP>();
+        } else if (pointer_mode == POINTER_ERROR) {
+            interpretTieredWith<POINTER_ERROR>();
+        } else {
+            interpretTieredWith<POINTER_GROW>();
+        }
+        tier_code.release();
+        output.flush();
+        return pointerInRange();
+    }
+
+    // 鍗曟鎵ц锛堢敤浜庤皟璇曪級
+    bool step() {
+        writePrefixOutput(); // 预先执行完整个程序时也要写出
+        if (instruction_pointer >= program.size()) {
+            output.flush();
+            return false;
+        }
+
+        selectEngine();
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            return false; // 指针越界
+        }
+        (this->*engine.step)();
+        instruction_pointer++;
+        stopped_at = -1;
+        hit_breakpoint = -1;
+        hit_watchpoint = -1;
+        if (history) recordInstruction();
+        output.flush();
+        return instruction_pointer < program.size() || pointerInRange();
+    }
+
+    // 断点停在position（过滤后代码中的位置）所属的IR指令之前；折叠的字符停在包含它的指令之前，预先执行过的部分不会停下。
+    // 返回断点的下标，position超出代码时为-1
+    int addBreakpoint(size_t position, BreakCondition condition = BREAK_ALWAYS, ptrdiff_t cell = -1, uint32_t value = 0) {
+        if (position >= code.size()) return -1;
+        Breakpoint point;
+        point.position = position;
+        point.condition = condition;
+        point.cell = cell;
+        point.value = value;
+        breakpoints.push_back(point);
+        markBreakpoints();
+        return static_cast<int>(breakpoints.size()) - 1;
+    }
+
+    bool removeBreakpoint(size_t index) {
+        if (index >= breakpoints.size()) return false;
+        breakpoints.erase(breakpoints.begin() + index);
+        markBreakpoints();
+        return true;
+    }
+
+    void clearBreakpoints() {
+        breakpoints.clear();
+        markBreakpoints();
+    }
+
+    const std::vector<Breakpoint>& getBreakpoints() const {
+        return breakpoints;
+    }
+
+    // 从当前位置全速执行到下一个条件成立的断点、命中的观察点或结束，不回到起点（同step()）。
+    // 断点之间用与interpret()相同的解释器，只在到达有断点的指令时检查条件；有观察点或记录历史时改用逐条检查的watchWith()。
+    // 上次停下的断点或'.'先执行再继续，不会原地重复停下；期间step()造成的观察点单元改变不会命中
+    DebugStop debugContinue() {
+        selectEngine();
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            stopped_at = -1;
+            return DEBUG_ERROR;
+        }
+        writePrefixOutput();
+        refreshWatchValues();
+        hit_breakpoint = -1;
+        hit_watchpoint = -1;
+        while (instruction_pointer < program.size()) {
+            const bool resumed = static_cast<ptrdiff_t>(instruction_pointer) == stopped_at;
+            if (!resumed) {
+                if (break_flags[instruction_pointer]) {
+                    hit_breakpoint = matchBreakpoint(instruction_pointer);
+                    if (hit_breakpoint >= 0) {
+                        stopped_at = instruction_pointer;
+                        output.flush();
+                        return DEBUG_BREAKPOINT;
+                    }
+                }
+                hit_watchpoint = matchWatchOutput(instruction_pointer);
+                if (hit_watchpoint >= 0) {
+                    stopped_at = instruction_pointer;
+                    output.flush();
+                    return DEBUG_WATCHPOINT;
+                }
+            }
+            if (break_flags[instruction_pointer] || resumed) {
+                // 从停下的位置继续，或断点条件不成立：单独执行这一条
+                const int op = program[instruction_pointer].op;
+                (this->*engine.step)();
+                instruction_pointer++;
+                stopped_at = -1;
+                if (history) recordInstruction();
+                hit_watchpoint = writesCells(op) ? matchWatchChange() : -1;
+            } else {
+                (this->*((watchpoints.empty() && !history) ? engine.debug : engine.watch))();
+            }
+            if (hit_watchpoint >= 0) {
+                if (watchpoints[hit_watchpoint].kind == WATCH_OUTPUT) {
+                    stopped_at = instruction_pointer;
+                }
+                output.flush();
+                return DEBUG_WATCHPOINT;
+            }
+        }
+        stopped_at = -1;
+        output.flush();
+        return pointerInRange() ? DEBUG_FINISHED : DEBUG_ERROR;
+    }
+
+    // debugContinue()上次停下时条件成立的断点
+    int getHitBreakpoint() const {
+        return hit_breakpoint;
+    }
+
+    // 有观察点时debugContinue()逐条检查，interpret()等不受影响。检查的是每条IR指令之后的值，
+    // 折叠的加减和改写的循环一次写入结果，中间值不会命中WATCH_EQUAL
+    int addWatchpoint(size_t cell, WatchKind kind = WATCH_CHANGE, uint32_t value = 0) {
+        Watchpoint point;
+        point.cell = cell;
+        point.kind = kind;
+        point.value = value;
+        watchpoints.push_back(point);
+        refreshWatchValues();
+        return static_cast<int>(watchpoints.size()) - 1;
+    }
+
+    bool removeWatchpoint(size_t index) {
+        if (index >= watchpoints.size()) return false;
+        watchpoints.erase(watchpoints.begin() + index);
+        refreshWatchValues();
+        return true;
+    }
+
+    void clearWatchpoints() {
+        watchpoints.clear();
+        watch_values.clear();
+    }
+
+    const std::vector<Watchpoint>& getWatchpoints() const {
+        return watchpoints;
+    }
+
+    int getHitWatchpoint() const {
+        return hit_watchpoint;
+    }
+
+    // 记录执行历史后才能用reverseStep()/reverseContinue()倒退。记录期间debugContinue()和step()按间隔保存检查点
+    // （磁带、指针和输入位置），读过的输入也保留，倒退后再向前执行读到相同的输入；检查点随记录变长而变稀疏，内存占用有上限。
+    // 记录期间debugContinue()逐条执行；interpret()等回到起点，重新开始记录。开启或关闭都从当前状态重新开始
+    void setHistory(bool enabled) {
+        history = enabled;
+        resetHistory();
+    }
+
+    bool getHistory() const {
+        return history;
+    }
+
+    // 开始记录以来执行的IR指令数，倒退时随之减少
+    long long getExecuted() const {
+        return executed;
+    }
+
+    // 倒退count条指令：恢复之前最近的检查点，全速重新执行到目标位置。重新执行时的输出被丢弃，
+    // 之后再向前执行时已输出过的字符会再次输出。没有记录历史或已在起点时返回false
+    bool reverseStep(long long count = 1) {
+        if (!history || count <= 0 || executed <= checkpoints[0].executed) return false;
+        const long long target = std::max(executed - count, checkpoints[0].executed);
+        selectEngine();
+        output.flush();
+        FILE* previous = output.redirect(nullptr);
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            output.redirect(previous);
+            return false;
+        }
+        restoreCheckpoint(checkpointBefore(target));
+        replay_target = target;
+        replay_scan = false;
+        (this->*engine.replay)();
+        output.flush();
+        output.redirect(previous);
+        stopped_at = -1;
+        hit_breakpoint = -1;
+        hit_watchpoint = -1;
+        return true;
+    }
+
+    // 倒退到上一个debugContinue()会停下的位置：从最近的检查点起逐段向前，每段重新执行一遍找出其中最后一个可停的位置，
+    // 找到后恢复到那里，getHitBreakpoint()/getHitWatchpoint()与向前执行时停下的相同。途中没有时回到起点，返回DEBUG_HISTORY_START
+    DebugStop reverseContinue() {
+        if (!history) return DEBUG_ERROR;
+        const long long now = executed;
+        // 停在改变类观察点时不再停在原处；停在指令之前或执行结束时，同一位置的改变类观察点在它之前
+        const long long before = (stopped_at < 0 && hit_watchpoint >= 0) ? now : now + 1;
+        selectEngine();
+        output.flush();
+        FILE* previous = output.redirect(nullptr);
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            output.redirect(previous);
+            return DEBUG_ERROR;
+        }
+        replay_stop = -1;
+        ptrdiff_t index = checkpointBefore(now - 1);
+        for (; index >= 0 && checkpoints[index].executed < now; index--) {
+            restoreCheckpoint(index);
+            refreshWatchValues();
+            replay_target = (static_cast<size_t>(index) + 1 < checkpoints.size()) ? std::min(checkpoints[index + 1].executed, now) : now;
+            replay_scan = true;
+            replay_before = before;
+            (this->*engine.replay)();
+            replay_scan = false;
+            if (replay_stop >= 0) break;
+        }
+        hit_breakpoint = -1;
+        hit_watchpoint = -1;
+        stopped_at = -1;
+        DebugStop stop = DEBUG_HISTORY_START;
+        if (replay_stop < 0) {
+            restoreCheckpoint(0);
+        } else {
+            restoreCheckpoint(index);
+            replay_target = replay_stop;
+            (this->*engine.replay)();
+            stop = DEBUG_WATCHPOINT;
+            if (replay_watch >= 0) {
+                hit_watchpoint = replay_watch;
+            } else {
+                // 停在指令之前：按debugContinue()的顺序先检查断点
+                stopped_at = instruction_pointer;
+                if (break_flags[instruction_pointer]) hit_breakpoint = matchBreakpoint(instruction_pointer);
+                if (hit_breakpoint >= 0) {
+                    stop = DEBUG_BREAKPOINT;
+                } else {
+                    hit_watchpoint = matchWatchOutput(instruction_pointer);
+                }
+            }
+        }
+        output.flush();
+        output.redirect(previous);
+        return stop;
+    }
+
+    // 下一条指令在过滤后代码中的位置，结束时为代码长度
+    size_t getSourcePosition() const {
+        return (instruction_pointer < program.size()) ? program[instruction_pointer].source : code.size();
+    }
+
+    // 鑾峰彇鍐呭瓨鐘舵€侊紙鐢ㄤ簬璋冭瘯锛?
+    void printMemoryState(size_t start = 0, size_t count = 20) {
+        std::cout << "Memory state (pointer at " << data_pointer << "): ";
+        for (size_t i = start; i < start + count && i < accessibleCells(); i++) {
+            std::cout << cellAt(i) << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    // 鑾峰彇褰撳墠鐘舵€侊紙鐢ㄤ簬璋冭瘯锛?
+    void printCurrentState() {
+        std::cout << "IP: " << instruction_pointer << ", DP: " << data_pointer;
+        if (data_pointer >= 0 && static_cast<size_t>(data_pointer) < accessibleCells()) {
+            std::cout << ", Current Cell: " << cellAt(data_pointer);
+        }
+        // 下一条指令访问的是DP加偏移处的单元
+        if (instruction_pointer < program.size() && program[instruction_pointer].offset != 0) {
+            std::cout << ", Cell Offset: " << program[instruction_pointer].offset;
+        }
+        std::cout << std::endl;
+    }
+
+private:
+    // 把IR编码为packed，同时合并超级指令：只替换序列第一条的编号，跳到序列中间时仍逐条执行。
+    // 序列按setProfiling()在语料库上的统计挑选（每行即writeProfile()的输出去掉注释），按顺序匹配、长的在前，
+    // 编号依次为OP_KINDS、OP_KINDS + 1……，与interpretThreaded()中处理代码的顺序一致
+    void packProgram() {
+        static const int fused[][3] = {
+            {OP_ADD, OP_MOVE, OP_LOOP_END},  // op_add_move_end
+            {OP_ADD, OP_ADD, OP_ADD},        // op_add_add_add
+            {OP_ADD, OP_MOVE, -1},           // op_add_move
+            {OP_MOVE, OP_LOOP_END, -1},      // op_move_end
+            {OP_ADD, OP_ADD, -1},            // op_add_add
+            {OP_MUL, OP_CLEAR, -1},          // op_multiply_clear
+            {OP_ADD, OP_MUL, -1},            // op_add_multiply
+            {OP_CLEAR, OP_LOOP_END, -1},     // op_clear_end
+            {OP_CLEAR, OP_CLEAR, -1},        // op_clear_clear
+            {OP_CLEAR, OP_ADD, -1}           // op_clear_add
+        };
+        const int fused_count = static_cast<int>(sizeof(fused) / sizeof(fused[0]));
+
+        threaded_handlers = nullptr;
+        packed.codes.assign(program.size() + 1, static_cast<uint8_t>(OP_KINDS + fused_count));
+        packed.operands.assign(program.size() + 1, PackedOperands{0, 0, 0, 0});
+        for (size_t i = 0; i < program.size(); i++) {
+            const Instruction& ins = program[i];
+            if (ins.offset != static_cast<int16_t>(ins.offset) || ins.from != static_cast<int16_t>(ins.from) ||
+                ins.by != static_cast<int16_t>(ins.by)) {
+                packed = PackedProgram();
+                return;
+            }
+            packed.codes[i] = static_cast<uint8_t>(ins.op);
+            packed.operands[i] = PackedOperands{ins.arg, static_cast<int16_t>(ins.offset),
+                                                static_cast<int16_t>(ins.from), static_cast<int16_t>(ins.by)};
+
+            for (int k = 0; k < fused_count; k++) {
+                const size_t length = (fused[k][2] < 0) ? 2 : 3;
+                size_t matched = 0;
+                while (matched < length && i + matched < program.size() && program[i + matched].op == fused[k][matched]) {
+                    matched++;
+                }
+                if (matched == length) {
+                    packed.codes[i] = static_cast<uint8_t>(OP_KINDS + k);
+                    break;
+                }
+            }
+        }
+    }
+
+#ifdef BFX_THREADED_DISPATCH
+    // 直接线索化解释器，执行packed：每个处理代码末尾直接跳到下一条指令，各自的间接跳转分别预测；超级指令整段只分派一次。
+    // stops不为空时标记的指令换成op_stop，执行到它之前停下；停在超级指令中间时这条超级指令按单条执行，其余指令没有额外开销
+    template <class P>
+    void interpretThreaded(const char* stops) {
+        using Cell = typename P::Cell;
+
+        // 顺序与OpCode一致，其后为packProgram()中的超级指令，最后一项为结束
+        static const void* const handlers[] = {
+            &&op_add, &&op_move, &&op_output, &&op_input, &&op_loop_start, &&op_loop_end,
+            &&op_clear, &&op_mul, &&op_scan, &&op_product, &&op_divmod, &&op_compare,
+            &&op_add_move_end, &&op_add_add_add, &&op_add_move, &&op_move_end, &&op_add_add,
+            &&op_multiply_clear, &&op_add_multiply, &&op_clear_end, &&op_clear_clear, &&op_clear_add,
+            &&op_halt
+        };
+
+        if (threaded_handlers != handlers || threaded_stops != stops) {
+            threaded.resize(packed.codes.size());
+            for (size_t i = 0; i < threaded.size(); i++) {
+                threaded[i] = ThreadedInstruction{handlers[packed.codes[i]], packed.operands[i].arg,
+                                                  packed.operands[i].offset, packed.operands[i].from};
+                if (stops == nullptr || i >= program.size()) continue;
+                if (stops[i]) {
+                    threaded[i].handler = &&op_stop;
+                } else if (packed.codes[i] >= OP_KINDS && (stops[i + 1] || (i + 2 < threaded.size() && stops[i + 2]))) {
+                    threaded[i].handler = handlers[program[i].op];
+                }
+            }
+            threaded_handlers = handlers;
+            threaded_stops = stops;
+        }
+
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        const ThreadedInstruction* const first = &threaded[0];
+        const ThreadedInstruction* ip = first + instruction_pointer;
+
+        #define BFX_DISPATCH() goto *ip->handler
+        #define BFX_NEXT() do { ++ip; BFX_DISPATCH(); } while (0)
+        #define BFX_CELL(offset) cells[P::at(data_pointer, (offset), size)]
+
+        BFX_DISPATCH();
+
+    op_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        BFX_NEXT();
+    op_move:
+        data_pointer = P::move(data_pointer, ip->arg, size);
+        BFX_NEXT();
+    op_output:
+        writeOutput(static_cast<uint8_t>(BFX_CELL(ip->offset)));
+        BFX_NEXT();
+    op_input:
+        promptInput();
+        P::read(input, BFX_CELL(ip->offset));
+        BFX_NEXT();
+    op_loop_start:
+        if (BFX_CELL(ip->offset) == 0) {
+            ip += ip->arg;
+        }
+        BFX_NEXT();
+    op_loop_end:
+        if (BFX_CELL(ip->offset) != 0) {
+            ip += ip->arg;
+        }
+        BFX_NEXT();
+    op_clear:
+        BFX_CELL(ip->offset) = 0;
+        BFX_NEXT();
+    op_mul: {
+        Cell counter = BFX_CELL(ip->from);
+        if (counter != 0) {
+            BFX_CELL(ip->offset) += counter * ip->arg;
+        }
+        BFX_NEXT();
+    }
+    op_scan:
+        if (BFX_CELL(0) != 0) {
+            data_pointer = scanCells<P>(cells, data_pointer, ip->arg);
+        }
+        BFX_NEXT();
+    op_product:
+        productCells<P>(cells, data_pointer, packed.operands[ip - first]);
+        BFX_NEXT();
+    op_divmod:
+        divmodCells<P>(cells, data_pointer, ip->offset, ip->from);
+        BFX_NEXT();
+    op_compare:
+        data_pointer = compareCells<P>(cells, data_pointer, ip->from, ip->arg);
+        BFX_NEXT();
+
+        // 超级指令（见packProgram()）
+    op_add_move_end:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        data_pointer = P::move(data_pointer, ip->arg, size);
+        ++ip;
+        goto op_loop_end;
+    op_add_add_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_add;
+    op_add_move:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_move;
+    op_move_end:
+        data_pointer = P::move(data_pointer, ip->arg, size);
+        ++ip;
+        goto op_loop_end;
+    op_add_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_add;
+    op_multiply_clear: {
+        Cell counter = BFX_CELL(ip->from);
+        if (counter != 0) {
+            BFX_CELL(ip->offset) += counter * ip->arg;
+        }
+        ++ip;
+        goto op_clear;
+    }
+    op_add_multiply:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_mul;
+    op_clear_end:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_loop_end;
+    op_clear_clear:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_clear;
+    op_clear_add:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_add;
+
+    op_stop:
+        instruction_pointer = ip - first;
+        return;
+
+    op_halt:
+        #undef BFX_CELL
+        #undef BFX_NEXT
+        #undef BFX_DISPATCH
+
+        instruction_pointer = program.size();
+    }
+#endif
+
+    // JIT函数：uint8_t* fn(self, memory, pointer)，返回结束时的指针
+    // 寄存器：rbx=当前指针，r12=内存起始，r14=this，r15=磁带末端（第tape_cells个单元）；
+    // 不检查边界，越界由磁带保护页处理，报错模式下磁带末端不在页边界时另外检查右侧（见needsEdgeCheck()）
+    typedef uint8_t* (*JitFunction)(BrainfuckCompiler* self, uint8_t* memory, uint8_t* pointer);
+    ExecutableMemory jit_code;
+    std::vector<unsigned char> jit_buffer;
+
+    // 分层执行（见tiered()）
+    int tier_threshold = DEFAULT_TIER_THRESHOLD;
+    std::vector<int> back_edges;         // 各']'已回跳的次数，下标为指令位置
+    std::vector<int> tier_entries;       // 已编译循环在tier_code中的入口，下标为'['的指令位置，未编译为-1
+    std::vector<size_t> hot_loops;       // 已编译的循环（'['的指令位置）
+    ExecutableMemory tier_code;          // 所有已编译循环的机器码，每个循环一个JitFunction
+
+    // JIT代码的输入输出回调，行为与executeInstruction()一致
+    static void jitOutput(BrainfuckCompiler* self, int value) {
+        self->writeOutput(static_cast<uint8_t>(value));
+    }
+
+    static int jitInput(BrainfuckCompiler* self, int value) {
+        uint8_t cell = static_cast<uint8_t>(value);
+        self->promptInput();
+        self->input.readCell(cell);
+        return cell;
+    }
+
+    // JIT代码中扫描循环的回调，返回扫描结束时的指针
+    static uint8_t* jitScan(BrainfuckCompiler* self, uint8_t* pointer, int stride) {
+        return self->memory + self->tape.scan(pointer - self->memory, stride, self->accessibleCells());
+    }
+
+    // JIT代码中OP_DIVMOD/OP_COMPARE的回调：对第index条指令做闭式计算，返回执行后的指针（JIT只用于8位单元，执行时不回绕）
+    static uint8_t* jitIdiom(BrainfuckCompiler* self, uint8_t* pointer, int index) {
+        if (self->pointer_mode == POINTER_ERROR) {
+            return self->idiomWith<Policy<uint8_t, POINTER_ERROR, InputSource::EOF_UNCHANGED>>(pointer, index);
+        }
+        return self->idiomWith<Policy<uint8_t, POINTER_GROW, InputSource::EOF_UNCHANGED>>(pointer, index);
+    }
+
+    template <class P>
+    uint8_t* idiomWith(uint8_t* pointer, int index) {
+        const Instruction& ins = program[index];
+        ptrdiff_t position = pointer - memory;
+        if (ins.op == OP_DIVMOD) {
+            divmodCells<P>(memory, position, ins.offset, ins.from);
+        } else {
+            position = compareCells<P>(memory, position, ins.from, ins.arg);
+        }
+        return memory + position;
+    }
+
+    // 向机器码缓冲区追加字节
+    void emit(unsigned char b) {
+        jit_buffer.push_back(b);
+    }
+
+    void emit(unsigned char b1, unsigned char b2) {
+        emit(b1);
+        emit(b2);
+    }
+
+    void emit(unsigned char b1, unsigned char b2, unsigned char b3) {
+        emit(b1);
+        emit(b2);
+        emit(b3);
+    }
+
+    void emitInt32(int value) {
+        for (int i = 0; i < 4; i++) {
+            emit(static_cast<unsigned char>((static_cast<unsigned int>(value) >> (i * 8)) & 0xFF));
+        }
+    }
+
+    void emitInt64(unsigned long long value) {
+        for (int i = 0; i < 8; i++) {
+            emit(static_cast<unsigned char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    // 回填位于position处的32位相对跳转偏移，使其跳转到target
+    void patchRel32(int position, int target) {
+        int rel = target - (position + 4);
+        for (int i = 0; i < 4; i++) {
+            jit_buffer[position + i] = static_cast<unsigned char>((static_cast<unsigned int>(rel) >> (i * 8)) & 0xFF);
+        }
+    }
+
+    // 生成[rbx + offset]的ModRM和位移，reg为ModRM的reg字段；能用8位位移时不用32位
+    void emitCellOperand(int reg, int offset) {
+        if (offset == 0) {
+            emit(static_cast<unsigned char>(0x03 | (reg << 3)));      // [rbx]
+        } else if (offset >= -128 && offset <= 127) {
+            emit(static_cast<unsigned char>(0x43 | (reg << 3)));      // [rbx + disp8]
+            emit(static_cast<unsigned char>(offset & 0xFF));
+        } else {
+            emit(static_cast<unsigned char>(0x83 | (reg << 3)));      // [rbx + disp32]
+            emitInt32(offset);
+        }
+    }
+
+    // 访问[rbx + offset]前检查它在磁带末端（r15）之前，否则读第0个单元左侧的保护区，与其他越界一样报告；
+    // 左侧越界仍由保护页处理。checked为false时不生成代码
+    void emitEdgeCheck(bool checked, int offset) {
+        if (!checked) return;
+        emit(0x48, 0x8D);                                     // lea rcx, [rbx + offset]
+        emitCellOperand(1, offset);
+        emit(0x4C, 0x39, 0xF9);                               // cmp rcx, r15
+        emit(0x72, 0x05);                                     // jb +5
+        emit(0x41, 0x8A, 0x4C); emit(0x24, 0xFF);             // mov cl, byte [r12 - 1]
+    }
+
+    // 回填position处的8位相对跳转偏移，使其跳到当前位置
+    void patchRel8(int position) {
+        jit_buffer[position] = static_cast<unsigned char>(((int)jit_buffer.size() - (position + 1)) & 0xFF);
+    }
+
+    // 生成把偏移offset处的内存单元传给回调的第二个参数、this传给第一个参数并调用callback的代码
+    void emitCall(const void* callback, int offset) {
+#ifdef _WIN32
+        emit(0x4C, 0x89, 0xF1);                 // mov rcx, r14
+        emit(0x0F, 0xB6);                       // movzx edx, byte [rbx + offset]
+        emitCellOperand(2, offset);
+#else
+        emit(0x4C, 0x89, 0xF7);                 // mov rdi, r14
+        emit(0x0F, 0xB6);                       // movzx esi, byte [rbx + offset]
+        emitCellOperand(6, offset);
+#endif
+        emit(0x48, 0xB8);                       // mov rax, imm64
+        emitInt64(reinterpret_cast<unsigned long long>(callback));
+        emit(0xFF, 0xD0);                       // call rax
+    }
+
+    // 生成以this、当前指针和value为参数调用callback，并把返回值作为新指针的代码
+    void emitPointerCall(const void* callback, int value) {
+#ifdef _WIN32
+        emit(0x4C, 0x89, 0xF1);                 // mov rcx, r14
+        emit(0x48, 0x89, 0xDA);                 // mov rdx, rbx
+        emit(0x41, 0xB8);                       // mov r8d, imm32
+#else
+        emit(0x4C, 0x89, 0xF7);                 // mov rdi, r14
+        emit(0x48, 0x89, 0xDE);                 // mov rsi, rbx
+        emit(0xBA);                             // mov edx, imm32
+#endif
+        emitInt32(value);
+        emit(0x48, 0xB8);                       // mov rax, imm64
+        emitInt64(reinterpret_cast<unsigned long long>(callback));
+        emit(0xFF, 0xD0);                       // call rax
+        emit(0x48, 0x89, 0xC3);                 // mov rbx, rax
+    }
+
+    static const int ELF_BUFFER_SIZE = 65536; // 独立程序输入、输出缓冲区各自的大小
+
+    // 独立程序的磁带字节数，不能扩展，扩展模式下直接用上限
+    unsigned long long nativeTapeBytes() const {
+        return (pointer_mode == POINTER_GROW) ? Tape::DEFAULT_LIMIT : static_cast<unsigned long long>(getTapeSize());
+    }
+
+    // 生成的C/C++程序的磁带单元数，同样在扩展模式下用上限
+    unsigned long long nativeTapeCells() const {
+        return (pointer_mode == POINTER_GROW) ? Tape::DEFAULT_LIMIT / cellBytes() : static_cast<unsigned long long>(getTapeSize());
+    }
+
+    // 以小端序追加size个字节
+    static void appendLittleEndian(std::vector<unsigned char>& out, unsigned long long value, int size) {
+        for (int i = 0; i < size; i++) {
+            out.push_back(static_cast<unsigned char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    // 追加一个ELF64程序头，对齐固定为一页
+    static void appendProgramHeader(std::vector<unsigned char>& out, unsigned int type, unsigned int flags,
+                                    unsigned long long offset, unsigned long long address,
+                                    unsigned long long file_size, unsigned long long memory_size) {
+        appendLittleEndian(out, type, 4);
+        appendLittleEndian(out, flags, 4);
+        appendLittleEndian(out, offset, 8);
+        appendLittleEndian(out, address, 8);
+        appendLittleEndian(out, address, 8);
+        appendLittleEndian(out, file_size, 8);
+        appendLittleEndian(out, memory_size, 8);
+        appendLittleEndian(out, 0x1000, 8);
+    }
+
+    // 生成call rel32，target为jit_buffer中的位置
+    void emitCallRel32(int target) {
+        emit(0xE8);                             // call rel32
+        emitInt32(0);
+        patchRel32((int)jit_buffer.size() - 4, target);
+    }
+
+    // 把value写入jit_buffer中position处的4个字节
+    void patchInt32(int position, unsigned int value) {
+        for (int i = 0; i < 4; i++) {
+            jit_buffer[position + i] = static_cast<unsigned char>((value >> (i * 8)) & 0xFF);
+        }
+    }
+
+    // 把IR中[first, end)的指令（其中的循环必须完整）翻译为机器码追加到jit_buffer，执行前rbx指向当前单元；
+    // compileNative()、compileHotLoops()和compileToElf()共用。put_routine/get_routine为独立程序中输入输出子程序的位置，
+    // -1表示JIT（输入输出和扫描走回调）；start不为first时先jmp到第start条指令（可以跳进循环体）；
+    // checked为true时访问单元前检查磁带末端（见emitEdgeCheck()），只用于JIT
+    bool emitInstructions(int put_routine, int get_routine, size_t first, size_t end, size_t start, bool checked) {
+        const bool standalone = (put_routine >= 0);
+        std::vector<int> loop_starts; // 尚未回填的循环开始处je指令的偏移位置
+        int entry_patch = -1;
+        if (start > first) {
+            emit(0xE9);                                                            // jmp <起点>
+            entry_patch = (int)jit_buffer.size();
+            emitInt32(0);
+        }
+
+        for (int i = (int)first; i < (int)end; i++) {
+            const Instruction& ins = program[i];
+            if (static_cast<size_t>(i) == start && entry_patch >= 0) {
+                patchRel32(entry_patch, (int)jit_buffer.size());
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // add byte [rbx + offset], imm8
+                    emitCellOperand(0, ins.offset);
+                    emit(static_cast<unsigned char>(ins.arg & 0xFF));
+                    break;
+                case OP_MOVE:
+                    emit(0x48, 0x81, 0xC3);                                        // add rbx, imm32
+                    emitInt32(ins.arg);
+                    break;
+                case OP_OUTPUT:
+                    emitEdgeCheck(checked, ins.offset);
+                    if (standalone) {
+                        emit(0x8A);                                                // mov al, byte [rbx + offset]
+                        emitCellOperand(0, ins.offset);
+                        emitCallRel32(put_routine);                                 // call put
+                    } else {
+                        emitCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitOutput), ins.offset);
+                    }
+                    break;
+                case OP_INPUT: {
+                    int skip_patch = -1; // EOF时跳过写入的js指令的偏移位置
+                    emitEdgeCheck(checked, ins.offset);
+                    if (!standalone) {
+                        emitCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitInput), ins.offset);
+                    } else {
+                        emitCallRel32(get_routine);                                 // call get（EOF时eax为-1）
+                        if (input.getEofMode() == InputSource::EOF_ZERO) {
+                            emit(0x85, 0xC0);                                      // test eax, eax
+                            emit(0x79, 0x02);                                      // jns +2
+                            emit(0x31, 0xC0);                                      // xor eax, eax
+                        } else if (input.getEofMode() == InputSource::EOF_UNCHANGED) {
+                            emit(0x85, 0xC0);                                      // test eax, eax
+                            emit(0x78, 0x00);                                      // js <写入之后>
+                            skip_patch = (int)jit_buffer.size() - 1;
+                        }
+                    }
+                    emit(0x88);                                                    // mov byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    if (skip_patch >= 0) patchRel8(skip_patch);
+                    break;
+                }
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // cmp byte [rbx + offset], 0
+                    emitCellOperand(7, ins.offset);
+                    emit(0x00);
+                    emit(0x0F, 0x84);                                              // je <循环结束之后>
+                    loop_starts.push_back((int)jit_buffer.size());
+                    emitInt32(0);
+                    break;
+                case OP_LOOP_END: {
+                    if (ins.arg == 0) {
+                        break;
+                    }
+                    if (loop_starts.empty()) {
+                        return false;
+                    }
+                    int start_patch = loop_starts.back();
+                    loop_starts.pop_back();
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // cmp byte [rbx + offset], 0
+                    emitCellOperand(7, ins.offset);
+                    emit(0x00);
+                    emit(0x0F, 0x85);                                              // jne <循环开始之后>
+                    emitInt32(0);
+                    patchRel32((int)jit_buffer.size() - 4, start_patch + 4);
+                    patchRel32(start_patch, (int)jit_buffer.size());
+                    break;
+                }
+                case OP_CLEAR:
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0xC6);                                                    // mov byte [rbx + offset], 0
+                    emitCellOperand(0, ins.offset);
+                    emit(0x00);
+                    break;
+                case OP_MUL: {
+                    // 与解释器一样，计数单元为0时不访问目标单元（目标单元可能在磁带之外）
+                    emitEdgeCheck(checked, ins.from);
+                    emit(0x0F, 0xB6);                                              // movzx eax, byte [rbx + from]
+                    emitCellOperand(0, ins.from);
+                    emit(0x84, 0xC0);                                              // test al, al
+                    emit(0x74, 0x00);                                              // je <乘加之后>
+                    int skip_patch = (int)jit_buffer.size() - 1;
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x69, 0xC0);                                              // imul eax, eax, imm32
+                    emitInt32(ins.arg);
+                    emit(0x00);                                                    // add byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    patchRel8(skip_patch);
+                    break;
+                }
+                case OP_SCAN: {
+                    if (standalone) {
+                        // 独立程序中没有CellScanner，逐个单元检查
+                        emit(0x80, 0x3B, 0x00);                                    // cmp byte [rbx], 0
+                        emit(0x74, 0x0C);                                          // je +12
+                        emit(0x48, 0x81, 0xC3);                                    // add rbx, imm32
+                        emitInt32(ins.arg);
+                        emit(0x80, 0x3B, 0x00);                                    // cmp byte [rbx], 0
+                        emit(0x75, 0xF4);                                          // jne -12
+                        break;
+                    }
+                    // 当前单元非0时调用jitScan()，由它完成向量化查找
+                    emitEdgeCheck(checked, 0);
+                    emit(0x80, 0x3B, 0x00);                                        // cmp byte [rbx], 0
+                    emit(0x0F, 0x84);                                              // je <扫描结束>
+                    int exit_patch = (int)jit_buffer.size();
+                    emitInt32(0);
+                    emitPointerCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitScan), ins.arg);
+                    patchRel32(exit_patch, (int)jit_buffer.size());
+                    break;
+                }
+                case OP_PRODUCT: {
+                    emitEdgeCheck(checked, ins.from);
+                    emitEdgeCheck(checked, ins.by);
+                    emit(0x0F, 0xB6);                                              // movzx eax, byte [rbx + from]
+                    emitCellOperand(0, ins.from);
+                    emit(0x0F, 0xB6);                                              // movzx ecx, byte [rbx + by]
+                    emitCellOperand(1, ins.by);
+                    emit(0x0F, 0xAF, 0xC1);                                        // imul eax, ecx
+                    emit(0x84, 0xC0);                                              // test al, al
+                    emit(0x74, 0x00);                                              // je <乘加之后>
+                    int skip_patch = (int)jit_buffer.size() - 1;
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x69, 0xC0);                                              // imul eax, eax, imm32
+                    emitInt32(ins.arg);
+                    emit(0x00);                                                    // add byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    patchRel8(skip_patch);
+                    break;
+                }
+                case OP_DIVMOD:
+                case OP_COMPARE:
+                    // 独立程序不展开，直接执行后面的原循环；JIT交给jitIdiom()
+                    if (!standalone) {
+                        emitPointerCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitIdiom), i);
+                    }
+                    break;
+            }
+        }
+        if (start >= end && entry_patch >= 0) {
+            patchRel32(entry_patch, (int)jit_buffer.size());
+        }
+        return loop_starts.empty();
+    }
+
+    // compileToElf()的运行时子程序flush/put/get，与compileToAsm()中的逐条对应，返回flush的位置
+    // r12=输出缓冲区（其后是输入缓冲区），r13=已缓冲的输出字节数，r14/r15=输入缓冲区的读取位置和长度
+    int emitElfRuntime(int& put_routine, int& get_routine) {
+        // flush: write(1, r12, r13)，直到全部写出或出错，然后清空缓冲区
+        int flush_routine = (int)jit_buffer.size();
+        emit(0x4C, 0x89, 0xE6);                  // mov rsi, r12
+        emit(0x4C, 0x89, 0xEA);                  // mov rdx, r13
+        emit(0x48, 0x85, 0xD2);                  // test rdx, rdx          <- .loop
+        emit(0x7E, 0x19);                        // jle .done
+        emit(0xBF); emitInt32(1);                // mov edi, 1
+        emit(0xB8); emitInt32(1);                // mov eax, 1 (write)
+        emit(0x0F, 0x05);                        // syscall
+        emit(0x48, 0x85, 0xC0);                  // test rax, rax
+        emit(0x7E, 0x08);                        // jle .done
+        emit(0x48, 0x01, 0xC6);                  // add rsi, rax
+        emit(0x48, 0x29, 0xC2);                  // sub rdx, rax
+        emit(0xEB, 0xE2);                        // jmp .loop
+        emit(0x45, 0x31, 0xED);                  // xor r13d, r13d         <- .done
+        emit(0xC3);                              // ret
+
+        // put: 把al追加到输出缓冲区，缓冲区满时flush
+        put_routine = (int)jit_buffer.size();
+        emit(0x43, 0x88); emit(0x04, 0x2C);      // mov byte [r12 + r13], al
+        emit(0x49, 0xFF, 0xC5);                  // inc r13
+        emit(0x49, 0x81, 0xFD); emitInt32(ELF_BUFFER_SIZE); // cmp r13, ELF_BUFFER_SIZE
+        emit(0x0F, 0x84);                        // je flush
+        emitInt32(0);
+        patchRel32((int)jit_buffer.size() - 4, flush_routine);
+        emit(0xC3);                              // ret
+
+        // get: 从输入缓冲区取一个字节放入eax，缓冲区读完时先flush再read(0)，输入结束时返回-1
+        get_routine = (int)jit_buffer.size();
+        emit(0x4D, 0x39, 0xFE);                  // cmp r14, r15
+        emit(0x72, 0x2C);                        // jb .have
+        emitCallRel32(flush_routine);             // call flush
+        emit(0x31, 0xFF);                        // xor edi, edi
+        emit(0x49, 0x8D, 0xB4); emit(0x24); emitInt32(ELF_BUFFER_SIZE); // lea rsi, [r12 + ELF_BUFFER_SIZE]
+        emit(0xBA); emitInt32(ELF_BUFFER_SIZE);  // mov edx, ELF_BUFFER_SIZE
+        emit(0x31, 0xC0);                        // xor eax, eax (read)
+        emit(0x0F, 0x05);                        // syscall
+        emit(0x45, 0x31, 0xF6);                  // xor r14d, r14d
+        emit(0x49, 0x89, 0xC7);                  // mov r15, rax
+        emit(0x48, 0x85, 0xC0);                  // test rax, rax
+        emit(0x7F, 0x09);                        // jg .have
+        emit(0x45, 0x31, 0xFF);                  // xor r15d, r15d
+        emit(0xB8); emitInt32(-1);               // mov eax, -1
+        emit(0xC3);                              // ret
+        emit(0x43, 0x0F, 0xB6); emit(0x84, 0x34); emitInt32(ELF_BUFFER_SIZE); // movzx eax, byte [r12 + r14 + ELF_BUFFER_SIZE]  <- .have
+        emit(0x49, 0xFF, 0xC6);                  // inc r14
+        emit(0xC3);                              // ret
+        return flush_routine;
+    }
+
+    // 把整个IR翻译为x86-64机器码，语义与interpret()一致，从instruction_pointer处开始执行
+    bool compileNative() {
+        if (!nativeSupported()) {
+            return false;
+        }
+        jit_buffer.clear();
+        emitPrologue();
+        if (!emitInstructions(-1, -1, 0, program.size(), instruction_pointer, needsEdgeCheck())) {
+            return false;
+        }
+        emitEpilogue();
+
+        bool loaded = jit_code.load(jit_buffer);
+        jit_buffer.clear();
+        return loaded;
+    }
+
+    // JIT代码访问单元前是否要检查磁带末端：磁带按页分配，报错模式下设置的长度不是整页时，
+    // 最后一个单元之后到页末可读写，保护页发现不了
+    bool needsEdgeCheck() const {
+        return pointer_mode == POINTER_ERROR && tape.size() > tape_cells;
+    }
+
+    // JIT只支持x86-64上的8位单元，指针不需要回绕（见needsWrap()）
+    bool nativeSupported() const {
+        return nativeCells() && !needsWrap();
+    }
+
+    // 平台和单元宽度是否支持JIT，不考虑回绕
+    bool nativeCells() const {
+#ifdef BFX_JIT_X64
+        return cell_bits == 8;
+#else
+        return false;
+#endif
+    }
+
+    // 把hot_loops中的循环全部重新翻译并载入tier_code（旧代码随之释放，不能在执行机器码时调用），
+    // 每个循环从'['开始执行，退出循环后返回；分配失败时全部退回解释执行
+    bool compileHotLoops() {
+        jit_buffer.clear();
+        std::fill(tier_entries.begin(), tier_entries.end(), -1);
+        for (size_t start : hot_loops) {
+            tier_entries[start] = (int)jit_buffer.size();
+            emitPrologue();
+            // 有界的循环在进入前检查（见interpretTiered()），其中不再检查磁带末端
+            emitInstructions(-1, -1, start, start + program[start].arg + 1, start, needsEdgeCheck() && !loop_ranges[start].bounded);
+            emitEpilogue();
+        }
+
+        bool loaded = tier_code.load(jit_buffer);
+        jit_buffer.clear();
+        if (!loaded) {
+            std::fill(tier_entries.begin(), tier_entries.end(), -1);
+        }
+        return loaded;
+    }
+
+    // 分层执行的解释部分：从instruction_pointer执行到结束，回跳达到tier_threshold的循环编译为机器码，
+    // 此后到达它的'['（包括达到阈值的这次回跳）都改为调用机器码；越界与jit()一样由保护页处理。
+    // 需要回绕时（Pointer为POINTER_WRAP）机器码不做回绕运算：只编译有界的循环，每次进入前检查整个循环都在磁带内，否则这次解释执行；
+    // 要检查磁带末端时（见needsEdgeCheck()）有界的循环同样在进入前检查，其他循环在机器码中逐次检查
+    template <PointerMode Pointer, InputSource::EofMode Eof>
+    void interpretTiered() {
+        using P = Policy<uint8_t, Pointer, Eof>;
+        const bool guarded = P::wraps || needsEdgeCheck(); // 有界循环的机器码进入前是否要检查
+        while (instruction_pointer < program.size()) {
+            const Instruction& ins = program[instruction_pointer];
+            if (ins.op == OP_LOOP_START && tier_entries[instruction_pointer] >= 0 &&
+                (!guarded || !loop_ranges[instruction_pointer].bounded || loopInside(instruction_pointer, data_pointer))) {
+                auto function = reinterpret_cast<JitFunction>(static_cast<uint8_t*>(tier_code.entry()) + tier_entries[instruction_pointer]);
+                data_pointer = function(this, memory, memory + data_pointer) - memory;
+                instruction_pointer += ins.arg + 1;
+                continue;
+            }
+
+            const size_t current = instruction_pointer;
+            executeInstruction<P>();
+            if (ins.op == OP_LOOP_END && instruction_pointer != current && ++back_edges[current] == tier_threshold &&
+                (!P::wraps || loop_ranges[instruction_pointer].bounded)) {
+                // 已经回到'['，条件单元不为0，从'['重新进入机器码
+                hot_loops.push_back(instruction_pointer);
+                if (compileHotLoops()) {
+                    continue;
+                }
+            }
+            instruction_pointer++;
+        }
+    }
+
+    template <PointerMode Pointer>
+    void interpretTieredWith() {
+        switch (input.getEofMode()) {
+            case InputSource::EOF_ZERO:
+                interpretTiered<Pointer, InputSource::EOF_ZERO>();
+                break;
+            case InputSource::EOF_MINUS_ONE:
+                interpretTiered<Pointer, InputSource::EOF_MINUS_ONE>();
+                break;
+            default:
+                interpretTiered<Pointer, InputSource::EOF_UNCHANGED>();
+                break;
+        }
+    }
+
+    // 保存非易失寄存器，预留Win64影子空间并保持16字节对齐（r13只为对齐），参数放入r14、r12、rbx，磁带末端放入r15
+    void emitPrologue() {
+        emit(0x53);                              // push rbx
+        emit(0x41, 0x54);                        // push r12
+        emit(0x41, 0x55);                        // push r13
+        emit(0x41, 0x56);                        // push r14
+        emit(0x41, 0x57);                        // push r15
+        emit(0x48, 0x83, 0xEC); emit(0x20);      // sub rsp, 32
+#ifdef _WIN32
+        emit(0x49, 0x89, 0xCE);                  // mov r14, rcx
+        emit(0x49, 0x89, 0xD4);                  // mov r12, rdx
+        emit(0x4C, 0x89, 0xC3);                  // mov rbx, r8
+#else
+        emit(0x49, 0x89, 0xFE);                  // mov r14, rdi
+        emit(0x49, 0x89, 0xF4);                  // mov r12, rsi
+        emit(0x48, 0x89, 0xD3);                  // mov rbx, rdx
+#endif
+        emit(0x4D, 0x8D, 0xBC); emit(0x24);      // lea r15, [r12 + tape_cells]
+        emitInt32(static_cast<int>(tape_cells));
+    }
+
+    // 返回当前指针并恢复寄存器
+    void emitEpilogue() {
+        emit(0x48, 0x89, 0xD8);                  // mov rax, rbx
+        emit(0x48, 0x83, 0xC4); emit(0x20);      // add rsp, 32
+        emit(0x41, 0x5F);                        // pop r15
+        emit(0x41, 0x5E);                        // pop r14
+        emit(0x41, 0x5D);                        // pop r13
+        emit(0x41, 0x5C);                        // pop r12
+        emit(0x5B);                              // pop rbx
+        emit(0xC3);                              // ret
+    }
+
+    // 尝试改写program[start..end]的最内层循环，成功时把结果追加到out
+    bool lowerLoop(size_t start, size_t end, std::vector<Instruction>& out) {
+        Instruction ins;
+        ins.source = program[start].source;
+        ins.arg = 0;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+
+        if (end - start == 2) {
+            const Instruction& body = program[start + 1];
+            // 奇数步长的加减一定会经过0
+            if (body.op == OP_ADD && (body.arg & 1)) {
+                ins.op = OP_CLEAR;
+                out.push_back(ins);
+                return true;
+            }
+            if (body.op == OP_MOVE) {
+                ins.op = OP_SCAN;
+                ins.arg = body.arg;
+                out.push_back(ins);
+                return true;
+            }
+        }
+
+        // 乘法循环：只有加减和移动，指针净移动为0，当前单元每轮加减1
+        std::map<int, int> deltas;
+        int position = 0;
+        for (size_t i = start + 1; i < end; i++) {
+            const Instruction& body = program[i];
+            if (body.op == OP_ADD) {
+                deltas[position] += body.arg;
+            } else if (body.op == OP_MOVE) {
+                position += body.arg;
+            } else {
+                return false;
+            }
+        }
+
+        uint32_t step = static_cast<uint32_t>(deltas[0]) & cellMask();
+        if (position != 0 || (step != 1 && step != cellMask())) {
+            return false;
+        }
+
+        // 每轮减1执行value次，每轮加1执行2^cell_bits-value次
+        int sign = (step == cellMask()) ? 1 : -1;
+        for (std::map<int, int>::iterator it = deltas.begin(); it != deltas.end(); ++it) {
+            if (it->first == 0 || (static_cast<uint32_t>(it->second) & cellMask()) == 0) {
+                continue;
+            }
+            ins.op = OP_MUL;
+            ins.offset = it->first;
+            ins.arg = sign * it->second;
+            out.push_back(ins);
+        }
+
+        ins.op = OP_CLEAR;
+        ins.offset = 0;
+        ins.arg = 0;
+        out.push_back(ins);
+        return true;
+    }
+
+    // 执行前重置磁带和指针；保护区不小于一条指令能跨越的字节数，越界访问才一定落在保护区内
+    void resetTape() {
+        tape.reset(tape_cells * cellBytes());
+        tape.ensureGuard(code.length() * cellBytes());
+        memory = tape.cells();
+        data_pointer = 0;
+    }
+
+    size_t cellBytes() const {
+        return static_cast<size_t>(cell_bits / 8);
+    }
+
+    uint32_t cellMask() const {
+        return (cell_bits == 32) ? 0xFFFFFFFFu : ((1u << cell_bits) - 1);
+    }
+
+    // 过滤后代码中position处的字符所属的IR指令：source不超过position的最后一条，同一source的多条取第一条
+    size_t instructionAt(size_t position) const {
+        auto after = std::upper_bound(program.begin(), program.end(), position,
+                                      [](size_t value, const Instruction& ins) { return value < ins.source; });
+        size_t index = (after == program.begin()) ? 0 : (after - program.begin()) - 1;
+        while (index > 0 && program[index - 1].source == program[index].source) {
+            index--;
+        }
+        return index;
+    }
+
+    // 按breakpoints重新标记break_flags，加载代码或修改断点后调用；stopped_at保持不变，停下时修改断点不影响继续执行
+    void markBreakpoints() {
+        break_flags.assign(program.size() + 1, 0);
+        threaded_handlers = nullptr;
+        if (program.empty()) return;
+        for (const Breakpoint& point : breakpoints) {
+            break_flags[instructionAt(point.position)] = 1;
+        }
+    }
+
+    // 第index条指令上第一个条件成立的断点，没有时为-1
+    int matchBreakpoint(size_t index) const {
+        for (size_t i = 0; i < breakpoints.size(); i++) {
+            const Breakpoint& point = breakpoints[i];
+            if (instructionAt(point.position) != index) continue;
+            if (point.condition == BREAK_ALWAYS) return static_cast<int>(i);
+            const ptrdiff_t cell = (point.cell >= 0) ? point.cell : data_pointer + program[index].offset;
+            if (cell < 0 || static_cast<size_t>(cell) >= accessibleCells()) continue;
+            const uint32_t value = cellAt(cell);
+            if ((point.condition == BREAK_EQUAL && value == point.value) ||
+                (point.condition == BREAK_NOT_EQUAL && value != point.value) ||
+                (point.condition == BREAK_LESS && value < point.value) ||
+                (point.condition == BREAK_GREATER && value > point.value)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // 改变类的观察点只在会写单元的指令之后检查
+    static bool writesCells(int op) {
+        return op != OP_MOVE && op != OP_OUTPUT && op != OP_LOOP_START && op != OP_LOOP_END && op != OP_SCAN;
+    }
+
+    uint32_t watchedValue(size_t cell) const {
+        return (cell < accessibleCells()) ? cellAt(cell) : 0;
+    }
+
+    // 记录观察点单元的当前值，此后的改变才会命中
+    void refreshWatchValues() {
+        watch_values.resize(watchpoints.size());
+        for (size_t i = 0; i < watchpoints.size(); i++) {
+            watch_values[i] = watchedValue(watchpoints[i].cell);
+        }
+    }
+
+    // 检查WATCH_CHANGE/WATCH_EQUAL并更新watch_values，返回第一个命中的观察点，没有时为-1
+    int matchWatchChange() {
+        int hit = -1;
+        for (size_t i = 0; i < watchpoints.size(); i++) {
+            const Watchpoint& point = watchpoints[i];
+            if (point.kind == WATCH_OUTPUT) continue;
+            const uint32_t value = watchedValue(point.cell);
+            if (value == watch_values[i]) continue;
+            watch_values[i] = value;
+            if (hit < 0 && (point.kind == WATCH_CHANGE || value == point.value)) {
+                hit = static_cast<int>(i);
+            }
+        }
+        return hit;
+    }
+
+    // 第index条指令是'.'且输出的单元上有WATCH_OUTPUT时返回这个观察点，否则为-1
+    int matchWatchOutput(size_t index) const {
+        if (program[index].op != OP_OUTPUT) return -1;
+        ptrdiff_t cell = data_pointer + program[index].offset;
+        if (pointer_mode == POINTER_WRAP) {
+            const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+            cell = ((cell % size) + size) % size;
+        }
+        for (size_t i = 0; i < watchpoints.size(); i++) {
+            if (watchpoints[i].kind == WATCH_OUTPUT && static_cast<ptrdiff_t>(watchpoints[i].cell) == cell) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void saveCheckpoint() {
+        Checkpoint point;
+        point.executed = executed;
+        point.instruction_pointer = instruction_pointer;
+        point.data_pointer = data_pointer;
+        point.input_cursor = input.getCursor();
+        size_t bytes = tape.size();
+        while (bytes > 0 && memory[bytes - 1] == 0) bytes--;
+        point.cells.assign(memory, memory + bytes);
+        history_bytes += bytes;
+        checkpoints.push_back(std::move(point));
+        if (checkpoints.size() > HISTORY_CHECKPOINTS || history_bytes > HISTORY_BYTES) {
+            thinCheckpoints();
+        }
+    }
+
+    // 保留第一个和之后每隔一个的检查点，间隔加倍：记录越长检查点越稀疏，内存占用有上限，倒退时重新执行的指令随之增加
+    void thinCheckpoints() {
+        size_t kept = 1;
+        history_bytes = checkpoints[0].cells.size();
+        for (size_t i = 2; i < checkpoints.size(); i += 2) {
+            history_bytes += checkpoints[i].cells.size();
+            checkpoints[kept++] = std::move(checkpoints[i]);
+        }
+        checkpoints.resize(kept);
+        history_interval *= 2;
+    }
+
+    // 记录历史时每条指令之后调用
+    void recordInstruction() {
+        executed++;
+        if (executed - checkpoints.back().executed >= history_interval) {
+            saveCheckpoint();
+        }
+    }
+
+    // 从当前状态重新开始记录，加载代码或回到起点后调用
+    void resetHistory() {
+        checkpoints.clear();
+        history_bytes = 0;
+        history_interval = HISTORY_INTERVAL;
+        executed = 0;
+        input.setRecording(history);
+        if (history) saveCheckpoint();
+    }
+
+    void restoreCheckpoint(size_t index) {
+        const Checkpoint& point = checkpoints[index];
+        std::fill(memory, memory + tape.size(), 0);
+        std::copy(point.cells.begin(), point.cells.end(), memory);
+        executed = point.executed;
+        instruction_pointer = point.instruction_pointer;
+        data_pointer = point.data_pointer;
+        input.rewind(point.input_cursor);
+    }
+
+    // executed不超过target的最后一个检查点
+    size_t checkpointBefore(long long target) const {
+        size_t index = checkpoints.size() - 1;
+        while (index > 0 && checkpoints[index].executed > target) index--;
+        return index;
+    }
+
+    // 按当前宽度读取一个单元（调试输出用）
+    uint32_t cellAt(size_t index) const {
+        switch (cell_bits) {
+            case 16: return reinterpret_cast<const uint16_t*>(memory)[index];
+            case 32: return reinterpret_cast<const uint32_t*>(memory)[index];
+            default: return memory[index];
+        }
+    }
+
+    void setCellAt(size_t index, uint32_t value) {
+        switch (cell_bits) {
+            case 16: reinterpret_cast<uint16_t*>(memory)[index] = static_cast<uint16_t>(value); break;
+            case 32: reinterpret_cast<uint32_t*>(memory)[index] = value; break;
+            default: memory[index] = static_cast<uint8_t>(value); break;
+        }
+    }
+
+    // 报错模式下结尾的移动之后没有访问，需要单独检查指针
+    bool pointerInRange() const {
+        return pointer_mode != POINTER_ERROR ||
+               (data_pointer >= 0 && static_cast<size_t>(data_pointer) < tape_cells);
+    }
+
+    // 当前可访问的单元数：扩展模式下为已分配的单元数，其他模式下等于tape_cells
+    size_t accessibleCells() const {
+        return (pointer_mode == POINTER_GROW) ? tape.size() / cellBytes() : tape_cells;
+    }
+
+    // 执行策略：单元类型、指针模式、EOF行为都是模板参数，每种组合单独实例化，
+    // 其中的判断都是编译期常量，用不到的语义不会进入内层循环
+    template <typename CellType, PointerMode Pointer, InputSource::EofMode Eof>
+    struct Policy {
+        using Cell = CellType;
+        static constexpr bool wraps = (Pointer == POINTER_WRAP);
+
+        // 回绕模式下结果落在[0, size)；其他模式不检查，访问时由at()和保护页处理越界
+        static ptrdiff_t move(ptrdiff_t pointer, int delta, ptrdiff_t size) {
+            pointer += delta;
+            if (wraps && static_cast<size_t>(pointer) >= static_cast<size_t>(size)) {
+                pointer %= size;
+                if (pointer < 0) pointer += size;
+            }
+            return pointer;
+        }
+
+        // 指令访问的单元。报错模式下磁带按页分配，最后一个单元之后到页末仍可读写：
+        // 越过size时返回-1，落在第0个单元左侧的保护区，与其他越界一样报告
+        static ptrdiff_t at(ptrdiff_t pointer, int offset, ptrdiff_t size) {
+            pointer = move(pointer, offset, size);
+            if (Pointer == POINTER_ERROR && static_cast<size_t>(pointer) >= static_cast<size_t>(size)) return -1;
+            return pointer;
+        }
+
+        static void read(InputSource& input, Cell& cell) {
+            int c = input.get();
+            if (c >= 0) {
+                cell = static_cast<Cell>(c);
+            } else if (Eof == InputSource::EOF_ZERO) {
+                cell = 0;
+            } else if (Eof == InputSource::EOF_MINUS_ONE) {
+                cell = static_cast<Cell>(-1);
+            }
+        }
+    };
+
+    // 扫描循环：8位单元用CellScanner整块查找，宽单元逐个检查（越过末端时同样由保护页处理）
+    template <class P>
+    ptrdiff_t scanCells(typename P::Cell* cells, ptrdiff_t pointer, int stride) {
+        if (sizeof(typename P::Cell) == 1) {
+            if (P::wraps) {
+                return static_cast<ptrdiff_t>(CellScanner::findZeroWrapped(
+                    reinterpret_cast<const uint8_t*>(cells), tape_cells, static_cast<size_t>(pointer), stride));
+            }
+            return tape.scan(pointer, stride, accessibleCells());
+        }
+        while (cells[P::at(pointer, 0, static_cast<ptrdiff_t>(tape_cells))] != 0) {
+            pointer = P::move(pointer, stride, static_cast<ptrdiff_t>(tape_cells));
+        }
+        return pointer;
+    }
+
+    template <class P>
+    void executeInstruction() {
+        using Cell = typename P::Cell;
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        const Instruction& instruction = program[instruction_pointer];
+        Cell& cell = cells[P::at(data_pointer, instruction.offset, size)];
+        switch (instruction.op) {
+            case OP_MOVE:
+                data_pointer = P::move(data_pointer, instruction.arg, size);
+                break;
+
+            case OP_ADD:
+                cell += instruction.arg;
+                break;
+
+            case OP_OUTPUT:
+            	writeOutput(static_cast<uint8_t>(cell));
+                break;
+
+            case OP_INPUT:
+                promptInput();
+                P::read(input, cell);
+                break;
+
+            case OP_LOOP_START:
+                if (cell == 0) {
+                    instruction_pointer += instruction.arg;
+                }
+                break;
+
+            case OP_LOOP_END:
+                if (cell != 0) {
+                    instruction_pointer += instruction.arg;
+                }
+                break;
+
+            case OP_CLEAR:
+                cell = 0;
+                break;
+
+            case OP_MUL: {
+                Cell counter = cells[P::at(data_pointer, instruction.from, size)];
+                if (counter != 0) {
+                    cell += counter * instruction.arg;
+                }
+                break;
+            }
+
+            case OP_SCAN:
+                if (cells[P::at(data_pointer, 0, size)] != 0) {
+                    data_pointer = scanCells<P>(cells, data_pointer, instruction.arg);
+                }
+                break;
+
+            case OP_PRODUCT:
+                productCells<P>(cells, data_pointer, instruction);
+                break;
+
+            case OP_DIVMOD:
+                divmodCells<P>(cells, data_pointer, instruction.offset, instruction.from);
+                break;
+
+            case OP_COMPARE:
+                data_pointer = compareCells<P>(cells, data_pointer, instruction.from, instruction.arg);
+                break;
+        }
+    }
+
+    // OP_PRODUCT：单元[offset] += 单元[from] * 单元[by] * arg；和OP_MUL一样，from处为0时不访问其他单元
+    template <class P, class I>
+    void productCells(typename P::Cell* cells, ptrdiff_t pointer, const I& ins) {
+        using Cell = typename P::Cell;
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        const Cell counter = cells[P::at(pointer, ins.from, size)];
+        if (counter != 0) {
+            const uint32_t product = static_cast<uint32_t>(counter) * cells[P::at(pointer, ins.by, size)];
+            cells[P::at(pointer, ins.offset, size)] += static_cast<Cell>(product * static_cast<uint32_t>(ins.arg));
+        }
+    }
+
+    // OP_DIVMOD的闭式计算（写法见lowerIdiom()），单元相对pointer：offset为被除数n（循环n轮，from为offset + 2时n也累加到offset + 1），
+    // from为除数倒计数c，from + 1、from + 2为余数r、商q，from + 3、from + 4为原循环要求为0的临时单元。
+    // 每轮c减1、r加1，c到0时c = c + r、r = 0、q加1；c + r不变，即除数d（0相当于2^cell_bits）。
+    // 原循环要读的临时单元不为0或d为1（重置时r为0，原循环的分支走偏）时不做修改，交给后面的原循环
+    template <class P>
+    void divmodCells(typename P::Cell* cells, ptrdiff_t pointer, int offset, int from) {
+        using Cell = typename P::Cell;
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        Cell& dividend = cells[P::at(pointer, offset, size)];
+        const uint64_t count = dividend;
+        if (count == 0 || cells[P::at(pointer, from + 4, size)] != 0) return;
+
+        const uint64_t range = static_cast<uint64_t>(cellMask()) + 1;
+        Cell& countdown = cells[P::at(pointer, from, size)];
+        Cell& remainder = cells[P::at(pointer, from + 1, size)];
+        const Cell sum = static_cast<Cell>(countdown + remainder);
+        const uint64_t divisor = (sum != 0) ? sum : range;
+        const uint64_t first = (countdown != 0) ? countdown : range; // 第一次重置c所在的轮
+        const uint64_t resets = (count >= first) ? 1 + (count - first) / divisor : 0;
+        // 没有重置的轮会读from + 3
+        if ((resets > 0 && divisor == 1) || (resets < count && cells[P::at(pointer, from + 3, size)] != 0)) return;
+
+        if (resets > 0) {
+            const uint64_t rest = (count - first) % divisor;
+            countdown = static_cast<Cell>(divisor - rest);
+            remainder = static_cast<Cell>(rest);
+            cells[P::at(pointer, from + 2, size)] += static_cast<Cell>(resets);
+        } else {
+            countdown -= static_cast<Cell>(count);
+            remainder += static_cast<Cell>(count);
+        }
+        if (from == offset + 2) {
+            cells[P::at(pointer, offset + 1, size)] += static_cast<Cell>(count);
+        }
+        dividend = 0;
+    }
+
+    // OP_COMPARE的闭式计算，返回执行后的指针：pointer处的x和from处的y每轮各减1，y不为0时扫描停在from + stride（要求为0）再回到x，
+    // x为0时结束；y为0时停在-stride（要求为0）结束。原循环要读的这两个单元不为0时不做修改，交给后面的原循环
+    template <class P>
+    ptrdiff_t compareCells(typename P::Cell* cells, ptrdiff_t pointer, int from, int stride) {
+        using Cell = typename P::Cell;
+        const ptrdiff_t size = static_cast<ptrdiff_t>(tape_cells);
+        Cell& left = cells[P::at(pointer, 0, size)];
+        if (left == 0) return pointer;
+
+        Cell& right = cells[P::at(pointer, from, size)];
+        const uint64_t rounds = (right != 0) ? right : static_cast<uint64_t>(cellMask()) + 1; // y到0的轮数
+        if (rounds <= left) {
+            const ptrdiff_t exit = P::move(pointer, -stride, size);
+            if ((rounds > 1 && cells[P::at(pointer, from + stride, size)] != 0) || cells[P::at(exit, 0, size)] != 0) return pointer;
+            left -= static_cast<Cell>(rounds);
+            right = 0;
+            return exit;
+        }
+        if (cells[P::at(pointer, from + stride, size)] != 0) return pointer;
+        right -= left;
+        left = 0;
+        return pointer;
+    }
+
+    template <class P>
+    void interpretWith() {
+#ifdef BFX_THREADED_DISPATCH
+        if (!packed.codes.empty()) {
+            interpretThreaded<P>(nullptr);
+            return;
+        }
+#endif
+        while (instruction_pointer < program.size()) {
+            executeInstruction<P>();
+            instruction_pointer++;
+        }
+    }
+
+    // 同interpretWith()，执行到break_flags标记的指令之前停下；从标记的指令开始时立即返回
+    template <class P>
+    void debugWith() {
+#ifdef BFX_THREADED_DISPATCH
+        if (!packed.codes.empty()) {
+            interpretThreaded<P>(break_flags.data());
+            return;
+        }
+#endif
+        while (instruction_pointer < program.size() && !break_flags[instruction_pointer]) {
+            executeInstruction<P>();
+            instruction_pointer++;
+        }
+    }
+
+    // 有观察点或记录历史时代替debugWith()：switch分派，'.'之前和写单元的指令之后检查，命中时设置hit_watchpoint后返回；
+    // 记录历史时每条指令之后计数并按间隔保存检查点。两者都没有时不使用，正常执行和只有断点的调试都不付出检查的开销
+    template <class P>
+    void watchWith() {
+        while (instruction_pointer < program.size() && !break_flags[instruction_pointer]) {
+            const int op = program[instruction_pointer].op;
+            hit_watchpoint = matchWatchOutput(instruction_pointer);
+            if (hit_watchpoint >= 0) return;
+            executeInstruction<P>();
+            instruction_pointer++;
+            if (history) recordInstruction();
+            if (writesCells(op)) {
+                hit_watchpoint = matchWatchChange();
+                if (hit_watchpoint >= 0) return;
+            }
+        }
+    }
+
+    // 倒退时从恢复的检查点重新执行到executed等于replay_target或结束，不保存检查点。
+    // replay_scan时同时找出这一段中debugContinue()会停下的最后一个位置（replay_stop/replay_watch）
+    template <class P>
+    void replayWith() {
+        while (executed < replay_target && instruction_pointer < program.size()) {
+            if (replay_scan && ((break_flags[instruction_pointer] && matchBreakpoint(instruction_pointer) >= 0) ||
+                                matchWatchOutput(instruction_pointer) >= 0)) {
+                replay_stop = executed;
+                replay_watch = -1;
+            }
+            const int op = program[instruction_pointer].op;
+            executeInstruction<P>();
+            instruction_pointer++;
+            executed++;
+            if (replay_scan && writesCells(op)) {
+                const int hit = matchWatchChange();
+                if (hit >= 0 && executed < replay_before) {
+                    replay_stop = executed;
+                    replay_watch = hit;
+                }
+            }
+        }
+    }
+
+    // 同interpretWith()的switch分派，另外统计顺序执行（中间没有跳转）的相邻两条、三条指令
+    template <class P>
+    void profileWith() {
+        int older = -1, previous = -1;
+        size_t next = instruction_pointer; // 不跳转时的下一条指令
+        while (instruction_pointer < program.size()) {
+            const int op = program[instruction_pointer].op;
+            if (instruction_pointer != next) {
+                older = previous = -1;
+            }
+            if (previous >= 0) {
+                pair_counts[previous * OP_KINDS + op]++;
+                if (older >= 0) {
+                    triple_counts[(older * OP_KINDS + previous) * OP_KINDS + op]++;
+                }
+            }
+            older = previous;
+            previous = op;
+            next = instruction_pointer + 1;
+            executeInstruction<P>();
+            instruction_pointer++;
+        }
+    }
+
+    // 同interpretWith()的switch分派，另外统计每条指令的执行次数和每个循环进入循环体的次数
+    template <class P>
+    void countWith() {
+        while (instruction_pointer < program.size()) {
+            const size_t current = instruction_pointer;
+            execution_counts[current]++;
+            executeInstruction<P>();
+            if (program[current].op == OP_LOOP_START && instruction_pointer == current) {
+                loop_entries[current]++;  // 没有跳到']'
+            }
+            instruction_pointer++;
+        }
+    }
+
+    void resetCounts() {
+        execution_counts.assign(program.size(), 0);
+        loop_entries.assign(program.size(), 0);
+    }
+
+    // run执行到结束，step执行一条指令（不移动instruction_pointer），profile执行到结束并统计指令序列，
+    // count执行到结束并统计每条指令的执行次数，debug执行到有断点的指令或结束，watch另外在观察点命中时停下并记录历史，replay从检查点重新执行（倒退调试）
+    using EngineFunction = void (BrainfuckCompiler::*)();
+    struct Engine {
+        EngineFunction run;
+        EngineFunction step;
+        EngineFunction profile;
+        EngineFunction count;
+        EngineFunction debug;
+        EngineFunction watch;
+        EngineFunction replay;
+    };
+    Engine engine;
+
+    // 按当前设置查表选出实例；27种组合都在编译时实例化，执行中不再判断这些设置。
+    // 回绕模式下程序不会越过磁带边界时（见needsWrap()）选用扩展模式的实例，不做回绕运算和边界检查
+    void selectEngine() {
+        #define BFX_ENGINE(Cell, Pointer, Eof) \
+            Engine{&BrainfuckCompiler::interpretWith<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::executeInstruction<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::profileWith<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::countWith<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::debugWith<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::watchWith<Policy<Cell, Pointer, Eof>>, \
+                   &BrainfuckCompiler::replayWith<Policy<Cell, Pointer, Eof>>}
+        #define BFX_ENGINES_EOF(Cell, Pointer) \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_UNCHANGED), \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_ZERO), \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_MINUS_ONE)
+        #define BFX_ENGINES(Cell) \
+            BFX_ENGINES_EOF(Cell, POINTER_WRAP), BFX_ENGINES_EOF(Cell, POINTER_ERROR), BFX_ENGINES_EOF(Cell, POINTER_GROW)
+
+        // 下标：(宽度 * 3 + PointerMode) * 3 + EofMode
+        static const Engine engines[] = {
+            BFX_ENGINES(uint8_t), BFX_ENGINES(uint16_t), BFX_ENGINES(uint32_t)
+        };
+
+        #undef BFX_ENGINES
+        #undef BFX_ENGINES_EOF
+        #undef BFX_ENGINE
+
+        int width = (cell_bits == 8) ? 0 : (cell_bits == 16) ? 1 : 2;
+        const PointerMode mode = (pointer_mode == POINTER_WRAP && !needsWrap()) ? POINTER_GROW : pointer_mode;
+        engine = engines[(width * 3 + mode) * 3 + input.getEofMode()];
+    }
+
+    // 由优化后的IR生成C/C++代码（compileToC()/compileToCpp()共用）：
+    // 折叠后的加减和移动，单元按IR中的偏移寻址（移动已由addressByOffset()推迟到循环边界）；清零/乘法/扫描循环生成赋值、memset、乘加和memchr；
+    // 输出经过64KB缓冲，读新一行输入前和结束时写出。单元宽度、回绕和EOF行为与当前设置一致，磁带长度见nativeTapeCells()，
+    // 回绕模式下只在指针范围分析不能证明在磁带内的地方回绕（见statementsSource()）。
+    // 其他模式下单元访问经过at()检查在磁带内，有界的循环同样在入口检查一次；磁带两侧各留2*REACH个单元（REACH为代码长度），
+    // 每次移动后检查指针离磁带不超过REACH，使at()的地址运算不离开存储区，报错模式下结束时还检查指针在磁带内。
+    // 越界时写出已有输出并以退出码1结束。
+    // 预先执行过的部分（见evaluatePrefix()）只留下结果：磁带和指针的初值、开头的一次写出，再goto到停下的指令。
+    // 整除取余、比较循环前调用生成的divmod()/compare()，前提不成立时它们不做修改，由后面的循环执行
+    std::string generateSource(bool cpp) {
+        const bool wrap = needsWrap();
+        const bool checked = pointer_mode != POINTER_WRAP;
+        std::ostringstream out;
+        out << (cpp ? "#include <cstdio>\n#include <cstring>\n" : "#include <stdio.h>\n#include <string.h>\n");
+        if (checked) out << (cpp ? "#include <cstdlib>\n" : "#include <stdlib.h>\n");
+        out << "\n";
+
+        // 整个程序已在加载时执行完：只剩写出
+        if (prefix_instruction > 0 && prefix_instruction >= program.size()) {
+            prefixOutputSource(out);
+            out << "int main(void) {\n";
+            if (!prefix_output.empty()) {
+                out << "    fwrite(prefixOutput, 1, sizeof(prefixOutput), stdout);\n";
+            }
+            out << "    return 0;\n";
+            out << "}\n";
+            return out.str();
+        }
+
+        // 运行时：磁带、输出缓冲区、按行读入的输入缓冲区
+        out << "typedef " << (cell_bits == 8 ? "unsigned char" : cell_bits == 16 ? "unsigned short" : "unsigned int") << " cell;\n";
+        out << "#define TAPE_SIZE " << nativeTapeCells() << "\n";
+        if (checked) {
+            out << "#define REACH " << code.length() + 1 << "\n\n";
+            out << "static cell storage[REACH * 2 + TAPE_SIZE + REACH * 2];\n";
+            out << "static cell* const tape = storage + REACH * 2;\n";
+            if (!prefix_cells.empty()) {
+                out << "static const cell initialTape[] = ";
+                initializerSource(out, prefix_cells);
+                out << ";\n";
+            }
+        } else if (prefix_cells.empty()) {
+            out << "\nstatic cell tape[TAPE_SIZE];\n";
+        } else {
+            out << "\nstatic cell tape[TAPE_SIZE] = ";
+            initializerSource(out, prefix_cells);
+            out << ";\n";
+        }
+        out << "static unsigned char outBuffer[65536];\n";
+        out << "static size_t outLength = 0;\n";
+        out << "static unsigned char inBuffer[65536];\n";
+        out << "static size_t inLength = 0, inPosition = 0;\n\n";
+        out << "static void flushOutput(void) {\n"
+               "    fwrite(outBuffer, 1, outLength, stdout);\n"
+               "    fflush(stdout);\n"
+               "    outLength = 0;\n"
+               "}\n\n";
+        out << "static void put(cell c) {\n"
+               "    outBuffer[outLength++] = (unsigned char)c;\n"
+               "    if (outLength == sizeof(outBuffer)) {\n"
+               "        flushOutput();\n"
+               "    }\n"
+               "}\n\n";
+        out << "static int get(void) {\n"
+               "    if (inPosition == inLength) {\n"
+               "        int c;\n"
+               "        flushOutput();\n"
+               "        inLength = inPosition = 0;\n"
+               "        while (inLength < sizeof(inBuffer) && (c = getchar()) != EOF) {\n"
+               "            inBuffer[inLength++] = (unsigned char)c;\n"
+               "            if (c == '\\n') {\n"
+               "                break;\n"
+               "            }\n"
+               "        }\n"
+               "        if (inLength == 0) {\n"
+               "            return EOF;\n"
+               "        }\n"
+               "    }\n"
+               "    return inBuffer[inPosition++];\n"
+               "}\n\n";
+        if (checked) {
+            out << "static void pointerError(void) {\n"
+                   "    flushOutput();\n"
+                   "    exit(1);\n"
+                   "}\n\n";
+            out << "static int reachable(cell* p) {\n"
+                   "    return p != 0 && p >= tape - REACH && p < tape + TAPE_SIZE + REACH;\n"
+                   "}\n\n";
+            out << "static cell* at(cell* p, long offset) {\n"
+                   "    if (p + offset < tape || p + offset >= tape + TAPE_SIZE) {\n"
+                   "        pointerError();\n"
+                   "    }\n"
+                   "    return p + offset;\n"
+                   "}\n\n";
+        } else if (wrap) {
+            out << "static cell* at(cell* p, long offset) {\n"
+                   "    long i = (long)(p - tape) + offset;\n"
+                   "    i %= TAPE_SIZE;\n"
+                   "    if (i < 0) {\n"
+                   "        i += TAPE_SIZE;\n"
+                   "    }\n"
+                   "    return tape + i;\n"
+                   "}\n\n";
+        }
+        if (wrap || checked) {
+            out << "static int inside(cell* p, long low, long high) {\n"
+                   "    return (long)(p - tape) + low >= 0 && (long)(p - tape) + high < TAPE_SIZE;\n"
+                   "}\n\n";
+        }
+        idiomSource(out);
+        prefixOutputSource(out);
+        out << "int main(void) {\n";
+        if (!prefix_output.empty()) {
+            out << "    fwrite(prefixOutput, 1, sizeof(prefixOutput), stdout);\n";
+        }
+        if (checked && !prefix_cells.empty()) {
+            out << "    memcpy(tape, initialTape, sizeof(initialTape));\n";
+        }
+        out << "    cell* p = tape";
+        if (prefix_pointer != 0) {
+            out << " + " << prefix_pointer;
+        }
+        out << ";\n";
+        if (prefix_instruction > 0) {
+            out << "    goto resume;\n";
+        }
+
+        statementsSource(out, 0, program.size(), 1, wrap || checked, wrap || checked);
+
+        out << "    flushOutput();\n";
+        if (pointer_mode == POINTER_ERROR) {
+            out << "    return p >= tape && p < tape + TAPE_SIZE ? 0 : 1;\n";
+        } else {
+            out << "    return 0;\n";
+        }
+        out << "}\n";
+        return out.str();
+    }
+
+    // 生成代码的缩进
+    // 生成IR中[first, end)的执行代码（其中的循环完整配对）。guarded时单元访问经过at()（回绕模式下移动也回绕）。
+    // split时有界的循环（见analyzePointerRange()）在入口检查一次整个循环是否都在磁带内，是则执行直接访问的一份，
+    // 否则执行经过at()的一份；只有最外层的有界循环这样生成，代码最多增加一倍，含预先执行停下位置（resume标签）的循环只生成经过at()的一份
+    void statementsSource(std::ostream& out, size_t first, size_t end, int depth, bool guarded, bool split) {
+        for (size_t i = first; i < end; i++) {
+            const Instruction& ins = program[i];
+            if (i == prefix_instruction && i > 0) {
+                indentSource(out, depth) << "resume: ;\n";
+            }
+            if (split && ins.op == OP_LOOP_START && ins.arg != 0 && loop_ranges[i].bounded &&
+                (prefix_instruction == 0 || prefix_instruction < i || prefix_instruction > i + ins.arg)) {
+                const size_t loop_end = i + ins.arg + 1;
+                indentSource(out, depth) << "if (inside(p, " << loop_ranges[i].low << ", " << loop_ranges[i].high << ")) {\n";
+                statementsSource(out, i, loop_end, depth + 1, false, false);
+                indentSource(out, depth) << "} else {\n";
+                statementsSource(out, i, loop_end, depth + 1, true, false);
+                indentSource(out, depth) << "}\n";
+                i = loop_end - 1;
+                continue;
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    indentSource(out, depth) << cellSource(ins.offset, guarded)
+                                             << (ins.arg < 0 ? " -= " : " += ") << (ins.arg < 0 ? -ins.arg : ins.arg) << ";\n";
+                    break;
+                case OP_MOVE:
+                    if (guarded && pointer_mode == POINTER_WRAP) {
+                        indentSource(out, depth) << "p = at(p, " << ins.arg << ");\n";
+                    } else {
+                        indentSource(out, depth) << "p " << (ins.arg < 0 ? "-= " : "+= ") << (ins.arg < 0 ? -ins.arg : ins.arg) << ";\n";
+                        if (guarded) pointerCheckSource(out, depth);
+                    }
+                    break;
+                case OP_OUTPUT:
+                    indentSource(out, depth) << "put(" << cellSource(ins.offset, guarded) << ");\n";
+                    break;
+                case OP_INPUT:
+                    indentSource(out, depth);
+                    if (input.getEofMode() == InputSource::EOF_MINUS_ONE) {
+                        out << cellSource(ins.offset, guarded) << " = (cell)get();\n";
+                    } else if (input.getEofMode() == InputSource::EOF_ZERO) {
+                        out << "{ int c = get(); " << cellSource(ins.offset, guarded) << " = (cell)(c == EOF ? 0 : c); }\n";
+                    } else {
+                        out << "{ int c = get(); if (c != EOF) " << cellSource(ins.offset, guarded) << " = (cell)c; }\n";
+                    }
+                    break;
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    indentSource(out, depth++) << "while (" << cellSource(ins.offset, guarded) << ") {\n";
+                    break;
+                case OP_LOOP_END:
+                    if (ins.arg == 0) {
+                        break;
+                    }
+                    indentSource(out, --depth) << "}\n";
+                    break;
+                case OP_CLEAR: {
+                    // 偏移依次加1的一串清零（"[-]>[-]>[-]"）合并为一次memset
+                    size_t count = 1;
+                    while (!guarded && i + count < end && i + count != prefix_instruction &&
+                           program[i + count].op == OP_CLEAR && program[i + count].offset == ins.offset + static_cast<int>(count)) {
+                        count++;
+                    }
+                    if (count >= 4) {
+                        indentSource(out, depth) << "memset(p + " << ins.offset << ", 0, " << count << " * sizeof(cell));\n";
+                        i += count - 1;
+                    } else {
+                        indentSource(out, depth) << cellSource(ins.offset, guarded) << " = 0;\n";
+                    }
+                    break;
+                }
+                case OP_MUL: {
+                    // lowerLoop()生成的若干OP_MUL之后紧跟一条清零计数单元的OP_CLEAR，整体对应原来的循环
+                    const int from = ins.from;
+                    indentSource(out, depth) << "if (" << cellSource(from, guarded) << ") {\n";
+                    for (; i < end && program[i].op == OP_MUL && program[i].from == from; i++) {
+                        int factor = program[i].arg < 0 ? -program[i].arg : program[i].arg;
+                        indentSource(out, depth + 1) << cellSource(program[i].offset, guarded)
+                                                     << (program[i].arg < 0 ? " -= " : " += ") << cellSource(from, guarded);
+                        if (factor != 1) {
+                            out << " * " << factor;
+                        }
+                        out << ";\n";
+                    }
+                    if (i < end && program[i].op == OP_CLEAR && program[i].offset == from) {
+                        indentSource(out, depth + 1) << cellSource(from, guarded) << " = 0;\n";
+                    } else {
+                        i--;
+                    }
+                    indentSource(out, depth) << "}\n";
+                    break;
+                }
+                case OP_SCAN:
+                    // 扫描循环无界，需要回绕或检查时总在经过at()的代码中
+                    if (guarded && pointer_mode == POINTER_WRAP) {
+                        indentSource(out, depth) << "while (*p) p = at(p, " << ins.arg << ");\n";
+                    } else if (ins.arg == 1 && cell_bits == 8 && guarded) {
+                        // 只查到磁带末端，找不到0时memchr()返回空指针，由reachable()报告
+                        indentSource(out, depth) << "if (*at(p, 0)) {\n";
+                        indentSource(out, depth + 1) << "p = (cell*)memchr(p, 0, (size_t)(tape + TAPE_SIZE - p));\n";
+                        pointerCheckSource(out, depth + 1);
+                        indentSource(out, depth) << "}\n";
+                    } else if (ins.arg == 1 && cell_bits == 8) {
+                        indentSource(out, depth) << "p = (cell*)memchr(p, 0, (size_t)(tape + TAPE_SIZE - p));\n";
+                    } else {
+                        indentSource(out, depth) << "while (" << cellSource(0, guarded) << ") p " << (ins.arg < 0 ? "-= " : "+= ")
+                                                 << (ins.arg < 0 ? -ins.arg : ins.arg) << ";\n";
+                    }
+                    break;
+                case OP_PRODUCT:
+                    indentSource(out, depth);
+                    if (guarded && pointer_mode != POINTER_WRAP) {
+                        out << "if (" << cellSource(ins.from, guarded) << ") "; // 同productCells()，计数为0时不访问其他单元
+                    }
+                    out << cellSource(ins.offset, guarded) << (ins.arg < 0 ? " -= " : " += ")
+                        << "(unsigned)" << cellSource(ins.from, guarded) << " * " << cellSource(ins.by, guarded);
+                    if (ins.arg != 1 && ins.arg != -1) {
+                        out << " * " << (ins.arg < 0 ? -ins.arg : ins.arg);
+                    }
+                    out << ";\n";
+                    break;
+                case OP_DIVMOD: {
+                    // 检查越界时divmod()/compare()按条件访问单元：不全在磁带内就不调用，由后面的循环经过at()执行
+                    const bool access = guarded && pointer_mode == POINTER_WRAP;
+                    indentSource(out, depth);
+                    if (guarded && !access) {
+                        out << "if (inside(p, " << std::min(ins.offset, ins.from) << ", " << std::max(ins.offset + 1, ins.from + 4) << ")) ";
+                    }
+                    out << "divmod(" << pointerSource(ins.offset, access) << ", "
+                        << (ins.from == ins.offset + 2 ? pointerSource(ins.offset + 1, access) : "0");
+                    for (int k = 0; k <= 4; k++) {
+                        out << ", " << pointerSource(ins.from + k, access);
+                    }
+                    out << ");\n";
+                    break;
+                }
+                case OP_COMPARE: {
+                    const bool access = guarded && pointer_mode == POINTER_WRAP;
+                    indentSource(out, depth);
+                    if (guarded && !access) {
+                        out << "if (inside(p, " << std::min({0, -ins.arg, ins.from, ins.from + ins.arg}) << ", "
+                            << std::max({0, -ins.arg, ins.from, ins.from + ins.arg}) << ")) ";
+                    }
+                    out << "p = compare(p, " << pointerSource(ins.from, access) << ", "
+                        << pointerSource(ins.from + ins.arg, access) << ", " << pointerSource(-ins.arg, access) << ");\n";
+                    break;
                 }
-
-                size_t start = loop_stack.top();
-                loop_stack.pop();
-
-                jump_forward[start] = i;
-                jump_backward[i] = start;
             }
         }
-
-        if (!loop_stack.empty()) {
-            throw std::runtime_error("Unmatched '[' in code");
-        }
     }
 
-    // 娓呯悊鍜岄獙璇佷唬鐮?
-    void loadCode(const std::string& brainfuck_code) {
-        code.clear();
-
-        // 鍙繚鐣欐湁鏁堢殑Brainfuck鎸囦护
-        for (char c : brainfuck_code) {
-            if (c == '>' || c == '<' || c == '+' || c == '-' ||
-                c == '.' || c == ',' || c == '[' || c == ']') {
-                code += c;
-            }
-        }
-
-        precomputeJumps();
+    // 移动指针后的越界检查，回绕模式下不生成
+    void pointerCheckSource(std::ostream& out, int depth) const {
+        if (pointer_mode == POINTER_WRAP) return;
+        indentSource(out, depth) << "if (!reachable(p)) pointerError();\n";
     }
 
-    // 浠庢枃浠跺姞杞戒唬鐮?
-    void loadCodeFromFile(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Cannot open file: " + filename);
+    static std::ostream& indentSource(std::ostream& out, int depth) {
+        for (int i = 0; i < depth; i++) {
+            out << "    ";
         }
-
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        loadCode(buffer.str());
+        return out;
     }
 
-    // 瑙ｉ噴鎵ц
-    void interpret() {
-        data_pointer = 0;
-        instruction_pointer = 0;
-        fill(memory.begin(), memory.end(), 0);
-
-        while (instruction_pointer < code.length()) {
-            executeInstruction();
-            instruction_pointer++;
+    // 预先执行的输出写成数组prefixOutput，没有输出时不生成
+    void prefixOutputSource(std::ostream& out) const {
+        if (prefix_output.empty()) {
+            return;
         }
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(prefix_output.data());
+        out << "static const unsigned char prefixOutput[] = ";
+        initializerSource(out, std::vector<uint32_t>(bytes, bytes + prefix_output.size()));
+        out << ";\n\n";
     }
 
-    // 鍗曟鎵ц锛堢敤浜庤皟璇曪級
-    bool step() {
-        if (instruction_pointer >= code.length()) {
-            return false;
+    // 数组初值列表，每行16个
+    static void initializerSource(std::ostream& out, const std::vector<uint32_t>& values) {
+        out << "{";
+        for (size_t i = 0; i < values.size(); i++) {
+            out << (i % 16 == 0 ? "\n    " : " ") << values[i] << (i + 1 < values.size() ? "," : "");
         }
-
-        executeInstruction();
-        instruction_pointer++;
-        return true;
+        out << "\n}";
     }
 
-    // 鑾峰彇鍐呭瓨鐘舵€侊紙鐢ㄤ簬璋冭瘯锛?
-    void printMemoryState(size_t start = 0, size_t count = 20) {
-        std::cout << "Memory state (pointer at " << data_pointer << "): ";
-        for (size_t i = start; i < start + count && i < memory.size(); i++) {
-            std::cout << static_cast<int>(memory[i]) << " ";
+    // 生成代码中的divmod()/compare()，只生成用到的；与divmodCells()/compareCells()逐条对应，参数为各单元的地址
+    void idiomSource(std::ostream& out) const {
+        bool divmod = false, compare = false;
+        for (const Instruction& ins : program) {
+            divmod = divmod || ins.op == OP_DIVMOD;
+            compare = compare || ins.op == OP_COMPARE;
+        }
+        if (divmod) {
+            out << "static void divmod(cell* n, cell* copy, cell* c, cell* r, cell* q, cell* t1, cell* t2) {\n"
+                   "    const unsigned long long size = (unsigned long long)(cell)-1 + 1;\n"
+                   "    unsigned long long count = *n, divisor, first, resets = 0, rest;\n"
+                   "    if (count == 0 || *t2) {\n"
+                   "        return;\n"
+                   "    }\n"
+                   "    divisor = (cell)(*c + *r) ? (cell)(*c + *r) : size;\n"
+                   "    first = *c ? *c : size;\n"
+                   "    if (count >= first) {\n"
+                   "        resets = 1 + (count - first) / divisor;\n"
+                   "    }\n"
+                   "    if ((resets && divisor == 1) || (resets < count && *t1)) {\n"
+                   "        return;\n"
+                   "    }\n"
+                   "    if (resets) {\n"
+                   "        rest = (count - first) % divisor;\n"
+                   "        *c = (cell)(divisor - rest);\n"
+                   "        *r = (cell)rest;\n"
+                   "        *q += (cell)resets;\n"
+                   "    } else {\n"
+                   "        *c -= (cell)count;\n"
+                   "        *r += (cell)count;\n"
+                   "    }\n"
+                   "    if (copy) {\n"
+                   "        *copy += (cell)count;\n"
+                   "    }\n"
+                   "    *n = 0;\n"
+                   "}\n\n";
+        }
+        if (compare) {
+            out << "static cell* compare(cell* x, cell* y, cell* between, cell* after) {\n"
+                   "    unsigned long long rounds = *y ? *y : (unsigned long long)(cell)-1 + 1;\n"
+                   "    if (*x == 0) {\n"
+                   "        return x;\n"
+                   "    }\n"
+                   "    if (rounds <= *x) {\n"
+                   "        if ((rounds > 1 && *between) || *after) {\n"
+                   "            return x;\n"
+                   "        }\n"
+                   "        *x -= (cell)rounds;\n"
+                   "        *y = 0;\n"
+                   "        return after;\n"
+                   "    }\n"
+                   "    if (*between) {\n"
+                   "        return x;\n"
+                   "    }\n"
+                   "    *y -= *x;\n"
+                   "    *x = 0;\n"
+                   "    return x;\n"
+                   "}\n\n";
         }
-        std::cout << std::endl;
     }
 
-    // 鑾峰彇褰撳墠鐘舵€侊紙鐢ㄤ簬璋冭瘯锛?
-    void printCurrentState() {
-        std::cout << "IP: " << instruction_pointer << ", DP: " << data_pointer
-                  << ", Current Cell: " << static_cast<int>(memory[data_pointer]) << std::endl;
+    // 生成代码中相对指针p偏移offset处单元地址的写法
+    static std::string pointerSource(int offset, bool wrap) {
+        std::ostringstream ref;
+        if (offset == 0) {
+            ref << "p";
+        } else if (wrap) {
+            ref << "at(p, " << offset << ")";
+        } else {
+            ref << "p " << (offset < 0 ? "- " : "+ ") << (offset < 0 ? -offset : offset);
+        }
+        return ref.str();
     }
 
-private:
-    void executeInstruction() {
-        char instruction = code[instruction_pointer];
-        switch (instruction) {
-            case '>':
-                data_pointer = (data_pointer + 1) % MEMORY_SIZE;
-                break;
-
-            case '<':
-                data_pointer = (data_pointer == 0) ? MEMORY_SIZE - 1 : data_pointer - 1;
-                break;
-
-            case '+':
-                memory[data_pointer]++;
-                break;
-
-            case '-':
-                memory[data_pointer]--;
-                break;
-
-            case '.':
-            	std::cout << "Output(only-one-character) >> " << memory[data_pointer] << "\n";
-                break;
-
-            case ',':
-                {
-                	std::cout << "Input(only-one-character,any-extra-is-ignored) >> ";
-                    std::string input;
-                    std::getline(std::cin,input);
-                    memory[data_pointer] = input[0];
-                }
-                break;
-
-            case '[':
-                if (memory[data_pointer] == 0) {
-                    instruction_pointer = jump_forward[instruction_pointer];
-                }
-                break;
-
-            case ']':
-                if (memory[data_pointer] != 0) {
-                    instruction_pointer = jump_backward[instruction_pointer];
-                }
-                break;
+    // 生成代码中相对指针p偏移offset处单元的写法，guarded时经过at()（回绕模式下p本身总在磁带内）
+    std::string cellSource(int offset, bool guarded) const {
+        std::ostringstream ref;
+        if (offset == 0 && (!guarded || pointer_mode == POINTER_WRAP)) {
+            ref << "*p";
+        } else if (guarded) {
+            ref << "*at(p, " << offset << ")";
+        } else {
+            ref << "p[" << offset << "]";
         }
+        return ref.str();
     }
 
 public:
     // 缂栬瘧涓篊浠ｇ爜
     std::string compileToC() {
-        std::stringstream c_code;
+        return generateSource(false);
+    }
+
+    // 缂栬瘧涓篊++浠ｇ爜
+    std::string compileToCpp() {
+        return generateSource(true);
+    }
 
-        c_code << "#include <bits/stdc++.h>\n";
-        c_code << "using namespace std;\n\n";
-        c_code << "int main() {\n";
-        c_code << "    unsigned char memory[" << MEMORY_SIZE << "] = {0};\n";
-        c_code << "    unsigned char *ptr = memory;\n\n";
+    // 编译为x86-64汇编（GNU as，Intel语法，Linux），不依赖C库，输入输出直接用系统调用并经过64KB缓冲
+    // as -o prog.o prog.s && ld -o prog prog.o；单元不是8位或需要回绕（见needsWrap()）时返回空串。
+    // 与compileToElf()一样在磁带前留一页空隙（启动时mprotect为不可访问），左侧越界触发段错误而不是写进缓冲区
+    std::string compileToAsm() {
+        if (cell_bits != 8 || needsWrap()) {
+            return "";
+        }
+        std::ostringstream out;
+        out << "# Brainfuck IDE生成的x86-64汇编\n"
+               "# as -o prog.o prog.s && ld -o prog prog.o\n"
+               "    .intel_syntax noprefix\n"
+               "    .bss\n"
+               "    .balign 4096\n"
+               "buffers:\n"
+               "    .skip " << ELF_BUFFER_SIZE * 2 << "\n"
+               "    .balign 4096\n"
+               "guard:\n"
+               "    .skip 4096\n"
+               "tape:\n"
+               "    .skip " << nativeTapeBytes() << "\n"
+               "    .text\n"
+               "    .globl _start\n\n";
 
-        for (size_t i = 0; i < code.length(); i++) {
-            char instruction = code[i];
+        // 运行时子程序，寄存器用途见emitElfRuntime()
+        out << "flush:\n"
+               "    mov rsi, r12\n"
+               "    mov rdx, r13\n"
+               ".Lflush_loop:\n"
+               "    test rdx, rdx\n"
+               "    jle .Lflush_done\n"
+               "    mov edi, 1\n"
+               "    mov eax, 1\n"
+               "    syscall\n"
+               "    test rax, rax\n"
+               "    jle .Lflush_done\n"
+               "    add rsi, rax\n"
+               "    sub rdx, rax\n"
+               "    jmp .Lflush_loop\n"
+               ".Lflush_done:\n"
+               "    xor r13d, r13d\n"
+               "    ret\n\n";
+        out << "put:\n"
+               "    mov byte ptr [r12 + r13], al\n"
+               "    inc r13\n"
+               "    cmp r13, " << ELF_BUFFER_SIZE << "\n"
+               "    je flush\n"
+               "    ret\n\n";
+        out << "get:\n"
+               "    cmp r14, r15\n"
+               "    jb .Lget_have\n"
+               "    call flush\n"
+               "    xor edi, edi\n"
+               "    lea rsi, [r12 + " << ELF_BUFFER_SIZE << "]\n"
+               "    mov edx, " << ELF_BUFFER_SIZE << "\n"
+               "    xor eax, eax\n"
+               "    syscall\n"
+               "    xor r14d, r14d\n"
+               "    mov r15, rax\n"
+               "    test rax, rax\n"
+               "    jg .Lget_have\n"
+               "    xor r15d, r15d\n"
+               "    mov eax, -1\n"
+               "    ret\n"
+               ".Lget_have:\n"
+               "    movzx eax, byte ptr [r12 + r14 + " << ELF_BUFFER_SIZE << "]\n"
+               "    inc r14\n"
+               "    ret\n\n";
 
-            // 娣诲姞缂╄繘
-            c_code << "    ";
+        out << "_start:\n"
+               "    lea rdi, [rip + guard]\n"
+               "    mov esi, 4096\n"
+               "    xor edx, edx\n"
+               "    mov eax, 10\n"
+               "    syscall\n"
+               "    lea rbx, [rip + tape]\n"
+               "    lea r12, [rip + buffers]\n"
+               "    xor r13d, r13d\n"
+               "    xor r14d, r14d\n"
+               "    xor r15d, r15d\n";
 
-            switch (instruction) {
-                case '>':
-                    c_code << "++ptr;";
+        std::vector<int> loop_labels; // 尚未结束的循环的标签编号
+        int label_count = 0;
+        for (int i = 0; i < (int)program.size(); i++) {
+            const Instruction& ins = program[i];
+            switch (ins.op) {
+                case OP_ADD:
+                    out << "    add " << asmCell(ins.offset) << ", " << (ins.arg & 0xFF) << "\n";
+                    break;
+                case OP_MOVE:
+                    out << "    add rbx, " << ins.arg << "\n";
                     break;
-                case '<':
-                    c_code << "--ptr;";
+                case OP_OUTPUT:
+                    out << "    mov al, " << asmCell(ins.offset) << "\n"
+                           "    call put\n";
+                    break;
+                case OP_INPUT:
+                    out << "    call get\n";
+                    if (input.getEofMode() == InputSource::EOF_ZERO) {
+                        out << "    test eax, eax\n"
+                               "    jns 1f\n"
+                               "    xor eax, eax\n"
+                               "1:\n";
+                    } else if (input.getEofMode() == InputSource::EOF_UNCHANGED) {
+                        out << "    test eax, eax\n"
+                               "    js 1f\n"
+                               "    mov " << asmCell(ins.offset) << ", al\n"
+                               "1:\n";
+                        break;
+                    }
+                    out << "    mov " << asmCell(ins.offset) << ", al\n";
                     break;
-                case '+':
-                    c_code << "++*ptr;";
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    loop_labels.push_back(label_count++);
+                    out << "    cmp " << asmCell(ins.offset) << ", 0\n"
+                           "    je .Lend" << loop_labels.back() << "\n"
+                           ".Lbegin" << loop_labels.back() << ":\n";
                     break;
-                case '-':
-                    c_code << "--*ptr;";
+                case OP_LOOP_END:
+                    if (ins.arg == 0 || loop_labels.empty()) {
+                        break;
+                    }
+                    out << "    cmp " << asmCell(ins.offset) << ", 0\n"
+                           "    jne .Lbegin" << loop_labels.back() << "\n"
+                           ".Lend" << loop_labels.back() << ":\n";
+                    loop_labels.pop_back();
                     break;
-                case '.':
-                    c_code << "putchar(*ptr);";
+                case OP_CLEAR:
+                    out << "    mov " << asmCell(ins.offset) << ", 0\n";
                     break;
-                case ',':
-                    c_code << "*ptr = getchar();";
+                case OP_MUL:
+                    out << "    movzx eax, " << asmCell(ins.from) << "\n"
+                           "    test al, al\n"
+                           "    je 1f\n"
+                           "    imul eax, eax, " << ins.arg << "\n"
+                           "    add " << asmCell(ins.offset) << ", al\n"
+                           "1:\n";
                     break;
-                case '[':
-                    c_code << "while (*ptr) {";
+                case OP_SCAN:
+                    out << "    cmp byte ptr [rbx], 0\n"
+                           "    je 1f\n"
+                           "2:\n"
+                           "    add rbx, " << ins.arg << "\n"
+                           "    cmp byte ptr [rbx], 0\n"
+                           "    jne 2b\n"
+                           "1:\n";
                     break;
-                case ']':
-                    c_code << "}";
+                case OP_PRODUCT:
+                    out << "    movzx eax, " << asmCell(ins.from) << "\n"
+                           "    movzx ecx, " << asmCell(ins.by) << "\n"
+                           "    imul eax, ecx\n"
+                           "    test al, al\n"
+                           "    je 1f\n"
+                           "    imul eax, eax, " << ins.arg << "\n"
+                           "    add " << asmCell(ins.offset) << ", al\n"
+                           "1:\n";
                     break;
+                case OP_DIVMOD:
+                case OP_COMPARE:
+                    break; // 不展开，直接执行后面的原循环（与compileToElf()一致）
             }
-
-            c_code << "\n";
         }
 
-        c_code << "    return 0;\n";
-        c_code << "}\n";
-
-        return c_code.str();
+        out << "    call flush\n"
+               "    mov eax, 60\n"
+               "    xor edi, edi\n"
+               "    syscall\n";
+        return out.str();
     }
 
-    // 缂栬瘧涓篊++浠ｇ爜
-    std::string compileToCpp() {
-        std::stringstream cpp_code;
-
-        cpp_code << "#include <bits/stdc++.h>\n";
-        cpp_code << "using namespace std;\n\n";
-        cpp_code << "int main() {\n";
-        cpp_code << "    vector<unsigned char> memory(" << MEMORY_SIZE << ", 0);\n";
-        cpp_code << "    size_t data_pointer = 0;\n\n";
+    // 汇编中相对rbx偏移offset处的单元
+    static std::string asmCell(int offset) {
+        std::ostringstream ref;
+        ref << "byte ptr [rbx";
+        if (offset > 0) {
+            ref << " + " << offset;
+        } else if (offset < 0) {
+            ref << " - " << -offset;
+        }
+        ref << "]";
+        return ref.str();
+    }
 
-        for (size_t i = 0; i < code.length(); i++) {
-            char instruction = code[i];
+    // 直接写出静态链接的ELF64可执行文件，不需要汇编器、链接器或C编译器；机器码与compileToAsm()对应
+    // 代码段在0x400000，缓冲区和磁带各占一个不占文件空间的段，前面各留一页空隙，越界即段错误
+    // 磁带长度：报错模式为getTapeSize()，扩展模式为Tape::DEFAULT_LIMIT（未访问的页不占内存）
+    bool compileToElf(const std::string& file_name) {
+        if (cell_bits != 8 || needsWrap()) {
+            return false;
+        }
+        const unsigned int text_address = 0x400000;
+        const int header_size = 64 + 56 * 4; // ELF头和4个程序头
 
-            // 娣诲姞缂╄繘
-            cpp_code << "    ";
+        jit_buffer.assign(header_size, 0);
+        int put_routine, get_routine;
+        int flush_routine = emitElfRuntime(put_routine, get_routine);
 
-            switch (instruction) {
-                case '>':
-                    cpp_code << "data_pointer = (data_pointer + 1) % " << MEMORY_SIZE << ";";
-                    break;
-                case '<':
-                    cpp_code << "data_pointer = (data_pointer == 0) ? " << MEMORY_SIZE - 1 << " : data_pointer - 1;";
-                    break;
-                case '+':
-                    cpp_code << "memory[data_pointer]++;";
-                    break;
-                case '-':
-                    cpp_code << "memory[data_pointer]--;";
-                    break;
-                case '.':
-                    cpp_code << "cout << memory[data_pointer];";
-                    break;
-                case ',':
-                    cpp_code << "cin >> memory[data_pointer];";
-                    break;
-                case '[':
-                    cpp_code << "while (memory[data_pointer] != 0) {";
-                    break;
-                case ']':
-                    cpp_code << "}";
-                    break;
-            }
+        // 入口：rbx指向磁带开头，r12指向缓冲区，其余运行时寄存器清零
+        int entry = (int)jit_buffer.size();
+        emit(0xBB);                              // mov ebx, imm32 (tape)
+        int tape_patch = (int)jit_buffer.size();
+        emitInt32(0);
+        emit(0x41, 0xBC);                        // mov r12d, imm32 (buffers)
+        int buffer_patch = (int)jit_buffer.size();
+        emitInt32(0);
+        emit(0x45, 0x31, 0xED);                  // xor r13d, r13d
+        emit(0x45, 0x31, 0xF6);                  // xor r14d, r14d
+        emit(0x45, 0x31, 0xFF);                  // xor r15d, r15d
+        if (!emitInstructions(put_routine, get_routine, 0, program.size(), 0, false)) {
+            jit_buffer.clear();
+            return false;
+        }
+        emitCallRel32(flush_routine);             // call flush
+        emit(0xB8); emitInt32(60);               // mov eax, 60 (exit)
+        emit(0x31, 0xFF);                        // xor edi, edi
+        emit(0x0F, 0x05);                        // syscall
 
-            cpp_code << "\n";
+        // 各段的地址都在4GB以内，可以用32位立即数寻址
+        const unsigned long long page = 0x1000;
+        const unsigned long long file_size = jit_buffer.size();
+        const unsigned long long buffer_address = (text_address + file_size + page - 1) / page * page + page;
+        const unsigned long long buffer_size = ELF_BUFFER_SIZE * 2;
+        const unsigned long long tape_address = buffer_address + buffer_size + page;
+        const unsigned long long tape_size = (nativeTapeBytes() + page - 1) / page * page;
+        if (tape_address + tape_size > 0xFFFFFFFFULL) {
+            jit_buffer.clear();
+            return false;
         }
+        patchInt32(tape_patch, static_cast<unsigned int>(tape_address));
+        patchInt32(buffer_patch, static_cast<unsigned int>(buffer_address));
+
+        // ELF头
+        std::vector<unsigned char> header;
+        const unsigned char ident[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        header.insert(header.end(), ident, ident + 16);
+        appendLittleEndian(header, 2, 2);                    // e_type: ET_EXEC
+        appendLittleEndian(header, 0x3E, 2);                 // e_machine: x86-64
+        appendLittleEndian(header, 1, 4);                    // e_version
+        appendLittleEndian(header, text_address + entry, 8);  // e_entry
+        appendLittleEndian(header, 64, 8);                   // e_phoff
+        appendLittleEndian(header, 0, 8);                    // e_shoff
+        appendLittleEndian(header, 0, 4);                    // e_flags
+        appendLittleEndian(header, 64, 2);                   // e_ehsize
+        appendLittleEndian(header, 56, 2);                   // e_phentsize
+        appendLittleEndian(header, 4, 2);                    // e_phnum
+        appendLittleEndian(header, 64, 2);                   // e_shentsize
+        appendLittleEndian(header, 0, 2);                    // e_shnum
+        appendLittleEndian(header, 0, 2);                    // e_shstrndx
 
-        cpp_code << "    return 0;\n";
-        cpp_code << "}\n";
+        // 程序头：代码段、缓冲区段、磁带段，以及不可执行的栈
+        appendProgramHeader(header, 1, 5, 0, text_address, file_size, file_size);
+        appendProgramHeader(header, 1, 6, 0, buffer_address, 0, buffer_size);
+        appendProgramHeader(header, 1, 6, 0, tape_address, 0, tape_size);
+        appendProgramHeader(header, 0x6474E551, 6, 0, 0, 0, 0);
+        std::copy(header.begin(), header.end(), jit_buffer.begin());
 
-        return cpp_code.str();
+        std::ofstream file(file_name.c_str(), std::ios::binary);
+        bool written = file.is_open() &&
+                       file.write(reinterpret_cast<const char*>(&jit_buffer[0]), jit_buffer.size());
+        file.close();
+        jit_buffer.clear();
+#ifndef _WIN32
+        if (written) {
+            chmod(file_name.c_str(), 0755);
+        }
+#endif
+        return written;
     }
 };
 
@@ -330,12 +4283,14 @@ void initializeTranslations() {
     english["editor_commands"] = "Editor Commands:";
     english["edit_program"] = "1. Input/Edit program (supports comments)";
     english["run_program"] = "2. Run program";
-    english["debug_program"] = "3. Debug Program";  // 补全
-    english["save_program"] = "4. Save program (with comments)";  // 调整序号
-    english["clear_program"] = "5. Clear program";  // 调整序号
-    english["show_filtered"] = "6. Show filtered code";  // 调整序号
-    english["language_settings_editor"] = "7. Language Settings";  // 调整序号
-    english["back_menu"] = "8. Back to main menu";  // 调整序号
+    english["profile_program"] = "3. Profile program (hot loops)";
+    english["debug_program"] = "4. Debug Program";  // 补全
+    english["native_program"] = "5. Compile to native and run";
+    english["save_program"] = "6. Save program (with comments)";  // 调整序号
+    english["clear_program"] = "7. Clear program";  // 调整序号
+    english["show_filtered"] = "8. Show filtered code";  // 调整序号
+    english["language_settings_editor"] = "9. Language Settings";  // 调整序号
+    english["back_menu"] = "10. Back to main menu";  // 调整序号
     english["select_option"] = "Select: ";
     english["program_empty"] = "Program is empty!";
     english["program_cleared"] = "Program cleared!";
@@ -347,6 +4302,32 @@ void initializeTranslations() {
     english["run_success"] = "Program executed successfully.";
     english["pointer_error"] = "Pointer out of bounds!";
     english["compile_error"] = "Compile error!";
+    english["native_built"] = "Native program built and executed (saved to cache).";
+    english["native_cached"] = "Cached native program executed.";
+    english["native_failed"] = "Native build failed! Check that a C compiler is installed (set CC to choose one).";
+    english["debug_help"] = "Commands: b <pos> [if <cell|*> <op> <value>] - breakpoint at filtered position; l <line> [if ...] - breakpoint at line; "
+                            "d <n> - delete; w <cell> [== <value> | out] - watch a cell for changes, a value or output by '.'; dw <n> - delete watch; "
+                            "i - list; c - continue; s [n] - step; h on|off - record history for rc/rs (continue runs slower); rc - continue backwards; "
+                            "rs [n] - step backwards; m [start] - memory; r - restart; q - quit. "
+                            "<op> is one of == != < >, * is the cell the instruction accesses";
+    english["debug_breakpoint_set"] = "Breakpoint %d at line %zu, column %zu";
+    english["debug_breakpoint_invalid"] = "Invalid breakpoint!";
+    english["debug_breakpoint_hit"] = "Breakpoint %d hit at line %zu, column %zu";
+    english["debug_no_breakpoints"] = "No breakpoints";
+    english["debug_watchpoint_set"] = "Watchpoint %d on cell %zu";
+    english["debug_watchpoint_hit"] = "Watchpoint %d hit on cell %zu";
+    english["debug_finished"] = "Program finished.";
+    english["debug_history_start"] = "Reached the start of the recorded history.";
+    english["debug_history_on"] = "Recording history from here; rc and rs can step back to this point.";
+    english["debug_history_off"] = "History recording is off. Enter 'h on' to use rc and rs.";
+    english["debug_location"] = "At line %zu, column %zu";
+    english["profile_total"] = "%lld IR instructions executed";
+    english["profile_loops"] = "Hot loops by self cost:";
+    english["profile_loop_header"] = "  self%       self cost      total cost      entries  iter/entry  line:col  code";
+    english["profile_no_loops"] = "No loops were executed.";
+    english["profile_lines"] = "Hot lines by cost:";
+    english["profile_line_header"] = "   cost%            cost   line | source";
+    english["unmatched_bracket"] = "Unmatched '%c' at line %zu, column %zu";
     english["input_program"] = "Enter Brainfuck program (characters other than the 8 valid commands and //, /* */ are treated as comments, enter '0' alone to end):";
     english["comments_supported"] = "Supports single-line (//) and multi-line (/* */) comments, other characters are also treated as comments";
     english["no_bf_files"] = "No .bf files found!";
@@ -392,12 +4373,14 @@ void initializeTranslations() {
     chinese["editor_commands"] = "编辑器指令:";
     chinese["edit_program"] = "1. 输入/编辑程序 (支持注释)";
     chinese["run_program"] = "2. 运行程序";
-    chinese["debug_program"] = "3. 调试程序";  // 补全分号
-    chinese["save_program"] = "4. 保存程序 (包含注释)";
-    chinese["clear_program"] = "5. 清空程序";
-    chinese["show_filtered"] = "6. 显示过滤后的代码";
-    chinese["language_settings_editor"] = "7. 语言设置";  // 修正序号冲突
-    chinese["back_menu"] = "8. 返回主菜单";  // 调整序号
+    chinese["profile_program"] = "3. 统计执行热点";
+    chinese["debug_program"] = "4. 调试程序";  // 补全分号
+    chinese["native_program"] = "5. 编译为本地程序并运行";
+    chinese["save_program"] = "6. 保存程序 (包含注释)";
+    chinese["clear_program"] = "7. 清空程序";
+    chinese["show_filtered"] = "8. 显示过滤后的代码";
+    chinese["language_settings_editor"] = "9. 语言设置";  // 修正序号冲突
+    chinese["back_menu"] = "10. 返回主菜单";  // 调整序号
     chinese["select_option"] = "选择: ";
     chinese["program_empty"] = "程序为空!";
     chinese["program_cleared"] = "程序已清空!";
@@ -409,6 +4392,32 @@ void initializeTranslations() {
     chinese["run_success"] = "程序执行成功。";
     chinese["pointer_error"] = "指针越界!";
     chinese["compile_error"] = "编译错误!";
+    chinese["native_built"] = "本地程序已编译并执行（已存入缓存）。";
+    chinese["native_cached"] = "已执行缓存的本地程序。";
+    chinese["native_failed"] = "本地编译失败！请确认已安装C编译器（可通过CC环境变量指定）。";
+    chinese["debug_help"] = "命令: b <位置> [if <单元|*> <比较> <值>] - 在过滤后代码的位置设置断点; l <行号> [if ...] - 在源代码行设置断点; "
+                            "d <n> - 删除断点; w <单元> [== <值> | out] - 观察单元的改变、取值或被'.'输出; dw <n> - 删除观察点; "
+                            "i - 列出断点和观察点; c - 继续执行; s [n] - 单步执行; h on|off - 记录执行历史，供rc/rs使用（继续执行变慢）; rc - 倒退执行; "
+                            "rs [n] - 单步倒退; m [起点] - 查看内存; r - 重新开始; q - 退出。"
+                            "<比较>为 == != < > 之一, * 表示指令访问的单元";
+    chinese["debug_breakpoint_set"] = "断点 %d 设置在第 %zu 行第 %zu 列";
+    chinese["debug_breakpoint_invalid"] = "无效的断点!";
+    chinese["debug_breakpoint_hit"] = "命中断点 %d（第 %zu 行第 %zu 列）";
+    chinese["debug_no_breakpoints"] = "没有断点";
+    chinese["debug_watchpoint_set"] = "观察点 %d 设置在单元 %zu";
+    chinese["debug_watchpoint_hit"] = "命中观察点 %d（单元 %zu）";
+    chinese["debug_finished"] = "程序执行完毕。";
+    chinese["debug_history_start"] = "已倒退到历史记录的起点。";
+    chinese["debug_history_on"] = "从这里开始记录执行历史，rc和rs最多倒退到这里。";
+    chinese["debug_history_off"] = "没有记录执行历史，输入 h on 开启后才能使用rc和rs。";
+    chinese["debug_location"] = "位于第 %zu 行第 %zu 列";
+    chinese["profile_total"] = "共执行 %lld 条IR指令";
+    chinese["profile_loops"] = "热点循环（按自身代价排序）：";
+    chinese["profile_loop_header"] = "  自身%        自身代价          总代价     进入次数    平均轮数  行:列     代码";
+    chinese["profile_no_loops"] = "没有执行任何循环。";
+    chinese["profile_lines"] = "热点行（按代价排序）：";
+    chinese["profile_line_header"] = "    占比            代价   行号 | 源代码";
+    chinese["unmatched_bracket"] = "括号 '%c' 没有配对（第 %zu 行第 %zu 列）";
     chinese["input_program"] = "请输入Brainfuck程序 (除8种有效指令和//、/* */外的字符均视为注释，输入0单独一行结束):";
     chinese["comments_supported"] = "支持单行注释（//）和多行注释（/* */），其他字符也视为注释";
     chinese["no_bf_files"] = "没有找到任何.bf文件!";
@@ -454,12 +4463,14 @@ void initializeTranslations() {
     spanish["editor_commands"] = "Comandos del Editor:";
     spanish["edit_program"] = "1. Ingresar/Editar programa (soporta comentarios)";
     spanish["run_program"] = "2. Ejecutar programa";
-    spanish["debug_program"] = "3. Depurar programa";  // 补全
-    spanish["save_program"] = "4. Guardar programa (con comentarios)";  // 调整序号
-    spanish["clear_program"] = "5. Limpiar programa";  // 调整序号
-    spanish["show_filtered"] = "6. Mostrar código filtrado";  // 调整序号
-    spanish["language_settings_editor"] = "7. Configuración de Idioma";  // 调整序号
-    spanish["back_menu"] = "8. Volver al menú principal";  // 调整序号
+    spanish["profile_program"] = "3. Perfilar programa (bucles calientes)";
+    spanish["debug_program"] = "4. Depurar programa";  // 补全
+    spanish["native_program"] = "5. Compilar a nativo y ejecutar";
+    spanish["save_program"] = "6. Guardar programa (con comentarios)";  // 调整序号
+    spanish["clear_program"] = "7. Limpiar programa";  // 调整序号
+    spanish["show_filtered"] = "8. Mostrar código filtrado";  // 调整序号
+    spanish["language_settings_editor"] = "9. Configuración de Idioma";  // 调整序号
+    spanish["back_menu"] = "10. Volver al menú principal";  // 调整序号
     spanish["select_option"] = "Seleccionar: ";
     spanish["program_empty"] = "?El programa está vacío!";  // 修正倒感叹号
     spanish["program_cleared"] = "?Programa limpiado!";  // 修正倒感叹号
@@ -516,12 +4527,14 @@ void initializeTranslations() {
     french["editor_commands"] = "Commandes de l'éditeur:";
     french["edit_program"] = "1. Saisir/éditer le programme (supporte les commentaires)";
     french["run_program"] = "2. Exécuter le programme";
-    french["debug_program"] = "3. Déboguer le programme";  // 补全
-    french["save_program"] = "4. Sauvegarder le programme (avec commentaires)";  // 调整序号
-    french["clear_program"] = "5. Effacer le programme";  // 调整序号
-    french["show_filtered"] = "6. Afficher le code filtré";  // 调整序号
-    french["language_settings_editor"] = "7. Paramètres de Langue";  // 调整序号
-    french["back_menu"] = "8. Retour au menu principal";  // 调整序号
+    french["profile_program"] = "3. Profiler le programme (boucles chaudes)";
+    french["debug_program"] = "4. Déboguer le programme";  // 补全
+    french["native_program"] = "5. Compiler en natif et exécuter";
+    french["save_program"] = "6. Sauvegarder le programme (avec commentaires)";  // 调整序号
+    french["clear_program"] = "7. Effacer le programme";  // 调整序号
+    french["show_filtered"] = "8. Afficher le code filtré";  // 调整序号
+    french["language_settings_editor"] = "9. Paramètres de Langue";  // 调整序号
+    french["back_menu"] = "10. Retour au menu principal";  // 调整序号
     french["select_option"] = "Sélectionner: ";
     french["program_empty"] = "Le programme est vide !";
     french["program_cleared"] = "Programme effacé !";
@@ -578,12 +4591,14 @@ void initializeTranslations() {
     german["editor_commands"] = "Editor-Befehle:";
     german["edit_program"] = "1. Programm eingeben/bearbeiten (unterstützt Kommentare)";
     german["run_program"] = "2. Programm ausführen";
-    german["debug_program"] = "3. Programm debuggen";  // 补全
-    german["save_program"] = "4. Programm speichern (mit Kommentaren)";  // 调整序号
-    german["clear_program"] = "5. Programm l?schen";  // 调整序号（修正?）
-    german["show_filtered"] = "6. Gefilterten Code anzeigen";  // 调整序号
-    german["language_settings_editor"] = "7. Spracheinstellungen";  // 调整序号
-    german["back_menu"] = "8. Zurück zum Hauptmenü";  // 调整序号
+    german["profile_program"] = "3. Programm profilieren (heiße Schleifen)";
+    german["debug_program"] = "4. Programm debuggen";  // 补全
+    german["native_program"] = "5. Nativ kompilieren und ausführen";
+    german["save_program"] = "6. Programm speichern (mit Kommentaren)";  // 调整序号
+    german["clear_program"] = "7. Programm l?schen";  // 调整序号（修正?）
+    german["show_filtered"] = "8. Gefilterten Code anzeigen";  // 调整序号
+    german["language_settings_editor"] = "9. Spracheinstellungen";  // 调整序号
+    german["back_menu"] = "10. Zurück zum Hauptmenü";  // 调整序号
     german["select_option"] = "Auswahl: ";
     german["program_empty"] = "Programm ist leer!";
     german["program_cleared"] = "Programm gel?scht!";  // 修正?
@@ -640,12 +4655,14 @@ void initializeTranslations() {
     russian["editor_commands"] = "Команды редактора:";
     russian["edit_program"] = "1. Ввод/Редактирование программы (поддерживает комментарии)";
     russian["run_program"] = "2. Запуск программы";
-    russian["debug_program"] = "3. Отладить программу";  // 补全
-    russian["save_program"] = "4. Сохранить программу (с комментариями)";  // 调整序号
-    russian["clear_program"] = "5. Очистить программу";  // 调整序号
-    russian["show_filtered"] = "6. Показать отфильтрованный код";  // 调整序号
-    russian["language_settings_editor"] = "7. Настройки языка";  // 调整序号
-    russian["back_menu"] = "8. Вернуться в главное меню";  // 调整序号
+    russian["profile_program"] = "3. Профилировать программу (горячие циклы)";
+    russian["debug_program"] = "4. Отладить программу";  // 补全
+    russian["native_program"] = "5. Скомпилировать в машинный код и запустить";
+    russian["save_program"] = "6. Сохранить программу (с комментариями)";  // 调整序号
+    russian["clear_program"] = "7. Очистить программу";  // 调整序号
+    russian["show_filtered"] = "8. Показать отфильтрованный код";  // 调整序号
+    russian["language_settings_editor"] = "9. Настройки языка";  // 调整序号
+    russian["back_menu"] = "10. Вернуться в главное меню";  // 调整序号
     russian["select_option"] = "Выбор: ";
     russian["program_empty"] = "Программа пуста!";
     russian["program_cleared"] = "Программа очищена!";
@@ -702,12 +4719,14 @@ void initializeTranslations() {
     portuguese["editor_commands"] = "Comandos do Editor:";
     portuguese["edit_program"] = "1. Inserir/Editar programa (suporta comentários)";
     portuguese["run_program"] = "2. Executar programa";
-    portuguese["debug_program"] = "3. Depurar programa";  // 补全
-    portuguese["save_program"] = "4. Salvar programa (com comentários)";  // 调整序号
-    portuguese["clear_program"] = "5. Limpar programa";  // 调整序号
-    portuguese["show_filtered"] = "6. Mostrar código filtrado";  // 调整序号
-    portuguese["language_settings_editor"] = "7. Configura??es de Idioma";  // 调整序号（修正??）
-    portuguese["back_menu"] = "8. Voltar ao menu principal";  // 调整序号
+    portuguese["profile_program"] = "3. Perfilar programa (laços quentes)";
+    portuguese["debug_program"] = "4. Depurar programa";  // 补全
+    portuguese["native_program"] = "5. Compilar para nativo e executar";
+    portuguese["save_program"] = "6. Salvar programa (com comentários)";  // 调整序号
+    portuguese["clear_program"] = "7. Limpar programa";  // 调整序号
+    portuguese["show_filtered"] = "8. Mostrar código filtrado";  // 调整序号
+    portuguese["language_settings_editor"] = "9. Configura??es de Idioma";  // 调整序号（修正??）
+    portuguese["back_menu"] = "10. Voltar ao menu principal";  // 调整序号
     portuguese["select_option"] = "Selecionar: ";
     portuguese["program_empty"] = "Programa está vazio!";
     portuguese["program_cleared"] = "Programa limpo!";
@@ -1505,10 +5524,63 @@ int find_all_bf(std::string path) {
     return bfFiles.size();
 }
 
+// 源码映射：filtered中每个字符在original中的行号和列号（从1开始）。
+// 游程编码：同一行中连续的有效指令合为一段，只记段首；注释、空白和换行处才开始新段。查找时对段二分，O(log n)
+class SourceMap {
+private:
+    struct Run {
+        size_t position = 0;  // 段首在filtered中的位置
+        size_t line = 0;
+        size_t column = 0;
+    };
+    std::vector<Run> runs;  // position递增，line不减
+    size_t length = 0;
+
+public:
+    void clear() {
+        runs.clear();
+        length = 0;
+    }
+
+    // 追加filtered的下一个字符
+    void add(size_t line, size_t column) {
+        if (runs.empty() || runs.back().line != line || runs.back().column + (length - runs.back().position) != column) {
+            Run run;
+            run.position = length;
+            run.line = line;
+            run.column = column;
+            runs.push_back(run);
+        }
+        length++;
+    }
+
+    // position超出filtered时返回false
+    bool locate(size_t position, size_t& line, size_t& column) const {
+        if (position >= length) return false;
+        auto run = std::upper_bound(runs.begin(), runs.end(), position,
+                                    [](size_t value, const Run& r) { return value < r.position; }) - 1;
+        line = run->line;
+        column = run->column + (position - run->position);
+        return true;
+    }
+
+    // 第line行第一个有效指令在filtered中的位置，这一行没有有效指令时为-1
+    ptrdiff_t lineStart(size_t line) const {
+        auto run = std::lower_bound(runs.begin(), runs.end(), line,
+                                    [](const Run& r, size_t value) { return r.line < value; });
+        return (run != runs.end() && run->line == line) ? static_cast<ptrdiff_t>(run->position) : -1;
+    }
+
+    size_t runCount() const {
+        return runs.size();
+    }
+};
+
 // 修改：返回原始输入和过滤后的程序
 struct ProgramData {
     std::string original;  // 原始输入（包含注释）
     std::string filtered;  // 过滤后的程序（只包含有效指令）
+    SourceMap source_map;  // filtered到original的行列，过滤时生成
 };
 
 // 显示带颜色的程序内容
@@ -1839,10 +5911,16 @@ ProgramData input_Bf(const std::string& initialData) {
     // 处理注释和过滤有效指令（保持原有逻辑）
     bool inMultiLineComment = false;
     bool inSingleLineComment = false;
+    size_t line_number = 0;
+    size_t line_begin = 0;  // 当前行第一个字符的下标
     
     for (std::string::size_type i = 0; i < input.length(); i++) {
         char ch = input[i];
         char next_ch = (i + 1 < input.length()) ? input[i + 1] : '\0';
+        if (i == 0 || input[i - 1] == '\n') {
+            line_number++;
+            line_begin = i;
+        }
         
         // 处理多行注释
         if (!inSingleLineComment && ch == '/' && next_ch == '*') {
@@ -1877,25 +5955,412 @@ ProgramData input_Bf(const std::string& initialData) {
         if (ch == '[' || ch == ']' || ch == '<' || ch == '>' || 
             ch == '.' || ch == ',' || ch == '+' || ch == '-') {
             data.filtered += ch;
+            data.source_map.add(line_number, i - line_begin + 1);
         }
     }
     return data;
 }
 
 // 运行函数：执行Brainfuck程序
+// 返回0成功，1指针越界，2括号不匹配
 int run(std::string program) {
     BrainfuckCompiler bfc;
-    bfc.loadCode(program);
-    bfc.interpret();
-    return 0;
+    bfc.setPrefixBudget(BrainfuckCompiler::DEFAULT_PREFIX_BUDGET);
+    try {
+        bfc.loadCode(program);
+    } catch (const std::runtime_error&) {
+        return 2;
+    }
+    return bfc.tiered() ? 0 : 1;
+}
+
+// 第一个未配对的括号：没有配对的']'优先，否则为最外层没有闭合的'['；都已配对时为-1
+ptrdiff_t findUnmatchedBracket(const std::string& program) {
+    std::vector<size_t> open;
+    for (size_t i = 0; i < program.length(); i++) {
+        if (program[i] == '[') {
+            open.push_back(i);
+        } else if (program[i] == ']') {
+            if (open.empty()) return static_cast<ptrdiff_t>(i);
+            open.pop_back();
+        }
+    }
+    return open.empty() ? -1 : static_cast<ptrdiff_t>(open[0]);
 }
 
-void running(std::string pro){
+// 输出编译错误，并通过源码映射给出未配对的括号在original中的行列
+void printCompileError(const ProgramData& programData, FILE* stream) {
+    fprintf(stream, "%s\n", tr("compile_error").c_str());
+    const ptrdiff_t position = findUnmatchedBracket(programData.filtered);
+    size_t line = 0, column = 0;
+    if (position >= 0 && programData.source_map.locate(position, line, column)) {
+        fprintf(stream, tr("unmatched_bracket").c_str(), programData.filtered[position], line, column);
+        fprintf(stream, "\n");
+    }
+}
+
+void running(const ProgramData& programData){
     printf("\n%s\n", tr("run_results").c_str());
-    int res=run(pro);
+    int res=run(programData.filtered);
     if(res==0) printf("\n%s\n", tr("run_success").c_str());
     if(res==1) printf("\n%s\n", tr("pointer_error").c_str());
-    if(res==2) printf("\n%s\n", tr("compile_error").c_str());
+    if(res==2) { printf("\n"); printCompileError(programData, stdout); }
+}
+
+// 统计执行热点：逐条解释执行（不预先执行、不编译为机器码），统计每条IR指令和每个循环的执行次数（见setCounting()），
+// 再输出按自身代价排序的热点循环和热点行，位置通过源码映射换算为原始代码的行列。
+// 报告中的循环都没有被优化器改写为闭式计算，排在前面的适合手工优化或补充新的循环识别；指针越界时输出越界之前的统计
+void profileProgram(const ProgramData& programData) {
+    static const size_t TOP = 10;      // 每份报告的条数
+    static const size_t SNIPPET = 40;  // 循环代码最多显示的字符数，源代码行为两倍
+
+    BrainfuckCompiler bfc;
+    bfc.setCounting(true);
+    printf("\n%s\n", tr("run_results").c_str());
+    try {
+        bfc.loadCode(programData.filtered);
+    } catch (const std::runtime_error&) {
+        printf("\n");
+        printCompileError(programData, stdout);
+        return;
+    }
+    const bool finished = bfc.interpret();
+    printf("\n%s\n", tr(finished ? "run_success" : "pointer_error").c_str());
+
+    const std::vector<long long> costs = bfc.getSourceCosts();
+    std::map<size_t, long long> line_costs;
+    long long total = 0;
+    for (size_t i = 0; i < costs.size(); i++) {
+        size_t line = 0, column = 0;
+        if (costs[i] > 0 && programData.source_map.locate(i, line, column)) {
+            line_costs[line] += costs[i];
+            total += costs[i];
+        }
+    }
+    printf("\n");
+    printf(tr("profile_total").c_str(), total);
+    printf("\n");
+    if (total == 0) return;
+    auto permille = [total](long long cost) { return cost * 1000 / total; };
+
+    const std::vector<BrainfuckCompiler::LoopProfile> loops = bfc.getLoopProfile();
+    printf("\n%s\n", tr("profile_loops").c_str());
+    printf("%s\n", tr(loops.empty() || loops[0].self_cost == 0 ? "profile_no_loops" : "profile_loop_header").c_str());
+    for (size_t i = 0; i < loops.size() && i < TOP && loops[i].self_cost > 0; i++) {
+        const BrainfuckCompiler::LoopProfile& loop = loops[i];
+        size_t line = 0, column = 0;
+        programData.source_map.locate(loop.start, line, column);
+        std::string text = programData.filtered.substr(loop.start, loop.end - loop.start + 1);
+        if (text.length() > SNIPPET) text = text.substr(0, SNIPPET - 3) + "...";
+        const std::string location = std::to_string(line) + ":" + std::to_string(column);
+        printf("%4lld.%lld%% %15lld %15lld %12lld %10.1f  %-9s %s\n", permille(loop.self_cost) / 10, permille(loop.self_cost) % 10,
+               loop.self_cost, loop.total_cost, loop.entries, loop.entries > 0 ? double(loop.iterations) / loop.entries : 0.0,
+               location.c_str(), text.c_str());
+    }
+
+    std::vector<std::pair<long long, size_t>> ranked;  // (-代价, 行号)
+    for (const auto& entry : line_costs) {
+        ranked.emplace_back(-entry.second, entry.first);
+    }
+    std::sort(ranked.begin(), ranked.end());
+    std::vector<std::string> lines;
+    std::istringstream original(programData.original);
+    for (std::string text; std::getline(original, text);) {
+        lines.push_back(text);
+    }
+    printf("\n%s\n%s\n", tr("profile_lines").c_str(), tr("profile_line_header").c_str());
+    for (size_t i = 0; i < ranked.size() && i < TOP; i++) {
+        const long long cost = -ranked[i].first;
+        const size_t line = ranked[i].second;
+        std::string text = (line >= 1 && line <= lines.size()) ? lines[line - 1] : "";
+        if (text.length() > SNIPPET * 2) text = text.substr(0, SNIPPET * 2 - 3) + "...";
+        printf("%4lld.%lld%% %15lld %6zu | %s\n", permille(cost) / 10, permille(cost) % 10, cost, line, text.c_str());
+    }
+}
+
+// 本地编译缓存：可执行文件按 过滤后的代码+编译器+编译选项+版本号 的散列存放在Cache目录，
+// 同一程序再次运行时跳过生成和编译。generateSource()的输出有变化时修改版本号使旧缓存失效
+const char* const NATIVE_CACHE_VERSION = "bfx-native-2";
+
+// 64位FNV-1a散列，十六进制表示
+std::string hashText(const std::string& text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char ch : text) {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+// 编译器和选项：环境变量CC、CFLAGS优先
+std::string getNativeCompiler() {
+    const char* cc = getenv("CC");
+    return (cc != nullptr && *cc != '\0') ? cc : "gcc";
+}
+
+std::string getNativeFlags() {
+    const char* flags = getenv("CFLAGS");
+    return (flags != nullptr && *flags != '\0') ? flags : "-O2";
+}
+
+// cmd /c会去掉命令行首尾的引号，整条命令外需要再加一层
+std::string shellCommand(const std::string& command) {
+#ifdef _WIN32
+    return "\"" + command + "\"";
+#else
+    return command;
+#endif
+}
+
+// 返回0成功，3编译器调用失败；与run()使用相同的设置，指针越界时程序以退出码1结束（见generateSource()）
+int buildNative(const std::string& program, std::string& exe_path, bool& cached) {
+    const std::string compiler_command = getNativeCompiler();
+    const std::string flags = getNativeFlags();
+    const std::string key = hashText(program + "\n" + compiler_command + "\n" + flags + "\n" + NATIVE_CACHE_VERSION);
+
+    std::string cache_dir = getExeDir();
+#ifdef _WIN32
+    cache_dir += "\\Cache";
+    const std::string base = cache_dir + "\\" + key;
+    const std::string exe_suffix = ".exe";
+#else
+    cache_dir += "/Cache";
+    const std::string base = cache_dir + "/" + key;
+    const std::string exe_suffix = "";
+#endif
+    exe_path = base + exe_suffix;
+
+    cached = std::ifstream(exe_path.c_str()).is_open();
+    if (cached) {
+        return 0;
+    }
+    createDirectory(cache_dir);
+
+    BrainfuckCompiler bfc;
+    bfc.setPrefixBudget(BrainfuckCompiler::DEFAULT_PREFIX_BUDGET);
+    try {
+        bfc.loadCode(program);
+    } catch (const std::runtime_error&) {
+        return 2;
+    }
+    const std::string source_path = base + ".c";
+    {
+        std::ofstream source(source_path.c_str());
+        if (!source.is_open()) {
+            return 3;
+        }
+        source << bfc.compileToC();
+    }
+
+    // 先写到临时文件，编译成功后再改名，中断的编译不会留在缓存里
+    const std::string partial_path = base + ".partial" + exe_suffix;
+    const std::string command = compiler_command + " " + flags + " -o \"" + partial_path + "\" \"" + source_path + "\"";
+    const int status = system(shellCommand(command).c_str());
+    remove(source_path.c_str());
+    if (status != 0 || rename(partial_path.c_str(), exe_path.c_str()) != 0) {
+        remove(partial_path.c_str());
+        return 3;
+    }
+    return 0;
+}
+
+// 构建失败的返回值与buildNative()相同，无法启动时也是3；程序报告指针越界或异常结束时返回1
+int runNative(const std::string& program, bool& cached) {
+    std::string exe_path;
+    const int result = buildNative(program, exe_path, cached);
+    if (result != 0) {
+        return result;
+    }
+    fflush(stdout);
+    const int status = system(shellCommand("\"" + exe_path + "\"").c_str());
+    if (status == -1) {
+        return 3;
+    }
+    return status == 0 ? 0 : 1;
+}
+
+void runningNative(const ProgramData& programData) {
+    printf("\n%s\n", tr("run_results").c_str());
+    bool cached = false;
+    const int res = runNative(programData.filtered, cached);
+    if (res == 0) printf("\n%s\n", tr(cached ? "native_cached" : "native_built").c_str());
+    if (res == 1) printf("\n%s\n", tr("pointer_error").c_str());
+    if (res == 2) {
+        printf("\n");
+        printCompileError(programData, stdout);
+    }
+    if (res == 3) printf("\n%s\n", tr("native_failed").c_str());
+}
+
+// 解析断点条件"if <单元|*> <比较> <值>"，没有条件时为BREAK_ALWAYS；格式错误返回false
+bool parseBreakCondition(std::istringstream& args, BrainfuckCompiler::Breakpoint& point) {
+    std::string word, cell, compare;
+    if (!(args >> word)) return true;
+    if (word != "if" || !(args >> cell >> compare >> point.value)) return false;
+    if (cell != "*") point.cell = std::atol(cell.c_str());
+    if (compare == "==") point.condition = BrainfuckCompiler::BREAK_EQUAL;
+    else if (compare == "!=") point.condition = BrainfuckCompiler::BREAK_NOT_EQUAL;
+    else if (compare == "<") point.condition = BrainfuckCompiler::BREAK_LESS;
+    else if (compare == ">") point.condition = BrainfuckCompiler::BREAK_GREATER;
+    else return false;
+    return true;
+}
+
+// 下一条指令在original中的行列（见SourceMap），以及指令和内存状态
+void printDebugState(BrainfuckCompiler& bfc, const ProgramData& programData) {
+    size_t line = 0, column = 0;
+    if (programData.source_map.locate(bfc.getSourcePosition(), line, column)) {
+        printf(tr("debug_location").c_str(), line, column);
+        printf("\n");
+    }
+    bfc.printCurrentState();
+    bfc.printMemoryState();
+}
+
+// 输出debugContinue()/reverseContinue()停下的原因，停在断点、观察点或历史起点时同时输出当前状态
+void printDebugStop(BrainfuckCompiler& bfc, const ProgramData& programData, BrainfuckCompiler::DebugStop stop) {
+    if (stop == BrainfuckCompiler::DEBUG_BREAKPOINT) {
+        size_t line = 0, column = 0;
+        programData.source_map.locate(bfc.getSourcePosition(), line, column);
+        printf(tr("debug_breakpoint_hit").c_str(), bfc.getHitBreakpoint(), line, column);
+        printf("\n");
+        bfc.printCurrentState();
+        bfc.printMemoryState();
+        return;
+    }
+    if (stop == BrainfuckCompiler::DEBUG_WATCHPOINT) {
+        printf(tr("debug_watchpoint_hit").c_str(), bfc.getHitWatchpoint(), bfc.getWatchpoints()[bfc.getHitWatchpoint()].cell);
+        printf("\n");
+    } else if (stop == BrainfuckCompiler::DEBUG_HISTORY_START) {
+        printf("%s\n", tr("debug_history_start").c_str());
+    } else {
+        printf("%s\n", tr(stop == BrainfuckCompiler::DEBUG_FINISHED ? "debug_finished" : "pointer_error").c_str());
+        return;
+    }
+    printDebugState(bfc, programData);
+}
+
+// 调试：按行读取命令（见debug_help），断点之间全速执行（见debugContinue()），可观察单元的改变和输出；不预先执行。
+// h on开启历史记录后可以倒退，记录期间继续执行逐条检查，所以默认不开启
+void debugProgram(const ProgramData& programData) {
+    BrainfuckCompiler bfc;
+    try {
+        bfc.loadCode(programData.filtered);
+    } catch (const std::runtime_error&) {
+        printCompileError(programData, stdout);
+        return;
+    }
+    printf("%s\n", tr("debug_help").c_str());
+
+    std::string line;
+    while (printf("(bfx) "), fflush(stdout), std::getline(std::cin, line)) {
+        std::istringstream args(line);
+        std::string command;
+        if (!(args >> command)) continue;
+        if (command == "b" || command == "l") {
+            long target = -1;
+            BrainfuckCompiler::Breakpoint point;
+            int index = -1;
+            size_t line = 0, column = 0;
+            if ((args >> target) && target >= 0 && parseBreakCondition(args, point)) {
+                // 行号从1开始；没有有效指令的行无效
+                const ptrdiff_t position = (command == "l") ? programData.source_map.lineStart(target) : target;
+                if (position >= 0 && programData.source_map.locate(position, line, column)) {
+                    index = bfc.addBreakpoint(position, point.condition, point.cell, point.value);
+                }
+            }
+            if (index < 0) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            } else {
+                printf(tr("debug_breakpoint_set").c_str(), index, line, column);
+                printf("\n");
+            }
+        } else if (command == "d") {
+            long index = -1;
+            args >> index;
+            if (index < 0 || !bfc.removeBreakpoint(static_cast<size_t>(index))) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            }
+        } else if (command == "w") {
+            long cell = -1;
+            std::string kind;
+            uint32_t value = 0;
+            int index = -1;
+            if ((args >> cell) && cell >= 0) {
+                if (!(args >> kind)) index = bfc.addWatchpoint(cell, BrainfuckCompiler::WATCH_CHANGE);
+                else if (kind == "out") index = bfc.addWatchpoint(cell, BrainfuckCompiler::WATCH_OUTPUT);
+                else if (kind == "==" && (args >> value)) index = bfc.addWatchpoint(cell, BrainfuckCompiler::WATCH_EQUAL, value);
+            }
+            if (index < 0) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            } else {
+                printf(tr("debug_watchpoint_set").c_str(), index, bfc.getWatchpoints()[index].cell);
+                printf("\n");
+            }
+        } else if (command == "dw") {
+            long index = -1;
+            args >> index;
+            if (index < 0 || !bfc.removeWatchpoint(static_cast<size_t>(index))) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            }
+        } else if (command == "i") {
+            static const char* const compares[] = {"", "==", "!=", "<", ">"};
+            const auto& points = bfc.getBreakpoints();
+            const auto& watches = bfc.getWatchpoints();
+            if (points.empty() && watches.empty()) printf("%s\n", tr("debug_no_breakpoints").c_str());
+            for (size_t i = 0; i < points.size(); i++) {
+                size_t line = 0, column = 0;
+                programData.source_map.locate(points[i].position, line, column);
+                printf("%zu: %zu (%zu:%zu)", i, points[i].position, line, column);
+                if (points[i].condition != BrainfuckCompiler::BREAK_ALWAYS) {
+                    if (points[i].cell < 0) printf(" if * %s %u", compares[points[i].condition], points[i].value);
+                    else printf(" if %td %s %u", points[i].cell, compares[points[i].condition], points[i].value);
+                }
+                printf("\n");
+            }
+            for (size_t i = 0; i < watches.size(); i++) {
+                printf("w%zu: %zu", i, watches[i].cell);
+                if (watches[i].kind == BrainfuckCompiler::WATCH_EQUAL) printf(" == %u", watches[i].value);
+                if (watches[i].kind == BrainfuckCompiler::WATCH_OUTPUT) printf(" out");
+                printf("\n");
+            }
+        } else if (command == "c") {
+            printDebugStop(bfc, programData, bfc.debugContinue());
+        } else if (command == "h") {
+            std::string mode;
+            args >> mode;
+            if ((mode == "on" || mode == "off") && (mode == "on") != bfc.getHistory()) bfc.setHistory(mode == "on");
+            printf("%s\n", tr(bfc.getHistory() ? "debug_history_on" : "debug_history_off").c_str());
+        } else if ((command == "rc" || command == "rs") && !bfc.getHistory()) {
+            printf("%s\n", tr("debug_history_off").c_str());
+        } else if (command == "rc") {
+            printDebugStop(bfc, programData, bfc.reverseContinue());
+        } else if (command == "rs") {
+            long long count = 1;
+            args >> count;
+            if (!bfc.reverseStep(count)) printf("%s\n", tr("debug_history_start").c_str());
+            printDebugState(bfc, programData);
+        } else if (command == "s") {
+            int count = 1;
+            args >> count;
+            for (int i = 0; i < count; i++) {
+                if (!bfc.step()) break;
+            }
+            printDebugState(bfc, programData);
+        } else if (command == "m") {
+            size_t start = 0;
+            args >> start;
+            bfc.printMemoryState(start);
+        } else if (command == "r") {
+            bfc.loadCode(programData.filtered);
+        } else if (command == "q") {
+            break;
+        } else {
+            printf("%s\n", tr("debug_help").c_str());
+        }
+    }
 }
 
 // 保存程序到文件（包含注释）
@@ -1940,9 +6405,11 @@ ProgramData loadProgram(const std::string& filename) {
     if (file.is_open()) {
         std::string line;
         bool inCommentBlock = false;
+        size_t line_number = 0;
         
         while (std::getline(file, line)) {
         	data.original += line + "\n";
+            line_number++;
             // 跳过文件头部的注释块
             if (line.find("/* Brainfuck Program with Comments */") != std::string::npos ||
                 line.find("/* Saved from Brainfuck IDE */") != std::string::npos ||
@@ -1968,6 +6435,7 @@ ProgramData loadProgram(const std::string& filename) {
                 if (ch == '[' || ch == ']' || ch == '<' || ch == '>' || 
                     ch == '.' || ch == ',' || ch == '+' || ch == '-') {
                     data.filtered += ch;
+                    data.source_map.add(line_number, i + 1);
                 }
             }
         }
@@ -1987,6 +6455,7 @@ void createEditor(ProgramData programData = ProgramData()) {
         printf("\n%s\n", tr("editor_commands").c_str());
         printf("%s\n", tr("edit_program").c_str());
         printf("%s\n", tr("run_program").c_str());
+        printf("%s\n", tr("profile_program").c_str());
         printf("%s\n", tr("save_program").c_str());
         printf("%s\n", tr("clear_program").c_str());
         printf("%s\n", tr("show_filtered").c_str());
@@ -1998,7 +6467,9 @@ void createEditor(ProgramData programData = ProgramData()) {
         WinConsoleMenu editorMenu(tr("editor_commands"));
         editorMenu.addOption(tr("edit_program"), [&choice]() {choice='1';});
         editorMenu.addOption(tr("run_program"), [&choice]() {choice='2';});
+        editorMenu.addOption(tr("profile_program"), [&choice]() {choice='p';});
         editorMenu.addOption(tr("debug_program"), [&choice]() {choice='8';});
+        editorMenu.addOption(tr("native_program"), [&choice]() {choice='9';});
         editorMenu.addOption(tr("save_program"), [&choice]() {choice='3';});
         editorMenu.addOption(tr("clear_program"), [&choice]() {choice='4';});
         editorMenu.addOption(tr("show_filtered"), [&choice]() {choice='5';});
@@ -2016,7 +6487,7 @@ void createEditor(ProgramData programData = ProgramData()) {
             case '2':
                 if (!programData.filtered.empty()) {
                 	clearScreen();
-                    running(programData.filtered);
+                    running(programData);
                 } else {
                     printf("%s\n", tr("program_empty").c_str());
                 }
@@ -2038,6 +6509,7 @@ void createEditor(ProgramData programData = ProgramData()) {
             	clearScreen();
                 programData.original.clear();
                 programData.filtered.clear();
+                programData.source_map.clear();
                 printf("%s\n", tr("program_cleared").c_str());
                 pauseScreen();
                 break;
@@ -2056,15 +6528,25 @@ void createEditor(ProgramData programData = ProgramData()) {
             case '8': 
     	 	    if (!programData.filtered.empty()) {
                 	clearScreen();
-                    BrainfuckCompiler bfc;
-				    bfc.loadCode(programData.filtered);
-				    std::cout << "Debug mode. Press Enter to step through execution.\n";
-	                while (bfc.step()) {
-	                    bfc.printCurrentState();
-	                    bfc.printMemoryState();
-	                    std::cout << "Press Enter to continue...";
-	                    std::cin.ignore();
-	                }
+                    debugProgram(programData);
+                } else {
+                    printf("%s\n", tr("program_empty").c_str());
+                }
+                pauseScreen();
+                break;
+            case '9':
+                if (!programData.filtered.empty()) {
+                	clearScreen();
+                    runningNative(programData);
+                } else {
+                    printf("%s\n", tr("program_empty").c_str());
+                }
+                pauseScreen();
+                break;
+            case 'p':
+                if (!programData.filtered.empty()) {
+                	clearScreen();
+                    profileProgram(programData);
                 } else {
                     printf("%s\n", tr("program_empty").c_str());
                 }
@@ -2134,13 +6616,54 @@ void open(){
     }
 }
 
-int main(){
+// 命令行模式：BFX [--native] <文件.bf>，程序输出到标准输出，提示信息到标准错误
+// 返回值与run()/runNative()相同，参数错误或文件为空时返回4
+int runCommandLine(int argc, char* argv[]) {
+    bool native = false;
+    std::string file_name;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--native") {
+            native = true;
+        } else if (file_name.empty()) {
+            file_name = arg;
+        } else {
+            file_name.clear();
+            break;
+        }
+    }
+    if (file_name.empty()) {
+        fprintf(stderr, "usage: %s [--native] <file.bf>\n", argv[0]);
+        return 4;
+    }
+
+    ProgramData program_data = loadProgram(file_name);
+    if (program_data.filtered.empty()) {
+        fprintf(stderr, "%s\n", tr("file_empty").c_str());
+        return 4;
+    }
+
+    bool cached = false;
+    const int result = native ? runNative(program_data.filtered, cached) : run(program_data.filtered);
+    fflush(stdout);
+    if (result == 1) fprintf(stderr, "%s\n", tr("pointer_error").c_str());
+    if (result == 2) printCompileError(program_data, stderr);
+    if (result == 3) fprintf(stderr, "%s\n", tr("native_failed").c_str());
+    return result;
+}
+
+int main(int argc, char* argv[]){
     // 初始化所有映射
     initializeTranslations();
     initializeLanguageNames();
     initializeColorNames();
     initializeColorMaps();
     
+    // 带参数时为命令行模式，不显示菜单
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+    
     // 创建Program目录
     std::string programDir = getExeDir();
 #ifdef _WIN32
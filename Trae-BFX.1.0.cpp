@@ -4,7 +4,9 @@
 #include <vector>
 #include <fstream>
 #include <cstring>
+#include <cstdio>
 #include <map>
+#include <set>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
@@ -57,6 +59,8 @@ Brainfuck IDE - 主要功能和全局变量说明
 - input_Bf()：输入Brainfuck程序
 - run()：执行Brainfuck程序
 - running()：处理运行结果
+- buildNative()/runNative()：编译为本地程序并按内容散列缓存
+- runCommandLine()：命令行模式
 
 工具函数：
 - clearScreen()：清屏
@@ -77,86 +81,4436 @@ Brainfuck IDE - 主要功能和全局变量说明
     #include <tchar.h>
     #include <conio.h>
     #include <commdlg.h>  // 用于Windows文件对话框
+    #include <io.h>       // 用于判断标准输入是否为终端
+    #include <setjmp.h>   // 用于磁带越界时跳回执行入口
 #else
     #include <dirent.h>
     #include <unistd.h>
     #include <limits.h>
     #include <sys/stat.h>
+    #include <sys/mman.h>  // 用于JIT的可执行内存和磁带
+    #include <signal.h>    // 用于捕获磁带保护页的访问
+    #include <setjmp.h>
+#endif
+
+// 只有x86-64平台才启用JIT，其他平台jit()退回解释执行
+#if defined(__x86_64__) || defined(_M_X64)
+    #define BFX_JIT_X64 1
+#endif
+
+// 解释器的分派方式在编译期选择：GCC/Clang支持"标签地址"（computed goto）扩展时使用直接线索化分派，
+// 其他编译器（或定义了BFX_NO_THREADED_DISPATCH时）使用可移植的switch分派
+#if defined(__GNUC__) && !defined(BFX_NO_THREADED_DISPATCH)
+    #define BFX_THREADED_DISPATCH 1
 #endif
 
 /*
- * BrainfuckCompiler类 - Brainfuck语言编译器和解释器
- * 提供优化的Brainfuck代码解释执行、编译和调试功能
- * 特性：
- * - 标准的30000字节Brainfuck内存空间
- * - 预计算循环跳转表，优化执行性能
- * - 支持从字符串或文件加载代码
- * - 提供完整的解释执行功能
- * - 提供单步执行功能，便于调试
- * - 支持编译为C或C++代码
- * - 提供内存状态和执行状态的调试输出
+ * ExecutableMemory类 - 存放JIT生成的机器码的可执行内存
+ * 先以可读写方式分配并写入机器码，再改为只读可执行（同一时刻不会既可写又可执行），析构时释放
+ * - Windows平台使用VirtualAlloc/VirtualProtect
+ * - 其他平台使用mmap/mprotect
  */
-class BrainfuckCompiler {
+class ExecutableMemory {
 private:
-    static const int MEMORY_SIZE = 30000; // Brainfuck标准内存大小（30000字节）
-    char memory[MEMORY_SIZE];             // 内存数组，模拟Brainfuck的内存空间
-    int memoryPointer;                    // 内存指针，指向当前操作的内存位置
-    int instructionPointer;               // 指令指针，指向当前执行的指令位置
-    std::string code;                     // 存储编译后的Brainfuck代码（仅包含有效指令）
-    std::map<int, int> jumpTable;         // 用于优化循环跳转的映射表，存储'['和']'的对应关系
+    void* address;  // 可执行内存的起始地址
+    size_t length;  // 分配的字节数
+
+    // 禁止拷贝，避免同一块内存被释放两次
+    ExecutableMemory(const ExecutableMemory&);
+    ExecutableMemory& operator=(const ExecutableMemory&);
+
+public:
+    ExecutableMemory() : address(NULL), length(0) {}
+
+    ~ExecutableMemory() {
+        release();
+    }
+
+    /*
+     * 把机器码复制到新分配的可执行内存中
+     * 参数：
+     * - bytes: 要载入的机器码
+     * 返回值：
+     * - 分配或修改内存权限失败时返回false
+     */
+    bool load(const std::vector<unsigned char>& bytes) {
+        release();
+        if (bytes.empty()) {
+            return false;
+        }
+#ifdef _WIN32
+        void* block = VirtualAlloc(NULL, bytes.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (block == NULL) {
+            return false;
+        }
+        memcpy(block, &bytes[0], bytes.size());
+        DWORD oldProtect;
+        if (!VirtualProtect(block, bytes.size(), PAGE_EXECUTE_READ, &oldProtect)) {
+            VirtualFree(block, 0, MEM_RELEASE);
+            return false;
+        }
+        FlushInstructionCache(GetCurrentProcess(), block, bytes.size());
+#else
+        void* block = mmap(NULL, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) {
+            return false;
+        }
+        memcpy(block, &bytes[0], bytes.size());
+        if (mprotect(block, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+            munmap(block, bytes.size());
+            return false;
+        }
+#endif
+        address = block;
+        length = bytes.size();
+        return true;
+    }
+
+    /*
+     * 释放可执行内存
+     */
+    void release() {
+        if (address == NULL) {
+            return;
+        }
+#ifdef _WIN32
+        VirtualFree(address, 0, MEM_RELEASE);
+#else
+        munmap(address, length);
+#endif
+        address = NULL;
+        length = 0;
+    }
+
+    /*
+     * 获取机器码入口地址，未载入时返回NULL
+     */
+    void* entry() const {
+        return address;
+    }
+};
+
+/*
+ * OutputSink类 - Brainfuck程序'.'指令的输出缓冲区
+ * 输出的字符先写入用户空间缓冲区，以下情况才整块写到目标文件：
+ * - 缓冲区已满
+ * - 执行','且需要等待新的输入之前（保证提示和已有输出先显示出来）
+ * - 程序执行结束或对象销毁
+ * - 选择了行缓冲模式且写入了换行符
+ */
+class OutputSink {
+private:
+    static const int BUFFER_SIZE = 65536;
+    char buffer[BUFFER_SIZE];   // 待写出的字符
+    int used;                   // 缓冲区中已使用的字节数
+    FILE* target;               // 输出目标，默认为stdout，为NULL时丢弃输出
+    bool lineBuffered;          // 是否在每个换行符后立即刷新
+
+    // 禁止复制（只声明不实现）
+    OutputSink(const OutputSink&);
+    OutputSink& operator=(const OutputSink&);
+
+public:
+    /*
+     * 构造函数
+     * 参数：
+     * - file: 输出目标文件，默认为stdout
+     */
+    explicit OutputSink(FILE* file = stdout) : used(0), target(file), lineBuffered(false) {}
+
+    ~OutputSink() {
+        flush();
+    }
+
+    /*
+     * 设置是否使用行缓冲模式
+     * 交互式程序需要及时看到每一行输出时使用，代价是刷新次数增加
+     */
+    void setLineBuffered(bool enabled) {
+        lineBuffered = enabled;
+    }
+
+    bool isLineBuffered() const {
+        return lineBuffered;
+    }
+
+    /*
+     * 更换输出目标，已缓冲的内容之后写到新目标
+     * 参数：
+     * - file: 新的输出目标，为NULL时丢弃之后的输出（用于倒退调试时重新执行已经输出过的部分）
+     * 返回值：
+     * - 原来的输出目标
+     */
+    FILE* redirect(FILE* file) {
+        FILE* previous = target;
+        target = file;
+        return previous;
+    }
+
+    /*
+     * 写入一个字符，缓冲区满或行缓冲模式下遇到换行符时刷新
+     */
+    void put(char c) {
+        buffer[used++] = c;
+        if (used == BUFFER_SIZE || (lineBuffered && c == '\n')) {
+            flush();
+        }
+    }
+
+    /*
+     * 写入一段字符
+     */
+    void write(const char* data, int length) {
+        for (int i = 0; i < length; i++) {
+            put(data[i]);
+        }
+    }
+
+    /*
+     * 把缓冲区中的内容写到目标文件
+     * std::cout与stdio保持同步，所以与其他std::cout输出的先后顺序不会错乱
+     */
+    void flush() {
+        if (target == NULL) {
+            used = 0;
+            return;
+        }
+        if (used > 0) {
+            fwrite(buffer, 1, used, target);
+            used = 0;
+        }
+        fflush(target);
+    }
+};
+
+/*
+ * InputSource类 - Brainfuck程序','指令的输入来源
+ * 输入按块读入用户空间缓冲区，每个','只需从缓冲区取一个字节：
+ * - 标准输入：终端上每次读入一行（保证交互式输入及时生效），管道或重定向时每次读入一整块
+ * - 文件：以二进制方式按块读取
+ * - 内存：直接使用给定的字符串，不再读取
+ * 读到输入末尾（EOF）后的行为由EofMode决定
+ */
+class InputSource {
+public:
+    /*
+     * 读到输入末尾后','对内存单元的处理方式
+     */
+    enum EofMode {
+        EOF_UNCHANGED,   // 保持单元原值
+        EOF_ZERO,        // 写入0
+        EOF_MINUS_ONE    // 写入-1（即getchar()返回的EOF，8位单元中为255）
+    };
+
+private:
+    static const int BUFFER_SIZE = 65536;
+    std::string data;       // 已读入但尚未取走的输入
+    size_t position;        // data中下一个要取走的字节
+    FILE* file;             // 读取来源，为NULL时表示只使用data中的内存数据
+    bool ownsFile;          // file是否由本对象打开（需要负责关闭）
+    bool interactive;       // file是否为终端
+    bool finished;          // file是否已经读到末尾
+    EofMode eofMode;        // EOF时的处理方式
+    bool skipNewlines;      // 是否跳过输入中的换行符
+    bool recording;         // 是否保留已读过的数据（见setRecording()）
+
+    // 禁止复制（只声明不实现）
+    InputSource(const InputSource&);
+    InputSource& operator=(const InputSource&);
+
+    /*
+     * 判断文件是否连接到终端
+     */
+    static bool isTerminal(FILE* f) {
+#ifdef _WIN32
+        return _isatty(_fileno(f)) != 0;
+#else
+        return isatty(fileno(f)) != 0;
+#endif
+    }
+
+    /*
+     * 关闭由本对象打开的文件并清空缓冲区
+     */
+    void reset() {
+        if (ownsFile && file != NULL) {
+            fclose(file);
+        }
+        file = NULL;
+        ownsFile = false;
+        interactive = false;
+        finished = false;
+        data.clear();
+        position = 0;
+    }
+
+    /*
+     * 从file读入下一块数据
+     * 返回值：
+     * - 读到了数据返回true，已到达末尾或没有文件时返回false
+     */
+    bool refill() {
+        if (file == NULL || finished) {
+            return false;
+        }
+        // 记录时新数据接在已读过的数据之后，否则覆盖
+        const size_t start = recording ? data.size() : 0;
+        data.resize(start + BUFFER_SIZE);
+        size_t length = 0;
+        if (interactive) {
+            // 终端上读入一行（含换行符），不等待后续输入
+            int c;
+            while (length < BUFFER_SIZE && (c = getc(file)) != EOF) {
+                data[start + length++] = static_cast<char>(c);
+                if (c == '\n') {
+                    break;
+                }
+            }
+        } else {
+            length = fread(&data[start], 1, BUFFER_SIZE, file);
+        }
+        data.resize(start + length);
+        position = start;
+        if (length == 0) {
+            finished = true;
+            if (interactive) {
+                clearerr(file); // 终端上的EOF不影响之后的菜单输入
+            }
+            return false;
+        }
+        return true;
+    }
+
+public:
+    /*
+     * 构造函数 - 默认从标准输入读取，EOF时写入-1，不跳过换行符
+     */
+    InputSource() : position(0), file(NULL), ownsFile(false), interactive(false),
+                    finished(false), eofMode(EOF_MINUS_ONE), skipNewlines(false), recording(false) {
+        useStdin();
+    }
+
+    ~InputSource() {
+        reset();
+    }
+
+    /*
+     * 从标准输入读取
+     */
+    void useStdin() {
+        reset();
+        file = stdin;
+        interactive = isTerminal(stdin);
+    }
+
+    /*
+     * 从文件读取
+     * 参数：
+     * - path: 输入文件路径
+     * 返回值：
+     * - 文件打开成功返回true，失败时返回false（此时视为空输入）
+     */
+    bool openFile(const std::string& path) {
+        reset();
+        file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return false;
+        }
+        ownsFile = true;
+        return true;
+    }
+
+    /*
+     * 从内存中的数据读取，取完后即为EOF
+     */
+    void setData(const std::string& input) {
+        reset();
+        data = input;
+    }
+
+    void setEofMode(EofMode mode) {
+        eofMode = mode;
+    }
+
+    EofMode getEofMode() const {
+        return eofMode;
+    }
+
+    /*
+     * 设置是否跳过输入中的换行符（'\n'）
+     * 逐行输入字符时，每行末尾的换行符通常不希望被程序读到
+     */
+    void setSkipNewlines(bool enabled) {
+        skipNewlines = enabled;
+    }
+
+    /*
+     * 下一次get()是否需要从文件读入新数据（可能会等待输入）
+     * 此时应先刷新已有输出，交互式程序才能先看到提示再输入
+     */
+    bool needsRefill() const {
+        return position >= data.size() && file != NULL && !finished;
+    }
+
+    bool isInteractive() const {
+        return interactive;
+    }
+
+    /*
+     * 设置是否保留从文件读过的数据，用于倒退调试时重新执行（见rewind()）
+     * 保留期间缓冲区只增不减，get()本身没有额外开销
+     */
+    void setRecording(bool enabled) {
+        recording = enabled;
+    }
+
+    /*
+     * 获取当前的输入位置，开启记录后可以用rewind()回到这里
+     */
+    size_t getCursor() const {
+        return position;
+    }
+
+    /*
+     * 回到之前的输入位置（getCursor()的返回值），此后的get()先重复已读过的数据，再继续读取新的输入
+     * EOF之后不再读取文件，重复执行时同样读到EOF
+     */
+    void rewind(size_t cursor) {
+        position = std::min(cursor, data.size());
+    }
+
+    /*
+     * 取出下一个字节
+     * 返回值：
+     * - 0-255的字节值，输入结束时返回-1
+     */
+    int get() {
+        for (;;) {
+            if (position >= data.size() && !refill()) {
+                return -1;
+            }
+            unsigned char c = static_cast<unsigned char>(data[position++]);
+            if (!(skipNewlines && c == '\n')) {
+                return c;
+            }
+        }
+    }
+
+    /*
+     * 执行一次','：读入一个字节写入cell，输入结束时按EofMode处理
+     * 参数：
+     * - cell: 当前内存单元（char、unsigned char等整数类型）
+     */
+    template <typename Cell>
+    void readCell(Cell& cell) {
+        int c = get();
+        if (c >= 0) {
+            cell = static_cast<Cell>(c);
+        } else if (eofMode == EOF_ZERO) {
+            cell = 0;
+        } else if (eofMode == EOF_MINUS_ONE) {
+            cell = static_cast<Cell>(-1);
+        }
+    }
+};
+
+// 扫描循环的SIMD加速：x86-64上SSE2总是可用；GCC/Clang下另外编译一份AVX2版本，运行时检测CPU后选用
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define BFX_SCAN_SSE2 1
+    #if defined(__GNUC__)
+        #include <immintrin.h>
+        #define BFX_SCAN_AVX2 1
+    #endif
+#endif
+
+/*
+ * CellScanner类 - 扫描循环（"[>]"、"[<]"、"[>>]"、"[<<<<]"等）的加速实现
+ * 在内存中按固定步长查找第一个值为0的单元：
+ * - 步长为1时与memchr相同，一次比较16（SSE2）或32（AVX2）个单元
+ * - 步长为2或4时同样整块比较，再用掩码只保留步长对应位置的结果
+ * - 其他步长以及不支持SIMD的平台逐个单元检查
+ * 所有函数都只访问[0, size)之内的单元
+ */
+class CellScanner {
+public:
+    /*
+     * 从position开始按stride（可为负）查找值为0的单元，越过内存边界时回绕
+     * 参数：
+     * - cells/size: 内存起始地址和单元数
+     * - position: 起始位置（包含）
+     * - stride: 步长，不能为0
+     * 返回值：
+     * - 第一个值为0的单元位置；若该步长能到达的单元都不为0则不会返回（与原始循环一致）
+     */
+    static int findZeroWrapped(const unsigned char* cells, int size, int position, int stride) {
+        for (;;) {
+            int found = findZero(cells, size, position, stride);
+            if (found >= 0) {
+                return found;
+            }
+            // 本段内没有找到，从越界后回绕的位置继续
+            if (stride > 0) {
+                int last = position + ((size - 1 - position) / stride) * stride;
+                position = ((last + stride) % size + size) % size;
+            } else {
+                int last = position % (-stride);
+                position = ((last + stride) % size + size) % size;
+            }
+        }
+    }
+
+    /*
+     * 从position开始按stride（可为负）查找值为0的单元，不回绕
+     * 返回值：
+     * - 找到的位置；到达内存边界仍未找到时返回-1
+     */
+    static int findZero(const unsigned char* cells, int size, int position, int stride) {
+        if (stride == 1 || stride == 2 || stride == 4) {
+            return findForward(cells, position, size, stride);
+        }
+        if (stride == -1 || stride == -2 || stride == -4) {
+            return findBackward(cells, position, -stride);
+        }
+        for (int i = position; i >= 0 && i < size; i += stride) {
+            if (cells[i] == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    // 步长为1/2/4时，一个块中需要检查的位（向前扫描时从最低位开始，向后扫描时从最高位开始）
+    static unsigned int forwardMask(int stride) {
+        return (stride == 1) ? 0xFFFFFFFFu : (stride == 2) ? 0x55555555u : 0x11111111u;
+    }
+
+    static unsigned int backwardMask(int stride) {
+        return (stride == 1) ? 0xFFFFFFFFu : (stride == 2) ? 0xAAAAAAAAu : 0x88888888u;
+    }
+
+    static int lowestBit(unsigned int bits) {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int n = 0;
+        while (!(bits & 1u)) {
+            bits >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    static int highestBit(unsigned int bits) {
+#if defined(__GNUC__)
+        return 31 - __builtin_clz(bits);
+#else
+        int n = 31;
+        while (!(bits & 0x80000000u)) {
+            bits <<= 1;
+            n--;
+        }
+        return n;
+#endif
+    }
+
+#ifdef BFX_SCAN_AVX2
+    // 运行时检测一次CPU是否支持AVX2
+    static bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    // AVX2版本：每次检查32个单元，返回找到的位置并把i推进到未检查的第一个位置
+    __attribute__((target("avx2")))
+    static int forwardAvx2(const unsigned char* cells, int& i, int limit, unsigned int mask) {
+        const __m256i zero = _mm256_setzero_si256();
+        while (i + 32 <= limit) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+            unsigned int hits = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero))) & mask;
+            if (hits) {
+                return i + lowestBit(hits);
+            }
+            i += 32;
+        }
+        return -1;
+    }
+
+    __attribute__((target("avx2")))
+    static int backwardAvx2(const unsigned char* cells, int& i, unsigned int mask) {
+        const __m256i zero = _mm256_setzero_si256();
+        while (i - 31 >= 0) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i - 31));
+            unsigned int hits = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero))) & mask;
+            if (hits) {
+                return i - 31 + highestBit(hits);
+            }
+            i -= 32;
+        }
+        return -1;
+    }
+#endif
+
+    /*
+     * 在[position, limit)中按步长1/2/4向前查找
+     * 每块的长度都是步长的整数倍，所以块内需要检查的位置固定，用掩码筛选即可
+     */
+    static int findForward(const unsigned char* cells, int position, int limit, int stride) {
+        int i = position;
+#ifdef BFX_SCAN_AVX2
+        if (hasAvx2()) {
+            int found = forwardAvx2(cells, i, limit, forwardMask(stride));
+            if (found >= 0) {
+                return found;
+            }
+        }
+#endif
+#ifdef BFX_SCAN_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        unsigned int mask = forwardMask(stride) & 0xFFFFu;
+        while (i + 16 <= limit) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+            unsigned int hits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero))) & mask;
+            if (hits) {
+                return i + lowestBit(hits);
+            }
+            i += 16;
+        }
+#endif
+        for (; i < limit; i += stride) {
+            if (cells[i] == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /*
+     * 从position开始按步长1/2/4向后查找，直到位置0
+     */
+    static int findBackward(const unsigned char* cells, int position, int stride) {
+        int i = position;
+#ifdef BFX_SCAN_AVX2
+        if (hasAvx2()) {
+            int found = backwardAvx2(cells, i, backwardMask(stride));
+            if (found >= 0) {
+                return found;
+            }
+        }
+#endif
+#ifdef BFX_SCAN_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        unsigned int mask = backwardMask(stride) & 0xFFFFu;
+        while (i - 15 >= 0) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i - 15));
+            unsigned int hits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero))) & mask;
+            if (hits) {
+                return i - 15 + highestBit(hits);
+            }
+            i -= 16;
+        }
+#endif
+        for (; i >= 0; i -= stride) {
+            if (cells[i] == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+/*
+ * Tape类 - Brainfuck程序的内存磁带
+ * 在虚拟地址空间中预留一整块区域，只有磁带当前的长度是可读写的，其余部分不可访问：
+ *   [左侧保护区][磁带（可读写）][尚未使用的部分，最多扩展到上限][右侧保护区]
+ * 执行时指针移动不做任何边界检查，访问到不可访问的页面时由SIGSEGV信号（Windows上为向量化异常）处理：
+ * - 访问磁带右侧尚未使用的部分且磁带允许扩展：扩展磁带后从出错的指令继续执行，新单元均为0
+ * - 其他情况（指针小于0、超过上限、磁带大小固定）：跳回执行入口（jumpBuffer()）报告指针越界
+ * 注意：
+ * - 磁带长度按页大小向上取整；报错模式下最后一个单元之后到页末的部分仍可读写，由执行时的显式检查报告越界
+ *   （见BrainfuckCompiler::Policy::at()），第0个单元紧挨左侧保护区
+ * - 保护区至少要和一条指令能跨越的距离一样大，执行前应调用ensureGuard()
+ * - 执行期间需要用Session对象安装信号处理函数
+ */
+class Tape {
+public:
+#ifdef _WIN32
+    typedef jmp_buf JumpBuffer;
+#else
+    typedef sigjmp_buf JumpBuffer;
+#endif
+    class Session;
+
+    static const size_t DEFAULT_LIMIT = 64 << 20;   // 默认的磁带长度上限（64MB）
+    static const size_t MIN_GUARD = 1 << 20;        // 保护区的最小大小（1MB）
+
+private:
+    char* base;             // 预留区域的起始地址（左侧保护区的开头）
+    size_t reservedBytes;   // 预留区域的总大小
+    size_t guardBytes;      // 两侧保护区各自的大小
+    size_t limitBytes;      // 磁带最多可以扩展到的长度
+    size_t committedBytes;  // 磁带当前的长度（可读写部分）
+    size_t initialBytes;    // 磁带的初始长度
+    bool growable;          // 访问到磁带右侧时是否扩展磁带
+    JumpBuffer jump;        // 指针越界时跳回的位置
+
+    friend class Session;
+
+    // 禁止复制（只声明不实现）
+    Tape(const Tape&);
+    Tape& operator=(const Tape&);
+
+    static size_t pageSize() {
+        static size_t size = 0;
+        if (size == 0) {
+#ifdef _WIN32
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            size = info.dwPageSize;
+#else
+            size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        }
+        return size;
+    }
+
+    static size_t roundUp(size_t bytes) {
+        size_t page = pageSize();
+        return (bytes + page - 1) / page * page;
+    }
+
+    // 当前执行中的磁带，信号处理函数通过它找到出错的磁带
+    static Tape*& activeTape() {
+        static Tape* tape = NULL;
+        return tape;
+    }
+
+    /*
+     * 预留整个区域并把磁带的前initialBytes字节设为可读写
+     * 参数：
+     * - guard: 保护区的大小（会向上取整到页大小）
+     */
+    void allocate(size_t guard) {
+        guardBytes = roundUp(guard < MIN_GUARD ? MIN_GUARD : guard);
+        reservedBytes = guardBytes * 2 + limitBytes;
+#ifdef _WIN32
+        base = static_cast<char*>(VirtualAlloc(NULL, reservedBytes, MEM_RESERVE, PAGE_NOACCESS));
+#else
+        void* region = mmap(NULL, reservedBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        base = (region == MAP_FAILED) ? NULL : static_cast<char*>(region);
+#endif
+        if (base == NULL) {
+            throw std::bad_alloc();
+        }
+        committedBytes = 0;
+        if (!commitTo(initialBytes)) {
+            release();
+            throw std::bad_alloc();
+        }
+    }
+
+    // 归还整个预留区域
+    void release() {
+        if (base != NULL) {
+#ifdef _WIN32
+            VirtualFree(base, 0, MEM_RELEASE);
+#else
+            munmap(base, reservedBytes);
+#endif
+            base = NULL;
+        }
+        committedBytes = 0;
+    }
+
+    /*
+     * 把磁带扩展到至少bytes字节（不超过上限），新增的单元为0
+     * 返回值：
+     * - 成功返回true
+     */
+    bool commitTo(size_t bytes) {
+        bytes = std::min(roundUp(bytes), limitBytes);
+        if (bytes <= committedBytes) {
+            return true;
+        }
+        char* start = cells() + committedBytes;
+        size_t length = bytes - committedBytes;
+#ifdef _WIN32
+        if (VirtualAlloc(start, length, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+            return false;
+        }
+#else
+        if (mprotect(start, length, PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+#endif
+        committedBytes = bytes;
+        return true;
+    }
+
+    bool owns(const char* address) const {
+        return base != NULL && address >= base && address < base + reservedBytes;
+    }
+
+    /*
+     * 处理对预留区域内address的非法访问
+     * 返回值：
+     * - 已扩展磁带、可以重新执行出错的指令时返回true，否则返回false（指针越界）
+     */
+    bool handleFault(const char* address) {
+        const char* begin = cells();
+        if (!growable || address < begin + committedBytes || address >= begin + limitBytes) {
+            return false;
+        }
+        // 至少扩展到出错的位置，同时按倍数增长以减少扩展次数
+        size_t needed = static_cast<size_t>(address - begin) + 1;
+        return commitTo(std::max(needed, std::min(committedBytes * 2, limitBytes)));
+    }
+
+#ifdef _WIN32
+    static LONG WINAPI onException(EXCEPTION_POINTERS* info) {
+        Tape* tape = activeTape();
+        if (tape != NULL && info->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION) {
+            const char* address = reinterpret_cast<const char*>(info->ExceptionRecord->ExceptionInformation[1]);
+            if (tape->owns(address)) {
+                if (tape->handleFault(address)) {
+                    return EXCEPTION_CONTINUE_EXECUTION;
+                }
+                longjmp(tape->jump, 1);
+            }
+        }
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+#else
+    static void onSignal(int signal, siginfo_t* info, void* context) {
+        (void)context;
+        Tape* tape = activeTape();
+        const char* address = static_cast<const char*>(info->si_addr);
+        if (tape != NULL && tape->owns(address)) {
+            if (tape->handleFault(address)) {
+                return;
+            }
+            siglongjmp(tape->jump, 1);
+        }
+        // 不是磁带引起的错误：恢复默认处理方式，返回后再次发生的错误照常终止程序
+        ::signal(signal, SIG_DFL);
+    }
+#endif
+
+public:
+    /*
+     * 构造函数
+     * 参数：
+     * - initialSize: 磁带的初始长度，默认为30000
+     * - canGrow: 访问到磁带右侧时是否扩展磁带，为false时作为指针越界处理
+     * - limit: 磁带长度的上限
+     */
+    explicit Tape(size_t initialSize = 30000, bool canGrow = true, size_t limit = DEFAULT_LIMIT)
+        : base(NULL), reservedBytes(0), guardBytes(0), committedBytes(0), growable(canGrow) {
+        initialBytes = roundUp(std::max<size_t>(initialSize, 1));
+        limitBytes = std::max(roundUp(limit), initialBytes);
+        allocate(MIN_GUARD);
+    }
+
+    ~Tape() {
+        release();
+    }
+
+    // 磁带第0个单元的地址
+    char* cells() const {
+        return base + guardBytes;
+    }
+
+    // 磁带当前的长度
+    int size() const {
+        return static_cast<int>(committedBytes);
+    }
+
+    bool isGrowable() const {
+        return growable;
+    }
+
+    void setGrowable(bool enabled) {
+        growable = enabled;
+    }
+
+    JumpBuffer& jumpBuffer() {
+        return jump;
+    }
+
+    /*
+     * 把磁带恢复为bytes字节（按页大小向上取整）并把所有单元清零
+     * 之前扩展出的部分重新变为不可访问并归还给系统；超过上限时重新预留更大的区域
+     * 注意：
+     * - 重新预留后cells()的地址会改变
+     */
+    void reset(size_t bytes) {
+        size_t length = roundUp(std::max<size_t>(bytes, 1));
+        if (length > limitBytes) {
+            release();
+            initialBytes = limitBytes = length;
+            allocate(guardBytes); // 新提交的页面内容均为0
+            return;
+        }
+        if (committedBytes > length) {
+            char* start = cells() + length;
+            size_t extra = committedBytes - length;
+#ifdef _WIN32
+            VirtualFree(start, extra, MEM_DECOMMIT);
+#else
+            mprotect(start, extra, PROT_NONE);
+            madvise(start, extra, MADV_DONTNEED);
+#endif
+            committedBytes = length;
+        }
+        memset(cells(), 0, committedBytes);
+        commitTo(length);
+        initialBytes = length;
+    }
+
+    /*
+     * 保证保护区不小于reach，否则重新预留区域（保留原有内容）
+     * 参数：
+     * - reach: 一条指令相对指针能访问的最大距离，不超过程序的长度
+     * 注意：
+     * - 重新预留后cells()的地址会改变
+     */
+    void ensureGuard(size_t reach) {
+        if (roundUp(reach) <= guardBytes) {
+            return;
+        }
+        std::vector<char> saved(cells(), cells() + committedBytes);
+        release();
+        allocate(reach);
+        commitTo(saved.size());
+        memcpy(cells(), &saved[0], saved.size());
+    }
+
+    /*
+     * 扫描循环：从position开始按stride查找值为0的单元
+     * 扫描到磁带末端仍未找到时，下一个位置在磁带之外：
+     * 访问它会触发保护页，磁带扩展后该单元为0即为结果，否则报告越界
+     * 参数：
+     * - end: 可以读取的单元数；小于size()时（不能扩展且长度不是页大小的整数倍），
+     *        end到页末之间的单元不属于磁带，扫描到那里时访问左侧保护区报告越界
+     */
+    int scan(int position, int stride, int end) {
+        int next = -1;
+        if (position < end || position >= size()) {
+            int found = CellScanner::findZero(reinterpret_cast<unsigned char*>(cells()), end, position, stride);
+            if (found >= 0) {
+                return found;
+            }
+            if (stride > 0) {
+                next = position + ((end - 1 - position) / stride + 1) * stride;
+            } else {
+                next = position % (-stride) + stride;
+            }
+            if (next >= end && next < size()) {
+                next = -1;
+            }
+        }
+        volatile char* cell = cells() + next;
+        (void)*cell;
+        return next;
+    }
+
+    /*
+     * Session类 - 执行期间安装处理磁带越界的信号处理函数
+     * 构造时把tape设为当前磁带，析构时恢复原来的处理方式
+     * 用法：
+     *   Tape::Session session(tape);
+     *   if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) { 指针越界 }
+     *   执行程序...
+     */
+    class Session {
+    private:
+        Tape* previousTape;
+#ifdef _WIN32
+        void* handler;
+#else
+        struct sigaction previousSegv;  // 安装之前的SIGSEGV处理方式
+        struct sigaction previousBus;   // 安装之前的SIGBUS处理方式
+#endif
+
+        Session(const Session&);
+        Session& operator=(const Session&);
+
+    public:
+        explicit Session(Tape& tape) : previousTape(activeTape()) {
+            activeTape() = &tape;
+#ifdef _WIN32
+            handler = AddVectoredExceptionHandler(1, &Tape::onException);
+#else
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_sigaction = &Tape::onSignal;
+            action.sa_flags = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGSEGV, &action, &previousSegv);
+            sigaction(SIGBUS, &action, &previousBus); // macOS上访问保护页产生SIGBUS
+#endif
+        }
+
+        ~Session() {
+#ifdef _WIN32
+            RemoveVectoredExceptionHandler(handler);
+#else
+            sigaction(SIGSEGV, &previousSegv, NULL);
+            sigaction(SIGBUS, &previousBus, NULL);
+#endif
+            activeTape() = previousTape;
+        }
+    };
+};
+
+// 设置磁带越界时跳回的位置，直接返回0，越界跳回时返回非0
+#ifdef _WIN32
+    #define BFX_TAPE_SETJMP(buffer) setjmp(buffer)
+#else
+    #define BFX_TAPE_SETJMP(buffer) sigsetjmp(buffer, 1)
+#endif
+
+/*
+ * BrainfuckCompiler类 - Brainfuck语言编译器和解释器
+ * 提供优化的Brainfuck代码解释执行、编译和调试功能
+ * 特性：
+ * - 默认30000个单元的Brainfuck内存磁带，可以设置初始长度，超出时自动扩展（由保护页检测，不需要边界检查）
+ * - 单元宽度（8/16/32位）、指针越界方式（回绕/报错/扩展）和EOF处理方式作为模板策略，
+ *   每种组合单独实例化一份解释器，不使用的语义在内层循环中没有开销
+ * - 预计算循环跳转表，优化执行性能
+ * - 加载时将代码翻译为折叠重复指令后的IR，解释器直接执行IR
+ * - x86-64平台上可把IR即时编译（JIT）为机器码直接运行
+ * - 支持GCC/Clang时解释器使用直接线索化分派，否则使用switch分派
+ * - 扫描循环使用SSE2/AVX2整块查找值为0的单元
+ * - 输出写入用户空间缓冲区，整块写出，可选按行刷新
+ * - 输入按块读入，可来自标准输入、文件或内存，EOF行为可配置
+ * - 支持从字符串或文件加载代码
+ * - 提供完整的解释执行功能
+ * - 提供单步执行功能，便于调试
+ * - 支持编译为C或C++代码
+ * - 提供内存状态和执行状态的调试输出
+ */
+class BrainfuckCompiler {
+public:
+    /*
+     * IR操作码 - loadCode()时由过滤后的代码翻译而来
+     * 连续的'+'/'-'折叠为一条OP_ADD，连续的'<'/'>'折叠为一条OP_MOVE，
+     * 常见的循环写法再由optimizeLoops()改写为OP_CLEAR/OP_MUL/OP_SCAN，整除取余、比较等固定写法之前加上闭式计算的指令，
+     * 只剩加减、清零和乘法的外层循环由lowerNestedLoops()改写为只执行一轮加上闭式计算，
+     * 最后由addressByOffset()把指针移动折算为各指令的单元偏移，
+     * 解释器直接执行IR，一次分派完成一整段重复指令或一整个循环
+     * 以下"当前单元"均指内存指针加上指令的offset处的单元
+     */
+    enum OpCode {
+        OP_ADD,        // 当前内存单元加上arg（arg为负时表示减）
+        OP_MOVE,       // 内存指针移动arg个位置（arg为负时表示左移，越界时按PointerMode处理）
+        OP_OUTPUT,     // 输出当前内存单元
+        OP_INPUT,      // 读入一个字符到当前内存单元
+        OP_LOOP_START, // 循环开始，arg为到匹配的OP_LOOP_END的相对偏移
+        OP_LOOP_END,   // 循环结束，arg为到匹配的OP_LOOP_START的相对偏移（负数）
+        OP_CLEAR,      // 当前内存单元清零，对应"[-]"、"[+]"
+        OP_MUL,        // 当前单元加上偏移from处的单元乘以arg，对应"[->+>++<<]"中的每个目标
+        OP_SCAN,       // 以arg为步长移动指针，直到遇到值为0的单元，对应"[>]"、"[<]"、"[>>]"
+        OP_PRODUCT,    // 当前单元加上偏移from处与偏移by处两个单元之积乘以arg，对应乘积等嵌套循环中剩余各轮的累加
+        OP_DIVMOD,     // 整除取余循环的闭式计算（见lowerIdiom()），from为除数单元，其后紧跟原循环
+        OP_COMPARE     // 比较循环的闭式计算（见lowerIdiom()），from为另一个单元，arg为循环中扫描的步长，其后紧跟原循环
+    };
+    static const int OP_KINDS = OP_COMPARE + 1; // 操作码的种数
+
+    /*
+     * 操作码的名称，用于状态显示和指令序列统计
+     */
+    static const char* opName(int op) {
+        static const char* const names[OP_KINDS] = {
+            "add", "move", "output", "input", "loop", "end", "clear", "multiply", "scan", "product", "divmod", "compare"
+        };
+        return names[op];
+    }
+
+    /*
+     * 一条IR指令
+     * - op: 操作码
+     * - arg: 折叠后的重复次数（OP_ADD/OP_MOVE）、乘数（OP_MUL/OP_PRODUCT）、步长（OP_SCAN/OP_COMPARE），
+     *        或循环指令到匹配位置的相对偏移（未配对的括号为0，即被忽略）
+     * - offset: 指令访问的单元相对于内存指针的偏移（OP_MUL为写入的目标单元，循环指令为检查的单元）
+     * - from: OP_MUL/OP_PRODUCT读取的单元（循环计数单元）、OP_DIVMOD/OP_COMPARE的第二个单元相对于内存指针的偏移
+     * - by: OP_PRODUCT读取的另一个单元相对于内存指针的偏移
+     * - source: 该指令对应的第一个源字符在code中的位置，用于调试输出
+     */
+    struct Instruction {
+        OpCode op;
+        int arg;
+        int offset;
+        int from;
+        int by;
+        int source;
+    };
+
+    /*
+     * 内存指针越过磁带边界时的处理方式
+     */
+    enum PointerMode {
+        POINTER_WRAP,  // 回绕到磁带另一端，磁带长度固定为设置的单元数
+        POINTER_ERROR, // 访问磁带之外的单元（或执行结束时指针在磁带之外）视为指针越界
+        POINTER_GROW   // 访问磁带右侧之外的单元时扩展磁带，左侧越界视为指针越界
+    };
+
+    /*
+     * 断点的条件：把单元的值与断点中的value比较，成立时才停下
+     */
+    enum BreakCondition {
+        BREAK_ALWAYS,    // 不检查，每次到达都停下
+        BREAK_EQUAL,     // 单元 == value
+        BREAK_NOT_EQUAL, // 单元 != value
+        BREAK_LESS,      // 单元 < value
+        BREAK_GREATER    // 单元 > value
+    };
+
+    /*
+     * 断点（见addBreakpoint()）
+     * - position: 过滤后代码中的位置，执行到这个位置所属的IR指令之前停下
+     * - condition/value: 停下的条件
+     * - cell: 条件检查的单元，为-1时检查这条指令访问的单元（内存指针加指令中的偏移）
+     */
+    struct Breakpoint {
+        int position;
+        BreakCondition condition;
+        int cell;
+        unsigned int value;
+    };
+
+    /*
+     * 观察点的类型
+     */
+    enum WatchKind {
+        WATCH_CHANGE, // 单元的值改变时停下
+        WATCH_EQUAL,  // 单元的值变为value时停下
+        WATCH_OUTPUT  // '.'输出这个单元时停下
+    };
+
+    /*
+     * 观察点（见addWatchpoint()）
+     * - cell: 观察的单元
+     * - kind/value: 停下的时机，value只用于WATCH_EQUAL
+     */
+    struct Watchpoint {
+        int cell;
+        WatchKind kind;
+        unsigned int value;
+    };
+
+    /*
+     * debugContinue()停下的原因
+     */
+    enum DebugStop {
+        DEBUG_BREAKPOINT, // 停在条件成立的断点处，断点所在的指令还没有执行
+        DEBUG_WATCHPOINT, // 观察点命中：WATCH_OUTPUT停在'.'执行之前，其余停在改变单元的指令执行之后
+        DEBUG_FINISHED,   // 程序执行完毕
+        DEBUG_ERROR,      // 内存指针越界
+        DEBUG_HISTORY_START // reverseContinue()一直倒退到了历史记录的起点，途中没有断点或观察点
+    };
+
+    /*
+     * 一个循环的执行统计（见setCounting()、getLoopProfile()），代价以IR指令的执行次数计
+     * - start/end: 循环的'['和']'在过滤后代码中的位置
+     * - depth: 嵌套深度，最外层为0
+     * - entries: 进入循环体的次数（到达'['时单元为0、直接跳过的不计）
+     * - iterations: 循环体执行的总轮数（lowerNestedLoops()改写过的循环只执行一轮，其余各轮由闭式计算完成）
+     * - selfCost: 直接属于这个循环的指令（包括'['和']'，不包括内层循环）的执行次数之和
+     * - totalCost: 包括内层循环在内的执行次数之和
+     */
+    struct LoopProfile {
+        int start;
+        int end;
+        int depth;
+        long long entries;
+        long long iterations;
+        long long selfCost;
+        long long totalCost;
+    };
+
+    static const int DEFAULT_PREFIX_BUDGET = 1 << 24; // 加载时预先执行的默认指令数上限（见setPrefixBudget()）
+    static const int DEFAULT_TIER_THRESHOLD = 1000;   // 分层执行时循环编译为机器码的默认回跳次数（见setTierThreshold()）
+
+private:
+    static const int MEMORY_SIZE = 30000; // Brainfuck标准内存大小（30000个单元），作为磁带的初始长度
+    Tape tape;                            // 内存磁带，按字节分配，单元宽度大于8位时占用多个字节
+    char* memory;                         // 磁带第0个单元的地址，即tape.cells()
+    int tapeCells;                        // 磁带的初始单元数，回绕模式下即为磁带长度
+    int cellBits;                         // 单元宽度（8、16或32位）
+    PointerMode pointerMode;              // 指针越界的处理方式
+    int memoryPointer;                    // 内存指针，指向当前操作的内存位置
+    int instructionPointer;               // 指令指针，指向当前执行的指令位置
+    std::string code;                     // 存储编译后的Brainfuck代码（仅包含有效指令）
+
+    std::vector<Instruction> program;     // 折叠后的IR指令序列，instructionPointer指向其中的位置
+    OutputSink output;                    // '.'指令的输出缓冲区
+    InputSource input;                    // ','指令的输入来源
+
+    // 加载时的预先执行（见evaluatePrefix()）
+    long long prefixBudget;               // 预先执行的IR指令数上限，为0时不预先执行
+    std::string prefixOutput;             // 预先执行期间产生的输出
+    bool prefixPending;                   // prefixOutput是否还没有写出（执行开始时写出）
+    std::vector<unsigned int> prefixCells;// 预先执行结束时的磁带内容，到最后一个非0单元为止
+    int prefixPointer;                    // 预先执行结束时的内存指针
+    int prefixInstruction;                // 预先执行结束时的指令位置，即实际执行的起点
+
+    /*
+     * 一段代码执行期间指针到达和访问的单元的范围（见analyzePointerRange()）
+     * - bounded: 范围是否有限；含扫描循环、比较循环或净移动不为0的循环时为false，此时low/high无意义
+     * - low/high: 最左和最右的单元，相对这段代码开始时的指针
+     */
+    struct PointerRange {
+        bool bounded;
+        int low;
+        int high;
+    };
+    std::vector<PointerRange> loopRanges; // 各循环（下标为'['的指令位置）的范围，相对进入循环时的指针
+    PointerRange programRange;            // 整个程序的范围，相对第0个单元
+
+    // 调试（见debugContinue()）
+    std::vector<Breakpoint> breakpoints;  // 已设置的断点，加载新代码后仍然保留
+    std::vector<char> breakFlags;         // 各IR指令上是否有断点，下标为指令位置，比program多一项（程序结束）
+    int stoppedAt;                        // 上次停在的断点所在的指令位置，从这里继续时先执行这条指令；没有时为-1
+    int hitBreakpoint;                    // 上次停下时条件成立的断点在breakpoints中的下标
+    std::vector<Watchpoint> watchpoints;  // 已设置的观察点，不为空时debugContinue()改用engine.watch
+    std::vector<unsigned int> watchValues; // 各观察点的单元上次检查时的值
+    int hitWatchpoint;                    // 上次停下时命中的观察点在watchpoints中的下标
+
+    /*
+     * 倒退调试的检查点（见setHistory()）：执行了executed条指令时的状态
+     * 磁带只保存到最后一个非0字节为止，之后的部分恢复时清零
+     */
+    struct Checkpoint {
+        long long executed;
+        int instructionPointer;
+        int memoryPointer;
+        size_t inputCursor;       // InputSource::getCursor()
+        std::vector<char> cells;
+    };
+    static const int HISTORY_CHECKPOINTS = 64;        // 检查点数量上限，超过时丢弃一半并把间隔加倍
+    static const size_t HISTORY_BYTES = 64 << 20;    // 检查点中磁带内容的总字节数上限，超过时同样丢弃一半
+    static const long long HISTORY_INTERVAL = 4096;   // 开始记录时的检查点间隔（指令数）
+    bool history;                         // 是否记录执行历史
+    std::vector<Checkpoint> checkpoints;  // 按executed递增，第一个为开始记录时的状态
+    size_t historyBytes;                  // checkpoints中磁带内容的总字节数
+    long long historyInterval;            // 当前的检查点间隔
+    long long executed;                   // 开始记录以来执行的指令数，倒退时随之减少
+    long long replayTarget;               // 重新执行到executed等于这个值为止（见replayWith()）
+    bool replayScan;                      // 重新执行时是否记录会停下的位置
+    long long replayBefore;               // 只记录executed小于这个值的位置
+    long long replayStop;                 // 记录到的最后一个会停下的位置，没有时为-1
+    int replayWatch;                      // replayStop处命中的改变类观察点，停在指令之前时为-1
+
+    // 指令序列统计（见setProfiling()），多次执行的结果累加
+    bool profiling;                       // interpret()是否统计相邻指令的操作码组合
+    std::vector<long long> pairCounts;    // 顺序执行的相邻两条指令，下标为 a * OP_KINDS + b
+    std::vector<long long> tripleCounts;  // 顺序执行的相邻三条指令，下标为 (a * OP_KINDS + b) * OP_KINDS + c
+
+    // 逐条指令的执行统计（见setCounting()），loadCode()和restart()时清零
+    bool counting;                        // interpret()是否统计每条IR指令的执行次数
+    std::vector<long long> executionCounts; // 每条IR指令的执行次数，下标与program相同
+    std::vector<long long> loopEntries;   // 每个OP_LOOP_START进入循环体的次数，其余指令处为0
+
+    /*
+     * 把过滤后的代码翻译为IR，同时折叠连续的'+'/'-'和'<'/'>'
+     * 净效果为0的片段（如"+-"、"<>"）不生成指令
+     */
+    void buildProgram() {
+        program.clear();
+        int i = 0;
+        while (i < (int)code.length()) {
+            char c = code[i];
+            Instruction ins;
+            ins.source = i;
+            ins.arg = 0;
+            ins.offset = 0;
+            ins.from = 0;
+            ins.by = 0;
+            if (c == '+' || c == '-') {
+                int delta = 0;
+                while (i < (int)code.length() && (code[i] == '+' || code[i] == '-')) {
+                    delta += (code[i] == '+') ? 1 : -1;
+                    i++;
+                }
+                if (cellBits < 32) {
+                    delta %= (1 << cellBits); // 加减次数只需保留模2^cellBits的部分
+                }
+                if (delta != 0) {
+                    ins.op = OP_ADD;
+                    ins.arg = delta;
+                    program.push_back(ins);
+                }
+                continue;
+            }
+            if (c == '>' || c == '<') {
+                int delta = 0;
+                while (i < (int)code.length() && (code[i] == '>' || code[i] == '<')) {
+                    delta += (code[i] == '>') ? 1 : -1;
+                    i++;
+                }
+                if (delta != 0) {
+                    ins.op = OP_MOVE;
+                    ins.arg = delta;
+                    program.push_back(ins);
+                }
+                continue;
+            }
+            switch (c) {
+                case '.': ins.op = OP_OUTPUT; break;
+                case ',': ins.op = OP_INPUT; break;
+                case '[': ins.op = OP_LOOP_START; break;
+                case ']': ins.op = OP_LOOP_END; break;
+                default: i++; continue; // 非指令字符直接忽略
+            }
+            program.push_back(ins);
+            i++;
+        }
+    }
+
+    /*
+     * 预计算循环跳转位置，优化执行性能
+     * 把OP_LOOP_START和OP_LOOP_END之间的相对偏移直接写入指令的arg，
+     * 跳转表随IR一起存放、大小与程序一致，执行时不需要任何查找
+     * 返回值：
+     * - 所有括号都已配对返回true；未配对的括号偏移为0，执行时被忽略
+     */
+    bool precomputeJumps() {
+        std::stack<int> loopStartStack;
+        bool balanced = true;
+        for (int i = 0; i < (int)program.size(); i++) {
+            if (program[i].op == OP_LOOP_START) {
+                program[i].arg = 0;
+                loopStartStack.push(i);
+            } else if (program[i].op == OP_LOOP_END) {
+                program[i].arg = 0;
+                if (loopStartStack.empty()) {
+                    balanced = false;
+                    continue;
+                }
+                int startPos = loopStartStack.top();
+                loopStartStack.pop();
+                program[startPos].arg = i - startPos;
+                program[i].arg = startPos - i;
+            }
+        }
+        return balanced && loopStartStack.empty();
+    }
+
+    /*
+     * 识别常见的循环写法并改写为专用指令，在precomputeJumps()之后调用
+     * 只处理不含嵌套循环和输入输出的最内层循环：
+     * - "[-]"、"[+]"等单条奇数次加减的循环 -> OP_CLEAR
+     * - "[>]"、"[<<]"等只有一次指针移动的循环 -> OP_SCAN
+     * - "[->+>++<<]"等指针净移动为0、当前单元每轮加减1的循环 -> 若干OP_MUL加一条OP_CLEAR
+     * 含嵌套循环的整除取余、比较写法保留原循环，在它之前加上闭式计算的指令（见lowerIdiom()）
+     * 改写后重新计算跳转表
+     */
+    void optimizeLoops() {
+        std::vector<Instruction> optimized;
+        optimized.reserve(program.size());
+        for (int i = 0; i < (int)program.size(); i++) {
+            if (program[i].op == OP_LOOP_START && program[i].arg > 0) {
+                if (lowerLoop(i, i + program[i].arg, optimized)) {
+                    i += program[i].arg; // 跳过整个已改写的循环
+                    continue;
+                }
+                lowerIdiom(i, i + program[i].arg, optimized);
+            }
+            optimized.push_back(program[i]);
+        }
+        program.swap(optimized);
+        precomputeJumps();
+    }
+
+    /*
+     * 尝试把program[start..end]之间的循环改写为专用指令
+     * 参数：
+     * - start/end: 循环开始和结束指令的位置
+     * - out: 改写成功时追加生成的指令
+     * 返回值：
+     * - 能够改写返回true，否则返回false且不修改out
+     */
+    bool lowerLoop(int start, int end, std::vector<Instruction>& out) {
+        Instruction ins;
+        ins.source = program[start].source;
+        ins.arg = 0;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+
+        // 只有一条指令的循环体：清零或扫描
+        if (end - start == 2) {
+            const Instruction& body = program[start + 1];
+            if (body.op == OP_ADD && (body.arg & 1)) {
+                // 奇数步长的加减最终一定会经过0
+                ins.op = OP_CLEAR;
+                out.push_back(ins);
+                return true;
+            }
+            if (body.op == OP_MOVE) {
+                ins.op = OP_SCAN;
+                ins.arg = body.arg;
+                out.push_back(ins);
+                return true;
+            }
+        }
+
+        // 乘法循环：循环体只包含加减和移动，指针净移动为0
+        std::map<int, int> deltas; // 偏移 -> 每轮的增量
+        int position = 0;
+        for (int i = start + 1; i < end; i++) {
+            const Instruction& body = program[i];
+            if (body.op == OP_ADD) {
+                deltas[position] += body.arg;
+            } else if (body.op == OP_MOVE) {
+                position += body.arg;
+            } else {
+                return false;
+            }
+        }
+        unsigned int step = static_cast<unsigned int>(deltas[0]) & cellMask();
+        if (position != 0 || (step != 1 && step != cellMask())) {
+            return false;
+        }
+
+        // 当前单元每轮减1时循环执行value次，每轮加1时执行2^cellBits-value次
+        int sign = (step == cellMask()) ? 1 : -1;
+        for (std::map<int, int>::iterator it = deltas.begin(); it != deltas.end(); ++it) {
+            if (it->first == 0 || (static_cast<unsigned int>(it->second) & cellMask()) == 0) {
+                continue;
+            }
+            ins.op = OP_MUL;
+            ins.offset = it->first;
+            ins.arg = sign * it->second;
+            out.push_back(ins);
+        }
+        ins.op = OP_CLEAR;
+        ins.offset = 0;
+        ins.arg = 0;
+        out.push_back(ins);
+        return true;
+    }
+
+    /*
+     * 识别整除取余、比较这两种固定写法，在optimizeLoops()中遇到不能由lowerLoop()改写的循环时调用
+     * 它们的循环体用"[>+>>]"、"[>]"这类指针停在不同位置的小循环实现分支，不能按乘法循环处理；
+     * 识别成功时在循环之前追加一条闭式计算的指令，原循环保留：闭式计算完成后循环条件单元为0，原循环直接跳过；
+     * 原循环会读到的临时单元不满足写法的前提（不为0）时闭式计算不做任何修改，仍由原循环逐轮执行，结果与逐轮执行一致
+     * 识别的写法（单元为相对循环条件单元的偏移）：
+     * - "[->-[>+>>]>[+[-<+>]>+>>]<<<<<]": 0为被除数，1为除数的倒计数，2、3累计余数和商，4、5为临时单元 -> OP_DIVMOD
+     * - "[->+>-[>+>>]>[+[-<+>]>+>>]<<<<<<]": 同上但整体右移一格，被除数同时累加到1 -> OP_DIVMOD
+     * - "[->-[>]<<]"等（两个单元各减1，第二个单元不为0时扫描到它旁边的0再回到第一个单元）:
+     *   两个单元同时减1直到其中一个为0，循环结束时指针停留的位置表示哪一个先到0 -> OP_COMPARE
+     * 参数：
+     * - start/end: 循环开始和结束指令的位置
+     * - out: 识别成功时追加生成的指令
+     */
+    void lowerIdiom(int start, int end, std::vector<Instruction>& out) {
+        // 整除取余循环中除数倒计数单元之后的部分，MOVE以外的循环指令只比较操作码
+        static const int DIVMOD_BODY[][2] = {
+            { OP_ADD, -1 }, { OP_LOOP_START, 0 }, { OP_MOVE, 1 }, { OP_ADD, 1 }, { OP_MOVE, 2 }, { OP_LOOP_END, 0 },
+            { OP_MOVE, 1 }, { OP_LOOP_START, 0 }, { OP_ADD, 1 }, { OP_LOOP_START, 0 }, { OP_ADD, -1 }, { OP_MOVE, -1 },
+            { OP_ADD, 1 }, { OP_MOVE, 1 }, { OP_LOOP_END, 0 }, { OP_MOVE, 1 }, { OP_ADD, 1 }, { OP_MOVE, 2 },
+            { OP_LOOP_END, 0 }
+        };
+        const int bodyLength = (int)(sizeof(DIVMOD_BODY) / sizeof(DIVMOD_BODY[0]));
+
+        Instruction ins;
+        ins.source = program[start].source;
+        ins.arg = 0;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+        if (!isOp(start + 1, OP_ADD, -1)) {
+            return;
+        }
+
+        // 整除取余：被除数减1，右移一格（另一种写法再给这一格加1并继续右移），然后是DIVMOD_BODY，最后移回被除数
+        int copy = (isOp(start + 2, OP_MOVE, 1) && isOp(start + 3, OP_ADD, 1)) ? 1 : 0;
+        int body = start + 3 + copy * 2;
+        if (end - body == bodyLength + 1 && isOp(start + 2, OP_MOVE, 1) && (copy == 0 || isOp(start + 4, OP_MOVE, 1)) &&
+            isOp(end - 1, OP_MOVE, -5 - copy)) {
+            bool matched = true;
+            for (int i = 0; i < bodyLength && matched; i++) {
+                const Instruction& actual = program[body + i];
+                matched = (actual.op == DIVMOD_BODY[i][0]) &&
+                          (actual.op == OP_LOOP_START || actual.op == OP_LOOP_END || actual.arg == DIVMOD_BODY[i][1]);
+            }
+            if (matched) {
+                ins.op = OP_DIVMOD;
+                ins.from = 1 + copy;
+                out.push_back(ins);
+            }
+            return;
+        }
+
+        // 比较：第一个单元减1，移动d，第二个单元减1，"[移动s]"，移动m回到第一个单元（d + s + m = 0）
+        // 扫描停下的单元d + s和第二个单元为0时停下的单元-s都不能与两个单元重合
+        if (end - start == 8 && program[start + 2].op == OP_MOVE && isOp(start + 3, OP_ADD, -1) &&
+            program[start + 4].op == OP_LOOP_START && program[start + 5].op == OP_MOVE &&
+            program[start + 6].op == OP_LOOP_END && program[end - 1].op == OP_MOVE) {
+            int distance = program[start + 2].arg;
+            int stride = program[start + 5].arg;
+            if (distance + stride + program[end - 1].arg == 0 && -stride != distance) {
+                ins.op = OP_COMPARE;
+                ins.from = distance;
+                ins.arg = stride;
+                out.push_back(ins);
+            }
+        }
+    }
+
+    // program[position]是否为操作数为arg的op指令
+    bool isOp(int position, OpCode op, int arg) const {
+        return position < (int)program.size() && program[position].op == op && program[position].arg == arg;
+    }
+
+    /*
+     * 单元值的仿射表示，用于lowerNestedLoops()：constant + Σ terms[k] * (偏移k处单元在循环体执行前的值)
+     * 系数和常数都按单元宽度取模，系数为0的项不保存
+     */
+    struct Affine {
+        unsigned int constant;
+        std::map<int, unsigned int> terms;
+
+        Affine() : constant(0) {
+        }
+
+        bool operator==(const Affine& other) const {
+            return constant == other.constant && terms == other.terms;
+        }
+    };
+    typedef std::map<int, Affine> AffineState; // 循环体修改过的单元（相对循环条件单元的偏移） -> 执行后的值
+
+    /*
+     * 把只含加减、移动、清零和乘法的循环改写为执行一轮加上闭式计算，在optimizeLoops()之后调用
+     * 这类循环多是内层已经改写为OP_CLEAR/OP_MUL的嵌套循环，例如乘积"[>[->+>+<<]>[-<+>]<<-]"
+     * 原来执行value轮（乘积为value * 内层轮数），改写后为常数时间
+     * 改写后重新计算跳转表
+     */
+    void lowerNestedLoops() {
+        std::vector<Instruction> lowered;
+        lowered.reserve(program.size());
+        for (int i = 0; i < (int)program.size(); i++) {
+            if (program[i].op == OP_LOOP_START && program[i].arg > 0 &&
+                lowerAffineLoop(i, i + program[i].arg, lowered)) {
+                i += program[i].arg;
+                continue;
+            }
+            lowered.push_back(program[i]);
+        }
+        program.swap(lowered);
+        precomputeJumps();
+    }
+
+    /*
+     * 尝试把program[start..end]之间的循环改写为执行一轮加上闭式计算
+     * 把循环体看作各单元上的仿射变换F，要求：
+     * - 循环条件单元每轮加减1，与其他单元无关，因此总轮数由它的初值决定
+     * - 执行第一轮之后，其余被修改的单元每一个都满足以下之一：
+     *   不再变化（F作用于F的任意结果时该单元不变），如乘积中被复制后又还原的单元；
+     *   每轮增加一个固定的量，这个量只取决于不再变化的单元和常数，如乘积的结果单元
+     * 满足时保留循环体作为第一轮，其后追加剩余轮数的闭式计算：
+     * 增量中的每一项生成一条OP_PRODUCT（剩余轮数 × 单元 × 系数）或OP_MUL（剩余轮数 × 常数），最后清零循环条件单元，
+     * 循环只执行一次；剩余轮数就是第一轮之后循环条件单元的值（每轮减1）或它的相反数（每轮加1）
+     * 所有运算都按单元宽度取模，与逐轮执行的回绕结果一致
+     * 参数：
+     * - start/end: 循环开始和结束指令的位置
+     * - out: 改写成功时追加改写后的整个循环
+     * 返回值：
+     * - 能够改写返回true，否则返回false且不修改out
+     */
+    bool lowerAffineLoop(int start, int end, std::vector<Instruction>& out) {
+        const unsigned int mask = cellMask();
+        AffineState state;
+        int position = 0;
+        for (int i = start + 1; i < end; i++) {
+            const Instruction& body = program[i];
+            if (body.op == OP_MOVE) {
+                position += body.arg;
+                continue;
+            }
+            Affine value = affineCell(state, position + body.offset);
+            if (body.op == OP_ADD) {
+                value.constant += static_cast<unsigned int>(body.arg);
+            } else if (body.op == OP_CLEAR) {
+                value = Affine();
+            } else if (body.op == OP_MUL) {
+                addAffine(value, affineCell(state, position + body.from), static_cast<unsigned int>(body.arg));
+            } else {
+                return false;
+            }
+            state[position + body.offset] = normalizeAffine(value);
+        }
+
+        // 循环条件单元每轮加减1
+        AffineState::const_iterator counter = state.find(0);
+        if (position != 0 || counter == state.end() || counter->second.terms.size() != 1 ||
+            counter->second.terms.begin()->first != 0 || counter->second.terms.begin()->second != 1 ||
+            (counter->second.constant != 1 && counter->second.constant != mask)) {
+            return false;
+        }
+        const unsigned int sign = (counter->second.constant == mask) ? 1 : mask; // 剩余轮数 = sign × 循环条件单元
+
+        // 每个单元每轮的增量E(y) = F(y) - y；第一轮之后的取值E(F(x))恒为0的单元不再变化
+        std::set<int> fixed;
+        std::map<int, Affine> deltas;
+        for (AffineState::const_iterator it = state.begin(); it != state.end(); ++it) {
+            if (it->first == 0) {
+                continue;
+            }
+            Affine delta = it->second;
+            delta.terms[it->first] -= 1;
+            normalizeAffine(delta);
+            Affine after = applyAffine(delta, state);
+            if (normalizeAffine(after) == Affine()) {
+                fixed.insert(it->first);
+            } else {
+                deltas[it->first] = delta;
+            }
+        }
+
+        // 其余单元的增量只能含常数和不再变化的单元（没有修改过的单元也不会变化）
+        std::vector<Instruction> tail;
+        Instruction ins;
+        ins.source = program[end].source;
+        ins.from = 0;
+        ins.by = 0;
+        for (std::map<int, Affine>::const_iterator it = deltas.begin(); it != deltas.end(); ++it) {
+            ins.offset = it->first;
+            const Affine& delta = it->second;
+            for (std::map<int, unsigned int>::const_iterator term = delta.terms.begin(); term != delta.terms.end(); ++term) {
+                if (term->first == 0 || (state.count(term->first) != 0 && fixed.count(term->first) == 0)) {
+                    return false;
+                }
+                ins.op = OP_PRODUCT;
+                ins.by = term->first;
+                ins.arg = signedCell(term->second * sign);
+                tail.push_back(ins);
+            }
+            if (delta.constant != 0) {
+                ins.op = OP_MUL;
+                ins.by = 0;
+                ins.arg = signedCell(delta.constant * sign);
+                tail.push_back(ins);
+            }
+        }
+        ins.op = OP_CLEAR;
+        ins.offset = 0;
+        ins.arg = 0;
+        ins.by = 0;
+        tail.push_back(ins);
+
+        // OP_PRODUCT排在前面，OP_MUL和清零紧挨着，与lowerLoop()生成的乘法循环形式相同
+        std::stable_sort(tail.begin(), tail.end(), isProductFirst);
+        out.insert(out.end(), program.begin() + start, program.begin() + end);
+        out.insert(out.end(), tail.begin(), tail.end());
+        out.push_back(program[end]);
+        return true;
+    }
+
+    static bool isProductFirst(const Instruction& a, const Instruction& b) {
+        return a.op == OP_PRODUCT && b.op != OP_PRODUCT;
+    }
+
+    // 偏移cell处单元的当前值，循环体没有修改过时为它的初值
+    static Affine affineCell(const AffineState& state, int cell) {
+        AffineState::const_iterator it = state.find(cell);
+        if (it != state.end()) {
+            return it->second;
+        }
+        Affine value;
+        value.terms[cell] = 1;
+        return value;
+    }
+
+    // target加上value乘以factor
+    static void addAffine(Affine& target, const Affine& value, unsigned int factor) {
+        target.constant += value.constant * factor;
+        for (std::map<int, unsigned int>::const_iterator it = value.terms.begin(); it != value.terms.end(); ++it) {
+            target.terms[it->first] += it->second * factor;
+        }
+    }
+
+    // 把value中的单元换成循环体执行后的值，即value(F(x))
+    static Affine applyAffine(const Affine& value, const AffineState& state) {
+        Affine result;
+        result.constant = value.constant;
+        for (std::map<int, unsigned int>::const_iterator it = value.terms.begin(); it != value.terms.end(); ++it) {
+            addAffine(result, affineCell(state, it->first), it->second);
+        }
+        return result;
+    }
+
+    // 按单元宽度取模并去掉系数为0的项
+    Affine& normalizeAffine(Affine& value) const {
+        const unsigned int mask = cellMask();
+        value.constant &= mask;
+        std::map<int, unsigned int>::iterator it = value.terms.begin();
+        while (it != value.terms.end()) {
+            it->second &= mask;
+            if (it->second == 0) {
+                value.terms.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        return value;
+    }
+
+    // 按单元宽度取模后的值换成有符号数（高位为1时为负），作为指令的arg
+    int signedCell(unsigned int value) const {
+        const unsigned int mask = cellMask();
+        value &= mask;
+        return static_cast<int>(value > (mask >> 1) ? (value | ~mask) : value);
+    }
+
+    /*
+     * 把IR改写为按偏移寻址，在optimizeLoops()和lowerNestedLoops()之后调用
+     * 直线代码中的指针移动不再逐条执行，而是累计为相对于块起点的偏移，写入之后各指令的offset；
+     * 只在扫描循环和比较循环（OP_COMPARE会移动指针）前后、净移动不为0的循环的边界和程序结尾留下一条OP_MOVE
+     * 循环体净移动为0、且不含扫描和这类内层循环的循环整体按偏移寻址，循环条件也检查偏移处的单元，
+     * 进出这样的循环都不需要移动指针
+     * 例如">>+<<-"改写为 OP_ADD(offset 2) OP_ADD(offset 0)，"[->>+<<]>"中的乘法目标直接按偏移2访问
+     */
+    void addressByOffset() {
+        // 第一遍：找出可以整体按偏移寻址的循环
+        std::vector<char> flatLoop(program.size(), 0); // 循环开始和结束位置是否可以按偏移寻址
+        std::vector<int> loopStarts;                    // 尚未结束的各层循环的开始位置
+        std::vector<int> netMoves;                      // 各层循环体中的净移动
+        std::vector<char> flat;                         // 各层循环体是否可以按偏移寻址
+        for (int i = 0; i < (int)program.size(); i++) {
+            const Instruction& ins = program[i];
+            if (ins.op == OP_LOOP_START && ins.arg != 0) {
+                loopStarts.push_back(i);
+                netMoves.push_back(0);
+                flat.push_back(1);
+            } else if (ins.op == OP_LOOP_END && ins.arg != 0) {
+                bool isFlat = flat.back() && netMoves.back() == 0;
+                flatLoop[loopStarts.back()] = flatLoop[i] = isFlat;
+                loopStarts.pop_back();
+                netMoves.pop_back();
+                flat.pop_back();
+                if (!isFlat && !flat.empty()) {
+                    flat.back() = 0;
+                }
+            } else if (ins.op == OP_MOVE && !netMoves.empty()) {
+                netMoves.back() += ins.arg;
+            } else if ((ins.op == OP_SCAN || ins.op == OP_COMPARE) && !flat.empty()) {
+                flat.back() = 0;
+            }
+        }
+
+        // 第二遍：累计指针移动，在必须移动指针的位置才生成OP_MOVE
+        std::vector<Instruction> addressed;
+        addressed.reserve(program.size());
+        int pending = 0; // 尚未执行的指针移动，即当前块起点到逻辑指针的偏移
+        for (int i = 0; i < (int)program.size(); i++) {
+            Instruction ins = program[i];
+            switch (ins.op) {
+                case OP_MOVE:
+                    pending += ins.arg;
+                    continue;
+                case OP_LOOP_START:
+                case OP_LOOP_END:
+                    if (ins.arg != 0 && !flatLoop[i]) {
+                        flushMove(addressed, pending, ins.source);
+                    }
+                    ins.offset = pending;
+                    break;
+                case OP_SCAN:
+                case OP_COMPARE:
+                    flushMove(addressed, pending, ins.source);
+                    break;
+                case OP_PRODUCT:
+                    ins.by += pending;
+                    ins.from += pending;
+                    ins.offset += pending;
+                    break;
+                case OP_MUL:
+                case OP_DIVMOD:
+                    ins.from += pending;
+                    ins.offset += pending;
+                    break;
+                default:
+                    ins.offset += pending;
+                    break;
+            }
+            addressed.push_back(ins);
+        }
+        flushMove(addressed, pending, (int)code.length());
+        program.swap(addressed);
+        precomputeJumps();
+    }
+
+    // 执行累计的指针移动：追加一条OP_MOVE并清零pending
+    static void flushMove(std::vector<Instruction>& out, int& pending, int source) {
+        if (pending == 0) {
+            return;
+        }
+        Instruction ins;
+        ins.op = OP_MOVE;
+        ins.arg = pending;
+        ins.offset = 0;
+        ins.from = 0;
+        ins.by = 0;
+        ins.source = source;
+        out.push_back(ins);
+        pending = 0;
+    }
+
+    /*
+     * 指针范围分析，在addressByOffset()之后调用，结果存入loopRanges和programRange
+     * 沿循环的嵌套结构做抽象解释：直线代码中指针的位置是确定的，每条指令访问的单元为指针加上指令中的偏移；
+     * 净移动为0、内层循环都有界的循环，无论执行多少轮，访问的单元都不超出一轮的范围，在外层中就是一段确定的范围；
+     * 扫描、比较和净移动不为0的循环每轮停在不同的位置，所在的各层都无界
+     * 回绕模式下整个程序都在磁带之内时不需要回绕运算（见needsWrap()），否则分层执行和生成的C代码在有界循环的入口检查一次，
+     * 整个循环都在磁带之内时不做回绕运算（见interpretTiered()、generateSource()）
+     */
+    void analyzePointerRange() {
+        PointerRange empty;
+        empty.bounded = true;
+        empty.low = 0;
+        empty.high = 0;
+        loopRanges.assign(program.size(), empty);
+
+        std::vector<PointerRange> ranges(1, empty); // 各层已分析部分的范围，第0层为整个程序
+        std::vector<int> loopStarts;                // 尚未结束的各层循环的开始位置
+        std::vector<int> entryShifts;               // 进入各层循环时指针在外一层中的位置
+        int shift = 0;                              // 指针相对最内层起点的位置
+        for (int i = 0; i < (int)program.size(); i++) {
+            const Instruction& ins = program[i];
+            switch (ins.op) {
+                case OP_MOVE:
+                    shift += ins.arg;
+                    includeRange(ranges.back(), shift, shift);
+                    break;
+                case OP_LOOP_START:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    if (ins.arg != 0) { // 未配对的括号被忽略
+                        loopStarts.push_back(i);
+                        entryShifts.push_back(shift);
+                        ranges.push_back(empty);
+                        shift = 0;
+                        includeRange(ranges.back(), ins.offset, ins.offset);
+                    }
+                    break;
+                case OP_LOOP_END:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    if (ins.arg != 0) {
+                        PointerRange loop = ranges.back();
+                        loop.bounded = loop.bounded && shift == 0;
+                        loopRanges[loopStarts.back()] = loop;
+                        ranges.pop_back();
+                        loopStarts.pop_back();
+                        shift = entryShifts.back();
+                        entryShifts.pop_back();
+                        if (loop.bounded) {
+                            includeRange(ranges.back(), shift + loop.low, shift + loop.high);
+                        } else {
+                            ranges.back().bounded = false;
+                        }
+                    }
+                    break;
+                case OP_SCAN:
+                case OP_COMPARE:
+                    ranges.back().bounded = false;
+                    break;
+                case OP_MUL:
+                    includeRange(ranges.back(), shift + std::min(ins.offset, ins.from), shift + std::max(ins.offset, ins.from));
+                    break;
+                case OP_PRODUCT:
+                    includeRange(ranges.back(), shift + std::min(ins.offset, std::min(ins.from, ins.by)),
+                                 shift + std::max(ins.offset, std::max(ins.from, ins.by)));
+                    break;
+                case OP_DIVMOD: // 访问的单元见divmodCells()
+                    includeRange(ranges.back(), shift + std::min(ins.offset, ins.from), shift + std::max(ins.offset + 1, ins.from + 4));
+                    break;
+                default:
+                    includeRange(ranges.back(), shift + ins.offset, shift + ins.offset);
+                    break;
+            }
+        }
+        programRange = ranges.front();
+    }
+
+    // 把[low, high]并入range
+    static void includeRange(PointerRange& range, int low, int high) {
+        range.low = std::min(range.low, low);
+        range.high = std::max(range.high, high);
+    }
+
+    /*
+     * 执行时指针是否需要回绕运算：回绕模式下，指针范围分析（见analyzePointerRange()）不能证明整个程序都在磁带之内
+     * 为false时回绕模式与不回绕的执行结果相同，解释器选用不检查边界的实例，JIT和生成的代码也不做回绕运算
+     */
+    bool needsWrap() const {
+        if (pointerMode != POINTER_WRAP) {
+            return false;
+        }
+        return !programRange.bounded || programRange.low < 0 || programRange.high >= getTapeSize();
+    }
+
+    /*
+     * 指针为pointer时进入start处的循环，整个循环执行期间是否都在磁带之内（循环无界时为false）
+     */
+    bool loopInside(int start, int pointer) const {
+        const PointerRange& range = loopRanges[start];
+        return range.bounded && pointer + range.low >= 0 && pointer + range.high < tapeCells;
+    }
+
+    /*
+     * 加载时的预先执行，在addressByOffset()之后调用
+     * 从头执行IR，直到第一条OP_INPUT、执行结束或执行了prefixBudget条指令为止；这一段与输入无关，
+     * 期间的输出存入prefixOutput，磁带和指针即为实际执行的起点，interpret()、jit()和generateSource()都从这里开始
+     * prefixBudget为0时不预先执行，起点为程序开头
+     */
+    void evaluatePrefix() {
+        prefixOutput.clear();
+        prefixCells.clear();
+        prefixPointer = 0;
+        prefixInstruction = 0;
+        if (prefixBudget > 0) {
+            if (cellBits == 16) {
+                evaluatePrefixWith<unsigned short>();
+            } else if (cellBits == 32) {
+                evaluatePrefixWith<unsigned int>();
+            } else {
+                evaluatePrefixWith<unsigned char>();
+            }
+        }
+        prefixPending = !prefixOutput.empty();
+        memoryPointer = prefixPointer;
+        instructionPointer = prefixInstruction;
+    }
+
+    /*
+     * 按单元类型Cell预先执行，直接修改磁带
+     * 访问或移动到[0, tapeCells)之外时在该指令之前停止，留给实际执行按指针越界方式处理，
+     * 因此结果与指针越界方式无关，也不会触发保护页
+     * lowerLoop()生成的一组OP_MUL连同其后清零计数单元的OP_CLEAR整体执行，不会停在中间（generateSource()整组生成这些指令）
+     */
+    template <typename Cell>
+    void evaluatePrefixWith() {
+        typedef Policy<Cell, POINTER_ERROR, InputSource::EOF_UNCHANGED> P; // 只访问磁带之内的单元，指针移动不需要处理
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        const int count = (int)program.size();
+        long long steps = 0;
+        int pointer = 0;
+        int ip = 0;
+        bool stopped = false;
+        while (!stopped && ip < count && steps < prefixBudget) {
+            const Instruction& ins = program[ip];
+            const int cell = pointer + ins.offset;
+            if (ins.op == OP_INPUT || !isTapeCell(cell)) {
+                break;
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    cells[cell] += ins.arg;
+                    break;
+                case OP_MOVE:
+                    if (!isTapeCell(pointer + ins.arg)) {
+                        stopped = true;
+                        continue;
+                    }
+                    pointer += ins.arg;
+                    break;
+                case OP_OUTPUT:
+                    prefixOutput += static_cast<char>(cells[cell]);
+                    break;
+                case OP_LOOP_START:
+                    if (cells[cell] == 0) {
+                        ip += ins.arg;
+                    }
+                    break;
+                case OP_LOOP_END:
+                    if (cells[cell] != 0) {
+                        ip += ins.arg;
+                    }
+                    break;
+                case OP_CLEAR:
+                    cells[cell] = 0;
+                    break;
+                case OP_MUL: {
+                    int last = mulGroupEnd(ip);
+                    for (int i = ip; i <= last && !stopped; i++) {
+                        stopped = !isTapeCell(pointer + program[i].offset) || !isTapeCell(pointer + program[i].from);
+                    }
+                    if (stopped) {
+                        continue;
+                    }
+                    Cell counter = cells[pointer + ins.from];
+                    for (int i = ip; i <= last; i++) {
+                        if (program[i].op == OP_CLEAR) {
+                            cells[pointer + program[i].offset] = 0;
+                        } else if (counter != 0) {
+                            cells[pointer + program[i].offset] += counter * program[i].arg;
+                        }
+                    }
+                    steps += last - ip;
+                    ip = last;
+                    break;
+                }
+                case OP_PRODUCT:
+                    if (!isTapeCell(pointer + ins.from) || !isTapeCell(pointer + ins.by)) {
+                        stopped = true;
+                        continue;
+                    }
+                    executeProduct<P>(cells, pointer, ins.offset, ins.from, ins.by, ins.arg);
+                    break;
+                case OP_DIVMOD:
+                    for (int i = std::min(ins.offset, ins.from); i <= ins.from + 4 && !stopped; i++) {
+                        stopped = !isTapeCell(pointer + i);
+                    }
+                    if (stopped) {
+                        continue;
+                    }
+                    divmodCells<P>(cells, pointer, ins.offset, ins.from);
+                    break;
+                case OP_COMPARE:
+                    if (!isTapeCell(pointer + ins.from) || !isTapeCell(pointer + ins.from + ins.arg) ||
+                        !isTapeCell(pointer - ins.arg)) {
+                        stopped = true;
+                        continue;
+                    }
+                    pointer = compareCells<P>(cells, pointer, ins.from, ins.arg);
+                    break;
+                case OP_SCAN:
+                    // 停在扫描中途时，从当前位置继续扫描结果相同
+                    while (cells[pointer] != 0 && !stopped) {
+                        stopped = !isTapeCell(pointer + ins.arg);
+                        if (!stopped) {
+                            pointer += ins.arg;
+                            steps++;
+                        }
+                    }
+                    if (stopped) {
+                        continue;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            ip++;
+            steps++;
+        }
+
+        prefixPointer = pointer;
+        prefixInstruction = ip;
+        int used = tapeCells;
+        while (used > 0 && cells[used - 1] == 0) {
+            used--;
+        }
+        prefixCells.assign(cells, cells + used);
+    }
+
+    // index是否在预先执行可以访问的范围[0, tapeCells)之内
+    bool isTapeCell(int index) const {
+        return index >= 0 && index < tapeCells;
+    }
+
+    /*
+     * 从start处的OP_MUL开始、读取同一计数单元的一组乘法指令的最后一条位置
+     * 紧随其后清零计数单元的OP_CLEAR也算在组内
+     */
+    int mulGroupEnd(int start) const {
+        const int from = program[start].from;
+        int last = start;
+        while (last + 1 < (int)program.size() && program[last + 1].op == OP_MUL && program[last + 1].from == from) {
+            last++;
+        }
+        if (last + 1 < (int)program.size() && program[last + 1].op == OP_CLEAR && program[last + 1].offset == from) {
+            last++;
+        }
+        return last;
+    }
+
+    // 执行开始前写出预先执行产生的输出
+    void writePrefixOutput() {
+        if (prefixPending) {
+            output.write(prefixOutput.data(), (int)prefixOutput.size());
+            prefixPending = false;
+        }
+    }
+
+    /*
+     * 根据单元宽度和已加载的代码重置磁带，并更新memory
+     * 一条指令最多使指针跨越与代码长度相同的单元数，保护区不小于这段距离即可保证越界访问一定落在保护区内
+     */
+    void prepareTape() {
+        tape.reset(static_cast<size_t>(tapeCells) * cellBytes());
+        tape.ensureGuard(code.length() * cellBytes());
+        memory = tape.cells();
+    }
+
+    // 每个单元占用的字节数
+    int cellBytes() const {
+        return cellBits / 8;
+    }
+
+    // 单元的取值掩码（8位为0xFF）
+    unsigned int cellMask() const {
+        return (cellBits == 32) ? 0xFFFFFFFFu : ((1u << cellBits) - 1);
+    }
+
+    /*
+     * 过滤后代码中position处的字符所属的IR指令位置：源位置不超过position的最后一条指令，
+     * 同一源位置对应多条指令时（如改写后的循环）取其中第一条；position在第一条指令之前时为0
+     */
+    int instructionAt(int position) const {
+        int low = 0, high = (int)program.size(); // 第一条源位置大于position的指令在[low, high]中
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if ((int)program[middle].source <= position) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        int index = std::max(low - 1, 0);
+        while (index > 0 && program[index - 1].source == program[index].source) {
+            index--;
+        }
+        return index;
+    }
+
+    // 按breakpoints重新标记breakFlags，加载代码或修改断点后调用；不改变stoppedAt，停下时修改断点后继续执行仍从停下的指令往后走
+    void markBreakpoints() {
+        breakFlags.assign(program.size() + 1, 0);
+        threadedHandlers = NULL;
+        for (int i = 0; i < (int)breakpoints.size() && !program.empty(); i++) {
+            breakFlags[instructionAt(breakpoints[i].position)] = 1;
+        }
+    }
+
+    /*
+     * 检查第index条指令上的断点，返回第一个条件成立的断点在breakpoints中的下标，都不成立时返回-1
+     */
+    int matchBreakpoint(int index) const {
+        for (int i = 0; i < (int)breakpoints.size(); i++) {
+            const Breakpoint& point = breakpoints[i];
+            if (instructionAt(point.position) != index) {
+                continue;
+            }
+            if (point.condition == BREAK_ALWAYS) {
+                return i;
+            }
+            const int cell = (point.cell >= 0) ? point.cell : memoryPointer + program[index].offset;
+            if (cell < 0 || cell >= accessibleCells()) {
+                continue;
+            }
+            const unsigned int value = cellAt(cell);
+            if ((point.condition == BREAK_EQUAL && value == point.value) ||
+                (point.condition == BREAK_NOT_EQUAL && value != point.value) ||
+                (point.condition == BREAK_LESS && value < point.value) ||
+                (point.condition == BREAK_GREATER && value > point.value)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // 操作码是否会写单元，改变类的观察点只在这些指令之后检查
+    static bool writesCells(int op) {
+        return op != OP_MOVE && op != OP_OUTPUT && op != OP_LOOP_START && op != OP_LOOP_END && op != OP_SCAN;
+    }
+
+    // 观察点的单元当前的值，不在磁带之内时为0
+    unsigned int watchedValue(int cell) const {
+        return (cell >= 0 && cell < accessibleCells()) ? cellAt(cell) : 0;
+    }
+
+    // 记录各观察点的单元当前的值，此后的改变才会命中
+    void refreshWatchValues() {
+        watchValues.resize(watchpoints.size());
+        for (int i = 0; i < (int)watchpoints.size(); i++) {
+            watchValues[i] = watchedValue(watchpoints[i].cell);
+        }
+    }
+
+    /*
+     * 检查WATCH_CHANGE/WATCH_EQUAL观察点的单元是否改变，同时更新watchValues
+     * 返回值：
+     * - 第一个命中的观察点在watchpoints中的下标，都没有命中时返回-1
+     */
+    int matchWatchChange() {
+        int hit = -1;
+        for (int i = 0; i < (int)watchpoints.size(); i++) {
+            const Watchpoint& point = watchpoints[i];
+            if (point.kind == WATCH_OUTPUT) {
+                continue;
+            }
+            const unsigned int value = watchedValue(point.cell);
+            if (value == watchValues[i]) {
+                continue;
+            }
+            watchValues[i] = value;
+            if (hit < 0 && (point.kind == WATCH_CHANGE || value == point.value)) {
+                hit = i;
+            }
+        }
+        return hit;
+    }
+
+    /*
+     * 第index条指令是'.'且输出的单元上有WATCH_OUTPUT观察点时，返回这个观察点在watchpoints中的下标，否则返回-1
+     */
+    int matchWatchOutput(int index) const {
+        if (program[index].op != OP_OUTPUT) {
+            return -1;
+        }
+        int cell = memoryPointer + program[index].offset;
+        if (pointerMode == POINTER_WRAP) {
+            cell = ((cell % tapeCells) + tapeCells) % tapeCells;
+        }
+        for (int i = 0; i < (int)watchpoints.size(); i++) {
+            if (watchpoints[i].kind == WATCH_OUTPUT && watchpoints[i].cell == cell) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // 保存当前状态为检查点，数量或大小超过上限时丢弃一半
+    void saveCheckpoint() {
+        Checkpoint point;
+        point.executed = executed;
+        point.instructionPointer = instructionPointer;
+        point.memoryPointer = memoryPointer;
+        point.inputCursor = input.getCursor();
+        size_t bytes = static_cast<size_t>(accessibleCells()) * cellBytes();
+        while (bytes > 0 && memory[bytes - 1] == 0) {
+            bytes--;
+        }
+        point.cells.assign(memory, memory + bytes);
+        checkpoints.push_back(point);
+        historyBytes += bytes;
+        if ((int)checkpoints.size() > HISTORY_CHECKPOINTS || historyBytes > HISTORY_BYTES) {
+            thinCheckpoints();
+        }
+    }
+
+    /*
+     * 保留第一个检查点和之后每隔一个的检查点，间隔加倍
+     * 记录越长检查点越稀疏，占用的内存保持在上限之内，倒退时需要重新执行的指令数随之增加
+     */
+    void thinCheckpoints() {
+        size_t kept = 1;
+        historyBytes = checkpoints[0].cells.size();
+        for (size_t i = 2; i < checkpoints.size(); i += 2) {
+            Checkpoint& point = checkpoints[kept++];
+            point.executed = checkpoints[i].executed;
+            point.instructionPointer = checkpoints[i].instructionPointer;
+            point.memoryPointer = checkpoints[i].memoryPointer;
+            point.inputCursor = checkpoints[i].inputCursor;
+            point.cells.swap(checkpoints[i].cells);
+            historyBytes += point.cells.size();
+        }
+        checkpoints.resize(kept);
+        historyInterval *= 2;
+    }
+
+    // 开启历史记录时每执行一条指令后调用：计数，离上一个检查点达到间隔时保存检查点
+    void recordInstruction() {
+        executed++;
+        if (executed - checkpoints.back().executed >= historyInterval) {
+            saveCheckpoint();
+        }
+    }
+
+    // 从当前状态开始重新记录历史，加载代码或回到起点后调用
+    void resetHistory() {
+        checkpoints.clear();
+        historyBytes = 0;
+        historyInterval = HISTORY_INTERVAL;
+        executed = 0;
+        input.setRecording(history);
+        if (history) {
+            saveCheckpoint();
+        }
+    }
+
+    // 恢复第index个检查点的状态
+    void restoreCheckpoint(int index) {
+        const Checkpoint& point = checkpoints[index];
+        memset(memory, 0, static_cast<size_t>(accessibleCells()) * cellBytes());
+        if (!point.cells.empty()) {
+            memcpy(memory, &point.cells[0], point.cells.size());
+        }
+        executed = point.executed;
+        instructionPointer = point.instructionPointer;
+        memoryPointer = point.memoryPointer;
+        input.rewind(point.inputCursor);
+    }
+
+    // executed不超过target的最后一个检查点
+    int checkpointBefore(long long target) const {
+        int index = (int)checkpoints.size() - 1;
+        while (index > 0 && checkpoints[index].executed > target) {
+            index--;
+        }
+        return index;
+    }
+
+    // 按当前单元宽度读取第index个单元的值，用于调试输出
+    unsigned int cellAt(int index) const {
+        if (cellBits == 16) {
+            return reinterpret_cast<const unsigned short*>(memory)[index];
+        }
+        if (cellBits == 32) {
+            return reinterpret_cast<const unsigned int*>(memory)[index];
+        }
+        return static_cast<unsigned char>(memory[index]);
+    }
+
+    // 按当前单元宽度写入第index个单元
+    void setCellAt(int index, unsigned int value) {
+        if (cellBits == 16) {
+            reinterpret_cast<unsigned short*>(memory)[index] = static_cast<unsigned short>(value);
+        } else if (cellBits == 32) {
+            reinterpret_cast<unsigned int*>(memory)[index] = value;
+        } else {
+            memory[index] = static_cast<char>(value);
+        }
+    }
+
+    /*
+     * 执行结束后检查内存指针
+     * 报错模式下结尾的移动之后没有再访问单元，需要单独检查指针是否仍在磁带之内
+     */
+    bool pointerInRange() const {
+        return pointerMode != POINTER_ERROR || (memoryPointer >= 0 && memoryPointer < tapeCells);
+    }
+
+    // 当前可以访问的单元数：扩展模式下为已分配的单元数，其他模式下等于tapeCells
+    int accessibleCells() const {
+        return (pointerMode == POINTER_GROW) ? tape.size() / cellBytes() : tapeCells;
+    }
+
+    /*
+     * 执行策略 - 单元宽度、指针越界方式和EOF处理方式作为模板参数
+     * 每种组合都单独实例化一份解释器（见selectEngine()），策略中的判断都是编译期常量，
+     * 不使用的语义不会出现在生成的代码中
+     * 参数：
+     * - CellType: 单元类型（unsigned char、unsigned short或unsigned int）
+     * - Pointer: PointerMode
+     * - Eof: InputSource::EofMode
+     */
+    template <typename CellType, int Pointer, int Eof>
+    struct Policy {
+        typedef CellType Cell;
+
+        // 指针是否回绕
+        static bool wraps() {
+            return Pointer == POINTER_WRAP;
+        }
+
+        /*
+         * 指针从pointer移动delta个单元后的位置
+         * 回绕模式下结果在[0, size)之内；其他模式不做检查，访问单元时由at()和磁带的保护页处理越界
+         */
+        static int move(int pointer, int delta, int size) {
+            pointer += delta;
+            if (wraps() && static_cast<unsigned int>(pointer) >= static_cast<unsigned int>(size)) {
+                pointer %= size;
+                if (pointer < 0) {
+                    pointer += size;
+                }
+            }
+            return pointer;
+        }
+
+        /*
+         * 指令访问的单元：指针pointer偏移offset处的下标
+         * 报错模式下磁带按页分配，最后一个单元之后到页末的部分仍可读写，越过size时返回-1，
+         * 访问第0个单元左侧的保护区，与其他越界一样报告
+         */
+        static int at(int pointer, int offset, int size) {
+            pointer = move(pointer, offset, size);
+            if (Pointer == POINTER_ERROR && static_cast<unsigned int>(pointer) >= static_cast<unsigned int>(size)) {
+                return -1;
+            }
+            return pointer;
+        }
+
+        /*
+         * 执行一次','：读入一个字节写入cell，输入结束时按Eof处理
+         */
+        static void read(InputSource& input, Cell& cell) {
+            int c = input.get();
+            if (c >= 0) {
+                cell = static_cast<Cell>(c);
+            } else if (Eof == InputSource::EOF_ZERO) {
+                cell = 0;
+            } else if (Eof == InputSource::EOF_MINUS_ONE) {
+                cell = static_cast<Cell>(-1);
+            }
+        }
+    };
+
+    /*
+     * 扫描循环：从pointer开始按stride移动指针，直到遇到值为0的单元
+     * 8位单元使用CellScanner整块查找，更宽的单元逐个检查
+     * 非回绕模式下越过磁带末端时访问保护页，与其他指令一样扩展磁带或报告越界
+     */
+    template <class P>
+    int scanCells(typename P::Cell* cells, int pointer, int stride) {
+        if (sizeof(typename P::Cell) == 1) {
+            if (P::wraps()) {
+                return CellScanner::findZeroWrapped(reinterpret_cast<unsigned char*>(cells), tapeCells, pointer, stride);
+            }
+            return tape.scan(pointer, stride, accessibleCells());
+        }
+        while (cells[P::at(pointer, 0, tapeCells)] != 0) {
+            pointer = P::move(pointer, stride, tapeCells);
+        }
+        return pointer;
+    }
+
+    /*
+     * 执行一条IR指令，循环跳转按指令中的相对偏移修改instructionPointer
+     * 供interpret()（switch分派）和step()共用
+     */
+    template <class P>
+    void executeInstruction(const Instruction& ins) {
+        typedef typename P::Cell Cell;
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        Cell& cell = cells[P::at(memoryPointer, ins.offset, tapeCells)]; // 指令访问的单元
+        switch (ins.op) {
+            case OP_ADD: // 增加或减少内存值
+                cell += ins.arg;
+                break;
+            case OP_MOVE: // 内存指针移动，回绕模式之外越界由磁带的保护页检测
+                memoryPointer = P::move(memoryPointer, ins.arg, tapeCells);
+                break;
+            case OP_OUTPUT: // 输出内存值（宽单元只输出低8位）
+                output.put(static_cast<char>(cell));
+                break;
+            case OP_INPUT: // 输入值到内存
+                if (input.needsRefill()) {
+                    output.flush();
+                }
+                P::read(input, cell);
+                break;
+            case OP_LOOP_START: // 循环开始
+                if (cell == 0) {
+                    // 如果当前内存值为0，跳转到对应的循环结束
+                    instructionPointer += ins.arg;
+                }
+                break;
+            case OP_LOOP_END: // 循环结束
+                if (cell != 0) {
+                    // 如果当前内存值不为0，跳转到对应的循环开始
+                    instructionPointer += ins.arg;
+                }
+                break;
+            case OP_CLEAR: // 清零循环
+                cell = 0;
+                break;
+            case OP_MUL: { // 乘法循环中的一个目标单元
+                Cell counter = cells[P::at(memoryPointer, ins.from, tapeCells)];
+                if (counter != 0) {
+                    cell += counter * ins.arg;
+                }
+                break;
+            }
+            case OP_SCAN: // 扫描循环：移动到第一个值为0的单元
+                if (cells[P::at(memoryPointer, 0, tapeCells)] != 0) {
+                    memoryPointer = scanCells<P>(cells, memoryPointer, ins.arg);
+                }
+                break;
+            case OP_PRODUCT: // 嵌套循环剩余各轮的累加
+                executeProduct<P>(cells, memoryPointer, ins.offset, ins.from, ins.by, ins.arg);
+                break;
+            case OP_DIVMOD: // 整除取余循环的闭式计算
+                divmodCells<P>(cells, memoryPointer, ins.offset, ins.from);
+                break;
+            case OP_COMPARE: // 比较循环的闭式计算
+                memoryPointer = compareCells<P>(cells, memoryPointer, ins.from, ins.arg);
+                break;
+        }
+    }
+
+    /*
+     * 执行一条OP_PRODUCT：偏移offset处的单元加上from、by两处单元之积乘以arg
+     * 与OP_MUL一样，from处的单元（剩余轮数）为0时不访问其他单元
+     */
+    template <class P>
+    void executeProduct(typename P::Cell* cells, int pointer, int offset, int from, int by, int arg) {
+        typedef typename P::Cell Cell;
+        Cell counter = cells[P::at(pointer, from, tapeCells)];
+        if (counter != 0) {
+            unsigned int product = static_cast<unsigned int>(counter) * cells[P::at(pointer, by, tapeCells)];
+            cells[P::at(pointer, offset, tapeCells)] += static_cast<Cell>(product * static_cast<unsigned int>(arg));
+        }
+    }
+
+    /*
+     * OP_DIVMOD的闭式计算，单元均为相对pointer的偏移（写法见lowerIdiom()）：
+     * - offset: 被除数n，即循环条件单元，循环执行n轮；from为offset + 2时n同时累加到offset + 1
+     * - from: 除数的倒计数c；from + 1、from + 2: 累计的余数r和商q；from + 3、from + 4: 临时单元，原循环要求为0
+     * 每轮c减1、r加1，c减到0时c恢复为c + r、r清零、q加1；c + r在各轮之间不变，即除数d（为0时相当于2^cellBits）
+     * 原循环会读到的临时单元不为0、或者d为1（重置时r为0，原循环的分支走偏）时不做任何修改，由其后的原循环执行
+     */
+    template <class P>
+    void divmodCells(typename P::Cell* cells, int pointer, int offset, int from) {
+        typedef typename P::Cell Cell;
+        Cell& dividend = cells[P::at(pointer, offset, tapeCells)];
+        const unsigned long long count = dividend;
+        if (count == 0 || cells[P::at(pointer, from + 4, tapeCells)] != 0) {
+            return;
+        }
+        const unsigned long long size = static_cast<unsigned long long>(cellMask()) + 1;
+        Cell& countdown = cells[P::at(pointer, from, tapeCells)];
+        Cell& remainder = cells[P::at(pointer, from + 1, tapeCells)];
+        const Cell sum = static_cast<Cell>(countdown + remainder);
+        const unsigned long long divisor = (sum != 0) ? sum : size;
+        const unsigned long long first = (countdown != 0) ? countdown : size; // 第一次重置c所在的轮
+        unsigned long long resets = 0;                                         // 重置c的次数，即商的增量
+        if (count >= first) {
+            resets = 1 + (count - first) / divisor;
+        }
+        // 没有重置的轮会读from + 3处的单元
+        if ((resets > 0 && divisor == 1) || (resets < count && cells[P::at(pointer, from + 3, tapeCells)] != 0)) {
+            return;
+        }
+        if (resets > 0) {
+            const unsigned long long rest = (count - first) % divisor;
+            countdown = static_cast<Cell>(divisor - rest);
+            remainder = static_cast<Cell>(rest);
+            cells[P::at(pointer, from + 2, tapeCells)] += static_cast<Cell>(resets);
+        } else {
+            countdown -= static_cast<Cell>(count);
+            remainder += static_cast<Cell>(count);
+        }
+        if (from == offset + 2) {
+            cells[P::at(pointer, offset + 1, tapeCells)] += static_cast<Cell>(count);
+        }
+        dividend = 0;
+    }
+
+    /*
+     * OP_COMPARE的闭式计算，返回执行后的内存指针（写法见lowerIdiom()）
+     * pointer处的单元x和偏移from处的单元y每轮各减1：y不为0时扫描停在from + stride处（原循环要求为0），回到x，
+     * x为0时循环结束；y为0时指针停在-stride处（原循环要求为0），循环在那里结束
+     * 原循环会读到的这两个单元不为0时不做任何修改，由其后的原循环执行
+     */
+    template <class P>
+    int compareCells(typename P::Cell* cells, int pointer, int from, int stride) {
+        typedef typename P::Cell Cell;
+        Cell& left = cells[P::at(pointer, 0, tapeCells)];
+        if (left == 0) {
+            return pointer;
+        }
+        Cell& right = cells[P::at(pointer, from, tapeCells)];
+        const unsigned long long rounds = (right != 0) ? right : static_cast<unsigned long long>(cellMask()) + 1; // y减到0的轮数
+        if (rounds <= left) {
+            const int exit = P::move(pointer, -stride, tapeCells);
+            if ((rounds > 1 && cells[P::at(pointer, from + stride, tapeCells)] != 0) || cells[P::at(exit, 0, tapeCells)] != 0) {
+                return pointer;
+            }
+            left -= static_cast<Cell>(rounds);
+            right = 0;
+            return exit;
+        }
+        if (cells[P::at(pointer, from + stride, tapeCells)] != 0) {
+            return pointer;
+        }
+        right -= left;
+        left = 0;
+        return pointer;
+    }
+
+    /*
+     * 紧凑编码中一条指令的操作数
+     * - arg: 次数、乘数、扫描步长或循环跳转的相对偏移
+     * - offset/from/by: 与Instruction相同，限制在16位之内
+     */
+    struct PackedOperands {
+        int arg;
+        short offset;
+        short from;
+        short by;
+    };
+
+    /*
+     * 紧凑的指令编码，由packProgram()在加载时生成，供直接线索化解释器执行
+     * 操作码和操作数分别放在两个平行数组中，每条指令共13字节（Instruction为24字节），
+     * 执行时再换算为16字节的ThreadedInstruction（原先预解码的指令为40字节），常见程序的整个热循环都能放进L1缓存
+     * 操作数不再继续拆成各自的数组：解释器中跨越回调仍然有效的寄存器只有6个，每多一个数组基址就要多一次栈上读取
+     * - codes: 处理代码编号，小于OP_KINDS时即OpCode，之后依次为超级指令（见packProgram()），最后一项为程序结束
+     * - operands: 各指令的操作数
+     */
+    struct PackedProgram {
+        std::vector<unsigned char> codes;
+        std::vector<PackedOperands> operands;
+    };
+    PackedProgram packed; // 为空时（偏移超出16位）退回switch分派
+
+    /*
+     * 直接线索化解释器执行时使用的指令，由packed中的编号换算出处理代码的地址，共16字节
+     * 分派只需一次读取；查编号表的两次读取在基准程序上慢约三分之一
+     * - handler: 该指令处理代码的标签地址
+     * - arg/offset/from: 与PackedOperands相同，by只有OP_PRODUCT用到，直接从packed读取
+     */
+    struct ThreadedInstruction {
+        const void* handler;
+        int arg;
+        short offset;
+        short from;
+    };
+
+    /*
+     * interpretThreaded()由packed换算出的指令，在多次执行之间复用
+     * 换算用到处理代码的标签地址，只能在interpretThreaded()中进行；packProgram()和markBreakpoints()之后、
+     * 或者换了策略P（处理代码表不同）或停止标记时重新换算
+     * 指针越界时执行从interpretThreaded()中直接跳回，它的栈帧中不能有需要析构的局部变量，所以放在这里
+     * - threadedHandlers: threaded按哪个处理代码表换算，为NULL时需要重新换算
+     * - threadedStops: threaded按哪个停止标记换算
+     */
+    std::vector<ThreadedInstruction> threaded;
+    const void* const* threadedHandlers;
+    const char* threadedStops;
+
+    /*
+     * 把IR编码为packed，同时把常见的指令序列合并为超级指令：只替换序列第一条的编号，其余指令不变，
+     * 循环跳转到序列中间时仍按单条指令执行
+     * 超级指令按setProfiling()在语料库上统计的结果挑选（每行即writeProfile()的输出去掉次数），按顺序匹配，较长的在前，
+     * 编号依次为OP_KINDS、OP_KINDS + 1……，与interpretThreaded()中处理代码的顺序一致
+     */
+    void packProgram() {
+        static const int fused[][3] = {
+            { OP_ADD, OP_MOVE, OP_LOOP_END },   // op_add_move_end
+            { OP_ADD, OP_ADD, OP_ADD },         // op_add_add_add
+            { OP_ADD, OP_MOVE, -1 },            // op_add_move
+            { OP_MOVE, OP_LOOP_END, -1 },       // op_move_end
+            { OP_ADD, OP_ADD, -1 },             // op_add_add
+            { OP_MUL, OP_CLEAR, -1 },           // op_multiply_clear
+            { OP_ADD, OP_MUL, -1 },             // op_add_multiply
+            { OP_CLEAR, OP_LOOP_END, -1 },      // op_clear_end
+            { OP_CLEAR, OP_CLEAR, -1 },         // op_clear_clear
+            { OP_CLEAR, OP_ADD, -1 }            // op_clear_add
+        };
+        const int fusedCount = (int)(sizeof(fused) / sizeof(fused[0]));
+        const int count = (int)program.size();
+
+        const PackedOperands none = { 0, 0, 0, 0 };
+        threadedHandlers = NULL;
+        packed.codes.assign(count + 1, static_cast<unsigned char>(OP_KINDS + fusedCount)); // 最后一项为程序结束
+        packed.operands.assign(count + 1, none);
+        for (int i = 0; i < count; i++) {
+            const Instruction& ins = program[i];
+            if (ins.offset != static_cast<short>(ins.offset) || ins.from != static_cast<short>(ins.from) ||
+                ins.by != static_cast<short>(ins.by)) {
+                packed = PackedProgram();
+                return;
+            }
+            packed.codes[i] = static_cast<unsigned char>(ins.op);
+            packed.operands[i].arg = ins.arg;
+            packed.operands[i].offset = static_cast<short>(ins.offset);
+            packed.operands[i].from = static_cast<short>(ins.from);
+            packed.operands[i].by = static_cast<short>(ins.by);
+
+            for (int k = 0; k < fusedCount; k++) {
+                const int length = (fused[k][2] < 0) ? 2 : 3;
+                int matched = 0;
+                while (matched < length && i + matched < count && program[i + matched].op == fused[k][matched]) {
+                    matched++;
+                }
+                if (matched == length) {
+                    packed.codes[i] = static_cast<unsigned char>(OP_KINDS + k);
+                    break;
+                }
+            }
+        }
+    }
+
+#ifdef BFX_THREADED_DISPATCH
+    /*
+     * 直接线索化（direct-threaded）解释器核心，执行packed中的紧凑编码
+     * 每个处理代码结尾直接跳转到下一条指令的处理代码，
+     * 每种指令都有自己的间接跳转，分支预测器可以分别学习，避免所有指令挤在switch的同一个间接跳转上
+     * 超级指令的处理代码先执行前面的指令，再直接跳到最后一条指令的处理代码，整个序列只需一次间接跳转
+     * 参数：
+     * - stops: 不为NULL时，标记了的指令换成停止执行的处理代码，执行到它之前停下（instructionPointer指向它）；
+     *   停止位置落在超级指令中间时，这条超级指令按单条指令执行。执行中不做额外的检查，速度与不设置时相同
+     */
+    template <class P>
+    void interpretThreaded(const char* stops) {
+        typedef typename P::Cell Cell;
+
+        // 顺序必须与OpCode一致，其后为packProgram()中的超级指令，最后一项为程序结束
+        static const void* const handlers[] = {
+            &&op_add, &&op_move, &&op_output, &&op_input, &&op_loop_start, &&op_loop_end,
+            &&op_clear, &&op_mul, &&op_scan, &&op_product, &&op_divmod, &&op_compare,
+            &&op_add_move_end, &&op_add_add_add, &&op_add_move, &&op_move_end, &&op_add_add,
+            &&op_multiply_clear, &&op_add_multiply, &&op_clear_end, &&op_clear_clear, &&op_clear_add,
+            &&op_halt
+        };
+
+        if (threadedHandlers != handlers || threadedStops != stops) {
+            threaded.resize(packed.codes.size());
+            for (size_t i = 0; i < threaded.size(); i++) {
+                threaded[i].handler = handlers[packed.codes[i]];
+                threaded[i].arg = packed.operands[i].arg;
+                threaded[i].offset = packed.operands[i].offset;
+                threaded[i].from = packed.operands[i].from;
+                if (stops == NULL || i >= program.size()) {
+                    continue;
+                }
+                if (stops[i]) {
+                    threaded[i].handler = &&op_stop;
+                } else if (packed.codes[i] >= OP_KINDS && (stops[i + 1] || (i + 2 < threaded.size() && stops[i + 2]))) {
+                    threaded[i].handler = handlers[program[i].op];
+                }
+            }
+            threadedHandlers = handlers;
+            threadedStops = stops;
+        }
+        const ThreadedInstruction* const start = &threaded[0];
+        Cell* cells = reinterpret_cast<Cell*>(memory);
+        const int size = tapeCells;
+        int pointer = memoryPointer;
+        const ThreadedInstruction* ip = start + instructionPointer;
+
+        #define BFX_DISPATCH() goto *ip->handler
+        #define BFX_NEXT() do { ++ip; BFX_DISPATCH(); } while (0)
+        #define BFX_CELL(offset) cells[P::at(pointer, (offset), size)]
+
+        BFX_DISPATCH();
+
+    op_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        BFX_NEXT();
+    op_move:
+        pointer = P::move(pointer, ip->arg, size);
+        BFX_NEXT();
+    op_output:
+        output.put(static_cast<char>(BFX_CELL(ip->offset)));
+        BFX_NEXT();
+    op_input:
+        if (input.needsRefill()) {
+            output.flush();
+        }
+        P::read(input, BFX_CELL(ip->offset));
+        BFX_NEXT();
+    op_loop_start:
+        if (BFX_CELL(ip->offset) == 0) {
+            ip += ip->arg;
+        }
+        BFX_NEXT();
+    op_loop_end:
+        if (BFX_CELL(ip->offset) != 0) {
+            ip += ip->arg;
+        }
+        BFX_NEXT();
+    op_clear:
+        BFX_CELL(ip->offset) = 0;
+        BFX_NEXT();
+    op_mul: {
+        Cell counter = BFX_CELL(ip->from);
+        if (counter != 0) {
+            BFX_CELL(ip->offset) += counter * ip->arg;
+        }
+        BFX_NEXT();
+    }
+    op_scan:
+        if (BFX_CELL(0) != 0) {
+            pointer = scanCells<P>(cells, pointer, ip->arg);
+        }
+        BFX_NEXT();
+    op_product:
+        executeProduct<P>(cells, pointer, ip->offset, ip->from, packed.operands[ip - start].by, ip->arg);
+        BFX_NEXT();
+    op_divmod:
+        divmodCells<P>(cells, pointer, ip->offset, ip->from);
+        BFX_NEXT();
+    op_compare:
+        pointer = compareCells<P>(cells, pointer, ip->from, ip->arg);
+        BFX_NEXT();
+
+        // 超级指令（见packProgram()）
+    op_add_move_end:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        pointer = P::move(pointer, ip->arg, size);
+        ++ip;
+        goto op_loop_end;
+    op_add_add_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_add;
+    op_add_move:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_move;
+    op_move_end:
+        pointer = P::move(pointer, ip->arg, size);
+        ++ip;
+        goto op_loop_end;
+    op_add_add:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_add;
+    op_multiply_clear: {
+        Cell counter = BFX_CELL(ip->from);
+        if (counter != 0) {
+            BFX_CELL(ip->offset) += counter * ip->arg;
+        }
+        ++ip;
+        goto op_clear;
+    }
+    op_add_multiply:
+        BFX_CELL(ip->offset) += ip->arg;
+        ++ip;
+        goto op_mul;
+    op_clear_end:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_loop_end;
+    op_clear_clear:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_clear;
+    op_clear_add:
+        BFX_CELL(ip->offset) = 0;
+        ++ip;
+        goto op_add;
+
+    op_stop:
+        memoryPointer = pointer;
+        instructionPointer = (int)(ip - start);
+        return;
+
+    op_halt:
+        #undef BFX_CELL
+        #undef BFX_NEXT
+        #undef BFX_DISPATCH
+
+        memoryPointer = pointer;
+        instructionPointer = (int)program.size();
+    }
+#endif
+
+    /*
+     * 按策略P从instructionPointer执行到程序结束
+     */
+    template <class P>
+    void interpretWith() {
+#ifdef BFX_THREADED_DISPATCH
+        if (!packed.codes.empty()) {
+            interpretThreaded<P>(NULL);
+            return;
+        }
+#endif
+        while (instructionPointer < (int)program.size()) {
+            executeInstruction<P>(program[instructionPointer]);
+            instructionPointer++;
+        }
+    }
+
+    /*
+     * 按策略P从instructionPointer全速执行，直到将要执行breakFlags中标记了的指令或程序结束
+     * 从标记了的指令开始时立即返回，由调用者先单独执行这条指令
+     */
+    template <class P>
+    void debugWith() {
+#ifdef BFX_THREADED_DISPATCH
+        if (!packed.codes.empty()) {
+            interpretThreaded<P>(&breakFlags[0]);
+            return;
+        }
+#endif
+        while (instructionPointer < (int)program.size() && !breakFlags[instructionPointer]) {
+            executeInstruction<P>(program[instructionPointer]);
+            instructionPointer++;
+        }
+    }
+
+    /*
+     * 设置了观察点或开启了历史记录时代替debugWith()：switch分派，'.'执行之前和写单元的指令执行之后检查观察点，
+     * 命中时设置hitWatchpoint后返回；开启了历史记录时每条指令之后计数并按间隔保存检查点（见recordInstruction()）
+     * 两者都没有时不使用，正常执行和只有断点的调试都不付出检查的开销
+     */
+    template <class P>
+    void watchWith() {
+        while (instructionPointer < (int)program.size() && !breakFlags[instructionPointer]) {
+            const Instruction& ins = program[instructionPointer];
+            hitWatchpoint = matchWatchOutput(instructionPointer);
+            if (hitWatchpoint >= 0) {
+                return;
+            }
+            executeInstruction<P>(ins);
+            instructionPointer++;
+            if (history) {
+                recordInstruction();
+            }
+            if (writesCells(ins.op)) {
+                hitWatchpoint = matchWatchChange();
+                if (hitWatchpoint >= 0) {
+                    return;
+                }
+            }
+        }
+    }
+
+    /*
+     * 倒退调试时从恢复的检查点重新执行，直到executed等于replayTarget或程序结束，不保存检查点
+     * replayScan为false时只是全速执行；为true时同时找出这一段中debugContinue()会停下的最后一个位置，
+     * 记录到replayStop（只记录executed小于replayBefore的位置）和replayWatch
+     */
+    template <class P>
+    void replayWith() {
+        if (!replayScan) {
+            while (executed < replayTarget && instructionPointer < (int)program.size()) {
+                executeInstruction<P>(program[instructionPointer]);
+                instructionPointer++;
+                executed++;
+            }
+            return;
+        }
+        while (executed < replayTarget && instructionPointer < (int)program.size()) {
+            if ((breakFlags[instructionPointer] && matchBreakpoint(instructionPointer) >= 0) ||
+                matchWatchOutput(instructionPointer) >= 0) {
+                replayStop = executed;
+                replayWatch = -1;
+            }
+            const Instruction& ins = program[instructionPointer];
+            executeInstruction<P>(ins);
+            instructionPointer++;
+            executed++;
+            if (writesCells(ins.op)) {
+                const int hit = matchWatchChange();
+                if (hit >= 0 && executed < replayBefore) {
+                    replayStop = executed;
+                    replayWatch = hit;
+                }
+            }
+        }
+    }
+
+    /*
+     * 按策略P从instructionPointer执行到程序结束，同时统计顺序执行（中间没有跳转）的相邻两条、三条指令的操作码组合
+     * 使用switch分派，不融合超级指令，统计的是融合之前的指令序列
+     */
+    template <class P>
+    void profileWith() {
+        int older = -1, previous = -1; // 前两条指令的操作码，中间发生跳转时重新开始
+        int last = -2;                 // 上一条执行的指令位置
+        while (instructionPointer < (int)program.size()) {
+            const int op = program[instructionPointer].op;
+            if (instructionPointer != last + 1) {
+                older = previous = -1;
+            }
+            if (previous >= 0) {
+                pairCounts[previous * OP_KINDS + op]++;
+                if (older >= 0) {
+                    tripleCounts[(older * OP_KINDS + previous) * OP_KINDS + op]++;
+                }
+            }
+            older = previous;
+            previous = op;
+            last = instructionPointer;
+            executeInstruction<P>(program[instructionPointer]);
+            instructionPointer++;
+        }
+    }
+
+    /*
+     * 按策略P从instructionPointer执行到程序结束，同时统计每条IR指令的执行次数，以及每个循环进入循环体的次数
+     * 使用switch分派，不融合超级指令，计数与program中的指令一一对应
+     */
+    template <class P>
+    void countWith() {
+        while (instructionPointer < (int)program.size()) {
+            const int current = instructionPointer;
+            const Instruction& ins = program[current];
+            executionCounts[current]++;
+            executeInstruction<P>(ins);
+            if (ins.op == OP_LOOP_START && instructionPointer == current) {
+                loopEntries[current]++; // 没有跳到']'，进入了循环体
+            }
+            instructionPointer++;
+        }
+    }
+
+    /*
+     * 清空逐条指令的执行统计，长度与当前的program一致
+     */
+    void resetCounts() {
+        executionCounts.assign(program.size(), 0);
+        loopEntries.assign(program.size(), 0);
+    }
+
+    /*
+     * getLoopProfile()的排序：自身代价大的在前，相同时按在代码中的位置
+     */
+    static bool bySelfCost(const LoopProfile& a, const LoopProfile& b) {
+        if (a.selfCost != b.selfCost) {
+            return a.selfCost > b.selfCost;
+        }
+        return a.start < b.start;
+    }
+
+    /*
+     * 按策略P执行instructionPointer指向的一条指令（不移动instructionPointer）
+     */
+    template <class P>
+    void stepWith() {
+        executeInstruction<P>(program[instructionPointer]);
+    }
+
+    /*
+     * 一组解释器实例
+     * - run: 执行到程序结束
+     * - step: 执行一条指令
+     * - profile: 执行到程序结束并统计指令序列（见setProfiling()）
+     * - count: 执行到程序结束并统计每条指令的执行次数（见setCounting()）
+     * - debug: 执行到有断点的指令或程序结束（见debugContinue()）
+     * - watch: 同debug，另外在观察点命中时停下，并记录执行历史（见setHistory()）
+     * - replay: 倒退调试时从检查点重新执行（见replayWith()）
+     */
+    typedef void (BrainfuckCompiler::*EngineFunction)();
+    struct Engine {
+        EngineFunction run;
+        EngineFunction step;
+        EngineFunction profile;
+        EngineFunction count;
+        EngineFunction debug;
+        EngineFunction watch;
+        EngineFunction replay;
+    };
+    Engine engine; // 当前设置对应的解释器实例，由selectEngine()选择
+
+    /*
+     * 根据单元宽度、指针越界方式和EOF处理方式选择解释器实例
+     * 全部27种组合在编译时各自实例化，这里只是查表，执行过程中不再判断这些设置
+     * 回绕模式下程序不会越过磁带边界时（见needsWrap()）选用扩展模式的实例，不做回绕运算和边界检查
+     */
+    void selectEngine() {
+        #define BFX_ENGINE(Cell, Pointer, Eof) \
+            { &BrainfuckCompiler::interpretWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::stepWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::profileWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::countWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::debugWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::watchWith<Policy<Cell, Pointer, Eof> >, \
+              &BrainfuckCompiler::replayWith<Policy<Cell, Pointer, Eof> > }
+        #define BFX_ENGINES_EOF(Cell, Pointer) \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_UNCHANGED), \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_ZERO), \
+            BFX_ENGINE(Cell, Pointer, InputSource::EOF_MINUS_ONE)
+        #define BFX_ENGINES(Cell) \
+            BFX_ENGINES_EOF(Cell, POINTER_WRAP), BFX_ENGINES_EOF(Cell, POINTER_ERROR), BFX_ENGINES_EOF(Cell, POINTER_GROW)
+
+        // 下标为 (宽度 * 3 + PointerMode) * 3 + EofMode，与各枚举的顺序一致
+        static const Engine engines[] = {
+            BFX_ENGINES(unsigned char), BFX_ENGINES(unsigned short), BFX_ENGINES(unsigned int)
+        };
+
+        #undef BFX_ENGINES
+        #undef BFX_ENGINES_EOF
+        #undef BFX_ENGINE
+
+        int width = (cellBits == 8) ? 0 : (cellBits == 16) ? 1 : 2;
+        PointerMode mode = (pointerMode == POINTER_WRAP && !needsWrap()) ? POINTER_GROW : pointerMode;
+        engine = engines[(width * 3 + mode) * 3 + input.getEofMode()];
+    }
+
+    /*
+     * JIT相关成员
+     * JIT生成的函数原型为 char* fn(BrainfuckCompiler* self, char* memory, char* pointer)，
+     * 返回执行结束时的内存指针。机器码中各寄存器的用途（均为调用者无需保存的寄存器之外的非易失寄存器）：
+     * - rbx: 当前内存指针
+     * - r12: 内存起始地址
+     * - r14: this指针，作为回调的第一个参数
+     * - r15: 磁带末端（第tapeCells个单元）的地址
+     * 指针移动不做边界检查，越界访问由磁带的保护页处理；报错模式下磁带末端不在页边界时另外检查右侧（见needsEdgeCheck()）
+     */
+    typedef char* (*JitFunction)(BrainfuckCompiler* self, char* memory, char* pointer);
+    ExecutableMemory jitCode;               // JIT生成的机器码
+    std::vector<unsigned char> jitBuffer;   // 生成机器码时使用的临时缓冲区
+
+    // 分层执行（见tiered()）
+    int tierThreshold;                      // 循环回跳多少次后编译为机器码
+    std::vector<int> backEdges;             // 各']'已经回跳的次数，下标为指令位置
+    std::vector<int> tierEntries;           // 已编译循环在tierCode中的入口位置，下标为'['的指令位置，未编译为-1
+    std::vector<int> hotLoops;              // 已编译的循环（'['的指令位置），按达到阈值的顺序
+    ExecutableMemory tierCode;              // 所有已编译循环的机器码，每个循环是一个原型与JitFunction相同的函数
+
+    /*
+     * JIT代码中'.'调用的输出回调，与interpret()的输出方式一致
+     */
+    static void jitOutput(BrainfuckCompiler* self, int value) {
+        self->output.put(static_cast<char>(value));
+    }
+
+    /*
+     * JIT代码中','调用的输入回调，参数为当前内存单元的值，返回值写入当前内存单元
+     */
+    static int jitInput(BrainfuckCompiler* self, int value) {
+        unsigned char cell = static_cast<unsigned char>(value);
+        if (self->input.needsRefill()) {
+            self->output.flush();
+        }
+        self->input.readCell(cell);
+        return cell;
+    }
+
+    /*
+     * JIT代码中扫描循环调用的回调，返回扫描结束时的内存指针
+     */
+    static char* jitScan(BrainfuckCompiler* self, char* pointer, int stride) {
+        return self->memory + self->tape.scan(static_cast<int>(pointer - self->memory), stride, self->accessibleCells());
+    }
+
+    /*
+     * JIT代码中OP_DIVMOD/OP_COMPARE调用的回调，由解释器执行第index条指令，返回执行后的内存指针
+     * JIT只用于8位单元，执行时不回绕（见needsWrap()），越界访问同样由磁带的保护页处理，报错模式下另外检查磁带末端
+     */
+    static char* jitExecute(BrainfuckCompiler* self, char* pointer, int index) {
+        self->memoryPointer = static_cast<int>(pointer - self->memory);
+        if (self->pointerMode == POINTER_ERROR) {
+            self->executeInstruction<Policy<unsigned char, POINTER_ERROR, InputSource::EOF_UNCHANGED> >(self->program[index]);
+        } else {
+            self->executeInstruction<Policy<unsigned char, POINTER_GROW, InputSource::EOF_UNCHANGED> >(self->program[index]);
+        }
+        return self->memory + self->memoryPointer;
+    }
+
+    // 向机器码缓冲区追加字节
+    void emit(unsigned char b) {
+        jitBuffer.push_back(b);
+    }
+
+    void emit(unsigned char b1, unsigned char b2) {
+        emit(b1);
+        emit(b2);
+    }
+
+    void emit(unsigned char b1, unsigned char b2, unsigned char b3) {
+        emit(b1);
+        emit(b2);
+        emit(b3);
+    }
+
+    void emitInt32(int value) {
+        for (int i = 0; i < 4; i++) {
+            emit(static_cast<unsigned char>((static_cast<unsigned int>(value) >> (i * 8)) & 0xFF));
+        }
+    }
+
+    void emitInt64(unsigned long long value) {
+        for (int i = 0; i < 8; i++) {
+            emit(static_cast<unsigned char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    // 回填位于position处的32位相对跳转偏移，使其跳转到target
+    void patchRel32(int position, int target) {
+        int rel = target - (position + 4);
+        for (int i = 0; i < 4; i++) {
+            jitBuffer[position + i] = static_cast<unsigned char>((static_cast<unsigned int>(rel) >> (i * 8)) & 0xFF);
+        }
+    }
+
+    /*
+     * 生成[rbx + offset]内存操作数的ModRM字节和位移，reg为ModRM的reg字段（寄存器编号或操作码扩展）
+     * 偏移为0时不带位移，能用8位表示时使用8位位移
+     */
+    void emitCellOperand(int reg, int offset) {
+        if (offset == 0) {
+            emit(static_cast<unsigned char>(0x03 | (reg << 3)));          // [rbx]
+        } else if (offset >= -128 && offset <= 127) {
+            emit(static_cast<unsigned char>(0x43 | (reg << 3)));          // [rbx + disp8]
+            emit(static_cast<unsigned char>(offset & 0xFF));
+        } else {
+            emit(static_cast<unsigned char>(0x83 | (reg << 3)));          // [rbx + disp32]
+            emitInt32(offset);
+        }
+    }
+
+    /*
+     * 访问[rbx + offset]之前检查它在磁带末端（r15）之前，否则读取第0个单元左侧的保护区，与其他越界一样报告
+     * 左侧越界仍由保护页处理；checked为false时不生成代码（见needsEdgeCheck()）
+     */
+    void emitEdgeCheck(bool checked, int offset) {
+        if (!checked) {
+            return;
+        }
+        emit(0x48, 0x8D);                                     // lea rcx, [rbx + offset]
+        emitCellOperand(1, offset);
+        emit(0x4C, 0x39, 0xF9);                               // cmp rcx, r15
+        emit(0x72, 0x05);                                     // jb +5
+        emit(0x41, 0x8A, 0x4C); emit(0x24, 0xFF);             // mov cl, byte [r12 - 1]
+    }
+
+    // 回填位于position处的8位相对跳转偏移，使其跳转到当前位置
+    void patchRel8(int position) {
+        jitBuffer[position] = static_cast<unsigned char>(((int)jitBuffer.size() - (position + 1)) & 0xFF);
+    }
+
+    // 生成把偏移offset处的内存单元传给回调的第二个参数、this传给第一个参数并调用callback的代码
+    void emitCall(const void* callback, int offset) {
+#ifdef _WIN32
+        emit(0x4C, 0x89, 0xF1);                 // mov rcx, r14
+        emit(0x0F, 0xB6);                       // movzx edx, byte [rbx + offset]
+        emitCellOperand(2, offset);
+#else
+        emit(0x4C, 0x89, 0xF7);                 // mov rdi, r14
+        emit(0x0F, 0xB6);                       // movzx esi, byte [rbx + offset]
+        emitCellOperand(6, offset);
+#endif
+        emit(0x48, 0xB8);                       // mov rax, imm64
+        emitInt64(reinterpret_cast<unsigned long long>(callback));
+        emit(0xFF, 0xD0);                       // call rax
+    }
+
+    // 生成以this、当前内存指针和value为参数调用callback，并把返回值作为新的内存指针的代码
+    void emitPointerCall(const void* callback, int value) {
+#ifdef _WIN32
+        emit(0x4C, 0x89, 0xF1);                 // mov rcx, r14
+        emit(0x48, 0x89, 0xDA);                 // mov rdx, rbx
+        emit(0x41, 0xB8);                       // mov r8d, imm32
+#else
+        emit(0x4C, 0x89, 0xF7);                 // mov rdi, r14
+        emit(0x48, 0x89, 0xDE);                 // mov rsi, rbx
+        emit(0xBA);                             // mov edx, imm32
+#endif
+        emitInt32(value);
+        emit(0x48, 0xB8);                       // mov rax, imm64
+        emitInt64(reinterpret_cast<unsigned long long>(callback));
+        emit(0xFF, 0xD0);                       // call rax
+        emit(0x48, 0x89, 0xC3);                 // mov rbx, rax
+    }
+
+    static const int ELF_BUFFER_SIZE = 65536; // compileToElf()/compileToAsm()生成的程序中输入、输出缓冲区各自的大小
+
+    // compileToElf()/compileToAsm()生成的程序的磁带字节数；独立程序不能扩展磁带，扩展模式下直接使用上限
+    unsigned long long nativeTapeBytes() const {
+        return (pointerMode == POINTER_GROW) ? Tape::DEFAULT_LIMIT : static_cast<unsigned long long>(getTapeSize());
+    }
+
+    // compileToC()/compileToCpp()生成的程序的磁带单元数，与nativeTapeBytes()一样扩展模式下使用上限
+    unsigned long long nativeTapeCells() const {
+        return (pointerMode == POINTER_GROW) ? Tape::DEFAULT_LIMIT / cellBytes() : static_cast<unsigned long long>(getTapeSize());
+    }
+
+    // 以小端序追加size个字节
+    static void appendLittleEndian(std::vector<unsigned char>& out, unsigned long long value, int size) {
+        for (int i = 0; i < size; i++) {
+            out.push_back(static_cast<unsigned char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    // 追加一个ELF64程序头，对齐固定为一页
+    static void appendProgramHeader(std::vector<unsigned char>& out, unsigned int type, unsigned int flags,
+                                    unsigned long long offset, unsigned long long address,
+                                    unsigned long long fileSize, unsigned long long memorySize) {
+        appendLittleEndian(out, type, 4);
+        appendLittleEndian(out, flags, 4);
+        appendLittleEndian(out, offset, 8);
+        appendLittleEndian(out, address, 8);
+        appendLittleEndian(out, address, 8);
+        appendLittleEndian(out, fileSize, 8);
+        appendLittleEndian(out, memorySize, 8);
+        appendLittleEndian(out, 0x1000, 8);
+    }
+
+    // 生成call rel32，target为jitBuffer中的位置
+    void emitCallRel32(int target) {
+        emit(0xE8);                             // call rel32
+        emitInt32(0);
+        patchRel32((int)jitBuffer.size() - 4, target);
+    }
+
+    // 把value写入jitBuffer中position处的4个字节
+    void patchInt32(int position, unsigned int value) {
+        for (int i = 0; i < 4; i++) {
+            jitBuffer[position + i] = static_cast<unsigned char>((value >> (i * 8)) & 0xFF);
+        }
+    }
+
+    /*
+     * 把IR中[first, end)范围内的指令翻译为机器码追加到jitBuffer，由compileNative()、compileHotLoops()和compileToElf()共用
+     * 执行前rbx指向当前内存单元
+     * 参数：
+     * - putRoutine/getRoutine: 独立可执行文件中输出、输入子程序在jitBuffer中的位置（见emitElfRuntime()）；
+     *   为-1时生成JIT代码，输入输出和扫描循环通过回调交给宿主完成
+     * - first/end: 要翻译的指令范围，其中的循环必须完整
+     * - start: 从第几条指令开始执行，不为first时先生成一条跳到该指令的jmp（可以跳进循环体中）
+     * - checked: 访问单元前是否检查磁带末端（见emitEdgeCheck()），只用于JIT代码
+     * 返回值：
+     * - 括号不匹配时返回false
+     */
+    bool emitInstructions(int putRoutine, int getRoutine, int first, int end, int start, bool checked) {
+        const bool standalone = (putRoutine >= 0);
+        std::vector<int> loopStarts; // 尚未回填的循环开始处je指令的偏移位置
+        int entryPatch = -1;         // 跳到起点的jmp的偏移位置
+        if (start > first) {
+            emit(0xE9);                                                            // jmp <起点>
+            entryPatch = (int)jitBuffer.size();
+            emitInt32(0);
+        }
+
+        for (int i = first; i < end; i++) {
+            const Instruction& ins = program[i];
+            if (i == start && entryPatch >= 0) {
+                patchRel32(entryPatch, (int)jitBuffer.size());
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // add byte [rbx + offset], imm8
+                    emitCellOperand(0, ins.offset);
+                    emit(static_cast<unsigned char>(ins.arg & 0xFF));
+                    break;
+                case OP_MOVE:
+                    emit(0x48, 0x81, 0xC3);                                        // add rbx, imm32
+                    emitInt32(ins.arg);
+                    break;
+                case OP_OUTPUT:
+                    emitEdgeCheck(checked, ins.offset);
+                    if (standalone) {
+                        emit(0x8A);                                                // mov al, byte [rbx + offset]
+                        emitCellOperand(0, ins.offset);
+                        emitCallRel32(putRoutine);                                 // call put
+                    } else {
+                        emitCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitOutput), ins.offset);
+                    }
+                    break;
+                case OP_INPUT: {
+                    int skipPatch = -1; // EOF时跳过写入的js指令的偏移位置
+                    emitEdgeCheck(checked, ins.offset);
+                    if (!standalone) {
+                        emitCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitInput), ins.offset);
+                    } else {
+                        emitCallRel32(getRoutine);                                 // call get（EOF时eax为-1）
+                        if (input.getEofMode() == InputSource::EOF_ZERO) {
+                            emit(0x85, 0xC0);                                      // test eax, eax
+                            emit(0x79, 0x02);                                      // jns +2
+                            emit(0x31, 0xC0);                                      // xor eax, eax
+                        } else if (input.getEofMode() == InputSource::EOF_UNCHANGED) {
+                            emit(0x85, 0xC0);                                      // test eax, eax
+                            emit(0x78, 0x00);                                      // js <写入之后>
+                            skipPatch = (int)jitBuffer.size() - 1;
+                        }
+                    }
+                    emit(0x88);                                                    // mov byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    if (skipPatch >= 0) {
+                        patchRel8(skipPatch);
+                    }
+                    break;
+                }
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // cmp byte [rbx + offset], 0
+                    emitCellOperand(7, ins.offset);
+                    emit(0x00);
+                    emit(0x0F, 0x84);                                              // je <循环结束之后>
+                    loopStarts.push_back((int)jitBuffer.size());
+                    emitInt32(0);
+                    break;
+                case OP_LOOP_END: {
+                    if (ins.arg == 0) {
+                        break;
+                    }
+                    if (loopStarts.empty()) {
+                        return false;
+                    }
+                    int startPatch = loopStarts.back();
+                    loopStarts.pop_back();
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x80);                                                    // cmp byte [rbx + offset], 0
+                    emitCellOperand(7, ins.offset);
+                    emit(0x00);
+                    emit(0x0F, 0x85);                                              // jne <循环开始之后>
+                    emitInt32(0);
+                    patchRel32((int)jitBuffer.size() - 4, startPatch + 4);
+                    patchRel32(startPatch, (int)jitBuffer.size());
+                    break;
+                }
+                case OP_CLEAR:
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0xC6);                                                    // mov byte [rbx + offset], 0
+                    emitCellOperand(0, ins.offset);
+                    emit(0x00);
+                    break;
+                case OP_MUL: {
+                    // 与解释器一样，计数单元为0时不访问目标单元（目标单元可能在磁带之外）
+                    emitEdgeCheck(checked, ins.from);
+                    emit(0x0F, 0xB6);                                              // movzx eax, byte [rbx + from]
+                    emitCellOperand(0, ins.from);
+                    emit(0x84, 0xC0);                                              // test al, al
+                    emit(0x74, 0x00);                                              // je <乘加之后>
+                    int skipPatch = (int)jitBuffer.size() - 1;
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x69, 0xC0);                                              // imul eax, eax, imm32
+                    emitInt32(ins.arg);
+                    emit(0x00);                                                    // add byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    patchRel8(skipPatch);
+                    break;
+                }
+                case OP_SCAN: {
+                    if (standalone) {
+                        // 独立程序中没有CellScanner，逐个单元检查
+                        emit(0x80, 0x3B, 0x00);                                    // cmp byte [rbx], 0
+                        emit(0x74, 0x0C);                                          // je +12
+                        emit(0x48, 0x81, 0xC3);                                    // add rbx, imm32
+                        emitInt32(ins.arg);
+                        emit(0x80, 0x3B, 0x00);                                    // cmp byte [rbx], 0
+                        emit(0x75, 0xF4);                                          // jne -12
+                        break;
+                    }
+                    // 当前单元非0时调用jitScan()，由它完成向量化查找
+                    emitEdgeCheck(checked, 0);
+                    emit(0x80, 0x3B, 0x00);                                        // cmp byte [rbx], 0
+                    emit(0x0F, 0x84);                                              // je <扫描结束>
+                    int exitPatch = (int)jitBuffer.size();
+                    emitInt32(0);
+                    emitPointerCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitScan), ins.arg);
+                    patchRel32(exitPatch, (int)jitBuffer.size());
+                    break;
+                }
+                case OP_PRODUCT: {
+                    emitEdgeCheck(checked, ins.from);
+                    emitEdgeCheck(checked, ins.by);
+                    emit(0x0F, 0xB6);                                              // movzx eax, byte [rbx + from]
+                    emitCellOperand(0, ins.from);
+                    emit(0x0F, 0xB6);                                              // movzx ecx, byte [rbx + by]
+                    emitCellOperand(1, ins.by);
+                    emit(0x0F, 0xAF, 0xC1);                                        // imul eax, ecx
+                    emit(0x84, 0xC0);                                              // test al, al
+                    emit(0x74, 0x00);                                              // je <乘加之后>
+                    int skipPatch = (int)jitBuffer.size() - 1;
+                    emitEdgeCheck(checked, ins.offset);
+                    emit(0x69, 0xC0);                                              // imul eax, eax, imm32
+                    emitInt32(ins.arg);
+                    emit(0x00);                                                    // add byte [rbx + offset], al
+                    emitCellOperand(0, ins.offset);
+                    patchRel8(skipPatch);
+                    break;
+                }
+                case OP_DIVMOD:
+                case OP_COMPARE:
+                    // 独立程序中不展开，直接执行其后的原循环；JIT代码交给解释器做闭式计算
+                    if (!standalone) {
+                        emitPointerCall(reinterpret_cast<const void*>(&BrainfuckCompiler::jitExecute), i);
+                    }
+                    break;
+            }
+        }
+        if (start >= end && entryPatch >= 0) {
+            patchRel32(entryPatch, (int)jitBuffer.size());
+        }
+        return loopStarts.empty();
+    }
+
+    /*
+     * JIT函数的序言：保存非易失寄存器，并为Win64调用约定预留32字节影子空间（同时保持16字节栈对齐，r13只为对齐而保存），
+     * 再把三个参数分别放入r14、r12和rbx，磁带末端放入r15
+     */
+    void emitPrologue() {
+        emit(0x53);                              // push rbx
+        emit(0x41, 0x54);                        // push r12
+        emit(0x41, 0x55);                        // push r13
+        emit(0x41, 0x56);                        // push r14
+        emit(0x41, 0x57);                        // push r15
+        emit(0x48, 0x83, 0xEC); emit(0x20);      // sub rsp, 32
+#ifdef _WIN32
+        emit(0x49, 0x89, 0xCE);                  // mov r14, rcx
+        emit(0x49, 0x89, 0xD4);                  // mov r12, rdx
+        emit(0x4C, 0x89, 0xC3);                  // mov rbx, r8
+#else
+        emit(0x49, 0x89, 0xFE);                  // mov r14, rdi
+        emit(0x49, 0x89, 0xF4);                  // mov r12, rsi
+        emit(0x48, 0x89, 0xD3);                  // mov rbx, rdx
+#endif
+        emit(0x4D, 0x8D, 0xBC); emit(0x24);      // lea r15, [r12 + tapeCells]
+        emitInt32(tapeCells);
+    }
+
+    /*
+     * JIT函数的尾声：返回当前内存指针并恢复寄存器
+     */
+    void emitEpilogue() {
+        emit(0x48, 0x89, 0xD8);                  // mov rax, rbx
+        emit(0x48, 0x83, 0xC4); emit(0x20);      // add rsp, 32
+        emit(0x41, 0x5F);                        // pop r15
+        emit(0x41, 0x5E);                        // pop r14
+        emit(0x41, 0x5D);                        // pop r13
+        emit(0x41, 0x5C);                        // pop r12
+        emit(0x5B);                              // pop rbx
+        emit(0xC3);                              // ret
+    }
+
+    /*
+     * 独立可执行文件的运行时，由compileToElf()使用，与compileToAsm()生成的flush/put/get子程序逐条对应
+     * 寄存器：r12为输出缓冲区（其后紧跟输入缓冲区）、r13为已缓冲的输出字节数、r14/r15为输入缓冲区的读取位置和长度
+     * 参数：
+     * - putRoutine/getRoutine: 返回put和get子程序在jitBuffer中的位置
+     * 返回值：
+     * - flush子程序的位置
+     */
+    int emitElfRuntime(int& putRoutine, int& getRoutine) {
+        // flush: write(1, r12, r13)，直到全部写出或出错，然后清空缓冲区
+        int flushRoutine = (int)jitBuffer.size();
+        emit(0x4C, 0x89, 0xE6);                  // mov rsi, r12
+        emit(0x4C, 0x89, 0xEA);                  // mov rdx, r13
+        emit(0x48, 0x85, 0xD2);                  // test rdx, rdx          <- .loop
+        emit(0x7E, 0x19);                        // jle .done
+        emit(0xBF); emitInt32(1);                // mov edi, 1
+        emit(0xB8); emitInt32(1);                // mov eax, 1 (write)
+        emit(0x0F, 0x05);                        // syscall
+        emit(0x48, 0x85, 0xC0);                  // test rax, rax
+        emit(0x7E, 0x08);                        // jle .done
+        emit(0x48, 0x01, 0xC6);                  // add rsi, rax
+        emit(0x48, 0x29, 0xC2);                  // sub rdx, rax
+        emit(0xEB, 0xE2);                        // jmp .loop
+        emit(0x45, 0x31, 0xED);                  // xor r13d, r13d         <- .done
+        emit(0xC3);                              // ret
+
+        // put: 把al追加到输出缓冲区，缓冲区满时flush
+        putRoutine = (int)jitBuffer.size();
+        emit(0x43, 0x88); emit(0x04, 0x2C);      // mov byte [r12 + r13], al
+        emit(0x49, 0xFF, 0xC5);                  // inc r13
+        emit(0x49, 0x81, 0xFD); emitInt32(ELF_BUFFER_SIZE); // cmp r13, ELF_BUFFER_SIZE
+        emit(0x0F, 0x84);                        // je flush
+        emitInt32(0);
+        patchRel32((int)jitBuffer.size() - 4, flushRoutine);
+        emit(0xC3);                              // ret
+
+        // get: 从输入缓冲区取一个字节放入eax，缓冲区读完时先flush再read(0)，输入结束时返回-1
+        getRoutine = (int)jitBuffer.size();
+        emit(0x4D, 0x39, 0xFE);                  // cmp r14, r15
+        emit(0x72, 0x2C);                        // jb .have
+        emitCallRel32(flushRoutine);             // call flush
+        emit(0x31, 0xFF);                        // xor edi, edi
+        emit(0x49, 0x8D, 0xB4); emit(0x24); emitInt32(ELF_BUFFER_SIZE); // lea rsi, [r12 + ELF_BUFFER_SIZE]
+        emit(0xBA); emitInt32(ELF_BUFFER_SIZE);  // mov edx, ELF_BUFFER_SIZE
+        emit(0x31, 0xC0);                        // xor eax, eax (read)
+        emit(0x0F, 0x05);                        // syscall
+        emit(0x45, 0x31, 0xF6);                  // xor r14d, r14d
+        emit(0x49, 0x89, 0xC7);                  // mov r15, rax
+        emit(0x48, 0x85, 0xC0);                  // test rax, rax
+        emit(0x7F, 0x09);                        // jg .have
+        emit(0x45, 0x31, 0xFF);                  // xor r15d, r15d
+        emit(0xB8); emitInt32(-1);               // mov eax, -1
+        emit(0xC3);                              // ret
+        emit(0x43, 0x0F, 0xB6); emit(0x84, 0x34); emitInt32(ELF_BUFFER_SIZE); // movzx eax, byte [r12 + r14 + ELF_BUFFER_SIZE]  <- .have
+        emit(0x49, 0xFF, 0xC6);                  // inc r14
+        emit(0xC3);                              // ret
+        return flushRoutine;
+    }
+
+    /*
+     * 把整个IR翻译为x86-64机器码并载入jitCode
+     * 语义与interpret()完全一致（8位单元、磁带越界由保护页处理），从instructionPointer处的指令开始执行
+     * 返回值：
+     * - 平台不支持、单元宽度不是8位、指针需要回绕（见needsWrap()）、括号不匹配或分配可执行内存失败时返回false
+     */
+    bool compileNative() {
+        if (!nativeSupported()) {
+            return false;
+        }
+        jitBuffer.clear();
+        emitPrologue();
+        if (!emitInstructions(-1, -1, 0, (int)program.size(), instructionPointer, needsEdgeCheck())) {
+            return false;
+        }
+        emitEpilogue();
+
+        bool loaded = jitCode.load(jitBuffer);
+        jitBuffer.clear();
+        return loaded;
+    }
+
+    /*
+     * JIT代码访问单元前是否需要检查磁带末端（见emitEdgeCheck()）
+     * 磁带按页分配，报错模式下设置的长度不是整页时，最后一个单元之后到页末的部分可读写，保护页发现不了
+     */
+    bool needsEdgeCheck() const {
+        return pointerMode == POINTER_ERROR && tape.size() > tapeCells;
+    }
+
+    /*
+     * 当前设置能否使用JIT：x86-64平台、8位单元、指针不需要回绕（见needsWrap()）
+     */
+    bool nativeSupported() const {
+        return nativeCells() && !needsWrap();
+    }
+
+    /*
+     * 平台和单元宽度是否支持JIT：x86-64平台、8位单元，不考虑指针回绕
+     */
+    bool nativeCells() const {
+#ifdef BFX_JIT_X64
+        return cellBits == 8;
+#else
+        return false;
+#endif
+    }
+
+    /*
+     * 把hotLoops中的所有循环重新翻译为机器码并载入tierCode（旧的机器码随之释放，调用时不能正在执行其中的代码）
+     * 每个循环是一个独立的函数，从'['开始执行，到匹配的']'退出循环后返回
+     * 返回值：
+     * - 分配可执行内存失败时返回false，所有循环都退回解释执行
+     */
+    bool compileHotLoops() {
+        jitBuffer.clear();
+        std::fill(tierEntries.begin(), tierEntries.end(), -1);
+        for (size_t i = 0; i < hotLoops.size(); i++) {
+            const int start = hotLoops[i];
+            tierEntries[start] = (int)jitBuffer.size();
+            emitPrologue();
+            // 有界的循环在进入前检查（见interpretTiered()），循环中不再检查磁带末端
+            emitInstructions(-1, -1, start, start + program[start].arg + 1, start, needsEdgeCheck() && !loopRanges[start].bounded);
+            emitEpilogue();
+        }
+
+        bool loaded = tierCode.load(jitBuffer);
+        jitBuffer.clear();
+        if (!loaded) {
+            std::fill(tierEntries.begin(), tierEntries.end(), -1);
+        }
+        return loaded;
+    }
+
+    /*
+     * 分层执行的解释部分，与interpretWith()一样从instructionPointer执行到程序结束，同时统计每个']'的回跳次数
+     * 回跳次数达到tierThreshold的循环编译为机器码，此后每次到达它的'['都改为调用机器码（包括达到阈值的这次回跳）
+     * 只用于8位单元（见nativeCells()），越界访问与jit()一样由磁带的保护页处理
+     * 需要回绕时（见needsWrap()）机器码中没有回绕运算：只编译有界的循环，每次进入前检查整个循环都在磁带之内，否则这一次解释执行；
+     * 需要检查磁带末端时（见needsEdgeCheck()）有界的循环同样在进入前检查，其他循环在机器码中逐次检查
+     * 模板参数：
+     * - Pointer: POINTER_WRAP（需要回绕）、POINTER_ERROR或POINTER_GROW（不检查边界）
+     * - Eof: InputSource::EofMode
+     */
+    template <int Pointer, int Eof>
+    void interpretTiered() {
+        typedef Policy<unsigned char, Pointer, Eof> P;
+        const int count = (int)program.size();
+        const bool guarded = P::wraps() || needsEdgeCheck(); // 有界循环的机器码是否要在进入前检查
+        while (instructionPointer < count) {
+            const Instruction& ins = program[instructionPointer];
+            if (ins.op == OP_LOOP_START && tierEntries[instructionPointer] >= 0 &&
+                (!guarded || !loopRanges[instructionPointer].bounded || loopInside(instructionPointer, memoryPointer))) {
+                JitFunction function = reinterpret_cast<JitFunction>(static_cast<char*>(tierCode.entry()) + tierEntries[instructionPointer]);
+                memoryPointer = static_cast<int>(function(this, memory, memory + memoryPointer) - memory);
+                instructionPointer += ins.arg + 1;
+                continue;
+            }
+
+            const int current = instructionPointer;
+            executeInstruction<P>(ins);
+            if (ins.op == OP_LOOP_END && instructionPointer != current && ++backEdges[current] == tierThreshold &&
+                (!P::wraps() || loopRanges[instructionPointer].bounded)) {
+                // instructionPointer已回到'['，编译成功时从'['重新进入，条件单元不为0，直接进入机器码中的循环体
+                hotLoops.push_back(instructionPointer);
+                if (compileHotLoops()) {
+                    continue;
+                }
+            }
+            instructionPointer++;
+        }
+    }
+
+    // 按EOF处理方式选择interpretTiered()的实例
+    template <int Pointer>
+    void interpretTieredWith() {
+        switch (input.getEofMode()) {
+            case InputSource::EOF_ZERO:
+                interpretTiered<Pointer, InputSource::EOF_ZERO>();
+                break;
+            case InputSource::EOF_MINUS_ONE:
+                interpretTiered<Pointer, InputSource::EOF_MINUS_ONE>();
+                break;
+            default:
+                interpretTiered<Pointer, InputSource::EOF_UNCHANGED>();
+                break;
+        }
+    }
+
+    /*
+     * 以JIT方式执行完整的Brainfuck代码，供compileToC()和compileToCpp()共用
+     * 生成的代码：
+     * - 连续的加减、移动已经折叠；IR中的指针移动已推迟到循环边界（见addressByOffset()），单元操作按偏移寻址（p[偏移]）
+     * - 清零循环生成赋值，相邻单元的连续清零合并为memset；乘法循环生成乘加；8位单元向右逐个扫描时使用memchr
+     * - 整除取余、比较循环之前调用生成的divmod()/compare()做闭式计算，前提不满足时它们不做修改，由其后的循环执行
+     * - 输出写入64KB的缓冲区，读取新的一行输入前和程序结束时整块写出
+     * - 单元宽度、指针回绕和EOF处理方式与当前设置一致，磁带长度见nativeTapeCells()；
+     *   回绕模式下只在指针范围分析不能证明在磁带之内的地方做回绕运算（见statementsSource()）
+     * - 回绕模式之外，单元访问经过at()检查是否在磁带之内，有界的循环与回绕模式一样在入口检查一次（见statementsSource()）；
+     *   磁带两侧各留出2*REACH个单元（REACH为代码长度，一条指令访问的单元离指针不会更远），每次移动指针后检查指针离磁带不超过REACH，
+     *   使at()中的地址运算不离开存储区；报错模式下结束时还检查指针在磁带之内。
+     *   发现越界时写出已有的输出，以退出码1结束，对应run()的指针越界
+     * - 加载时预先执行过的部分（见evaluatePrefix()）不再生成执行代码：磁带和指针以预先执行的结果为初值，
+     *   已产生的输出开始时一次写出，然后跳到停下的指令（goto resume）继续；整个程序都已执行完时只剩这一次写出
+     * 参数：
+     * - cpp: 为true时使用C++的头文件，否则使用C的头文件
+     * 返回值：
+     * - 生成的源代码字符串
+     */
+    std::string generateSource(bool cpp) {
+        const bool wrap = needsWrap();
+        const bool checked = pointerMode != POINTER_WRAP;
+        std::ostringstream out;
+        out << (cpp ? "#include <cstdio>\n#include <cstring>\n" : "#include <stdio.h>\n#include <string.h>\n");
+        if (checked) {
+            out << (cpp ? "#include <cstdlib>\n" : "#include <stdlib.h>\n");
+        }
+        out << "\n";
+
+        // 预先执行已经执行完整个程序：只需写出它的输出
+        if (prefixInstruction > 0 && prefixInstruction >= (int)program.size()) {
+            prefixOutputSource(out);
+            out << "int main(void) {\n";
+            if (!prefixOutput.empty()) {
+                out << "    fwrite(prefixOutput, 1, sizeof(prefixOutput), stdout);\n";
+            }
+            out << "    return 0;\n";
+            out << "}\n";
+            return out.str();
+        }
+
+        // 运行时：磁带、输出缓冲区、按行读入的输入缓冲区
+        out << "typedef " << (cellBits == 8 ? "unsigned char" : cellBits == 16 ? "unsigned short" : "unsigned int") << " cell;\n";
+        out << "#define TAPE_SIZE " << nativeTapeCells() << "\n";
+        if (checked) {
+            out << "#define REACH " << code.length() + 1 << "\n\n";
+            out << "static cell storage[REACH * 2 + TAPE_SIZE + REACH * 2];\n";
+            out << "static cell* const tape = storage + REACH * 2;\n";
+            if (!prefixCells.empty()) {
+                out << "static const cell initialTape[] = ";
+                initializerSource(out, prefixCells);
+                out << ";\n";
+            }
+        } else if (prefixCells.empty()) {
+            out << "\nstatic cell tape[TAPE_SIZE];\n";
+        } else {
+            out << "\nstatic cell tape[TAPE_SIZE] = ";
+            initializerSource(out, prefixCells);
+            out << ";\n";
+        }
+        out << "static unsigned char outBuffer[65536];\n";
+        out << "static size_t outLength = 0;\n";
+        out << "static unsigned char inBuffer[65536];\n";
+        out << "static size_t inLength = 0, inPosition = 0;\n\n";
+        out << "static void flushOutput(void) {\n"
+               "    fwrite(outBuffer, 1, outLength, stdout);\n"
+               "    fflush(stdout);\n"
+               "    outLength = 0;\n"
+               "}\n\n";
+        out << "static void put(cell c) {\n"
+               "    outBuffer[outLength++] = (unsigned char)c;\n"
+               "    if (outLength == sizeof(outBuffer)) {\n"
+               "        flushOutput();\n"
+               "    }\n"
+               "}\n\n";
+        out << "static int get(void) {\n"
+               "    if (inPosition == inLength) {\n"
+               "        int c;\n"
+               "        flushOutput();\n"
+               "        inLength = inPosition = 0;\n"
+               "        while (inLength < sizeof(inBuffer) && (c = getchar()) != EOF) {\n"
+               "            inBuffer[inLength++] = (unsigned char)c;\n"
+               "            if (c == '\\n') {\n"
+               "                break;\n"
+               "            }\n"
+               "        }\n"
+               "        if (inLength == 0) {\n"
+               "            return EOF;\n"
+               "        }\n"
+               "    }\n"
+               "    return inBuffer[inPosition++];\n"
+               "}\n\n";
+        if (checked) {
+            out << "static void pointerError(void) {\n"
+                   "    flushOutput();\n"
+                   "    exit(1);\n"
+                   "}\n\n";
+            out << "static int reachable(cell* p) {\n"
+                   "    return p != 0 && p >= tape - REACH && p < tape + TAPE_SIZE + REACH;\n"
+                   "}\n\n";
+            out << "static cell* at(cell* p, long offset) {\n"
+                   "    if (p + offset < tape || p + offset >= tape + TAPE_SIZE) {\n"
+                   "        pointerError();\n"
+                   "    }\n"
+                   "    return p + offset;\n"
+                   "}\n\n";
+        } else if (wrap) {
+            out << "static cell* at(cell* p, long offset) {\n"
+                   "    long i = (long)(p - tape) + offset;\n"
+                   "    i %= TAPE_SIZE;\n"
+                   "    if (i < 0) {\n"
+                   "        i += TAPE_SIZE;\n"
+                   "    }\n"
+                   "    return tape + i;\n"
+                   "}\n\n";
+        }
+        if (wrap || checked) {
+            out << "static int inside(cell* p, long low, long high) {\n"
+                   "    return (long)(p - tape) + low >= 0 && (long)(p - tape) + high < TAPE_SIZE;\n"
+                   "}\n\n";
+        }
+        idiomSource(out);
+        prefixOutputSource(out);
+        out << "int main(void) {\n";
+        if (!prefixOutput.empty()) {
+            out << "    fwrite(prefixOutput, 1, sizeof(prefixOutput), stdout);\n";
+        }
+        if (checked && !prefixCells.empty()) {
+            out << "    memcpy(tape, initialTape, sizeof(initialTape));\n";
+        }
+        out << "    cell* p = tape";
+        if (prefixPointer != 0) {
+            out << " + " << prefixPointer;
+        }
+        out << ";\n";
+        if (prefixInstruction > 0) {
+            out << "    goto resume;\n";
+        }
+
+        statementsSource(out, 0, (int)program.size(), 1, wrap || checked, wrap || checked);
+
+        out << "    flushOutput();\n";
+        if (pointerMode == POINTER_ERROR) {
+            out << "    return p >= tape && p < tape + TAPE_SIZE ? 0 : 1;\n";
+        } else {
+            out << "    return 0;\n";
+        }
+        out << "}\n";
+        return out.str();
+    }
+
+    /*
+     * 生成IR中[first, end)范围内指令的执行代码（其中的循环完整配对），供generateSource()使用
+     * 需要回绕或检查越界时，有界的循环（见analyzePointerRange()）在入口检查一次整个循环是否都在磁带之内，
+     * 是则执行直接访问单元的一份，否则执行经过at()回绕或检查的一份；只有最外层的有界循环这样生成，代码最多增加一倍
+     * 包含预先执行停下位置（resume标签）的循环只生成经过at()的一份
+     * 参数：
+     * - out: 输出目标
+     * - first/end: 指令范围
+     * - depth: 缩进层数
+     * - guarded: 单元访问是否经过at()，回绕模式下指针移动也做回绕运算
+     * - split: 是否为有界循环生成两份代码
+     */
+    void statementsSource(std::ostream& out, int first, int end, int depth, bool guarded, bool split) {
+        for (int i = first; i < end; i++) {
+            const Instruction& ins = program[i];
+            if (i == prefixInstruction && i > 0) {
+                indentSource(out, depth) << "resume: ;\n";
+            }
+            if (split && ins.op == OP_LOOP_START && ins.arg != 0 && loopRanges[i].bounded &&
+                (prefixInstruction == 0 || prefixInstruction < i || prefixInstruction > i + ins.arg)) {
+                const int loopEnd = i + ins.arg + 1;
+                indentSource(out, depth) << "if (inside(p, " << loopRanges[i].low << ", " << loopRanges[i].high << ")) {\n";
+                statementsSource(out, i, loopEnd, depth + 1, false, false);
+                indentSource(out, depth) << "} else {\n";
+                statementsSource(out, i, loopEnd, depth + 1, true, false);
+                indentSource(out, depth) << "}\n";
+                i = loopEnd - 1;
+                continue;
+            }
+            switch (ins.op) {
+                case OP_ADD:
+                    indentSource(out, depth) << cellSource(ins.offset, guarded)
+                                             << (ins.arg < 0 ? " -= " : " += ") << (ins.arg < 0 ? -ins.arg : ins.arg) << ";\n";
+                    break;
+                case OP_MOVE:
+                    if (guarded && pointerMode == POINTER_WRAP) {
+                        indentSource(out, depth) << "p = at(p, " << ins.arg << ");\n";
+                    } else {
+                        indentSource(out, depth) << "p += " << ins.arg << ";\n";
+                        if (guarded) {
+                            pointerCheckSource(out, depth);
+                        }
+                    }
+                    break;
+                case OP_OUTPUT:
+                    indentSource(out, depth) << "put(" << cellSource(ins.offset, guarded) << ");\n";
+                    break;
+                case OP_INPUT:
+                    indentSource(out, depth);
+                    if (input.getEofMode() == InputSource::EOF_MINUS_ONE) {
+                        out << cellSource(ins.offset, guarded) << " = (cell)get();\n";
+                    } else if (input.getEofMode() == InputSource::EOF_ZERO) {
+                        out << "{ int c = get(); " << cellSource(ins.offset, guarded) << " = (cell)(c == EOF ? 0 : c); }\n";
+                    } else {
+                        out << "{ int c = get(); if (c != EOF) " << cellSource(ins.offset, guarded) << " = (cell)c; }\n";
+                    }
+                    break;
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    indentSource(out, depth++) << "while (" << cellSource(ins.offset, guarded) << ") {\n";
+                    break;
+                case OP_LOOP_END:
+                    if (ins.arg == 0) {
+                        break;
+                    }
+                    indentSource(out, --depth) << "}\n";
+                    break;
+                case OP_CLEAR: {
+                    // 偏移依次加1的一串清零（"[-]>[-]>[-]"）合并为一次memset
+                    int count = 1;
+                    while (!guarded && i + count < end && i + count != prefixInstruction &&
+                           program[i + count].op == OP_CLEAR && program[i + count].offset == ins.offset + count) {
+                        count++;
+                    }
+                    if (count >= 4) {
+                        indentSource(out, depth) << "memset(p + " << ins.offset << ", 0, " << count << " * sizeof(cell));\n";
+                        i += count - 1;
+                    } else {
+                        indentSource(out, depth) << cellSource(ins.offset, guarded) << " = 0;\n";
+                    }
+                    break;
+                }
+                case OP_MUL: {
+                    // lowerLoop()生成的若干OP_MUL之后紧跟一条清零计数单元的OP_CLEAR，整体对应原来的循环
+                    const int from = ins.from;
+                    indentSource(out, depth) << "if (" << cellSource(from, guarded) << ") {\n";
+                    for (; i < end && program[i].op == OP_MUL && program[i].from == from; i++) {
+                        int factor = program[i].arg < 0 ? -program[i].arg : program[i].arg;
+                        indentSource(out, depth + 1) << cellSource(program[i].offset, guarded)
+                                                     << (program[i].arg < 0 ? " -= " : " += ") << cellSource(from, guarded);
+                        if (factor != 1) {
+                            out << " * " << factor;
+                        }
+                        out << ";\n";
+                    }
+                    if (i < end && program[i].op == OP_CLEAR && program[i].offset == from) {
+                        indentSource(out, depth + 1) << cellSource(from, guarded) << " = 0;\n";
+                    } else {
+                        i--;
+                    }
+                    indentSource(out, depth) << "}\n";
+                    break;
+                }
+                case OP_SCAN:
+                    // 扫描循环无界，回绕和检查越界时都在经过at()的代码中
+                    if (guarded && pointerMode == POINTER_WRAP) {
+                        indentSource(out, depth) << "while (*p) p = at(p, " << ins.arg << ");\n";
+                    } else if (ins.arg == 1 && cellBits == 8 && guarded) {
+                        // 查找范围到磁带末端为止，找不到0时memchr()返回空指针，由reachable()报告越界
+                        indentSource(out, depth) << "if (*at(p, 0)) {\n";
+                        indentSource(out, depth + 1) << "p = (cell*)memchr(p, 0, (size_t)(tape + TAPE_SIZE - p));\n";
+                        pointerCheckSource(out, depth + 1);
+                        indentSource(out, depth) << "}\n";
+                    } else if (ins.arg == 1 && cellBits == 8) {
+                        indentSource(out, depth) << "p = (cell*)memchr(p, 0, (size_t)(tape + TAPE_SIZE - p));\n";
+                    } else {
+                        indentSource(out, depth) << "while (" << cellSource(0, guarded) << ") p += " << ins.arg << ";\n";
+                    }
+                    break;
+                case OP_PRODUCT:
+                    indentSource(out, depth);
+                    if (guarded && pointerMode != POINTER_WRAP) {
+                        out << "if (" << cellSource(ins.from, guarded) << ") "; // 与executeProduct()一样，计数为0时不访问其他单元
+                    }
+                    out << cellSource(ins.offset, guarded) << (ins.arg < 0 ? " -= " : " += ")
+                        << "(unsigned)" << cellSource(ins.from, guarded) << " * " << cellSource(ins.by, guarded);
+                    if (ins.arg != 1 && ins.arg != -1) {
+                        out << " * " << (ins.arg < 0 ? -ins.arg : ins.arg);
+                    }
+                    out << ";\n";
+                    break;
+                case OP_DIVMOD: {
+                    // 检查越界时divmod()/compare()按条件访问单元，整体不在磁带之内就不调用，由其后的循环逐条检查着执行
+                    const bool access = guarded && pointerMode == POINTER_WRAP;
+                    indentSource(out, depth);
+                    if (guarded && !access) {
+                        out << "if (inside(p, " << std::min(ins.offset, ins.from) << ", " << std::max(ins.offset + 1, ins.from + 4) << ")) ";
+                    }
+                    out << "divmod(" << pointerSource(ins.offset, access) << ", "
+                        << (ins.from == ins.offset + 2 ? pointerSource(ins.offset + 1, access) : "0");
+                    for (int k = 0; k <= 4; k++) {
+                        out << ", " << pointerSource(ins.from + k, access);
+                    }
+                    out << ");\n";
+                    break;
+                }
+                case OP_COMPARE: {
+                    const bool access = guarded && pointerMode == POINTER_WRAP;
+                    indentSource(out, depth);
+                    if (guarded && !access) {
+                        int low = std::min(std::min(0, -ins.arg), std::min(ins.from, ins.from + ins.arg));
+                        int high = std::max(std::max(0, -ins.arg), std::max(ins.from, ins.from + ins.arg));
+                        out << "if (inside(p, " << low << ", " << high << ")) ";
+                    }
+                    out << "p = compare(p, " << pointerSource(ins.from, access) << ", "
+                        << pointerSource(ins.from + ins.arg, access) << ", " << pointerSource(-ins.arg, access) << ");\n";
+                    break;
+                }
+            }
+        }
+    }
+
+    // 生成代码中移动指针之后的越界检查，回绕模式下不需要（见generateSource()）
+    void pointerCheckSource(std::ostream& out, int depth) const {
+        if (pointerMode != POINTER_WRAP) {
+            indentSource(out, depth) << "if (!reachable(p)) pointerError();\n";
+        }
+    }
+
+    // 生成代码的缩进
+    static std::ostream& indentSource(std::ostream& out, int depth) {
+        for (int i = 0; i < depth; i++) {
+            out << "    ";
+        }
+        return out;
+    }
+
+    // 生成代码中存放预先执行输出的数组prefixOutput，没有输出时不生成
+    void prefixOutputSource(std::ostream& out) const {
+        if (prefixOutput.empty()) {
+            return;
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(prefixOutput.data());
+        out << "static const unsigned char prefixOutput[] = ";
+        initializerSource(out, std::vector<unsigned int>(bytes, bytes + prefixOutput.size()));
+        out << ";\n\n";
+    }
+
+    // 生成代码中数组的初值列表，每行16个
+    static void initializerSource(std::ostream& out, const std::vector<unsigned int>& values) {
+        out << "{";
+        for (int i = 0; i < (int)values.size(); i++) {
+            out << (i % 16 == 0 ? "\n    " : " ") << values[i] << (i + 1 < (int)values.size() ? "," : "");
+        }
+        out << "\n}";
+    }
+
+    /*
+     * 生成代码中OP_DIVMOD/OP_COMPARE调用的divmod()和compare()，只生成程序中用到的
+     * 与divmodCells()/compareCells()逐条对应，参数为各单元的地址
+     */
+    void idiomSource(std::ostream& out) const {
+        bool divmod = false;
+        bool compare = false;
+        for (int i = 0; i < (int)program.size(); i++) {
+            divmod = divmod || program[i].op == OP_DIVMOD;
+            compare = compare || program[i].op == OP_COMPARE;
+        }
+        if (divmod) {
+            out << "static void divmod(cell* n, cell* copy, cell* c, cell* r, cell* q, cell* t1, cell* t2) {\n"
+                   "    const unsigned long long size = (unsigned long long)(cell)-1 + 1;\n"
+                   "    unsigned long long count = *n, divisor, first, resets = 0, rest;\n"
+                   "    if (count == 0 || *t2) {\n"
+                   "        return;\n"
+                   "    }\n"
+                   "    divisor = (cell)(*c + *r) ? (cell)(*c + *r) : size;\n"
+                   "    first = *c ? *c : size;\n"
+                   "    if (count >= first) {\n"
+                   "        resets = 1 + (count - first) / divisor;\n"
+                   "    }\n"
+                   "    if ((resets && divisor == 1) || (resets < count && *t1)) {\n"
+                   "        return;\n"
+                   "    }\n"
+                   "    if (resets) {\n"
+                   "        rest = (count - first) % divisor;\n"
+                   "        *c = (cell)(divisor - rest);\n"
+                   "        *r = (cell)rest;\n"
+                   "        *q += (cell)resets;\n"
+                   "    } else {\n"
+                   "        *c -= (cell)count;\n"
+                   "        *r += (cell)count;\n"
+                   "    }\n"
+                   "    if (copy) {\n"
+                   "        *copy += (cell)count;\n"
+                   "    }\n"
+                   "    *n = 0;\n"
+                   "}\n\n";
+        }
+        if (compare) {
+            out << "static cell* compare(cell* x, cell* y, cell* between, cell* after) {\n"
+                   "    unsigned long long rounds = *y ? *y : (unsigned long long)(cell)-1 + 1;\n"
+                   "    if (*x == 0) {\n"
+                   "        return x;\n"
+                   "    }\n"
+                   "    if (rounds <= *x) {\n"
+                   "        if ((rounds > 1 && *between) || *after) {\n"
+                   "            return x;\n"
+                   "        }\n"
+                   "        *x -= (cell)rounds;\n"
+                   "        *y = 0;\n"
+                   "        return after;\n"
+                   "    }\n"
+                   "    if (*between) {\n"
+                   "        return x;\n"
+                   "    }\n"
+                   "    *y -= *x;\n"
+                   "    *x = 0;\n"
+                   "    return x;\n"
+                   "}\n\n";
+        }
+    }
+
+    // 生成代码中相对指针p偏移offset处单元地址的写法
+    static std::string pointerSource(int offset, bool wrap) {
+        std::ostringstream ref;
+        if (offset == 0) {
+            ref << "p";
+        } else if (wrap) {
+            ref << "at(p, " << offset << ")";
+        } else {
+            ref << "p " << (offset < 0 ? "- " : "+ ") << (offset < 0 ? -offset : offset);
+        }
+        return ref.str();
+    }
+
+    // 生成代码中相对指针p偏移offset处单元的写法，guarded为true时经过at()（回绕模式下p本身总在磁带之内）
+    std::string cellSource(int offset, bool guarded) const {
+        std::ostringstream ref;
+        if (offset == 0 && (!guarded || pointerMode == POINTER_WRAP)) {
+            ref << "*p";
+        } else if (guarded) {
+            ref << "*at(p, " << offset << ")";
+        } else {
+            ref << "p[" << offset << "]";
+        }
+        return ref.str();
+    }
+
+public:
+    /*
+     * 构造函数 - 初始化磁带和指针
+     * 设置内存指针和指令指针为0，磁带的所有单元初始为0
+     * 参数：
+     * - tapeSize: 磁带的初始单元数（可以扩展时按页大小向上取整），默认为30000
+     * - growable: 访问超出磁带长度的单元时是否自动扩展，为false时作为指针越界处理
+     */
+    explicit BrainfuckCompiler(int tapeSize = MEMORY_SIZE, bool growable = true) : tape(tapeSize, growable) {
+        memory = tape.cells();
+        tapeCells = std::max(tapeSize, 1);
+        cellBits = 8;
+        pointerMode = growable ? POINTER_GROW : POINTER_ERROR;
+        memoryPointer = 0;
+        instructionPointer = 0;
+        prefixBudget = 0;
+        stoppedAt = -1;
+        hitBreakpoint = -1;
+        hitWatchpoint = -1;
+        history = false;
+        historyBytes = 0;
+        historyInterval = HISTORY_INTERVAL;
+        executed = 0;
+        replayTarget = 0;
+        replayScan = false;
+        replayBefore = 0;
+        replayStop = -1;
+        replayWatch = -1;
+        prefixPending = false;
+        prefixPointer = 0;
+        prefixInstruction = 0;
+        threadedHandlers = NULL;
+        threadedStops = NULL;
+        tierThreshold = DEFAULT_TIER_THRESHOLD;
+        profiling = false;
+        resetProfile();
+        counting = false;
+        selectEngine();
+    }
+
+    /*
+     * 设置访问超出磁带长度的单元时是否自动扩展磁带
+     * 等同于setPointerMode(POINTER_GROW)或setPointerMode(POINTER_ERROR)
+     */
+    void setTapeGrowable(bool enabled) {
+        setPointerMode(enabled ? POINTER_GROW : POINTER_ERROR);
+    }
+
+    /*
+     * 设置内存指针越过磁带边界时的处理方式，默认为POINTER_GROW
+     */
+    void setPointerMode(PointerMode mode) {
+        pointerMode = mode;
+        tape.setGrowable(mode == POINTER_GROW);
+        selectEngine();
+    }
+
+    PointerMode getPointerMode() const {
+        return pointerMode;
+    }
+
+    /*
+     * 设置单元宽度
+     * 参数：
+     * - bits: 8、16或32
+     * 返回值：
+     * - 宽度有效返回true，否则返回false且不做修改
+     * 副作用：
+     * - IR与单元宽度有关，已加载的代码会重新加载（内存和指针被重置）
+     */
+    bool setCellBits(int bits) {
+        if (bits != 8 && bits != 16 && bits != 32) {
+            return false;
+        }
+        cellBits = bits;
+        loadCode(code);
+        return true;
+    }
+
+    int getCellBits() const {
+        return cellBits;
+    }
+
+    /*
+     * 设置加载时预先执行的IR指令数上限，0表示不预先执行（默认）
+     * 开启后loadCode()会先执行到程序第一次读取输入为止（或执行完毕、达到上限），
+     * 把这段与输入无关的计算结果作为执行的起点：期间的输出在执行开始时一次写出，
+     * compileToC()/compileToCpp()生成的代码也以它作为磁带的初值；不读取输入的程序只剩下一次写出
+     * 参数：
+     * - steps: 指令数上限，一般取DEFAULT_PREFIX_BUDGET
+     * 副作用：
+     * - 已加载的代码会重新加载（内存和指针被重置）
+     */
+    void setPrefixBudget(long long steps) {
+        prefixBudget = std::max(steps, 0LL);
+        loadCode(code);
+    }
+
+    long long getPrefixBudget() const {
+        return prefixBudget;
+    }
+
+    /*
+     * 设置interpret()是否统计顺序执行的相邻两条、三条IR指令的操作码组合，默认关闭
+     * 开启后改用switch分派执行（不融合超级指令）；统计结果在多次执行、加载不同程序之间累加，
+     * 在一组程序上执行后由writeProfile()输出出现最多的序列，用于挑选超级指令（见packProgram()）
+     */
+    void setProfiling(bool enabled) {
+        profiling = enabled;
+    }
+
+    bool getProfiling() const {
+        return profiling;
+    }
+
+    /*
+     * 清空指令序列统计
+     */
+    void resetProfile() {
+        pairCounts.assign(OP_KINDS * OP_KINDS, 0);
+        tripleCounts.assign(OP_KINDS * OP_KINDS * OP_KINDS, 0);
+    }
+
+    /*
+     * 输出出现次数最多的top个两条指令序列和三条指令序列，每行一个，格式与packProgram()中的超级指令表相同，
+     * 例如 "{ OP_ADD, OP_MOVE, -1 }, // op_add_move: 123456 (12.3%)"，百分比为占全部同长度序列的比例
+     * 参数：
+     * - out: 输出目标
+     * - top: 每种长度输出的序列数
+     */
+    void writeProfile(std::ostream& out, int top) const {
+        static const char* const constants[OP_KINDS] = {
+            "OP_ADD", "OP_MOVE", "OP_OUTPUT", "OP_INPUT", "OP_LOOP_START", "OP_LOOP_END",
+            "OP_CLEAR", "OP_MUL", "OP_SCAN", "OP_PRODUCT", "OP_DIVMOD", "OP_COMPARE"
+        };
+        for (int length = 2; length <= 3; length++) {
+            const std::vector<long long>& counts = (length == 2) ? pairCounts : tripleCounts;
+            long long total = 0;
+            std::vector<std::pair<long long, int> > ranked;
+            for (int i = 0; i < (int)counts.size(); i++) {
+                total += counts[i];
+                if (counts[i] > 0) {
+                    ranked.push_back(std::make_pair(-counts[i], i));
+                }
+            }
+            std::sort(ranked.begin(), ranked.end());
+            out << "// " << length << "-instruction sequences, " << total << " in total\n";
+            for (int k = 0; k < top && k < (int)ranked.size(); k++) {
+                const int index = ranked[k].second;
+                const int ops[3] = { (length == 2) ? index / OP_KINDS : index / (OP_KINDS * OP_KINDS),
+                                     (length == 2) ? index % OP_KINDS : index / OP_KINDS % OP_KINDS,
+                                     (length == 2) ? -1 : index % OP_KINDS };
+                std::ostringstream name;
+                name << "op";
+                for (int j = 0; j < length; j++) {
+                    name << "_" << opName(ops[j]);
+                }
+                const long long permille = -ranked[k].first * 1000 / total;
+                out << "{ " << constants[ops[0]] << ", " << constants[ops[1]] << ", " << (ops[2] < 0 ? "-1" : constants[ops[2]])
+                    << " }, // " << name.str() << ": " << -ranked[k].first << " (" << permille / 10 << "." << permille % 10 << "%)\n";
+            }
+        }
+    }
+
+    /*
+     * 设置interpret()是否统计每条IR指令的执行次数和每个循环进入循环体的次数，默认关闭
+     * 开启后改用switch分派执行（不融合超级指令）；统计在loadCode()和restart()时清零，
+     * 执行后由getLoopProfile()和getSourceCosts()取得，用于找出值得手工优化的热点循环，
+     * 以及优化器没有改写为闭式计算的循环写法
+     * 注意：
+     * - 预先执行的部分（见setPrefixBudget()）不计入，需要完整统计时应把上限设为0
+     * - setProfiling()同时开启时只统计指令序列
+     */
+    void setCounting(bool enabled) {
+        counting = enabled;
+    }
+
+    bool getCounting() const {
+        return counting;
+    }
 
     /*
-     * 预计算循环跳转位置，优化执行性能
-     * 构建'['和']'指令之间的映射关系，避免运行时重复查找
+     * 获取每个循环的执行统计（见LoopProfile），按自身代价从大到小排列
+     * 已被改写为清零、乘法、扫描等闭式计算的循环不再是循环，不出现在结果中；未配对的括号也不算循环
      */
-    void precomputeJumps() {
-        std::stack<int> loopStartStack;
-        for (int i = 0; i < code.length(); i++) {
-            if (code[i] == '[') {
-                loopStartStack.push(i);
-            } else if (code[i] == ']') {
-                if (!loopStartStack.empty()) {
-                    int startPos = loopStartStack.top();
-                    loopStartStack.pop();
-                    jumpTable[startPos] = i;
-                    jumpTable[i] = startPos;
+    std::vector<LoopProfile> getLoopProfile() const {
+        std::vector<LoopProfile> loops;
+        std::vector<int> open; // 包含当前指令的各层循环在loops中的下标，最内层在最后
+        for (int i = 0; i < (int)program.size(); i++) {
+            const Instruction& ins = program[i];
+            if (ins.op == OP_LOOP_START && ins.arg != 0) {
+                LoopProfile loop;
+                loop.start = ins.source;
+                loop.end = program[i + ins.arg].source;
+                loop.depth = (int)open.size();
+                loop.entries = loopEntries[i];
+                loop.iterations = executionCounts[i + ins.arg]; // 每轮都以']'结束
+                loop.selfCost = 0;
+                loop.totalCost = 0;
+                open.push_back((int)loops.size());
+                loops.push_back(loop);
+            }
+            if (!open.empty()) {
+                loops[open.back()].selfCost += executionCounts[i];
+                for (int k = 0; k < (int)open.size(); k++) {
+                    loops[open[k]].totalCost += executionCounts[i];
                 }
             }
+            if (ins.op == OP_LOOP_END && ins.arg != 0) {
+                open.pop_back();
+            }
         }
+        std::sort(loops.begin(), loops.end(), bySelfCost);
+        return loops;
     }
 
-public:
     /*
-     * 构造函数 - 初始化内存和指针
-     * 设置内存指针和指令指针为0，并将所有内存单元初始化为0
+     * 获取过滤后代码中每个位置的执行代价：从这个位置开始的IR指令的执行次数之和，
+     * 折叠后的一条指令（如"+++"）计在第一个字符上，用于把统计标注到源代码的行上
      */
-    BrainfuckCompiler() {
-        memoryPointer = 0;
-        instructionPointer = 0;
-        // 初始化内存为0
-        for (int i = 0; i < MEMORY_SIZE; i++) {
-            memory[i] = 0;
+    std::vector<long long> getSourceCosts() const {
+        std::vector<long long> costs(code.length(), 0);
+        for (int i = 0; i < (int)program.size(); i++) {
+            if (program[i].source < (int)code.length()) { // 末尾补上的指针移动（见addressByOffset()）不对应任何字符
+                costs[program[i].source] += executionCounts[i];
+            }
         }
+        return costs;
+    }
+
+    /*
+     * 设置tiered()中循环编译为机器码所需的回跳次数，默认为DEFAULT_TIER_THRESHOLD
+     * 阈值越小越早编译，为1时每个回跳过一次的循环都会编译；不影响interpret()和jit()
+     */
+    void setTierThreshold(int backEdgeCount) {
+        tierThreshold = std::max(backEdgeCount, 1);
+    }
+
+    int getTierThreshold() const {
+        return tierThreshold;
+    }
+
+    /*
+     * 设置读到输入末尾后','的处理方式，等同于getInput().setEofMode()
+     */
+    void setEofMode(InputSource::EofMode mode) {
+        input.setEofMode(mode);
+        selectEngine();
+    }
+
+    /*
+     * 获取设置的磁带单元数，不按页大小取整
+     * 回绕和报错模式下即为磁带长度；扩展模式下为初始长度，访问更右侧的单元时磁带随之扩展
+     */
+    int getTapeSize() const {
+        return tapeCells;
+    }
+
+    /*
+     * 设置'.'指令的输出是否按行刷新
+     * 默认只在缓冲区满、读取输入前和执行结束时刷新；
+     * 交互式程序需要每输出一行就立即显示时应开启
+     */
+    void setOutputLineBuffered(bool enabled) {
+        output.setLineBuffered(enabled);
+    }
+
+    /*
+     * 获取','指令的输入来源，用于改为从文件或内存读取、设置EOF处理方式
+     * 默认从标准输入读取，EOF时写入-1
+     * 注意：
+     * - 执行前会按当前的EOF处理方式重新选择解释器实例
+     */
+    InputSource& getInput() {
+        return input;
     }
 
     /*
      * 加载Brainfuck代码
      * 参数：
-     * - program: 要加载的Brainfuck代码字符串
+     * - source: 要加载的Brainfuck代码字符串
+     * 返回值：
+     * - 所有'['和']'都能配对返回true，否则返回false（未配对的括号在执行时被忽略）
      * 副作用：
      * - 重置内存和所有指针
-     * - 预计算跳转表
+     * - 生成折叠后的IR，预计算跳转表，改写常见循环和嵌套循环，再改写为按偏移寻址，最后编码为解释器使用的紧凑形式
+     * - 设置了setPrefixBudget()时预先执行到第一次读取输入为止，内存和指针停在那里
      */
-    void loadCode(const std::string& program) {
-        code = program;
+    bool loadCode(const std::string& source) {
+        code = source;
         instructionPointer = 0;
         memoryPointer = 0;
+        stoppedAt = -1;
         // 重置内存
-        for (int i = 0; i < MEMORY_SIZE; i++) {
-            memory[i] = 0;
+        prepareTape();
+        selectEngine();
+        // 生成IR，预计算跳转表，再改写常见循环和指针移动
+        buildProgram();
+        bool balanced = precomputeJumps();
+        optimizeLoops();
+        lowerNestedLoops();
+        addressByOffset();
+        analyzePointerRange();
+        evaluatePrefix();
+        packProgram();
+        markBreakpoints();
+        resetHistory();
+        resetCounts();
+        return balanced;
+    }
+
+    /*
+     * 回到loadCode()刚结束时的状态，用于再次执行已加载的代码
+     * 磁带恢复为预先执行的结果，指针回到执行起点，预先执行的输出重新等待写出
+     */
+    void restart() {
+        prepareTape();
+        for (int i = 0; i < (int)prefixCells.size(); i++) {
+            setCellAt(i, prefixCells[i]);
         }
-        // 预计算跳转表
-        precomputeJumps();
+        memoryPointer = prefixPointer;
+        instructionPointer = prefixInstruction;
+        prefixPending = !prefixOutput.empty();
+        stoppedAt = -1;
+        resetHistory();
+        resetCounts();
     }
 
     /*
@@ -188,90 +4542,124 @@ public:
 
     /*
      * 解释执行完整的Brainfuck代码
-     * 逐条执行代码中的指令，直到执行完毕
+     * 逐条执行折叠后的IR指令，直到执行完毕
+     * 编译器支持时使用直接线索化分派（见interpretThreaded()），否则使用switch分派
+     * 按当前的单元宽度、指针越界方式和EOF处理方式选择对应的解释器实例（见selectEngine()）
+     * 返回值：
+     * - 执行完毕返回true，内存指针越界（小于0或超出不可扩展的磁带）时返回false
      */
-    void interpret() {
-        while (instructionPointer < code.length()) {
-            switch (code[instructionPointer]) {
-                case '+': // 增加内存值
-                    memory[memoryPointer]++;
-                    break;
-                case '-': // 减少内存值
-                    memory[memoryPointer]--;
-                    break;
-                case '>': // 内存指针右移
-                    memoryPointer = (memoryPointer + 1) % MEMORY_SIZE;
-                    break;
-                case '<': // 内存指针左移
-                    memoryPointer = (memoryPointer - 1 + MEMORY_SIZE) % MEMORY_SIZE;
-                    break;
-                case '.': // 输出内存值
-                    std::cout << memory[memoryPointer];
-                    break;
-                case ',': // 输入值到内存
-                    memory[memoryPointer] = getchar();
-                    break;
-                case '[': // 循环开始
-                    if (memory[memoryPointer] == 0) {
-                        // 如果当前内存值为0，跳转到对应的']'
-                        instructionPointer = jumpTable[instructionPointer];
-                    }
-                    break;
-                case ']': // 循环结束
-                    if (memory[memoryPointer] != 0) {
-                        // 如果当前内存值不为0，跳转到对应的'['
-                        instructionPointer = jumpTable[instructionPointer];
-                    }
-                    break;
-            }
-            instructionPointer++;
+    bool interpret() {
+        selectEngine();
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            return false;
+        }
+        writePrefixOutput();
+        (this->*(profiling ? engine.profile : counting ? engine.count : engine.run))();
+        output.flush();
+        return pointerInRange();
+    }
+
+    /*
+     * 以JIT方式执行完整的Brainfuck代码
+     * 把IR翻译为x86-64机器码放入可执行内存后直接调用，输入输出通过回调交给宿主完成，
+     * 省去了每条指令的分派开销，也不需要调用外部编译器
+     * 返回值：
+     * - 与interpret()相同，内存指针越界时返回false
+     * 注意：
+     * - 从instructionPointer处开始执行，预先执行或step()已经执行过的部分不再重复
+     * - 非x86-64平台、单元宽度不是8位、指针需要回绕（见needsWrap()）或括号不匹配时，退回interpret()
+     */
+    bool jit() {
+        if (!compileNative()) {
+            return interpret();
+        }
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            jitCode.release();
+            output.flush();
+            return false;
+        }
+        writePrefixOutput();
+        JitFunction function = reinterpret_cast<JitFunction>(jitCode.entry());
+        char* pointer = function(this, memory, memory + memoryPointer);
+        memoryPointer = static_cast<int>(pointer - memory);
+        instructionPointer = (int)program.size();
+        jitCode.release();
+        output.flush();
+        return pointerInRange();
+    }
+
+    /*
+     * 分层执行完整的Brainfuck代码
+     * 先解释执行，同时按']'的回跳次数找出热点循环，回跳达到阈值（见setTierThreshold()）的循环才编译为机器码，
+     * 此后再进入这个循环时直接执行机器码：短程序保留解释执行的启动速度，长时间运行的程序不为冷代码付出编译开销，
+     * 热点循环中得到与jit()相同的速度
+     * 返回值：
+     * - 与interpret()相同，内存指针越界时返回false
+     * 注意：
+     * - 从instructionPointer处开始执行，预先执行或step()已经执行过的部分不再重复
+     * - 不支持JIT时（见nativeCells()）等同于interpret()
+     */
+    bool tiered() {
+        if (!nativeCells()) {
+            return interpret();
+        }
+        backEdges.assign(program.size(), 0);
+        tierEntries.assign(program.size(), -1);
+        hotLoops.clear();
+
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            tierCode.release();
+            output.flush();
+            return false;
         }
+        writePrefixOutput();
+        if (needsWrap()) {
+            interpretTieredWith<POINTER_WRAP>();
+        } else if (pointerMode == POINTER_ERROR) {
+            interpretTieredWith<POINTER_ERROR>();
+        } else {
+            interpretTieredWith<POINTER_GROW>();
+        }
+        tierCode.release();
+        output.flush();
+        return pointerInRange();
     }
 
     /*
      * 单步执行Brainfuck代码，用于调试
-     * 执行当前指令指针指向的一条指令，然后将指令指针向前移动
+     * 执行当前指令指针指向的一条IR指令（可能对应多个连续的源字符），然后将指令指针向前移动
      * 返回值：
      * - 如果执行了指令返回true
-     * - 如果程序已执行完毕返回false
+     * - 如果程序已执行完毕或内存指针越界返回false
      */
     bool step() {
-        if (instructionPointer >= code.length()) {
+        // 加载时预先执行的输出在第一步之前写出；预先执行完整个程序时不会再执行任何指令
+        writePrefixOutput();
+        if (instructionPointer >= (int)program.size()) {
+            output.flush();
             return false; // 执行完毕
         }
 
-        switch (code[instructionPointer]) {
-            case '+':
-                memory[memoryPointer]++;
-                break;
-            case '-':
-                memory[memoryPointer]--;
-                break;
-            case '>':
-                memoryPointer = (memoryPointer + 1) % MEMORY_SIZE;
-                break;
-            case '<':
-                memoryPointer = (memoryPointer - 1 + MEMORY_SIZE) % MEMORY_SIZE;
-                break;
-            case '.':
-                std::cout << memory[memoryPointer];
-                break;
-            case ',':
-                memory[memoryPointer] = getchar();
-                break;
-            case '[':
-                if (memory[memoryPointer] == 0) {
-                    instructionPointer = jumpTable[instructionPointer];
-                }
-                break;
-            case ']':
-                if (memory[memoryPointer] != 0) {
-                    instructionPointer = jumpTable[instructionPointer];
-                }
-                break;
+        selectEngine();
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            return false; // 内存指针越界
         }
+        (this->*engine.step)();
         instructionPointer++;
-        return true;
+        stoppedAt = -1;
+        hitBreakpoint = -1;
+        hitWatchpoint = -1;
+        if (history) {
+            recordInstruction();
+        }
+        output.flush(); // 单步调试时每一步的输出都要立即可见
+        return instructionPointer < (int)program.size() || pointerInRange();
     }
 
     /*
@@ -283,13 +4671,13 @@ public:
     void printMemoryState(int range = 10) {
         std::cout << "Memory state around pointer (" << memoryPointer << "):\n";
         int start = std::max(0, memoryPointer - range);
-        int end = std::min(MEMORY_SIZE - 1, memoryPointer + range);
+        int end = std::min(accessibleCells() - 1, memoryPointer + range);
         
         for (int i = start; i <= end; i++) {
             if (i == memoryPointer) {
-                std::cout << "[" << static_cast<int>(memory[i]) << "] ";
+                std::cout << "[" << cellAt(i) << "] ";
             } else {
-                std::cout << static_cast<int>(memory[i]) << " ";
+                std::cout << cellAt(i) << " ";
             }
         }
         std::cout << std::endl;
@@ -301,102 +4689,659 @@ public:
      */
     void printCurrentState() {
         std::cout << "Current state:\n";
-        std::cout << "  Memory pointer: " << memoryPointer << " (value: " << static_cast<int>(memory[memoryPointer]) << ")\n";
+        std::cout << "  Memory pointer: " << memoryPointer;
+        if (memoryPointer >= 0 && memoryPointer < accessibleCells()) {
+            std::cout << " (value: " << cellAt(memoryPointer) << ")";
+        }
+        std::cout << "\n";
         std::cout << "  Instruction pointer: " << instructionPointer;
-        if (instructionPointer < code.length()) {
-            std::cout << " (next instruction: '" << code[instructionPointer] << "')";
+        if (instructionPointer < (int)program.size()) {
+            const Instruction& ins = program[instructionPointer];
+            std::cout << " (next instruction: '" << code[ins.source] << "'";
+            if (ins.op == OP_ADD || ins.op == OP_MOVE) {
+                std::cout << " folded, net " << ins.arg;
+            } else if (ins.op >= OP_CLEAR) {
+                std::cout << " loop lowered to " << opName(ins.op);
+            }
+            if (ins.offset != 0) {
+                std::cout << ", cell offset " << ins.offset;
+            }
+            std::cout << ", source position: " << ins.source << ")";
         }
         std::cout << std::endl;
     }
 
     /*
-     * 将Brainfuck代码编译为等价的C代码
+     * 添加断点，执行到过滤后代码中position处的字符所属的IR指令之前时，条件成立则由debugContinue()停下
+     * 折叠或改写过的字符没有单独的指令，停在包含它的指令之前；加载时预先执行过的部分（见setPrefixBudget()）不会停下
+     * 参数：
+     * - position: 过滤后代码中的位置
+     * - condition/value: 停下的条件，默认总是停下
+     * - cell: 条件检查的单元，默认（-1）为这条指令访问的单元
      * 返回值：
-     * - 生成的C代码字符串
+     * - 断点在getBreakpoints()中的下标；position超出代码范围时不添加，返回-1
      */
-    std::string compileToC() {
-        std::string cCode = "#include <stdio.h>\n\n";
-        cCode += "int main() {\n";
-        cCode += "    unsigned char memory[30000] = {0};\n";
-        cCode += "    unsigned char* ptr = memory;\n\n";
-
-        for (int i = 0; i < code.length(); i++) {
-            switch (code[i]) {
-                case '+':
-                    cCode += "    ++(*ptr);\n";
-                    break;
-                case '-':
-                    cCode += "    --(*ptr);\n";
-                    break;
-                case '>':
-                    cCode += "    ++ptr;\n";
-                    break;
-                case '<':
-                    cCode += "    --ptr;\n";
-                    break;
-                case '.':
-                    cCode += "    putchar(*ptr);\n";
-                    break;
-                case ',':
-                    cCode += "    *ptr = getchar();\n";
-                    break;
-                case '[':
-                    cCode += "    while (*ptr) {\n";
-                    break;
-                case ']':
-                    cCode += "    }\n";
-                    break;
+    int addBreakpoint(int position, BreakCondition condition = BREAK_ALWAYS, int cell = -1, unsigned int value = 0) {
+        if (position < 0 || position >= (int)code.length()) {
+            return -1;
+        }
+        Breakpoint point;
+        point.position = position;
+        point.condition = condition;
+        point.cell = cell;
+        point.value = value;
+        breakpoints.push_back(point);
+        markBreakpoints();
+        return (int)breakpoints.size() - 1;
+    }
+
+    /*
+     * 删除getBreakpoints()中下标为index的断点，之后的断点下标依次减1
+     * 返回值：
+     * - 下标无效时返回false
+     */
+    bool removeBreakpoint(int index) {
+        if (index < 0 || index >= (int)breakpoints.size()) {
+            return false;
+        }
+        breakpoints.erase(breakpoints.begin() + index);
+        markBreakpoints();
+        return true;
+    }
+
+    /*
+     * 删除所有断点
+     */
+    void clearBreakpoints() {
+        breakpoints.clear();
+        markBreakpoints();
+    }
+
+    /*
+     * 获取已设置的断点
+     */
+    const std::vector<Breakpoint>& getBreakpoints() const {
+        return breakpoints;
+    }
+
+    /*
+     * 从当前位置全速执行到下一个条件成立的断点、命中的观察点或程序结束，用于调试
+     * 两个断点之间使用与interpret()相同的解释器（有断点的指令换成停止执行的处理代码，其余指令不做额外检查），
+     * 只在到达有断点的指令时检查条件，条件不成立时执行这一条后继续全速执行
+     * 设置了观察点或开启了历史记录时改用逐条检查的解释器（见watchWith()），两者都取消后恢复全速
+     * 上次停在断点或'.'之前时，先执行那条指令再继续，不会在原地重复停下；期间可以调用step()单步执行，
+     * 单步执行期间观察点单元的改变不会在继续时命中
+     * 返回值：
+     * - DEBUG_BREAKPOINT: 停在断点处，getHitBreakpoint()为条件成立的断点，断点所在的指令还没有执行
+     * - DEBUG_WATCHPOINT: 观察点命中，getHitWatchpoint()为命中的观察点
+     * - DEBUG_FINISHED: 程序执行完毕
+     * - DEBUG_ERROR: 内存指针越界
+     */
+    DebugStop debugContinue() {
+        selectEngine();
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            stoppedAt = -1;
+            return DEBUG_ERROR;
+        }
+        writePrefixOutput();
+        refreshWatchValues();
+        hitBreakpoint = -1;
+        hitWatchpoint = -1;
+        while (instructionPointer < (int)program.size()) {
+            if (instructionPointer != stoppedAt) {
+                if (breakFlags[instructionPointer]) {
+                    hitBreakpoint = matchBreakpoint(instructionPointer);
+                    if (hitBreakpoint >= 0) {
+                        stoppedAt = instructionPointer;
+                        output.flush();
+                        return DEBUG_BREAKPOINT;
+                    }
+                }
+                hitWatchpoint = matchWatchOutput(instructionPointer);
+                if (hitWatchpoint >= 0) {
+                    stoppedAt = instructionPointer;
+                    output.flush();
+                    return DEBUG_WATCHPOINT;
+                }
+            }
+            if (breakFlags[instructionPointer] || instructionPointer == stoppedAt) {
+                // 从停下的位置继续，或断点条件不成立：执行这一条后继续
+                const int op = program[instructionPointer].op;
+                (this->*engine.step)();
+                instructionPointer++;
+                stoppedAt = -1;
+                if (history) {
+                    recordInstruction();
+                }
+                hitWatchpoint = writesCells(op) ? matchWatchChange() : -1;
+            } else {
+                (this->*((watchpoints.empty() && !history) ? engine.debug : engine.watch))();
+            }
+            if (hitWatchpoint >= 0) {
+                if (watchpoints[hitWatchpoint].kind == WATCH_OUTPUT) {
+                    stoppedAt = instructionPointer;
+                }
+                output.flush();
+                return DEBUG_WATCHPOINT;
             }
         }
+        stoppedAt = -1;
+        output.flush();
+        return pointerInRange() ? DEBUG_FINISHED : DEBUG_ERROR;
+    }
+
+    /*
+     * 获取debugContinue()上次停下时条件成立的断点在getBreakpoints()中的下标
+     */
+    int getHitBreakpoint() const {
+        return hitBreakpoint;
+    }
+
+    /*
+     * 添加观察点，由debugContinue()在单元改变、变为指定值或被'.'输出时停下
+     * 设置了观察点期间debugContinue()逐条检查，比只有断点时慢；interpret()等正常执行不受影响
+     * 检查的是每条IR指令执行后的值，折叠的加减和改写的循环一次写入结果，中间值不会命中WATCH_EQUAL
+     * 参数：
+     * - cell: 观察的单元
+     * - kind: 停下的时机
+     * - value: WATCH_EQUAL时比较的值
+     * 返回值：
+     * - 观察点在getWatchpoints()中的下标；cell小于0时不添加，返回-1
+     */
+    int addWatchpoint(int cell, WatchKind kind = WATCH_CHANGE, unsigned int value = 0) {
+        if (cell < 0) {
+            return -1;
+        }
+        Watchpoint point;
+        point.cell = cell;
+        point.kind = kind;
+        point.value = value;
+        watchpoints.push_back(point);
+        refreshWatchValues();
+        return (int)watchpoints.size() - 1;
+    }
+
+    /*
+     * 删除getWatchpoints()中下标为index的观察点，之后的观察点下标依次减1
+     * 返回值：
+     * - 下标无效时返回false
+     */
+    bool removeWatchpoint(int index) {
+        if (index < 0 || index >= (int)watchpoints.size()) {
+            return false;
+        }
+        watchpoints.erase(watchpoints.begin() + index);
+        refreshWatchValues();
+        return true;
+    }
+
+    /*
+     * 删除所有观察点
+     */
+    void clearWatchpoints() {
+        watchpoints.clear();
+        watchValues.clear();
+    }
+
+    /*
+     * 获取已设置的观察点
+     */
+    const std::vector<Watchpoint>& getWatchpoints() const {
+        return watchpoints;
+    }
+
+    /*
+     * 获取debugContinue()上次停下时命中的观察点在getWatchpoints()中的下标
+     */
+    int getHitWatchpoint() const {
+        return hitWatchpoint;
+    }
+
+    /*
+     * 设置是否记录执行历史，开启后才能用reverseStep()和reverseContinue()倒退
+     * 记录期间debugContinue()和step()每执行一段指令保存一个检查点（磁带、指针和输入位置），
+     * 读到的输入也被记录，倒退后再向前执行时读到相同的输入；检查点的间隔随记录变长而加倍，占用的内存有上限
+     * 记录期间debugContinue()逐条执行，比不记录时慢；interpret()等正常执行不受影响
+     * 开启或关闭都从当前状态重新开始记录，loadCode()和restart()之后也重新开始
+     */
+    void setHistory(bool enabled) {
+        history = enabled;
+        resetHistory();
+    }
+
+    bool getHistory() const {
+        return history;
+    }
+
+    /*
+     * 获取开始记录历史以来执行的指令数，倒退时随之减少
+     */
+    long long getExecuted() const {
+        return executed;
+    }
+
+    /*
+     * 倒退count条指令：恢复之前最近的检查点，再全速重新执行到目标位置
+     * 重新执行期间的输出被丢弃；倒退之后再向前执行时，已经输出过的字符会再次输出
+     * 返回值：
+     * - 倒退了返回true；没有开启历史记录或已在历史记录的起点时返回false
+     */
+    bool reverseStep(long long count = 1) {
+        if (!history || executed <= checkpoints[0].executed || count <= 0) {
+            return false;
+        }
+        const long long target = std::max(executed - count, checkpoints[0].executed);
+        selectEngine();
+        output.flush();
+        FILE* previousTarget = output.redirect(NULL);
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            output.redirect(previousTarget);
+            return false;
+        }
+        restoreCheckpoint(checkpointBefore(target));
+        replayTarget = target;
+        replayScan = false;
+        (this->*engine.replay)();
+        output.flush();
+        output.redirect(previousTarget);
+        stoppedAt = -1;
+        hitBreakpoint = -1;
+        hitWatchpoint = -1;
+        return true;
+    }
+
+    /*
+     * 倒退到上一次debugContinue()会停下的位置（条件成立的断点或命中的观察点）
+     * 从最近的检查点开始逐段向前查找：每段从检查点重新执行，记下其中最后一个会停下的位置，
+     * 这一段没有时再从更早的检查点查找，找到后恢复到那里
+     * 返回值：
+     * - DEBUG_BREAKPOINT/DEBUG_WATCHPOINT: 停在那里，getHitBreakpoint()/getHitWatchpoint()与向前执行时停下的相同
+     * - DEBUG_HISTORY_START: 途中没有会停下的位置，已回到历史记录的起点
+     * - DEBUG_ERROR: 没有开启历史记录
+     */
+    DebugStop reverseContinue() {
+        if (!history) {
+            return DEBUG_ERROR;
+        }
+        const long long now = executed;
+        selectEngine();
+        output.flush();
+        FILE* previousTarget = output.redirect(NULL);
+        Tape::Session session(tape);
+        if (BFX_TAPE_SETJMP(tape.jumpBuffer()) != 0) {
+            output.flush();
+            output.redirect(previousTarget);
+            return DEBUG_ERROR;
+        }
+        int index = checkpointBefore(now - 1);
+        replayStop = -1;
+        for (; index >= 0 && checkpoints[index].executed < now; index--) {
+            restoreCheckpoint(index);
+            refreshWatchValues();
+            replayTarget = (index + 1 < (int)checkpoints.size()) ? std::min(checkpoints[index + 1].executed, now) : now;
+            replayScan = true;
+            replayBefore = (stoppedAt < 0 && hitWatchpoint >= 0) ? now : now + 1; // 停在改变类观察点时不再停在原处
+            (this->*engine.replay)();
+            replayScan = false;
+            if (replayStop >= 0) {
+                break;
+            }
+        }
+        hitBreakpoint = -1;
+        hitWatchpoint = -1;
+        stoppedAt = -1;
+        DebugStop stop = DEBUG_HISTORY_START;
+        if (replayStop < 0) {
+            restoreCheckpoint(0);
+        } else {
+            restoreCheckpoint(index);
+            replayTarget = replayStop;
+            (this->*engine.replay)();
+            stop = DEBUG_WATCHPOINT;
+            if (replayWatch >= 0) {
+                hitWatchpoint = replayWatch;
+            } else {
+                // 停在指令之前，按debugContinue()的顺序先检查断点，继续时先执行这一条
+                stoppedAt = instructionPointer;
+                if (breakFlags[instructionPointer]) {
+                    hitBreakpoint = matchBreakpoint(instructionPointer);
+                }
+                if (hitBreakpoint >= 0) {
+                    stop = DEBUG_BREAKPOINT;
+                } else {
+                    hitWatchpoint = matchWatchOutput(instructionPointer);
+                }
+            }
+        }
+        output.flush();
+        output.redirect(previousTarget);
+        return stop;
+    }
+
+    /*
+     * 获取下一条要执行的指令在过滤后代码中的位置，执行完毕时为代码长度
+     */
+    int getSourcePosition() const {
+        if (instructionPointer >= (int)program.size()) {
+            return (int)code.length();
+        }
+        return (int)program[instructionPointer].source;
+    }
+
+    /*
+     * 获取当前的内存指针
+     */
+    int getMemoryPointer() const {
+        return memoryPointer;
+    }
 
-        cCode += "\n    return 0;\n";
-        cCode += "}";
-        return cCode;
+    /*
+     * 将Brainfuck代码编译为等价的C代码
+     * 由优化后的IR生成（见generateSource()），输出经过缓冲
+     * 返回值：
+     * - 生成的C代码字符串
+     */
+    std::string compileToC() {
+        return generateSource(false);
     }
 
     /*
      * 将Brainfuck代码编译为等价的C++代码
+     * 与compileToC()生成相同的程序，只是使用C++的头文件
      * 返回值：
      * - 生成的C++代码字符串
      */
     std::string compileToCpp() {
-        std::string cppCode = "#include <iostream>\n\n";
-        cppCode += "int main() {\n";
-        cppCode += "    unsigned char memory[30000] = {0};\n";
-        cppCode += "    unsigned char* ptr = memory;\n\n";
-
-        for (int i = 0; i < code.length(); i++) {
-            switch (code[i]) {
-                case '+':
-                    cppCode += "    ++(*ptr);\n";
+        return generateSource(true);
+    }
+
+    /*
+     * 将Brainfuck代码编译为x86-64汇编（GNU as，Intel语法，Linux）
+     * 生成的程序不依赖C库，直接通过read/write/exit系统调用完成输入输出，输出经过64KB的缓冲区；
+     * 指令与compileToElf()写出的机器码一一对应；磁带前面同样留出一页空隙（guard），启动时用mprotect设为不可访问，
+     * 指针越过磁带左端时触发段错误，不会写进输入输出缓冲区
+     * 汇编和链接：as -o prog.o prog.s && ld -o prog prog.o
+     * 返回值：
+     * - 生成的汇编代码字符串；单元宽度不是8位或指针需要回绕（见needsWrap()）时返回空字符串
+     */
+    std::string compileToAsm() {
+        if (cellBits != 8 || needsWrap()) {
+            return "";
+        }
+        std::ostringstream out;
+        out << "# Brainfuck IDE生成的x86-64汇编\n"
+               "# as -o prog.o prog.s && ld -o prog prog.o\n"
+               "    .intel_syntax noprefix\n"
+               "    .bss\n"
+               "    .balign 4096\n"
+               "buffers:\n"
+               "    .skip " << ELF_BUFFER_SIZE * 2 << "\n"
+               "    .balign 4096\n"
+               "guard:\n"
+               "    .skip 4096\n"
+               "tape:\n"
+               "    .skip " << nativeTapeBytes() << "\n"
+               "    .text\n"
+               "    .globl _start\n\n";
+
+        // 运行时子程序，寄存器用途见emitElfRuntime()
+        out << "flush:\n"
+               "    mov rsi, r12\n"
+               "    mov rdx, r13\n"
+               ".Lflush_loop:\n"
+               "    test rdx, rdx\n"
+               "    jle .Lflush_done\n"
+               "    mov edi, 1\n"
+               "    mov eax, 1\n"
+               "    syscall\n"
+               "    test rax, rax\n"
+               "    jle .Lflush_done\n"
+               "    add rsi, rax\n"
+               "    sub rdx, rax\n"
+               "    jmp .Lflush_loop\n"
+               ".Lflush_done:\n"
+               "    xor r13d, r13d\n"
+               "    ret\n\n";
+        out << "put:\n"
+               "    mov byte ptr [r12 + r13], al\n"
+               "    inc r13\n"
+               "    cmp r13, " << ELF_BUFFER_SIZE << "\n"
+               "    je flush\n"
+               "    ret\n\n";
+        out << "get:\n"
+               "    cmp r14, r15\n"
+               "    jb .Lget_have\n"
+               "    call flush\n"
+               "    xor edi, edi\n"
+               "    lea rsi, [r12 + " << ELF_BUFFER_SIZE << "]\n"
+               "    mov edx, " << ELF_BUFFER_SIZE << "\n"
+               "    xor eax, eax\n"
+               "    syscall\n"
+               "    xor r14d, r14d\n"
+               "    mov r15, rax\n"
+               "    test rax, rax\n"
+               "    jg .Lget_have\n"
+               "    xor r15d, r15d\n"
+               "    mov eax, -1\n"
+               "    ret\n"
+               ".Lget_have:\n"
+               "    movzx eax, byte ptr [r12 + r14 + " << ELF_BUFFER_SIZE << "]\n"
+               "    inc r14\n"
+               "    ret\n\n";
+
+        out << "_start:\n"
+               "    lea rdi, [rip + guard]\n"
+               "    mov esi, 4096\n"
+               "    xor edx, edx\n"
+               "    mov eax, 10\n"
+               "    syscall\n"
+               "    lea rbx, [rip + tape]\n"
+               "    lea r12, [rip + buffers]\n"
+               "    xor r13d, r13d\n"
+               "    xor r14d, r14d\n"
+               "    xor r15d, r15d\n";
+
+        std::vector<int> loopLabels; // 尚未结束的循环的标签编号
+        int labelCount = 0;
+        for (int i = 0; i < (int)program.size(); i++) {
+            const Instruction& ins = program[i];
+            switch (ins.op) {
+                case OP_ADD:
+                    out << "    add " << asmCell(ins.offset) << ", " << (ins.arg & 0xFF) << "\n";
+                    break;
+                case OP_MOVE:
+                    out << "    add rbx, " << ins.arg << "\n";
                     break;
-                case '-':
-                    cppCode += "    --(*ptr);\n";
+                case OP_OUTPUT:
+                    out << "    mov al, " << asmCell(ins.offset) << "\n"
+                           "    call put\n";
+                    break;
+                case OP_INPUT:
+                    out << "    call get\n";
+                    if (input.getEofMode() == InputSource::EOF_ZERO) {
+                        out << "    test eax, eax\n"
+                               "    jns 1f\n"
+                               "    xor eax, eax\n"
+                               "1:\n";
+                    } else if (input.getEofMode() == InputSource::EOF_UNCHANGED) {
+                        out << "    test eax, eax\n"
+                               "    js 1f\n"
+                               "    mov " << asmCell(ins.offset) << ", al\n"
+                               "1:\n";
+                        break;
+                    }
+                    out << "    mov " << asmCell(ins.offset) << ", al\n";
                     break;
-                case '>':
-                    cppCode += "    ++ptr;\n";
+                case OP_LOOP_START:
+                    if (ins.arg == 0) {
+                        break; // 未配对的括号被忽略
+                    }
+                    loopLabels.push_back(labelCount++);
+                    out << "    cmp " << asmCell(ins.offset) << ", 0\n"
+                           "    je .Lend" << loopLabels.back() << "\n"
+                           ".Lbegin" << loopLabels.back() << ":\n";
                     break;
-                case '<':
-                    cppCode += "    --ptr;\n";
+                case OP_LOOP_END:
+                    if (ins.arg == 0 || loopLabels.empty()) {
+                        break;
+                    }
+                    out << "    cmp " << asmCell(ins.offset) << ", 0\n"
+                           "    jne .Lbegin" << loopLabels.back() << "\n"
+                           ".Lend" << loopLabels.back() << ":\n";
+                    loopLabels.pop_back();
                     break;
-                case '.':
-                    cppCode += "    std::cout << *ptr;\n";
+                case OP_CLEAR:
+                    out << "    mov " << asmCell(ins.offset) << ", 0\n";
                     break;
-                case ',':
-                    cppCode += "    *ptr = std::cin.get();\n";
+                case OP_MUL:
+                    out << "    movzx eax, " << asmCell(ins.from) << "\n"
+                           "    test al, al\n"
+                           "    je 1f\n"
+                           "    imul eax, eax, " << ins.arg << "\n"
+                           "    add " << asmCell(ins.offset) << ", al\n"
+                           "1:\n";
                     break;
-                case '[':
-                    cppCode += "    while (*ptr) {\n";
+                case OP_SCAN:
+                    out << "    cmp byte ptr [rbx], 0\n"
+                           "    je 1f\n"
+                           "2:\n"
+                           "    add rbx, " << ins.arg << "\n"
+                           "    cmp byte ptr [rbx], 0\n"
+                           "    jne 2b\n"
+                           "1:\n";
                     break;
-                case ']':
-                    cppCode += "    }\n";
+                case OP_PRODUCT:
+                    out << "    movzx eax, " << asmCell(ins.from) << "\n"
+                           "    movzx ecx, " << asmCell(ins.by) << "\n"
+                           "    imul eax, ecx\n"
+                           "    test al, al\n"
+                           "    je 1f\n"
+                           "    imul eax, eax, " << ins.arg << "\n"
+                           "    add " << asmCell(ins.offset) << ", al\n"
+                           "1:\n";
                     break;
+                case OP_DIVMOD:
+                case OP_COMPARE:
+                    break; // 不展开，直接执行其后的原循环（与compileToElf()一致）
             }
         }
 
-        cppCode += "\n    return 0;\n";
-        cppCode += "}";
-        return cppCode;
+        out << "    call flush\n"
+               "    mov eax, 60\n"
+               "    xor edi, edi\n"
+               "    syscall\n";
+        return out.str();
+    }
+
+    // 汇编中相对rbx偏移offset处的单元
+    static std::string asmCell(int offset) {
+        std::ostringstream ref;
+        ref << "byte ptr [rbx";
+        if (offset > 0) {
+            ref << " + " << offset;
+        } else if (offset < 0) {
+            ref << " - " << -offset;
+        }
+        ref << "]";
+        return ref.str();
+    }
+
+    /*
+     * 将Brainfuck代码直接编译为静态链接的x86-64 Linux可执行文件（ELF64），不需要汇编器、链接器或C编译器
+     * 文件布局：
+     * - 代码段（可读可执行）：ELF头、程序头、运行时子程序（见emitElfRuntime()）和程序本身，装载于0x400000
+     * - 缓冲区段与磁带段（可读写，不占文件空间）：各自前面留出一页不映射的空隙，指针越过磁带两端时触发段错误
+     * 磁带长度：报错模式下为getTapeSize()，扩展模式下为Tape::DEFAULT_LIMIT（未访问的页不占用物理内存）
+     * 参数：
+     * - fileName: 输出文件路径，非Windows平台上同时设置为可执行
+     * 返回值：
+     * - 成功返回true；单元宽度不是8位、指针需要回绕（见needsWrap()）或写文件失败时返回false
+     */
+    bool compileToElf(const std::string& fileName) {
+        if (cellBits != 8 || needsWrap()) {
+            return false;
+        }
+        const unsigned int textAddress = 0x400000;
+        const int headerSize = 64 + 56 * 4; // ELF头和4个程序头
+
+        jitBuffer.assign(headerSize, 0);
+        int putRoutine, getRoutine;
+        int flushRoutine = emitElfRuntime(putRoutine, getRoutine);
+
+        // 入口：rbx指向磁带开头，r12指向缓冲区，其余运行时寄存器清零
+        int entry = (int)jitBuffer.size();
+        emit(0xBB);                              // mov ebx, imm32 (tape)
+        int tapePatch = (int)jitBuffer.size();
+        emitInt32(0);
+        emit(0x41, 0xBC);                        // mov r12d, imm32 (buffers)
+        int bufferPatch = (int)jitBuffer.size();
+        emitInt32(0);
+        emit(0x45, 0x31, 0xED);                  // xor r13d, r13d
+        emit(0x45, 0x31, 0xF6);                  // xor r14d, r14d
+        emit(0x45, 0x31, 0xFF);                  // xor r15d, r15d
+        if (!emitInstructions(putRoutine, getRoutine, 0, (int)program.size(), 0, false)) {
+            jitBuffer.clear();
+            return false;
+        }
+        emitCallRel32(flushRoutine);             // call flush
+        emit(0xB8); emitInt32(60);               // mov eax, 60 (exit)
+        emit(0x31, 0xFF);                        // xor edi, edi
+        emit(0x0F, 0x05);                        // syscall
+
+        // 各段的地址都在4GB以内，可以用32位立即数寻址
+        const unsigned long long page = 0x1000;
+        const unsigned long long fileSize = jitBuffer.size();
+        const unsigned long long bufferAddress = (textAddress + fileSize + page - 1) / page * page + page;
+        const unsigned long long bufferSize = ELF_BUFFER_SIZE * 2;
+        const unsigned long long tapeAddress = bufferAddress + bufferSize + page;
+        const unsigned long long tapeSize = (nativeTapeBytes() + page - 1) / page * page;
+        if (tapeAddress + tapeSize > 0xFFFFFFFFULL) {
+            jitBuffer.clear();
+            return false;
+        }
+        patchInt32(tapePatch, static_cast<unsigned int>(tapeAddress));
+        patchInt32(bufferPatch, static_cast<unsigned int>(bufferAddress));
+
+        // ELF头
+        std::vector<unsigned char> header;
+        const unsigned char ident[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        header.insert(header.end(), ident, ident + 16);
+        appendLittleEndian(header, 2, 2);                    // e_type: ET_EXEC
+        appendLittleEndian(header, 0x3E, 2);                 // e_machine: x86-64
+        appendLittleEndian(header, 1, 4);                    // e_version
+        appendLittleEndian(header, textAddress + entry, 8);  // e_entry
+        appendLittleEndian(header, 64, 8);                   // e_phoff
+        appendLittleEndian(header, 0, 8);                    // e_shoff
+        appendLittleEndian(header, 0, 4);                    // e_flags
+        appendLittleEndian(header, 64, 2);                   // e_ehsize
+        appendLittleEndian(header, 56, 2);                   // e_phentsize
+        appendLittleEndian(header, 4, 2);                    // e_phnum
+        appendLittleEndian(header, 64, 2);                   // e_shentsize
+        appendLittleEndian(header, 0, 2);                    // e_shnum
+        appendLittleEndian(header, 0, 2);                    // e_shstrndx
+
+        // 程序头：代码段、缓冲区段、磁带段，以及不可执行的栈
+        appendProgramHeader(header, 1, 5, 0, textAddress, fileSize, fileSize);
+        appendProgramHeader(header, 1, 6, 0, bufferAddress, 0, bufferSize);
+        appendProgramHeader(header, 1, 6, 0, tapeAddress, 0, tapeSize);
+        appendProgramHeader(header, 0x6474E551, 6, 0, 0, 0, 0);
+        std::copy(header.begin(), header.end(), jitBuffer.begin());
+
+        std::ofstream file(fileName.c_str(), std::ios::binary);
+        bool written = file.is_open() &&
+                       file.write(reinterpret_cast<const char*>(&jitBuffer[0]), jitBuffer.size());
+        file.close();
+        jitBuffer.clear();
+#ifndef _WIN32
+        if (written) {
+            chmod(fileName.c_str(), 0755);
+        }
+#endif
+        return written;
     }
 
     /*
@@ -416,6 +5361,16 @@ public:
     const std::string& getCode() {
         return code;
     }
+
+    /*
+     * 获取优化后的IR
+     * 返回值：
+     * - 当前加载代码对应的IR指令序列的常量引用
+     */
+    const std::vector<Instruction>& getProgram() {
+        return program;
+    }
+
 };
 
 /*
@@ -513,6 +5468,35 @@ void initializeTranslations() {
     english["run_success"] = "Program executed successfully.";
     english["pointer_error"] = "Pointer out of bounds!";
     english["compile_error"] = "Compile error!";
+    english["native_program"] = "Compile to native and run";
+    english["native_built"] = "Native program built and executed (saved to cache).";
+    english["native_cached"] = "Cached native program executed.";
+    english["native_failed"] = "Native build failed! Check that a C compiler is installed (set CC to choose one).";
+    english["debug_program"] = "Debug program (breakpoints)";
+    english["profile_program"] = "Profile program (hot loops and lines)";
+    english["profile_total"] = "%s IR instructions executed";
+    english["profile_loops"] = "Hot loops by self cost:";
+    english["profile_loop_header"] = "  self%       self cost      total cost      entries  iter/entry  line:col  code";
+    english["profile_no_loops"] = "No loops were executed.";
+    english["profile_lines"] = "Hot lines by cost:";
+    english["profile_line_header"] = "   cost%            cost   line | source";
+    english["debug_help"] = "Commands: b <pos> [if <cell|*> <op> <value>] - breakpoint at filtered position; l <line> [if ...] - breakpoint at line; "
+                            "d <n> - delete; w <cell> [== <value> | out] - watch a cell for changes, a value or output by '.'; dw <n> - delete watch; "
+                            "i - list; c - continue; s [n] - step; h on|off - record history for rc/rs (continue runs slower); rc - continue backwards; "
+                            "rs [n] - step backwards; m [range] - memory; r - restart; q - quit. "
+                            "<op> is one of == != < >, * is the cell the instruction accesses";
+    english["debug_breakpoint_set"] = "Breakpoint %d at line %d, column %d";
+    english["debug_breakpoint_invalid"] = "Invalid breakpoint!";
+    english["debug_breakpoint_hit"] = "Breakpoint %d hit at line %d, column %d";
+    english["debug_no_breakpoints"] = "No breakpoints";
+    english["debug_watchpoint_set"] = "Watchpoint %d on cell %d";
+    english["debug_watchpoint_hit"] = "Watchpoint %d hit on cell %d";
+    english["debug_finished"] = "Program finished.";
+    english["debug_location"] = "At line %d, column %d";
+    english["unmatched_bracket"] = "Unmatched '%c' at line %d, column %d";
+    english["debug_history_start"] = "Reached the start of the recorded history.";
+    english["debug_history_on"] = "Recording history from here; rc and rs can step back to this point.";
+    english["debug_history_off"] = "History recording is off. Enter 'h on' to use rc and rs.";
     english["input_program"] = "Enter Brainfuck program (characters other than the 8 valid commands and //, /* */ are treated as comments, enter '0' alone to end):";
     english["comments_supported"] = "Supports single-line (//) and multi-line (/* */) comments, other characters are also treated as comments";
     english["no_bf_files"] = "No .bf files found!";
@@ -600,6 +5584,35 @@ void initializeTranslations() {
     chinese["run_success"] = "程序执行成功。";
     chinese["pointer_error"] = "指针越界!";
     chinese["compile_error"] = "编译错误!";
+    chinese["native_program"] = "编译为本地程序并运行";
+    chinese["native_built"] = "本地程序已编译并执行（已存入缓存）。";
+    chinese["native_cached"] = "已执行缓存的本地程序。";
+    chinese["native_failed"] = "本地编译失败！请确认已安装C编译器（可通过CC环境变量指定）。";
+    chinese["debug_program"] = "调试程序（断点）";
+    chinese["profile_program"] = "统计执行热点（循环和行）";
+    chinese["profile_total"] = "共执行 %s 条IR指令";
+    chinese["profile_loops"] = "热点循环（按自身代价排序）：";
+    chinese["profile_loop_header"] = "  自身%        自身代价          总代价     进入次数    平均轮数  行:列     代码";
+    chinese["profile_no_loops"] = "没有执行任何循环。";
+    chinese["profile_lines"] = "热点行（按代价排序）：";
+    chinese["profile_line_header"] = "    占比            代价   行号 | 源代码";
+    chinese["debug_help"] = "命令: b <位置> [if <单元|*> <比较> <值>] - 在过滤后代码的位置设置断点; l <行号> [if ...] - 在源代码行设置断点; "
+                            "d <n> - 删除断点; w <单元> [== <值> | out] - 观察单元的改变、取值或被'.'输出; dw <n> - 删除观察点; "
+                            "i - 列出断点和观察点; c - 继续执行; s [n] - 单步执行; h on|off - 记录执行历史，供rc/rs使用（继续执行变慢）; rc - 倒退执行; "
+                            "rs [n] - 单步倒退; m [范围] - 查看内存; r - 重新开始; q - 退出。"
+                            "<比较>为 == != < > 之一, * 表示指令访问的单元";
+    chinese["debug_breakpoint_set"] = "断点 %d 设置在第 %d 行第 %d 列";
+    chinese["debug_breakpoint_invalid"] = "无效的断点!";
+    chinese["debug_breakpoint_hit"] = "命中断点 %d（第 %d 行第 %d 列）";
+    chinese["debug_no_breakpoints"] = "没有断点";
+    chinese["debug_watchpoint_set"] = "观察点 %d 设置在单元 %d";
+    chinese["debug_watchpoint_hit"] = "命中观察点 %d（单元 %d）";
+    chinese["debug_finished"] = "程序执行完毕。";
+    chinese["debug_location"] = "位于第 %d 行第 %d 列";
+    chinese["unmatched_bracket"] = "括号 '%c' 没有配对（第 %d 行第 %d 列）";
+    chinese["debug_history_start"] = "已倒退到历史记录的起点。";
+    chinese["debug_history_on"] = "从这里开始记录执行历史，rc和rs最多倒退到这里。";
+    chinese["debug_history_off"] = "没有记录执行历史，输入 h on 开启后才能使用rc和rs。";
     chinese["input_program"] = "请输入Brainfuck程序 (除8个有效命令和//, /* */外的字符都视为注释，输入0单独一行结束):";
     chinese["comments_supported"] = "支持单行注释(//)和多行注释(/* */)，其他字符也视为注释";
     chinese["no_bf_files"] = "未找到任何.bf文件!";
@@ -3421,16 +8434,112 @@ int find_all_bf(std::string path) {
 const int MEMORY_SIZE = 30000;	// Brainfuck标准内存大小，符合语言规范
 const int PROGRAM_SIZE = 10000;	// 程序最大长度限制，防止过长的程序导致性能问题
 
+/**
+ * 源码映射：过滤后代码中每个字符在原始代码中的行号和列号（都从1开始）
+ * 功能：把断点、错误等使用的过滤后位置换算回编辑器中看到的行列，以及按行号找到过滤后的位置
+ * 存储方式：游程编码，同一行中连续的有效指令字符合为一段，只记录段首字符的位置和行列，
+ *           注释、空白和换行处才开始新的一段；查找时对段二分，O(log n)
+ */
+class SourceMap {
+private:
+    struct Run {
+        int position; // 段首字符在过滤后代码中的位置
+        int line;     // 段首字符在原始代码中的行号
+        int column;   // 段首字符在原始代码中的列号
+    };
+    std::vector<Run> runs; // 按position递增，line也不减
+    int length;            // 已加入的字符数，即过滤后代码的长度
+
+    // position所在的段：position不小于段首的最后一段
+    int runAt(int position) const {
+        int low = 0, high = (int)runs.size();
+        while (high - low > 1) {
+            int middle = (low + high) / 2;
+            if (runs[middle].position <= position) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+public:
+    SourceMap() : length(0) {}
+
+    void clear() {
+        runs.clear();
+        length = 0;
+    }
+
+    /*
+     * 追加过滤后代码的下一个字符
+     * 参数：
+     * - line, column: 这个字符在原始代码中的行号和列号
+     */
+    void add(int line, int column) {
+        if (runs.empty() || runs.back().line != line ||
+            runs.back().column + (length - runs.back().position) != column) {
+            Run run;
+            run.position = length;
+            run.line = line;
+            run.column = column;
+            runs.push_back(run);
+        }
+        length++;
+    }
+
+    /*
+     * 查找过滤后代码中position处的字符在原始代码中的行列
+     * 返回值：
+     * - position有效时返回true并写入line和column，否则返回false
+     */
+    bool locate(int position, int& line, int& column) const {
+        if (position < 0 || position >= length) {
+            return false;
+        }
+        const Run& run = runs[runAt(position)];
+        line = run.line;
+        column = run.column + (position - run.position);
+        return true;
+    }
+
+    /*
+     * 获取原始代码第line行的第一个有效指令字符在过滤后代码中的位置
+     * 返回值：
+     * - 这一行没有有效指令时返回-1
+     */
+    int lineStart(int line) const {
+        int low = 0, high = (int)runs.size();
+        while (low < high) { // 第一个行号不小于line的段
+            int middle = (low + high) / 2;
+            if (runs[middle].line < line) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return (low < (int)runs.size() && runs[low].line == line) ? runs[low].position : -1;
+    }
+
+    // 段数，用于估计映射占用的空间
+    int runCount() const {
+        return (int)runs.size();
+    }
+};
+
 /**
  * 结构体：存储Brainfuck程序数据
  * 功能：同时保存程序的原始形式和过滤后的形式
  * 成员变量：
  * - original: 原始代码，包含所有注释和格式信息
  * - filtered: 过滤后的代码，只保留8个有效的Brainfuck指令字符（[ ] < > . , + -）
+ * - sourceMap: filtered中每个字符在original中的行列
  */
 struct ProgramData {
     std::string original;  // 原始代码（包含注释和格式）
     std::string filtered;  // 过滤后的代码（只包含有效Brainfuck指令）
+    SourceMap sourceMap;   // filtered到original的行列映射，由过滤时生成
 };
 
 /**
@@ -3544,6 +8653,7 @@ void displayProgramWithColors(const std::string& program) {
  *   - ProgramData结构体，包含:
  *     - original：原始输入代码（包含注释和格式）
  *     - filtered：过滤后的代码（只包含8个有效的Brainfuck指令字符）
+ *     - sourceMap：filtered中每个字符在original中的行列
  * 使用示例：
  *   用户输入：>++++++++[<+++++++++>-]<.  # 输出 'A'
  *   处理结果：original保留完整输入，filtered只保留 '>++++++++[<+++++++++>-]<.'
@@ -3573,10 +8683,16 @@ ProgramData input_Bf() {
     // 过滤注释和空白，只保留有效指令
     bool inMultiLineComment = false; // 多行注释状态标记
     bool inSingleLineComment = false; // 单行注释状态标记
+    int lineNumber = 0; // 当前字符所在的行号
+    std::string::size_type lineBegin = 0; // 当前行第一个字符的下标
     
     for (std::string::size_type i = 0; i < input.length(); i++) {
         char ch = input[i];
         char next_ch = (i + 1 < input.length()) ? input[i + 1] : '\0';
+        if (i == 0 || input[i - 1] == '\n') {
+            lineNumber++; // 新的一行
+            lineBegin = i;
+        }
         
         // 检查多行注释（/* */）
         // 如果不在单行注释中，且遇到/*，则进入多行注释状态
@@ -3618,6 +8734,7 @@ ProgramData input_Bf() {
         if (ch == '[' || ch == ']' || ch == '<' || ch == '>' || 
             ch == '.' || ch == ',' || ch == '+' || ch == '-') {
             data.filtered += ch;
+            data.sourceMap.add(lineNumber, (int)(i - lineBegin) + 1);
         }
     }
     
@@ -3628,11 +8745,14 @@ ProgramData input_Bf() {
  * 带错误检查执行Brainfuck程序
  * 功能：执行给定的Brainfuck程序代码，提供完整的错误检查和边界条件处理
  * 执行流程：
- * 1. 初始化30000字节的内存空间，所有单元初始化为0
- * 2. 构建循环映射表，验证括号匹配情况
- * 3. 逐指令执行Brainfuck程序，处理所有8种有效指令
+ * 1. 使用30000个8位单元的磁带，指针越界方式为报错（POINTER_ERROR），所有单元初始化为0
+ * 2. 由BrainfuckCompiler生成优化后的IR，同时验证括号匹配情况
+ * 3. 分层执行IR：先解释执行，连续的加减/移动以及清零、乘法、扫描循环都只需一次分派；
+ *    回跳次数达到BrainfuckCompiler::DEFAULT_TIER_THRESHOLD的循环编译为机器码执行
+ * 4. 第一次读取输入之前的部分在加载时预先执行（最多BrainfuckCompiler::DEFAULT_PREFIX_BUDGET条指令），执行从停下的位置开始
+ * 输入：标准输入，跳过换行符，EOF时保持单元原值
  * 错误处理：
- * - 指针越界：当内存指针试图超出30000字节边界时返回错误
+ * - 指针越界：访问磁带之外的单元时由保护页捕获并返回错误，指针移动本身不做检查
  * - 编译错误：当检测到不匹配的括号时返回错误
  * 参数：program - 过滤后的Brainfuck程序代码（只包含8个有效指令字符）
  * 返回值：
@@ -3641,86 +8761,54 @@ ProgramData input_Bf() {
  * - 2：编译错误（括号不匹配）
  */
 int run(std::string program) {
-    unsigned char memory[MEMORY_SIZE] = {0};	// Brainfuck内存数组，大小为30000字节，初始化为0
-    int pointer = 0;							// 内存指针，指向当前操作的内存单元位置
-    
-    // 循环映射数组：存储每个循环指令的匹配位置
-    // loop_map[i] = j 表示位置i的循环指令与位置j的循环指令匹配
-    int loop_map[PROGRAM_SIZE];
-    // 初始化循环映射数组为-1（表示未匹配）
-    for(int i = 0; i < PROGRAM_SIZE; i++) loop_map[i] = -1;
+    BrainfuckCompiler compiler(MEMORY_SIZE, false);	// 磁带大小固定，越界即报错
+    InputSource& input = compiler.getInput();
+    input.setSkipNewlines(true);
+    compiler.setEofMode(InputSource::EOF_UNCHANGED);
+    compiler.setPrefixBudget(BrainfuckCompiler::DEFAULT_PREFIX_BUDGET);
     
-    std::stack<int> loop_stack;	// 循环栈：用于构建循环映射时临时存储'['的位置
-    
-    // 第一次扫描：构建循环映射（括号匹配）
-    for(int i = 0; i < (int)program.length(); i++) {
-        if(program[i] == '[') {
-            loop_stack.push(i);	// 将'['的位置压入栈中
-        } else if(program[i] == ']') {
-            if(loop_stack.empty()) {
-                return 2; // 没有匹配的'['，返回编译错误
+    // 生成IR，循环跳转的相对偏移已写在指令中；读取输入之前的部分在加载时预先执行
+    if (!compiler.loadCode(program)) {
+        return 2; // 存在不匹配的括号，返回编译错误
+    }
+    return compiler.tiered() ? 0 : 1;
+}
+
+/**
+ * 查找过滤后代码中第一个未配对的括号
+ * 功能：没有配对的']'优先；否则为最外层没有闭合的'['
+ * 返回值：括号的位置，括号都已配对时返回-1
+ */
+int findUnmatchedBracket(const std::string& program) {
+    std::vector<int> open; // 尚未闭合的'['的位置
+    for (int i = 0; i < (int)program.length(); i++) {
+        if (program[i] == '[') {
+            open.push_back(i);
+        } else if (program[i] == ']') {
+            if (open.empty()) {
+                return i;
             }
-            int start = loop_stack.top();	// 获取匹配的'['位置
-            loop_stack.pop();					// 弹出栈顶元素
-            loop_map[start] = i;			// 记录'['匹配的']'位置
-            loop_map[i] = start;			// 记录']'匹配的'['位置
+            open.pop_back();
         }
     }
-    
-    // 检查是否有未匹配的'['
-    if(!loop_stack.empty()) {
-        return 2; // 有未匹配的'['，返回编译错误
-    }
-    
-    // 第二次扫描：执行程序指令
-    for(int i = 0; i < (int)program.length(); i++) {
-        switch(program[i]) {
-            case '>':	// 指针右移指令
-                if(pointer == MEMORY_SIZE - 1) {
-                    return 1; // 指针已到达内存边界，无法继续右移，返回指针越界错误
-                }
-                pointer++; // 内存指针向右移动一个单元
-                break;
-            case '<':	// 指针左移指令
-                if(pointer == 0) {
-                    return 1; // 指针已在内存起始位置，无法继续左移，返回指针越界错误
-                }
-                pointer--; // 内存指针向左移动一个单元
-                break;
-            case '+':	// 当前内存单元加1指令
-                memory[pointer]++; // 对当前指针指向的内存单元值加1
-                break;
-            case '-':	// 当前内存单元减1指令
-                memory[pointer]--; // 对当前指针指向的内存单元值减1
-                break;
-            case '.':	// 输出指令
-                printf("%c", memory[pointer]); // 输出当前内存单元值对应的ASCII字符
-                break;
-            case ',':	// 输入指令
-                // 清除输入缓冲区中的换行符
-                int c;
-                while ((c = getchar()) == '\n') {} // 循环读取直到遇到非换行符
-                if (c != EOF) { // 确保读取的不是文件结束符
-                    memory[pointer] = static_cast<unsigned char>(c); // 将读取的字符存入当前内存单元
-                }
-                break;
-            case '[':	// 循环开始指令
-                // 如果当前内存单元值为0，则跳转到匹配的']'位置（跳过循环体）
-                if(memory[pointer] == 0) {
-                    i = loop_map[i];	// 跳转至匹配的']'位置
-                }
-                // 如果当前内存单元值不为0，则继续执行（进入循环体）
-                break;
-            case ']':	// 循环结束指令
-                // 如果当前内存单元值不为0，则跳转回匹配的'['位置（继续循环）
-                if(memory[pointer] != 0) {
-                    i = loop_map[i];	// 跳转至匹配的'['位置
-                }
-                // 如果当前内存单元值为0，则继续执行（跳出循环）
-                break;
-        }
+    return open.empty() ? -1 : open[0];
+}
+
+/**
+ * 输出编译错误
+ * 功能：输出compile_error，能找到未配对的括号时再通过源码映射给出它在原始代码中的行列
+ * 参数：
+ * - programData: 出错的程序
+ * - stream: 输出目标
+ */
+void printCompileError(const ProgramData& programData, FILE* stream) {
+    fprintf(stream, "%s\n", tr("compile_error").c_str());
+    int position = findUnmatchedBracket(programData.filtered);
+    int line, column;
+    if (position >= 0 && programData.sourceMap.locate(position, line, column)) {
+        fprintf(stream, tr("unmatched_bracket").c_str(), programData.filtered[position], line, column);
+        fprintf(stream, "\n");
     }
-    return 0;
 }
 
 /**
@@ -3729,16 +8817,517 @@ int run(std::string program) {
  * 处理流程：
  * 1. 显示"运行结果"标题
  * 2. 调用run()函数执行Brainfuck程序
- * 3. 根据run()函数返回的错误码显示相应的多语言提示信息
- * 参数：pro - 过滤后的Brainfuck程序代码（只包含8个有效指令字符）
+ * 3. 根据run()函数返回的错误码显示相应的多语言提示信息，编译错误时给出未配对括号的行列
+ * 参数：programData - 要执行的程序
  * 副作用：在控制台输出执行结果和状态消息
  */
-void running(std::string pro){
+void running(const ProgramData& programData){
     printf("\n%s\n", tr("run_results").c_str());
-    int res=run(pro);
+    int res=run(programData.filtered);
     if(res==0) printf("\n%s\n", tr("run_success").c_str());
     if(res==1) printf("\n%s\n", tr("pointer_error").c_str());
-    if(res==2) printf("\n%s\n", tr("compile_error").c_str());
+    if(res==2) { printf("\n"); printCompileError(programData, stdout); }
+}
+
+/**
+ * 执行统计报告中的数值格式
+ * formatCount()把次数转为字符串（部分运行库的printf不支持%lld），formatPercent()给出占总数的比例，保留一位小数
+ */
+std::string formatCount(long long count) {
+    std::ostringstream text;
+    text << count;
+    return text.str();
+}
+
+std::string formatPercent(long long part, long long total) {
+    const long long permille = (total > 0) ? part * 1000 / total : 0;
+    std::ostringstream text;
+    text << permille / 10 << "." << permille % 10 << "%";
+    return text.str();
+}
+
+/**
+ * 统计执行并输出热点报告
+ * 功能：在与run()相同的环境中逐条解释执行（不预先执行、不编译为机器码），统计每条IR指令的执行次数和
+ *       每个循环的进入次数（见BrainfuckCompiler::setCounting()），再输出按自身代价排序的两份报告：
+ * 1. 热点循环：自身代价（不含内层循环）、总代价、进入次数、平均每次进入的轮数，以及循环在原始代码中的行列和代码
+ * 2. 热点行：原始代码每一行上的IR指令的执行次数之和，以及这一行的内容
+ * 代价以IR指令的执行次数计。报告中的循环都没有被优化器改写为闭式计算，排在前面的适合手工优化或补充新的循环识别
+ * 指针越界时输出越界之前的统计
+ * 参数：programData - 要执行的程序，sourceMap用于把过滤后代码的位置换算为原始代码的行列
+ */
+void profileProgram(const ProgramData& programData) {
+    const int top = 10;     // 每份报告输出的条数
+    const int snippet = 40; // 循环代码最多显示的字符数
+
+    BrainfuckCompiler compiler(MEMORY_SIZE, false);
+    compiler.getInput().setSkipNewlines(true);
+    compiler.setEofMode(InputSource::EOF_UNCHANGED);
+    compiler.setCounting(true);
+    printf("\n%s\n", tr("run_results").c_str());
+    if (!compiler.loadCode(programData.filtered)) {
+        printf("\n");
+        printCompileError(programData, stdout);
+        return;
+    }
+    const bool finished = compiler.interpret();
+    printf("\n%s\n", tr(finished ? "run_success" : "pointer_error").c_str());
+
+    const std::vector<long long> costs = compiler.getSourceCosts();
+    std::map<int, long long> lineCosts;
+    long long total = 0;
+    for (int i = 0; i < (int)costs.size(); i++) {
+        int line, column;
+        if (costs[i] > 0 && programData.sourceMap.locate(i, line, column)) {
+            lineCosts[line] += costs[i];
+            total += costs[i];
+        }
+    }
+    printf("\n");
+    printf(tr("profile_total").c_str(), formatCount(total).c_str());
+    printf("\n");
+    if (total == 0) {
+        return;
+    }
+
+    // 热点循环
+    const std::vector<BrainfuckCompiler::LoopProfile> loops = compiler.getLoopProfile();
+    printf("\n%s\n", tr("profile_loops").c_str());
+    if (loops.empty() || loops[0].selfCost == 0) {
+        printf("%s\n", tr("profile_no_loops").c_str());
+    } else {
+        printf("%s\n", tr("profile_loop_header").c_str());
+    }
+    for (int i = 0; i < (int)loops.size() && i < top && loops[i].selfCost > 0; i++) {
+        const BrainfuckCompiler::LoopProfile& loop = loops[i];
+        int line = 0, column = 0;
+        programData.sourceMap.locate(loop.start, line, column);
+        std::string text = programData.filtered.substr(loop.start, loop.end - loop.start + 1);
+        if ((int)text.length() > snippet) {
+            text = text.substr(0, snippet - 3) + "...";
+        }
+        std::ostringstream location;
+        location << line << ":" << column;
+        printf("%7s %15s %15s %12s %10.1f  %-9s %s\n", formatPercent(loop.selfCost, total).c_str(),
+               formatCount(loop.selfCost).c_str(), formatCount(loop.totalCost).c_str(), formatCount(loop.entries).c_str(),
+               loop.entries > 0 ? (double)loop.iterations / loop.entries : 0.0, location.str().c_str(), text.c_str());
+    }
+
+    // 热点行，按代价从大到小
+    std::vector<std::pair<long long, int> > ranked; // (-代价, 行号)
+    for (std::map<int, long long>::const_iterator it = lineCosts.begin(); it != lineCosts.end(); ++it) {
+        ranked.push_back(std::make_pair(-it->second, it->first));
+    }
+    std::sort(ranked.begin(), ranked.end());
+    std::vector<std::string> lines;
+    std::istringstream original(programData.original);
+    std::string text;
+    while (std::getline(original, text)) {
+        lines.push_back(text);
+    }
+    printf("\n%s\n%s\n", tr("profile_lines").c_str(), tr("profile_line_header").c_str());
+    for (int i = 0; i < (int)ranked.size() && i < top; i++) {
+        const int line = ranked[i].second;
+        text = (line >= 1 && line <= (int)lines.size()) ? lines[line - 1] : "";
+        if ((int)text.length() > snippet * 2) {
+            text = text.substr(0, snippet * 2 - 3) + "...";
+        }
+        printf("%7s %15s %6d | %s\n", formatPercent(-ranked[i].first, total).c_str(),
+               formatCount(-ranked[i].first).c_str(), line, text.c_str());
+    }
+}
+
+/**
+ * 原生程序缓存的版本号
+ * 参与缓存键的计算，generateSource()生成的代码有变化时需要修改，使旧的缓存失效
+ */
+const char* const NATIVE_CACHE_VERSION = "bfx-native-2";
+
+/**
+ * 计算字符串的64位FNV-1a散列
+ * 参数：text - 要计算散列的字符串
+ * 返回值：16位十六进制表示的散列值，用作缓存文件名
+ */
+std::string hashText(const std::string& text) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (std::string::size_type i = 0; i < text.length(); i++) {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 1099511628211ULL;
+    }
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", hash);
+    return std::string(buffer);
+}
+
+/**
+ * 获取本地C编译器的命令和编译选项
+ * 环境变量CC、CFLAGS优先，未设置时使用系统默认的编译器和-O2
+ */
+std::string getNativeCompiler() {
+    const char* cc = getenv("CC");
+    if (cc != NULL && *cc != '\0') {
+        return cc;
+    }
+#ifdef _WIN32
+    return "gcc";
+#else
+    return "cc";
+#endif
+}
+
+std::string getNativeFlags() {
+    const char* flags = getenv("CFLAGS");
+    if (flags != NULL && *flags != '\0') {
+        return flags;
+    }
+    return "-O2";
+}
+
+/**
+ * 构造可交给system()执行的命令行
+ * Windows的cmd /c会去掉命令行首尾的引号，需要在整条命令外再加一层引号
+ */
+std::string shellCommand(const std::string& command) {
+#ifdef _WIN32
+    return "\"" + command + "\"";
+#else
+    return command;
+#endif
+}
+
+/**
+ * 将Brainfuck程序编译为本地可执行文件，结果按内容散列缓存
+ * 功能：由compileToC()生成C代码，调用本地C编译器编译，可执行文件保存在程序目录下的Cache子目录
+ * 缓存：
+ * - 文件名为 过滤后的代码 + 编译器 + 编译选项 + NATIVE_CACHE_VERSION 的散列
+ * - 缓存命中时直接返回已有的可执行文件，不再生成C代码和调用编译器
+ * - 编译结果先写入临时文件，成功后再改名，编译中断不会留下不完整的缓存
+ * 语义：与run()相同的30000个8位单元、EOF时保持原值，指针越界时以退出码1结束（见generateSource()），但不跳过输入中的换行符
+ * 参数：
+ * - program: 过滤后的Brainfuck程序代码（只包含8个有效指令字符）
+ * - exePath: 返回可执行文件的完整路径
+ * - cached: 返回是否命中缓存
+ * 返回值：
+ * - 0：成功
+ * - 2：编译错误（括号不匹配）
+ * - 3：C编译器调用失败
+ */
+int buildNative(const std::string& program, std::string& exePath, bool& cached) {
+    std::string compilerCommand = getNativeCompiler();
+    std::string flags = getNativeFlags();
+    std::string key = hashText(program + "\n" + compilerCommand + "\n" + flags + "\n" + NATIVE_CACHE_VERSION);
+    
+    std::string cacheDir = getExeDir();
+#ifdef _WIN32
+    cacheDir += "\\Cache";
+    std::string base = cacheDir + "\\" + key;
+    exePath = base + ".exe";
+#else
+    cacheDir += "/Cache";
+    std::string base = cacheDir + "/" + key;
+    exePath = base;
+#endif
+    
+    // 缓存命中：跳过生成和编译
+    std::ifstream existing(exePath.c_str());
+    cached = existing.is_open();
+    if (cached) {
+        return 0;
+    }
+    createDirectory(cacheDir);
+    
+    BrainfuckCompiler compiler(MEMORY_SIZE, false);
+    compiler.setEofMode(InputSource::EOF_UNCHANGED);
+    compiler.setPrefixBudget(BrainfuckCompiler::DEFAULT_PREFIX_BUDGET);
+    if (!compiler.loadCode(program)) {
+        return 2;
+    }
+    
+    std::string sourcePath = base + ".c";
+    std::ofstream source(sourcePath.c_str());
+    if (!source.is_open()) {
+        return 3;
+    }
+    source << compiler.compileToC();
+    source.close();
+    
+#ifdef _WIN32
+    std::string partialPath = base + ".partial.exe";
+#else
+    std::string partialPath = base + ".partial";
+#endif
+    std::string command = compilerCommand + " " + flags + " -o \"" + partialPath + "\" \"" + sourcePath + "\"";
+    int status = system(shellCommand(command).c_str());
+    remove(sourcePath.c_str());
+    if (status != 0 || !renameFileOrDirectory(partialPath, exePath)) {
+        remove(partialPath.c_str());
+        return 3;
+    }
+    return 0;
+}
+
+/**
+ * 以本地可执行文件的形式运行Brainfuck程序
+ * 功能：通过buildNative()取得（或生成）可执行文件后直接执行，程序的输入输出使用当前控制台
+ * 参数：
+ * - program: 过滤后的Brainfuck程序代码
+ * - cached: 返回是否命中缓存
+ * 返回值：
+ * - 0/2/3：与buildNative()相同，无法启动可执行文件时也返回3
+ * - 1：程序报告指针越界（读写磁带之外的单元，见generateSource()）或异常结束
+ */
+int runNative(const std::string& program, bool& cached) {
+    std::string exePath;
+    int result = buildNative(program, exePath, cached);
+    if (result != 0) {
+        return result;
+    }
+    fflush(stdout);
+    int status = system(shellCommand("\"" + exePath + "\"").c_str());
+    if (status == -1) {
+        return 3;
+    }
+    return status == 0 ? 0 : 1;
+}
+
+/**
+ * 编译为本地程序并执行，显示结果
+ * 功能：与running()相同，但通过runNative()执行，并提示是否使用了缓存
+ * 参数：programData - 要执行的程序
+ */
+void runningNative(const ProgramData& programData) {
+    printf("\n%s\n", tr("run_results").c_str());
+    bool cached = false;
+    int res = runNative(programData.filtered, cached);
+    if (res == 0) printf("\n%s\n", tr(cached ? "native_cached" : "native_built").c_str());
+    if (res == 1) printf("\n%s\n", tr("pointer_error").c_str());
+    if (res == 2) {
+        printf("\n");
+        printCompileError(programData, stdout);
+    }
+    if (res == 3) printf("\n%s\n", tr("native_failed").c_str());
+}
+
+/**
+ * 解析断点条件"if <单元|*> <比较> <值>"，没有条件时为BREAK_ALWAYS
+ * 参数：
+ * - args: 断点位置之后的命令参数
+ * - point: 返回解析出的条件、单元（*为-1）和值
+ * 返回值：格式错误时返回false
+ */
+bool parseBreakCondition(std::istringstream& args, BrainfuckCompiler::Breakpoint& point) {
+    point.condition = BrainfuckCompiler::BREAK_ALWAYS;
+    point.cell = -1;
+    point.value = 0;
+    std::string word, cell, compare;
+    if (!(args >> word)) {
+        return true;
+    }
+    if (word != "if" || !(args >> cell >> compare >> point.value)) {
+        return false;
+    }
+    if (cell != "*") {
+        point.cell = atoi(cell.c_str());
+    }
+    if (compare == "==") {
+        point.condition = BrainfuckCompiler::BREAK_EQUAL;
+    } else if (compare == "!=") {
+        point.condition = BrainfuckCompiler::BREAK_NOT_EQUAL;
+    } else if (compare == "<") {
+        point.condition = BrainfuckCompiler::BREAK_LESS;
+    } else if (compare == ">") {
+        point.condition = BrainfuckCompiler::BREAK_GREATER;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 输出调试中的当前状态：下一条指令在原始代码中的行列（见SourceMap），以及指令和内存状态
+ */
+void printDebugState(BrainfuckCompiler& compiler, const ProgramData& programData) {
+    int line, column;
+    if (programData.sourceMap.locate(compiler.getSourcePosition(), line, column)) {
+        printf(tr("debug_location").c_str(), line, column);
+        printf("\n");
+    }
+    compiler.printCurrentState();
+    compiler.printMemoryState();
+}
+
+/**
+ * 输出debugContinue()或reverseContinue()停下的原因，停在断点或观察点时同时输出当前状态
+ */
+void printDebugStop(BrainfuckCompiler& compiler, const ProgramData& programData, BrainfuckCompiler::DebugStop stop) {
+    if (stop == BrainfuckCompiler::DEBUG_BREAKPOINT || stop == BrainfuckCompiler::DEBUG_WATCHPOINT) {
+        if (stop == BrainfuckCompiler::DEBUG_BREAKPOINT) {
+            int line = 0, column = 0;
+            programData.sourceMap.locate(compiler.getSourcePosition(), line, column);
+            printf(tr("debug_breakpoint_hit").c_str(), compiler.getHitBreakpoint(), line, column);
+            printf("\n");
+            compiler.printCurrentState();
+            compiler.printMemoryState();
+            return;
+        }
+        printf(tr("debug_watchpoint_hit").c_str(), compiler.getHitWatchpoint(),
+               compiler.getWatchpoints()[compiler.getHitWatchpoint()].cell);
+        printf("\n");
+        printDebugState(compiler, programData);
+    } else if (stop == BrainfuckCompiler::DEBUG_HISTORY_START) {
+        printf("%s\n", tr("debug_history_start").c_str());
+        printDebugState(compiler, programData);
+    } else {
+        printf("%s\n", tr(stop == BrainfuckCompiler::DEBUG_FINISHED ? "debug_finished" : "pointer_error").c_str());
+    }
+}
+
+/**
+ * 调试Brainfuck程序
+ * 功能：按行读取调试命令（见debug_help），在断点之间全速执行（见BrainfuckCompiler::debugContinue()），
+ *       也可以观察单元的改变、取值和输出；用h命令开启历史记录后可以倒退（见BrainfuckCompiler::setHistory()），
+ *       记录期间继续执行逐条检查，默认不开启
+ * 执行环境与run()相同，但不预先执行，断点对整个程序有效
+ * 断点可以设置在过滤后代码的位置，也可以设置在源代码行上（该行的第一个有效指令字符）
+ * 参数：programData - 要调试的程序，sourceMap用于在行号和过滤后代码的位置之间换算
+ */
+void debugProgram(const ProgramData& programData) {
+    BrainfuckCompiler compiler(MEMORY_SIZE, false);
+    compiler.getInput().setSkipNewlines(true);
+    compiler.setEofMode(InputSource::EOF_UNCHANGED);
+    if (!compiler.loadCode(programData.filtered)) {
+        printCompileError(programData, stdout);
+        return;
+    }
+    printf("%s\n", tr("debug_help").c_str());
+
+    std::string line;
+    while (printf("(bfx) "), fflush(stdout), std::getline(std::cin, line)) {
+        std::istringstream args(line);
+        std::string command;
+        if (!(args >> command)) {
+            continue;
+        }
+        if (command == "b" || command == "l") { // 设置断点
+            int target = -1;
+            BrainfuckCompiler::Breakpoint point;
+            int position = -1;
+            if ((args >> target) && parseBreakCondition(args, point)) {
+                // 没有有效指令的行为-1
+                position = (command == "b") ? target : programData.sourceMap.lineStart(target);
+            }
+            int index = (position >= 0) ? compiler.addBreakpoint(position, point.condition, point.cell, point.value) : -1;
+            int line, column;
+            if (index < 0 || !programData.sourceMap.locate(position, line, column)) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            } else {
+                printf(tr("debug_breakpoint_set").c_str(), index, line, column);
+                printf("\n");
+            }
+        } else if (command == "d") { // 删除断点
+            int index = -1;
+            args >> index;
+            if (!compiler.removeBreakpoint(index)) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            }
+        } else if (command == "w") { // 设置观察点
+            int cell = -1;
+            std::string kind;
+            unsigned int value = 0;
+            int index = -1;
+            if (args >> cell) {
+                if (!(args >> kind)) {
+                    index = compiler.addWatchpoint(cell, BrainfuckCompiler::WATCH_CHANGE);
+                } else if (kind == "out") {
+                    index = compiler.addWatchpoint(cell, BrainfuckCompiler::WATCH_OUTPUT);
+                } else if (kind == "==" && (args >> value)) {
+                    index = compiler.addWatchpoint(cell, BrainfuckCompiler::WATCH_EQUAL, value);
+                }
+            }
+            if (index < 0) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            } else {
+                printf(tr("debug_watchpoint_set").c_str(), index, cell);
+                printf("\n");
+            }
+        } else if (command == "dw") { // 删除观察点
+            int index = -1;
+            args >> index;
+            if (!compiler.removeWatchpoint(index)) {
+                printf("%s\n", tr("debug_breakpoint_invalid").c_str());
+            }
+        } else if (command == "i") { // 列出断点和观察点
+            const std::vector<BrainfuckCompiler::Breakpoint>& points = compiler.getBreakpoints();
+            const std::vector<BrainfuckCompiler::Watchpoint>& watches = compiler.getWatchpoints();
+            static const char* const compares[] = { "", "==", "!=", "<", ">" };
+            if (points.empty() && watches.empty()) {
+                printf("%s\n", tr("debug_no_breakpoints").c_str());
+            }
+            for (size_t i = 0; i < points.size(); i++) {
+                int line = 0, column = 0;
+                programData.sourceMap.locate(points[i].position, line, column);
+                printf("%d: %d (%d:%d)", (int)i, points[i].position, line, column);
+                if (points[i].condition != BrainfuckCompiler::BREAK_ALWAYS) {
+                    if (points[i].cell < 0) {
+                        printf(" if * %s %u", compares[points[i].condition], points[i].value);
+                    } else {
+                        printf(" if %d %s %u", points[i].cell, compares[points[i].condition], points[i].value);
+                    }
+                }
+                printf("\n");
+            }
+            for (size_t i = 0; i < watches.size(); i++) {
+                printf("w%d: %d", (int)i, watches[i].cell);
+                if (watches[i].kind == BrainfuckCompiler::WATCH_EQUAL) {
+                    printf(" == %u", watches[i].value);
+                } else if (watches[i].kind == BrainfuckCompiler::WATCH_OUTPUT) {
+                    printf(" out");
+                }
+                printf("\n");
+            }
+        } else if (command == "c") { // 继续执行到下一个断点或观察点
+            BrainfuckCompiler::DebugStop stop = compiler.debugContinue();
+            printf("\n");
+            printDebugStop(compiler, programData, stop);
+        } else if (command == "h") { // 开启或关闭历史记录
+            std::string mode;
+            args >> mode;
+            if ((mode == "on" || mode == "off") && (mode == "on") != compiler.getHistory()) {
+                compiler.setHistory(mode == "on"); // 已经开启时不重新开始记录
+            }
+            printf("%s\n", tr(compiler.getHistory() ? "debug_history_on" : "debug_history_off").c_str());
+        } else if ((command == "rc" || command == "rs") && !compiler.getHistory()) {
+            printf("%s\n", tr("debug_history_off").c_str());
+        } else if (command == "rc") { // 倒退到上一个断点或观察点
+            printDebugStop(compiler, programData, compiler.reverseContinue());
+        } else if (command == "rs") { // 单步倒退
+            int count = 1;
+            args >> count;
+            if (!compiler.reverseStep(count)) {
+                printf("%s\n", tr("debug_history_start").c_str());
+            }
+            printDebugState(compiler, programData);
+        } else if (command == "s") { // 单步执行
+            int count = 1;
+            args >> count;
+            bool running = true;
+            for (int i = 0; i < count && running; i++) {
+                running = compiler.step();
+            }
+            printf("\n");
+            printDebugState(compiler, programData);
+        } else if (command == "m") { // 查看内存
+            int range = 10;
+            args >> range;
+            compiler.printMemoryState(range);
+        } else if (command == "r") { // 重新开始
+            compiler.loadCode(programData.filtered);
+        } else if (command == "q") { // 退出
+            break;
+        } else {
+            printf("%s\n", tr("debug_help").c_str());
+        }
+    }
 }
 
 /**
@@ -3808,6 +9397,7 @@ bool saveProgram(std::string filename, ProgramData programData) {
  *   - ProgramData结构体，包含:
  *     - original：过滤掉IDE注释后的原始代码（保留用户添加的注释格式）
  *     - filtered：只包含8个有效Brainfuck指令字符的代码
+ *     - sourceMap：filtered中每个字符在original中的行列
  * 注意：
  *   - 如果文件无法打开，将返回空的ProgramData结构体
  *   - 支持的注释格式包括多行注释和单行注释
@@ -3818,6 +9408,7 @@ ProgramData loadProgram(const std::string& filename) {
     if (file.is_open()) { // 检查文件是否成功打开
         std::string line; // 用于存储每一行的内容
         bool inCommentBlock = false; // 多行注释块状态标记
+        int lineNumber = 0; // 当前行在original中的行号
         
         while (std::getline(file, line)) { // 逐行读取文件内容
             // 跳过文件头部的IDE自动添加的注释行
@@ -3845,6 +9436,7 @@ ProgramData loadProgram(const std::string& filename) {
             
             // 添加入除IDE注释外的原始代码行
             data.original += line + "\n"; // 将当前行添加到原始代码中
+            lineNumber++;
             
             // 同时过滤有效指令字符
             for (std::string::size_type i = 0; i < line.length(); i++) {
@@ -3853,6 +9445,7 @@ ProgramData loadProgram(const std::string& filename) {
                 if (ch == '[' || ch == ']' || ch == '<' || ch == '>' || 
                     ch == '.' || ch == ',' || ch == '+' || ch == '-') {
                     data.filtered += ch; // 将有效指令添加到过滤后的代码中
+                    data.sourceMap.add(lineNumber, (int)i + 1);
                 }
             }
         }
@@ -3902,6 +9495,8 @@ void renameSelectedItem(const std::string& path, std::string& itemName) {
  * 主要功能：
  * - 创建新的Brainfuck程序
  * - 运行已编辑的程序
+ * - 用断点调试程序
+ * - 编译为本地程序运行（结果按内容缓存）
  * - 保存程序到文件
  * - 清除当前程序
  * - 更改语言设置
@@ -3911,7 +9506,7 @@ void renameSelectedItem(const std::string& path, std::string& itemName) {
  * - filePath: 可选参数，初始文件完整路径，默认为空字符串
  * 处理流程：
  * 1. 初始化编辑器状态变量
- * 2. 创建编辑器菜单选项（编辑、运行、保存、清除、语言设置、返回）
+ * 2. 创建编辑器菜单选项（编辑、运行、统计执行热点、调试、本地编译运行、保存、清除、语言设置、返回）
  * 3. 进入编辑器主循环，等待用户选择操作
  * 4. 根据用户选择执行相应的功能
  * 5. 当用户选择返回主菜单时退出循环
@@ -3930,6 +9525,9 @@ void createEditor(ProgramData programData = ProgramData(), std::string fileName
         std::vector<std::string> editorOptions;
         editorOptions.push_back(tr("edit_program"));
         editorOptions.push_back(tr("run_program"));
+        editorOptions.push_back(tr("profile_program"));
+        editorOptions.push_back(tr("debug_program"));
+        editorOptions.push_back(tr("native_program"));
         editorOptions.push_back(tr("save_program"));
         editorOptions.push_back(tr("clear_program"));
         editorOptions.push_back(tr("language_settings_editor"));
@@ -3955,13 +9553,40 @@ void createEditor(ProgramData programData = ProgramData(), std::string fileName
             }
             case 1: // 运行程序
                 if (!programData.filtered.empty()) { // 检查程序是否为空
-                    running(programData.filtered); // 调用running函数运行程序
+                    running(programData); // 调用running函数运行程序
                 } else {
                     printf("%s\n", tr("program_empty").c_str()); // 提示程序为空
                 }
                 pauseScreen(); // 暂停屏幕等待用户按键
                 break;
-            case 2: // 保存程序
+            case 2: // 统计执行热点
+                if (!programData.filtered.empty()) {
+                    profileProgram(programData); // 执行后输出热点循环和热点行
+                } else {
+                    printf("%s\n", tr("program_empty").c_str());
+                }
+                pauseScreen();
+                break;
+            case 3: // 调试程序
+                if (!programData.filtered.empty()) {
+                    // 清空输入缓冲区中的换行符，调试命令按行读取
+                    int c;
+                    while ((c = getchar()) != '\n' && c != EOF);
+                    debugProgram(programData);
+                } else {
+                    printf("%s\n", tr("program_empty").c_str());
+                    pauseScreen();
+                }
+                break;
+            case 4: // 编译为本地程序并运行
+                if (!programData.filtered.empty()) {
+                    runningNative(programData); // 相同的程序第二次运行时直接使用缓存的可执行文件
+                } else {
+                    printf("%s\n", tr("program_empty").c_str());
+                }
+                pauseScreen();
+                break;
+            case 5: // 保存程序
                 if (!programData.original.empty()) { // 检查程序是否为空
                     // 获取程序目录
                     std::string programDir = getExeDir();
@@ -4027,17 +9652,18 @@ void createEditor(ProgramData programData = ProgramData(), std::string fileName
                 }
                 pauseScreen(); // 暂停屏幕等待用户按键
                 break;
-            case 3: // 清除程序
+            case 6: // 清除程序
                 programData.original.clear(); // 清空原始代码
                 programData.filtered.clear(); // 清空过滤后的代码
+                programData.sourceMap.clear();
                 currentFileName = ""; // 清空当前文件名
                 printf("%s\n", tr("program_cleared").c_str()); // 提示程序已清除
                 pauseScreen(); // 暂停屏幕等待用户按键
                 break;
-            case 4: // 语言设置
+            case 7: // 语言设置
                 languageSettings(); // 调用languageSettings函数进入语言设置
                 break;
-            case 5: // 返回主菜单
+            case 8: // 返回主菜单
                 editing = false; // 设置循环标志为false，退出编辑器循环
                 break;
             default: // 无效选择或取消
@@ -4189,9 +9815,63 @@ void open() {
     }
 }
 
+/**
+ * 命令行模式
+ * 功能：不进入菜单，直接执行指定的.bf文件，程序输出写到标准输出，提示信息写到标准错误
+ * 用法：
+ *   BFX <文件.bf>            解释执行（与编辑器中的"运行程序"相同）
+ *   BFX --native <文件.bf>   编译为本地程序执行，相同的程序再次执行时直接使用缓存
+ * 参数：
+ * - argc/argv: main()的命令行参数
+ * 返回值：
+ * - 0：执行成功
+ * - 1：指针越界错误
+ * - 2：编译错误（括号不匹配）
+ * - 3：本地编译失败
+ * - 4：参数错误或文件为空
+ */
+int runCommandLine(int argc, char* argv[]) {
+    bool native = false;
+    std::string fileName;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--native") {
+            native = true;
+        } else if (fileName.empty()) {
+            fileName = arg;
+        } else {
+            fileName.clear();
+            break;
+        }
+    }
+    if (fileName.empty()) {
+        fprintf(stderr, "usage: %s [--native] <file.bf>\n", argv[0]);
+        return 4;
+    }
+    
+    ProgramData programData = loadProgram(fileName);
+    if (programData.filtered.empty()) {
+        fprintf(stderr, "%s\n", tr("file_empty").c_str());
+        return 4;
+    }
+    
+    int result;
+    if (native) {
+        bool cached = false;
+        result = runNative(programData.filtered, cached);
+    } else {
+        result = run(programData.filtered);
+    }
+    fflush(stdout);
+    if (result == 1) fprintf(stderr, "%s\n", tr("pointer_error").c_str());
+    if (result == 2) printCompileError(programData, stderr);
+    if (result == 3) fprintf(stderr, "%s\n", tr("native_failed").c_str());
+    return result;
+}
+
 /**
  * 程序主入口
- * 功能：程序的起点，负责初始化环境、加载设置并显示主菜单
+ * 功能：程序的起点，负责初始化环境、加载设置并显示主菜单；带命令行参数时进入命令行模式（见runCommandLine()）
  * 初始化流程：
  * 1. 在Windows平台下设置控制台为UTF-8编码和支持多语言的字体
  * 2. 初始化翻译映射表和语言名称映射
@@ -4203,6 +9883,8 @@ void open() {
  * 2. 显示主菜单并获取用户选择
  * 3. 根据用户选择执行相应的功能
  * 4. 当用户选择退出时，重置颜色并返回退出状态码
+ * 参数：
+ * - argc/argv: 命令行参数，没有参数时显示主菜单
  * 返回值：程序退出状态码（0表示正常退出）
  * 副作用：
  * - 修改控制台设置（仅Windows平台）
@@ -4210,7 +9892,7 @@ void open() {
  * - 加载和保存用户设置
  * - 在控制台显示主菜单和各种状态消息
  */
-int main(){ // 主函数入口，初始化设置并显示主菜单
+int main(int argc, char* argv[]){ // 主函数入口，初始化设置并显示主菜单
     // 在Windows环境下设置控制台为UTF-8编码和支持阿拉伯语的字体
     #ifdef _WIN32
         SetConsoleOutputCP(CP_UTF8); // 设置输出代码页为UTF-8
@@ -4249,6 +9931,11 @@ int main(){ // 主函数入口，初始化设置并显示主菜单
     initializeColorNames();
     initializeColorMaps();
     
+    // 命令行模式：不加载颜色设置，也不显示菜单
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+    
     // 创建Program目录
     std::string programDir = getExeDir();
 #ifdef _WIN32